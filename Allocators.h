@@ -0,0 +1,215 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ALLOCATORS_H
+#define BGP_ALLOCATORS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <new>
+#include <memory_resource>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Backs the pools behind the RIB with huge pages where the OS allows it: a full table touches most of its pages, and with
+// 4 KiB pages that is a lot of TLB misses. Small requests are carved out of 2 MiB chunks, and freed ones are kept for the
+// next request of the same size, which is how a pool asks for memory. Requests of a chunk or more get a mapping of their
+// own. Falls back to ordinary pages (with transparent huge pages requested on Linux) when huge pages are not available,
+// so it always works. Chunks are only returned to the OS when the resource is destroyed, put a pool in front of it.
+class HugePageResource : public std::pmr::memory_resource {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    HugePageResource() = default;
+    HugePageResource(const HugePageResource &) = delete;
+    HugePageResource &operator=(const HugePageResource &) = delete;
+
+    ~HugePageResource() override {
+        for (const auto chunk : chunks_) {
+            Unmap(chunk, HUGE_PAGE_SIZE);
+        }
+    }
+
+    // Bytes mapped from the OS, whether or not they are huge pages
+    [[nodiscard]] size_t mapped() const {
+        return mapped_;
+    }
+
+    // Bytes of that that are known to be huge pages. Transparent huge pages are not counted.
+    [[nodiscard]] size_t huge_mapped() const {
+        return hugeMapped_;
+    }
+
+private:
+    void *do_allocate(size_t bytes, const size_t alignment) override {
+        bytes = RoundUp(std::max(bytes, alignment), alignof(std::max_align_t));
+        if (bytes >= HUGE_PAGE_SIZE) {
+            return MapOrThrow(RoundUp(bytes, HUGE_PAGE_SIZE));
+        }
+
+        auto &freed = freed_[bytes];
+        if (!freed.empty() && reinterpret_cast<uintptr_t>(freed.back()) % alignment == 0) {
+            const auto memory = freed.back();
+            freed.pop_back();
+            return memory;
+        }
+
+        auto offset = RoundUp(used_, alignment);
+        if (chunks_.empty() || offset + bytes > HUGE_PAGE_SIZE) {
+            chunks_.emplace_back(static_cast<uint8_t *>(MapOrThrow(HUGE_PAGE_SIZE)));
+            offset = 0;
+        }
+        used_ = offset + bytes;
+        return chunks_.back() + offset;
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, const size_t alignment) override {
+        bytes = RoundUp(std::max(bytes, alignment), alignof(std::max_align_t));
+        if (bytes >= HUGE_PAGE_SIZE) {
+            const auto size = RoundUp(bytes, HUGE_PAGE_SIZE);
+            Unmap(pointer, size);
+            mapped_ -= size;
+            return;
+        }
+        freed_[bytes].emplace_back(pointer);
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    static constexpr size_t RoundUp(const size_t value, const size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    void *MapOrThrow(const size_t size) {
+        bool huge = false;
+        const auto memory = Map(size, huge);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        mapped_ += size;
+        hugeMapped_ += huge ? size : 0;
+        return memory;
+    }
+
+    static void *Map(const size_t size, bool &huge) {
+#if defined(_WIN32)
+        // Needs SeLockMemoryPrivilege, which most accounts do not have
+        const auto largePage = GetLargePageMinimum();
+        if (largePage != 0 && size % largePage == 0) {
+            if (const auto memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                                 PAGE_READWRITE)) {
+                huge = true;
+                return memory;
+            }
+        }
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+        // Needs huge pages reserved through vm.nr_hugepages
+        const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            huge = true;
+            return memory;
+        }
+#endif
+        const auto fallback = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (fallback == MAP_FAILED) {
+            return nullptr;
+        }
+#if defined(MADV_HUGEPAGE)
+        madvise(fallback, size, MADV_HUGEPAGE);
+#endif
+        return fallback;
+#endif
+    }
+
+    static void Unmap(void *memory, const size_t size) {
+#if defined(_WIN32)
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+
+    std::vector<uint8_t *> chunks_;
+    // Bytes used in chunks_.back()
+    size_t used_ = 0;
+    std::unordered_map<size_t, std::vector<void *>> freed_;
+    size_t mapped_ = 0;
+    size_t hugeMapped_ = 0;
+};
+
+// The memory behind the RIBs and the stores feeding them: size-class pools for the small, fixed size objects they are
+// made of (table nodes, path lists, attribute sets and their values), so a full table does not scatter them across the
+// general heap and withdrawn ones are reused by the next announcement instead of fragmenting it. Optionally backed by
+// huge pages. Not synchronized, like everything that allocates from it. TODO: [14]
+class RibMemory {
+public:
+    // Largest object that gets a pool of its own, anything bigger goes straight to the upstream resource
+    static constexpr size_t LARGEST_POOLED_BLOCK = 512;
+    // Blocks per chunk the pools grow to, in bytes for the largest size class this is 2 MiB
+    static constexpr size_t MAX_BLOCKS_PER_CHUNK = 4096;
+
+    explicit RibMemory(const bool hugePages = false)
+            : hugePages_(hugePages ? std::make_unique<HugePageResource>() : nullptr),
+              pool_(std::pmr::pool_options{MAX_BLOCKS_PER_CHUNK, LARGEST_POOLED_BLOCK},
+                    hugePages_ ? hugePages_.get() : std::pmr::new_delete_resource()) {}
+
+    RibMemory(const RibMemory &) = delete;
+    RibMemory &operator=(const RibMemory &) = delete;
+
+    // Everything allocated from this has to be gone before the RibMemory is, declare it first
+    [[nodiscard]] std::pmr::memory_resource *resource() {
+        return &pool_;
+    }
+
+    // nullptr unless constructed with hugePages
+    [[nodiscard]] const HugePageResource *huge_pages() const {
+        return hugePages_.get();
+    }
+
+private:
+    std::unique_ptr<HugePageResource> hugePages_;
+    std::pmr::unsynchronized_pool_resource pool_;
+};
+
+// Bump allocator for everything decoded from one message. Allocating is a pointer increment and nothing is freed until
+// Reset(), which makes the whole message disappear at once. Messages are at most 4096 octets (65535 with RFC 8654), and
+// decode to a few times that, so the inline buffer covers nearly all of them without touching the heap.
+class MessageArena {
+public:
+    static constexpr size_t INLINE_BYTES = 64 * 1024;
+
+    MessageArena() : arena_(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource()) {}
+
+    MessageArena(const MessageArena &) = delete;
+    MessageArena &operator=(const MessageArena &) = delete;
+
+    [[nodiscard]] std::pmr::memory_resource *resource() {
+        return &arena_;
+    }
+
+    // Invalidates everything allocated since the last Reset()
+    void Reset() {
+        arena_.release();
+    }
+
+private:
+    alignas(std::max_align_t) std::array<std::byte, INLINE_BYTES> buffer_;
+    std::pmr::monotonic_buffer_resource arena_;
+};
+
+#endif //BGP_ALLOCATORS_H
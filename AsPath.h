@@ -0,0 +1,284 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ASPATH_H
+#define BGP_ASPATH_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <span>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include "Util.h"
+#include "Path.h"
+
+// RFC 6793 4.2.2, stands in for a 4-octet ASN when talking to a 2-octet-only speaker
+constexpr uint32_t AS_TRANS = 23456;
+
+struct AsPathSegmentDescriptor {
+    AsPathSegmentType Type;
+    uint8_t Length;
+    // Index of the segment's first ASN in AsPath::asns()
+    uint16_t Offset;
+
+    bool operator==(const AsPathSegmentDescriptor &other) const = default;
+};
+
+// Mutable form of an AS_PATH, only used while decoding and merging before the result is interned
+struct DecodedAsPath {
+    std::vector<uint32_t> Asns;
+    std::vector<AsPathSegmentDescriptor> Segments;
+
+    // RFC 4271 9.1.2.2 a), an AS_SET counts as one regardless of its size
+    [[nodiscard]] uint32_t length() const {
+        uint32_t length = 0;
+        for (const auto &segment : Segments) {
+            length += segment.Type == ASSet ? 1 : segment.Length;
+        }
+        return length;
+    }
+
+    void AppendSegment(const AsPathSegmentType type, std::span<const uint32_t> asns) {
+        // Adjacent AS_SEQUENCEs are folded together as long as the wire format's 255 ASN limit allows
+        if (type == ASSequence && !Segments.empty() && Segments.back().Type == ASSequence &&
+            Segments.back().Length + asns.size() <= UINT8_MAX) {
+            Segments.back().Length += static_cast<uint8_t>(asns.size());
+        } else {
+            Segments.emplace_back(AsPathSegmentDescriptor{type, static_cast<uint8_t>(asns.size()),
+                                                          static_cast<uint16_t>(Asns.size())});
+        }
+        Asns.insert(Asns.end(), asns.begin(), asns.end());
+    }
+};
+
+// Decodes an AS_PATH (2 or 4-octet ASNs, depending on what the session negotiated) or an AS4_PATH (always 4-octet)
+std::optional<DecodedAsPath> parseAsPathAttribute(std::span<const uint8_t> value, const bool fourOctetAsns) {
+    const size_t asnSize = fourOctetAsns ? 4 : 2;
+    DecodedAsPath path;
+    size_t i = 0;
+
+    while (i < value.size()) {
+        if (i + 2 > value.size()) {
+            return std::nullopt;
+        }
+
+        const auto type = static_cast<AsPathSegmentType>(value[i]);
+        const auto count = value[i + 1];
+        i += 2;
+
+        // TODO: [10] AS_CONFED_SEQUENCE and AS_CONFED_SET
+        if ((type != ASSet && type != ASSequence) || count == 0 || i + count * asnSize > value.size() ||
+            path.Asns.size() + count > UINT16_MAX) {
+            return std::nullopt;
+        }
+
+        path.Segments.emplace_back(AsPathSegmentDescriptor{type, count, static_cast<uint16_t>(path.Asns.size())});
+        for (uint8_t j = 0; j < count; ++j, i += asnSize) {
+            path.Asns.emplace_back(fourOctetAsns ? _8to32(value[i], value[i + 1], value[i + 2], value[i + 3])
+                                                 : _8to16(value[i], value[i + 1]));
+        }
+    }
+
+    return path;
+}
+
+// RFC 6793 4.2.3: reconstructs the real path from an AS_PATH carrying AS_TRANS and the AS4_PATH the OLD speakers along
+// the way passed through untouched. The leading ASNs the AS4_PATH does not account for come from the AS_PATH.
+DecodedAsPath mergeAs4Path(const DecodedAsPath &asPath, const DecodedAsPath &as4Path) {
+    const auto asPathLength = asPath.length();
+    const auto as4PathLength = as4Path.length();
+
+    if (asPathLength < as4PathLength) {
+        return asPath;
+    }
+
+    DecodedAsPath merged;
+    auto remaining = asPathLength - as4PathLength;
+
+    for (const auto &segment : asPath.Segments) {
+        if (remaining == 0) {
+            break;
+        }
+        const std::span<const uint32_t> asns(asPath.Asns.data() + segment.Offset, segment.Length);
+        if (segment.Type == ASSet) {
+            merged.AppendSegment(ASSet, asns);
+            --remaining;
+        } else {
+            const auto taken = std::min<size_t>(remaining, asns.size());
+            merged.AppendSegment(ASSequence, asns.first(taken));
+            remaining -= static_cast<uint32_t>(taken);
+        }
+    }
+
+    for (const auto &segment : as4Path.Segments) {
+        merged.AppendSegment(segment.Type, std::span<const uint32_t>(as4Path.Asns.data() + segment.Offset,
+                                                                     segment.Length));
+    }
+
+    return merged;
+}
+
+uint64_t hashAsPath(const std::vector<uint32_t> &asns, const std::vector<AsPathSegmentDescriptor> &segments) {
+    uint64_t hash = hashBytes(nullptr, 0);
+    for (const auto &segment : segments) {
+        const uint8_t descriptor[2] = {segment.Type, segment.Length};
+        hash = hashBytes(descriptor, sizeof(descriptor), hash);
+    }
+    return hashBytes(reinterpret_cast<const uint8_t *>(asns.data()), asns.size() * sizeof(uint32_t), hash);
+}
+
+// An immutable, interned AS_PATH. The ASNs of every segment sit in one contiguous array, followed in the same allocation
+// by the segment descriptors, so loop detection, length comparison and regex matching all scan a single block.
+class AsPath {
+public:
+    AsPath(const std::vector<uint32_t> &asns, const std::vector<AsPathSegmentDescriptor> &segments, const uint64_t hash,
+           const uint64_t id) : asnCount_(static_cast<uint16_t>(asns.size())),
+                                segmentCount_(static_cast<uint16_t>(segments.size())),
+                                hash_(hash),
+                                id_(id),
+                                block_(std::make_unique<uint32_t[]>(asns.size() + segments.size())) {
+        std::copy(asns.begin(), asns.end(), block_.get());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            block_[asnCount_ + i] = static_cast<uint32_t>(segments[i].Type) << 24 |
+                                    static_cast<uint32_t>(segments[i].Length) << 16 | segments[i].Offset;
+            length_ += segments[i].Type == ASSet ? 1 : segments[i].Length;
+        }
+        if (segmentCount_ > 0 && segments.front().Type == ASSequence) {
+            firstAs_ = asns[segments.front().Offset];
+        }
+        if (segmentCount_ > 0 && segments.back().Type == ASSequence) {
+            originAs_ = asns[segments.back().Offset + segments.back().Length - 1];
+        }
+    }
+
+    [[nodiscard]] std::span<const uint32_t> asns() const {
+        return {block_.get(), asnCount_};
+    }
+
+    [[nodiscard]] size_t segment_count() const {
+        return segmentCount_;
+    }
+
+    [[nodiscard]] AsPathSegmentDescriptor segment(const size_t index) const {
+        const auto packed = block_[asnCount_ + index];
+        return {static_cast<AsPathSegmentType>(packed >> 24), static_cast<uint8_t>(packed >> 16),
+                static_cast<uint16_t>(packed)};
+    }
+
+    // RFC 4271 9.1.2.2 a)
+    [[nodiscard]] uint16_t length() const {
+        return length_;
+    }
+
+    // The neighbor AS, 0 if the path is empty or starts with an AS_SET
+    [[nodiscard]] uint32_t first_as() const {
+        return firstAs_;
+    }
+
+    // The originating AS, 0 if the path is empty or ends with an AS_SET
+    [[nodiscard]] uint32_t origin_as() const {
+        return originAs_;
+    }
+
+    [[nodiscard]] uint64_t hash() const {
+        return hash_;
+    }
+
+    // Unique for the lifetime of the process, across every AsPathStore, unlike its address
+    [[nodiscard]] uint64_t id() const {
+        return id_;
+    }
+
+    // Loop detection, RFC 4271 9.1.2
+    [[nodiscard]] bool Contains(const uint32_t asn) const {
+        const auto path = asns();
+        return std::find(path.begin(), path.end(), asn) != path.end();
+    }
+
+    [[nodiscard]] std::string to_string() const {
+        std::stringstream output;
+        for (size_t i = 0; i < segmentCount_; ++i) {
+            const auto descriptor = segment(i);
+            if (i > 0) {
+                output << ' ';
+            }
+            output << (descriptor.Type == ASSet ? "{" : "");
+            for (uint16_t j = 0; j < descriptor.Length; ++j) {
+                output << (j > 0 ? (descriptor.Type == ASSet ? "," : " ") : "")
+                       << std::to_string(block_[descriptor.Offset + j]);
+            }
+            output << (descriptor.Type == ASSet ? "}" : "");
+        }
+        return output.str();
+    }
+
+private:
+    uint16_t asnCount_;
+    uint16_t segmentCount_;
+    uint16_t length_ = 0;
+    uint32_t firstAs_ = 0;
+    uint32_t originAs_ = 0;
+    uint64_t hash_;
+    uint64_t id_;
+    // asnCount_ ASNs, then segmentCount_ descriptors packed as Type << 24 | Length << 16 | Offset
+    std::unique_ptr<uint32_t[]> block_;
+};
+
+// Deduplicates AS_PATHs across attribute sets. Like PathAttributeStore it only keeps weak references.
+class AsPathStore {
+public:
+    std::shared_ptr<const AsPath> Intern(const DecodedAsPath &path) {
+        const auto hash = hashAsPath(path.Asns, path.Segments);
+        auto [it, end] = paths_.equal_range(hash);
+
+        while (it != end) {
+            if (auto existing = it->second.lock()) {
+                if (Equals(*existing, path)) {
+                    return existing;
+                }
+                ++it;
+            } else {
+                it = paths_.erase(it);
+            }
+        }
+
+        auto interned = std::make_shared<const AsPath>(path.Asns, path.Segments, hash,
+                                                       nextId_.fetch_add(1, std::memory_order_relaxed));
+        paths_.emplace(hash, interned);
+        return interned;
+    }
+
+    void Purge() {
+        std::erase_if(paths_, [](const auto &entry) { return entry.second.expired(); });
+    }
+
+    [[nodiscard]] size_t size() const {
+        return paths_.size();
+    }
+
+private:
+    static bool Equals(const AsPath &interned, const DecodedAsPath &path) {
+        if (interned.segment_count() != path.Segments.size() ||
+            !std::equal(path.Asns.begin(), path.Asns.end(), interned.asns().begin(), interned.asns().end())) {
+            return false;
+        }
+        for (size_t i = 0; i < path.Segments.size(); ++i) {
+            if (!(interned.segment(i) == path.Segments[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Shared by every store, so results cached by AsPath::id() cannot be confused across stores
+    static inline std::atomic<uint64_t> nextId_{1};
+    std::unordered_multimap<uint64_t, std::weak_ptr<const AsPath>> paths_;
+};
+
+#endif //BGP_ASPATH_H
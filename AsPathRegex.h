@@ -0,0 +1,359 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ASPATHREGEX_H
+#define BGP_ASPATHREGEX_H
+
+#include <cstdint>
+#include <cctype>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <span>
+#include "AsPath.h"
+
+// A regular expression over the ASNs of an AS_PATH rather than over its text form. The dialect is the familiar one:
+//   65000          the ASN 65000
+//   [64512-65534]  any ASN in the range, several ranges or single ASNs can be separated by commas
+//   .              any ASN
+//   _ and ' '      a token boundary, which is implicit between ASNs, so they only serve as separators
+//   ^ and $        start and end of the path, only valid at the start and end of the pattern
+//   * + ? ( ) |    as usual
+// The members of an AS_SET are matched as if they were consecutive ASNs.
+//
+// Patterns compile to a DFA whose alphabet is the set of disjoint ASN intervals the pattern distinguishes, so matching
+// is one binary search and one table lookup per ASN. Results are memoized per interned AS_PATH (by AsPath::id(), which
+// no two paths share), so a full table only pays for each distinct path once. Paths come and go under churn and ids
+// are never reused, so the cache starts over whenever it reaches MAX_CACHE_ENTRIES.
+// The result cache is not synchronized. TODO: [14]
+class AsPathRegex {
+public:
+    // Upper bound on DFA states, patterns that would exceed it are rejected rather than compiled
+    static constexpr size_t MAX_DFA_STATES = 4096;
+    // Well above the distinct AS_PATHs of a full table, about 6 MiB of cache at most
+    static constexpr size_t MAX_CACHE_ENTRIES = 1 << 18;
+
+    explicit AsPathRegex(std::string pattern) : pattern_(std::move(pattern)) {
+        Compile();
+    }
+
+    [[nodiscard]] bool Matches(const AsPath &path) const {
+        if (cache_.size() >= MAX_CACHE_ENTRIES) {
+            cache_.clear();
+        }
+        const auto [entry, inserted] = cache_.try_emplace(path.id(), false);
+        if (inserted) {
+            entry->second = Run(path.asns());
+            ++evaluations_;
+        }
+        return entry->second;
+    }
+
+    // Runs the DFA without consulting or filling the cache
+    [[nodiscard]] bool Run(std::span<const uint32_t> asns) const {
+        uint32_t state = 0;
+        if (acceptAnywhere_[state]) {
+            return true;
+        }
+        for (const auto asn : asns) {
+            const auto symbolClass = std::upper_bound(breakpoints_.begin(), breakpoints_.end(), asn) - breakpoints_.begin();
+            state = transitions_[state * classCount_ + symbolClass];
+            if (acceptAnywhere_[state]) {
+                return true;
+            }
+        }
+        return accepting_[state];
+    }
+
+    void ClearCache() {
+        cache_.clear();
+    }
+
+    [[nodiscard]] const std::string &pattern() const {
+        return pattern_;
+    }
+
+    [[nodiscard]] size_t state_count() const {
+        return accepting_.size();
+    }
+
+    // Number of distinct paths the DFA actually ran on, the rest were answered from the cache
+    [[nodiscard]] uint64_t evaluations() const {
+        return evaluations_;
+    }
+
+private:
+    struct NfaState {
+        // -1 for a pure epsilon state
+        int Symbol = -1;
+        int Next = -1;
+        std::vector<int> Epsilon;
+    };
+
+    struct Fragment {
+        int Start;
+        int End;
+    };
+
+    int NewState() {
+        nfa_.emplace_back();
+        return static_cast<int>(nfa_.size() - 1);
+    }
+
+    [[noreturn]] void Fail(const std::string &reason) const {
+        throw std::invalid_argument("Invalid AS_PATH regex '" + pattern_ + "' at offset " + std::to_string(position_) +
+                                    ": " + reason);
+    }
+
+    [[nodiscard]] bool AtEnd() const {
+        return position_ >= pattern_.size();
+    }
+
+    uint32_t ParseAsn() {
+        uint64_t value = 0;
+        const auto start = position_;
+        while (!AtEnd() && std::isdigit(static_cast<unsigned char>(pattern_[position_]))) {
+            value = value * 10 + (pattern_[position_++] - '0');
+            if (value > UINT32_MAX) {
+                Fail("ASN out of range");
+            }
+        }
+        if (position_ == start) {
+            Fail("expected an ASN");
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    Fragment Symbol(std::vector<std::pair<uint32_t, uint32_t>> intervals) {
+        symbols_.emplace_back(std::move(intervals));
+        const auto start = NewState();
+        const auto end = NewState();
+        nfa_[start].Symbol = static_cast<int>(symbols_.size() - 1);
+        nfa_[start].Next = end;
+        return {start, end};
+    }
+
+    Fragment Epsilon() {
+        const auto state = NewState();
+        return {state, state};
+    }
+
+    Fragment ParseAlternation() {
+        auto fragment = ParseConcatenation();
+        while (!AtEnd() && pattern_[position_] == '|') {
+            ++position_;
+            const auto other = ParseConcatenation();
+            const auto start = NewState();
+            const auto end = NewState();
+            nfa_[start].Epsilon = {fragment.Start, other.Start};
+            nfa_[fragment.End].Epsilon.emplace_back(end);
+            nfa_[other.End].Epsilon.emplace_back(end);
+            fragment = {start, end};
+        }
+        return fragment;
+    }
+
+    Fragment ParseConcatenation() {
+        auto fragment = Epsilon();
+        while (!AtEnd() && pattern_[position_] != '|' && pattern_[position_] != ')' &&
+               !(pattern_[position_] == '$' && position_ == pattern_.size() - 1)) {
+            const auto next = ParseRepetition();
+            nfa_[fragment.End].Epsilon.emplace_back(next.Start);
+            fragment.End = next.End;
+        }
+        return fragment;
+    }
+
+    Fragment ParseRepetition() {
+        auto fragment = ParseAtom();
+        while (!AtEnd() && (pattern_[position_] == '*' || pattern_[position_] == '+' || pattern_[position_] == '?')) {
+            const auto op = pattern_[position_++];
+            const auto start = NewState();
+            const auto end = NewState();
+            nfa_[start].Epsilon.emplace_back(fragment.Start);
+            if (op != '+') {
+                nfa_[start].Epsilon.emplace_back(end);
+            }
+            if (op != '?') {
+                nfa_[fragment.End].Epsilon.emplace_back(fragment.Start);
+            }
+            nfa_[fragment.End].Epsilon.emplace_back(end);
+            fragment = {start, end};
+        }
+        return fragment;
+    }
+
+    Fragment ParseAtom() {
+        const auto c = pattern_[position_];
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            const auto asn = ParseAsn();
+            return Symbol({{asn, asn}});
+        }
+
+        ++position_;
+        switch (c) {
+            case '_':
+            case ' ':
+                return Epsilon();
+            case '.':
+                return Symbol({{0, UINT32_MAX}});
+            case '(': {
+                const auto fragment = ParseAlternation();
+                if (AtEnd() || pattern_[position_] != ')') {
+                    Fail("expected ')'");
+                }
+                ++position_;
+                return fragment;
+            }
+            case '[': {
+                std::vector<std::pair<uint32_t, uint32_t>> intervals;
+                do {
+                    if (!intervals.empty()) {
+                        ++position_;
+                    }
+                    const auto low = ParseAsn();
+                    auto high = low;
+                    if (!AtEnd() && pattern_[position_] == '-') {
+                        ++position_;
+                        high = ParseAsn();
+                    }
+                    if (high < low) {
+                        Fail("empty ASN range");
+                    }
+                    intervals.emplace_back(low, high);
+                } while (!AtEnd() && pattern_[position_] == ',');
+                if (AtEnd() || pattern_[position_] != ']') {
+                    Fail("expected ']'");
+                }
+                ++position_;
+                return Symbol(std::move(intervals));
+            }
+            default:
+                --position_;
+                Fail(std::string("unexpected '") + c + "'");
+        }
+    }
+
+    void AddClosure(std::vector<int> &states, const int state, std::vector<bool> &visited) const {
+        if (visited[state]) {
+            return;
+        }
+        visited[state] = true;
+        states.emplace_back(state);
+        for (const auto next : nfa_[state].Epsilon) {
+            AddClosure(states, next, visited);
+        }
+    }
+
+    void Compile() {
+        bool anchoredStart = !pattern_.empty() && pattern_.front() == '^';
+        bool anchoredEnd = !pattern_.empty() && pattern_.back() == '$' && pattern_.size() > (anchoredStart ? 1 : 0);
+        position_ = anchoredStart ? 1 : 0;
+
+        const auto fragment = ParseAlternation();
+        if (!AtEnd() && !(anchoredEnd && position_ == pattern_.size() - 1)) {
+            Fail("unexpected '" + std::string(1, pattern_[position_]) + "'");
+        }
+        const auto acceptState = fragment.End;
+
+        // Split the ASN space into the intervals the pattern can tell apart
+        for (const auto &intervals : symbols_) {
+            for (const auto &[low, high] : intervals) {
+                breakpoints_.emplace_back(low);
+                if (high < UINT32_MAX) {
+                    breakpoints_.emplace_back(high + 1);
+                }
+            }
+        }
+        std::sort(breakpoints_.begin(), breakpoints_.end());
+        breakpoints_.erase(std::unique(breakpoints_.begin(), breakpoints_.end()), breakpoints_.end());
+        classCount_ = breakpoints_.size() + 1;
+
+        std::vector<std::vector<bool>> symbolCoversClass(symbols_.size(), std::vector<bool>(classCount_));
+        for (size_t symbol = 0; symbol < symbols_.size(); ++symbol) {
+            for (size_t symbolClass = 0; symbolClass < classCount_; ++symbolClass) {
+                const auto representative = symbolClass == 0 ? 0 : breakpoints_[symbolClass - 1];
+                for (const auto &[low, high] : symbols_[symbol]) {
+                    if (representative >= low && representative <= high) {
+                        symbolCoversClass[symbol][symbolClass] = true;
+                    }
+                }
+            }
+        }
+
+        // Subset construction. Without a leading ^ the start closure is folded into every state, which is the DFA
+        // equivalent of prefixing the pattern with .*
+        std::vector<int> startClosure;
+        {
+            std::vector<bool> visited(nfa_.size());
+            AddClosure(startClosure, fragment.Start, visited);
+            std::sort(startClosure.begin(), startClosure.end());
+        }
+
+        std::map<std::vector<int>, uint32_t> stateIds;
+        std::vector<std::vector<int>> pending;
+        const auto addState = [&](std::vector<int> states) -> uint32_t {
+            const auto [it, inserted] = stateIds.try_emplace(states, static_cast<uint32_t>(stateIds.size()));
+            if (inserted) {
+                if (stateIds.size() > MAX_DFA_STATES) {
+                    Fail("pattern is too complex");
+                }
+                const bool accepting = std::binary_search(states.begin(), states.end(), acceptState);
+                accepting_.emplace_back(accepting);
+                acceptAnywhere_.emplace_back(accepting && !anchoredEnd);
+                transitions_.resize(transitions_.size() + classCount_);
+                pending.emplace_back(std::move(states));
+            }
+            return it->second;
+        };
+
+        addState(startClosure);
+        for (size_t id = 0; id < pending.size(); ++id) {
+            const auto current = pending[id];
+            for (size_t symbolClass = 0; symbolClass < classCount_; ++symbolClass) {
+                std::vector<int> next;
+                std::vector<bool> visited(nfa_.size());
+                for (const auto state : current) {
+                    const auto symbol = nfa_[state].Symbol;
+                    if (symbol >= 0 && symbolCoversClass[symbol][symbolClass]) {
+                        AddClosure(next, nfa_[state].Next, visited);
+                    }
+                }
+                if (!anchoredStart) {
+                    for (const auto state : startClosure) {
+                        AddClosure(next, state, visited);
+                    }
+                }
+                std::sort(next.begin(), next.end());
+                transitions_[id * classCount_ + symbolClass] = addState(std::move(next));
+            }
+        }
+
+        nfa_.clear();
+        symbols_.clear();
+    }
+
+    std::string pattern_;
+    size_t position_ = 0;
+
+    // Only used while compiling
+    std::vector<NfaState> nfa_;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> symbols_;
+
+    // ASN class c covers [breakpoints_[c - 1], breakpoints_[c]), with the first and last classes open-ended
+    std::vector<uint32_t> breakpoints_;
+    size_t classCount_ = 1;
+    std::vector<uint32_t> transitions_;
+    std::vector<bool> accepting_;
+    std::vector<bool> acceptAnywhere_;
+
+    mutable std::unordered_map<uint64_t, bool> cache_;
+    mutable uint64_t evaluations_ = 0;
+};
+
+#endif //BGP_ASPATHREGEX_H
@@ -5,15 +5,116 @@
 #include <numeric>
 #include <iomanip>
 #include <utility>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
 
 #include "BGP.h"
 #include "BgpOpenMessage.h"
 #include "MessageType.h"
 #include "BgpHeader.h"
 #include "BgpUpdateMessage.h"
+#include "PathAttributes.h"
+#include "Allocators.h"
+#include "Rib.h"
+#include "Fib.h"
+#include "NextHopResolver.h"
+#include "Mrt.h"
+#include "MrtWriter.h"
+#include "RibSnapshot.h"
+#include "GracefulRestart.h"
+#include "RouteRefresh.h"
+#include "Export.h"
+#include "Orf.h"
+#include "Dampening.h"
+#include "MaxPrefix.h"
+#include "RouteChangeBus.h"
+#include "Bmp.h"
+#include "Metrics.h"
+#include "ConvergenceTrace.h"
+#include "Policy.h"
 #include "BgpNotificationMessage.h"
 #include "FiniteStateMachine.h"
 
+// BMP to a collector over TCP (RFC 7854 3.2), connecting again each time the exporter asks
+class TcpBmpConnection : public BmpConnection {
+public:
+    explicit TcpBmpConnection(std::shared_ptr<SocketAddress> collector) : collector_(std::move(collector)) {}
+
+    bool Connect() override {
+        socket_ = std::make_unique<TcpSocket>(collector_);
+        if (!socket_->Connect()) {
+            socket_.reset();
+            return false;
+        }
+        std::stringstream message;
+        message << "BMP connected to collector " << collector_->to_string();
+        logging::INFO(message.str());
+        return true;
+    }
+
+    bool Send(const std::span<const std::span<const uint8_t>> buffers) override {
+        return socket_ && socket_->Send(buffers);
+    }
+
+    void Close() override {
+        socket_.reset();
+    }
+
+private:
+    std::shared_ptr<SocketAddress> collector_;
+    std::unique_ptr<TcpSocket> socket_;
+};
+
+// Serves MetricsRegistry::Scrape() over HTTP, one request per connection, e.g. to a Prometheus server on the same host
+class MetricsEndpoint {
+public:
+    MetricsEndpoint(const MetricsRegistry &metrics, std::shared_ptr<SocketAddress> address)
+            : metrics_(metrics),
+              server_(std::make_shared<ServerSocket>(std::move(address))) {
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    MetricsEndpoint(const MetricsEndpoint &) = delete;
+    MetricsEndpoint &operator=(const MetricsEndpoint &) = delete;
+
+    // The listener is closed here, which fails the pending Accept(), and nowhere else: ~ServerSocket() only closes it
+    // if it is still open
+    ~MetricsEndpoint() {
+        stopping_.store(true, std::memory_order_release);
+        server_->Close();
+        thread_.join();
+    }
+
+private:
+    void Run() {
+        while (true) {
+            const auto client = server_->Accept();
+            if (stopping_.load(std::memory_order_acquire)) {
+                return;
+            }
+            if (!client) {
+                // Accept() already logged why. Whatever it is, retrying right away would only spin on it.
+                std::this_thread::sleep_for(ACCEPT_RETRY_INTERVAL);
+                continue;
+            }
+            // Whatever was asked for, the answer is the same
+            client->Receive();
+            const auto body = metrics_.Scrape();
+            const auto response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                  std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            client->Send(std::vector<uint8_t>(response.begin(), response.end()));
+        }
+    }
+
+    static constexpr auto ACCEPT_RETRY_INTERVAL = std::chrono::seconds(1);
+
+    const MetricsRegistry &metrics_;
+    std::shared_ptr<ServerSocket> server_;
+    std::atomic<bool> stopping_ = false;
+    std::thread thread_;
+};
+
 class BgpServer {
 public:
     // TODO: support for active mode
@@ -24,15 +125,194 @@ public:
         server_ = std::make_shared<ServerSocket>(serverAddress);
     }
 
+    // Lets the snapshot being written finish
+    ~BgpServer() {
+        if (snapshotWriter_.joinable()) {
+            snapshotWriter_.join();
+        }
+    }
+
+    // Loads a TABLE_DUMP_V2 RIB dump or a BGP4MP update trace (RFC 6396), e.g. from RouteViews or RIPE RIS, through the
+    // same UPDATE handling as a live session. Returns the number of records applied. Malformed records are skipped, and
+    // a truncated file, common with partial downloads, keeps whatever came before the truncation. Throws
+    // std::runtime_error if the file cannot be mapped.
+    size_t LoadMrt(const std::string &path) {
+        const MrtFile file(path);
+        MrtReader reader(file.bytes());
+        std::vector<MrtPeer> peerIndex;
+        size_t applied = 0;
+        size_t skipped = 0;
+
+        while (true) {
+            std::optional<MrtRecord> record;
+            try {
+                record = reader.Next();
+            } catch (const std::runtime_error &e) {
+                logging::WARN(path + ": " + e.what() + ", keeping the records before it");
+                break;
+            }
+            if (!record) {
+                break;
+            }
+            try {
+                applied += ApplyMrtRecord(*record, peerIndex);
+            } catch (const std::runtime_error &) {
+                ++skipped;
+            }
+            messageArena_.Reset();
+        }
+        ApplyChanges();
+        if (skipped > 0) {
+            std::stringstream message;
+            message << path << ": skipped " << skipped << " malformed MRT records";
+            logging::WARN(message.str());
+        }
+        return applied;
+    }
+
+    // Returns true if record went into the RIB. Throws std::runtime_error if it is malformed.
+    bool ApplyMrtRecord(const MrtRecord &record, std::vector<MrtPeer> &peerIndex) {
+        if (record.Type == TableDumpV2 && record.Subtype == PeerIndexTable) {
+            peerIndex = parseMrtPeerIndexTable(record);
+        } else if (record.Type == TableDumpV2 && record.Subtype == RibIpv4Unicast) {
+            const auto rib = parseMrtRib(record);
+            // Every entry is parsed before any is applied, so a malformed one skips the record as a whole
+            std::vector<std::pair<const MrtPeer *, std::pmr::vector<PathAttribute>>> entries;
+            rib.ForEachEntry([&](const MrtRibEntry &entry) {
+                if (entry.PeerIndex >= peerIndex.size() || peerIndex[entry.PeerIndex].Ipv6) {
+                    return;
+                }
+                std::pmr::vector<PathAttribute> attributes(messageArena_.resource());
+                if (!parsePathAttributes(entry.Attributes, attributes)) {
+                    throw std::runtime_error("MRT RIB entry has malformed path attributes");
+                }
+                entries.emplace_back(&peerIndex[entry.PeerIndex], std::move(attributes));
+            });
+            for (auto &[peer, attributes] : entries) {
+                BgpUpdateMessage updateMessage = {0, std::pmr::vector<Route>(messageArena_.resource()), 0,
+                                                  std::move(attributes),
+                                                  std::pmr::vector<Route>({rib.Prefix}, messageArena_.resource())};
+                HandleUpdate(updateMessage, MrtAdjRibIn(peer->Address, peer->BgpIdentifier), true);
+            }
+            return true;
+        } else if ((record.Type == Bgp4mp || record.Type == Bgp4mpEt) &&
+                   (record.Subtype == Bgp4mpMessage || record.Subtype == Bgp4mpMessageAs4)) {
+            const auto message = parseMrtBgp4mpMessage(record);
+            if (message.Message.size() <= 19 || message.PeerAddress == 0) {
+                return false;
+            }
+            const auto header = parseBgpHeader(message.Message.first(19));
+            // An UPDATE is at least its header, Withdrawn Routes Length and Total Path Attribute Length
+            if (header.Type != Update) {
+                return false;
+            }
+            if (header.Length < 23 || header.Length > message.Message.size()) {
+                throw std::runtime_error("MRT BGP4MP record has an UPDATE of length " + std::to_string(header.Length));
+            }
+            const auto updateMessage = parseUntrustedBgpUpdateMessage(
+                    message.Message.subspan(19, header.Length - 19), messageArena_.resource());
+            // BGP4MP does not carry the peer's BGP identifier, the address stands in for it
+            HandleUpdate(updateMessage, MrtAdjRibIn(message.PeerAddress, message.PeerAddress), message.FourOctetAsns);
+            return true;
+        }
+        return false;
+    }
+
     void Start() {
         // TODO: track this via user-defined config file (or interactive configuration)
         fsm_ = std::make_shared<BgpFiniteStateMachine>(
                 BgpFiniteStateMachine{0x0A010166, 0x0A010101, 65002, 65001, 16843009, 0,
-                                      AllowAutomaticStop, {}, 180, 60, {}, {}, {}, {}, [this](auto bytes) { SendMessageToPeer(bytes); }, {}});
+                                      static_cast<SessionAttributeFlagBits>(AllowAutomaticStop | DampPeerOscillations |
+                                                                            PassiveTcpEstablishment),
+                                      {}, 180, 60, {}, {}, {}, IDLE_HOLD_TIME,
+                                      [this](auto bytes) { SendMessageToPeer(bytes); },
+                                      LocalCapabilities()});
+        // TODO: track this via user-defined config file (or interactive configuration)
+        if (std::filesystem::exists(IGP_TABLE_PATH)) {
+            try {
+                const auto writtenAt = std::filesystem::last_write_time(IGP_TABLE_PATH);
+                nextHopResolver_ = NextHopResolver(loadIgpTable(IGP_TABLE_PATH));
+                locRib_.SetNextHopResolver(nextHopResolver_.resolver());
+                igpTableWrittenAt_ = writtenAt;
+            } catch (const std::runtime_error &e) {
+                logging::ERROR(std::string("Starting without the IGP table: ") + e.what());
+            } catch (const std::invalid_argument &e) {
+                logging::ERROR(std::string("Starting without the IGP table: ") + e.what());
+            }
+        }
+        peerMetrics_ = metrics_.Peer(fsm_->RemoteIpAddress);
+        // TODO: track this via user-defined config file (or interactive configuration)
+        if (std::filesystem::is_directory("mrt")) {
+            try {
+                mrtWriter_ = std::make_unique<MrtWriter>(MrtWriterOptions{"mrt"});
+            } catch (const std::runtime_error &e) {
+                logging::ERROR(std::string("Not archiving messages: ") + e.what());
+            }
+        }
+        fsm_->OnStateChange = [this](const BgpSessionState oldState, const BgpSessionState newState) {
+            peerMetrics_->StateChanged(newState);
+            peerMetrics_->Damping(fsm_->IsDamped(), fsm_->IdleHoldBackoff, fsm_->PeerOscillationsDamped);
+            // RFC 6396 4.4.1 numbers the states from 1
+            if (mrtWriter_) {
+                mrtWriter_->ArchiveStateChange(mrtSession(), oldState + 1, newState + 1);
+            }
+        };
+        // TODO: track this via user-defined config file (or interactive configuration)
+        if (std::filesystem::is_directory(TRACE_DIRECTORY)) {
+            convergenceTrace_ = std::make_unique<ConvergenceTrace>(TRACE_SAMPLE_EVERY, TRACE_CAPACITY);
+        }
+        // "<address> <port>" to serve metrics on, e.g. "127.0.0.1 9179". TODO: track this via user-defined config file
+        // (or interactive configuration)
+        if (std::filesystem::exists("metrics.txt")) {
+            std::ifstream config("metrics.txt");
+            std::string address;
+            std::string port;
+            if (config >> address >> port) {
+                metricsEndpoint_ = std::make_unique<MetricsEndpoint>(metrics_,
+                                                                     std::make_shared<SocketAddress>(address, port));
+            }
+        }
+        // "<address> <port>" of a BMP collector to export the session to. TODO: track this via user-defined config file
+        // (or interactive configuration)
+        if (std::filesystem::exists("bmp.txt")) {
+            std::ifstream config("bmp.txt");
+            std::string address;
+            std::string port;
+            if (config >> address >> port) {
+                bmpExporter_ = std::make_unique<BmpExporter>(
+                        std::make_unique<TcpBmpConnection>(std::make_shared<SocketAddress>(address, port)));
+            }
+        }
+        // Pick up what the peer advertised before a restart, if it was in the snapshot, and keep it until the peer has
+        // had a chance to re-announce it
+        const auto restored = adjRibsIn_.find(fsm_->RemoteIpAddress);
+        const bool wasRestored = restored != adjRibsIn_.end();
+        if (wasRestored) {
+            adjRibIn_ = std::move(restored->second);
+            adjRibsIn_.erase(restored);
+            peer_ = adjRibIn_->peer();
+        } else {
+            peer_ = locRib_.AddPeer(fsm_->RemoteIpAddress, fsm_->RemoteRouterId, fsm_->LocalAsn != fsm_->RemoteAsn);
+            adjRibIn_ = std::make_unique<AdjRibIn>(peer_, ribMemory_.resource());
+        }
+        adjRibOut_ = std::make_unique<AdjRibOut>(peer_, ribMemory_.resource());
+        gracefulRestart_ = std::make_unique<GracefulRestartHelper>(*adjRibIn_);
+        // Only eBGP paths are dampened (RFC 2439 4.4). TODO: track this via user-defined config file (or interactive
+        // configuration)
+        if (fsm_->LocalAsn != fsm_->RemoteAsn) {
+            dampening_ = std::make_unique<RouteDampening>();
+        }
+        if (wasRestored) {
+            gracefulRestart_->Restored(std::chrono::steady_clock::now(), std::chrono::seconds(GRACEFUL_RESTART_TIME));
+        }
         fsm_->Start();
-        fsm_->HandleEvent(AutomaticStartWithPassiveTcpEstablishment);
+        fsm_->HandleEvent(AutomaticStartWithDampPeerOscillationsAndPassiveTcpEstablishment);
 
         socket_ = server_->Accept();
+        if (!socket_) {
+            logging::ERROR("Unable to accept a connection from the peer");
+            return;
+        }
 
         std::stringstream message;
         message << "BgpServer connected to peer " << socket_->address()->to_string();
@@ -42,22 +322,167 @@ public:
         // TODO: [14]
         std::vector<uint8_t> messageBytes;
         while (!(messageBytes = socket_->Receive()).empty()) {
-            HandleMessage(messageBytes);
+            const auto previousReceive = receivedAt_;
+            receivedAt_ = std::chrono::steady_clock::now();
+            // Shared, so BMP can send the bytes as they are after HandleMessage() is done with them
+            HandleMessage(std::make_shared<const std::vector<uint8_t>>(std::move(messageBytes)));
+            UpdateGauges();
+            const auto now = std::chrono::steady_clock::now();
+            const bool established = fsm_->State == Established;
+            if (established != established_) {
+                HandleSessionStateChange(now, established);
+            }
+            SweepStaleRoutes(now);
+            ReuseDampenedRoutes(now);
+            ContinueSnapshot(now, receivedAt_ - previousReceive);
+            if (now - lastBmpStatsReport_ >= BMP_STATS_INTERVAL) {
+                ReportBmpStats(now);
+            }
+            if (bmpExporter_ && established_ && bmpExporter_->TakeResync(bmpPeer())) {
+                ExportBmpAdjRibIn();
+            }
+            if (convergenceTrace_ && now - lastTraceWrite_ >= TRACE_INTERVAL) {
+                WriteConvergenceTrace(now);
+            }
+            if (igpTableWrittenAt_ && now - lastIgpTableCheck_ >= IGP_TABLE_CHECK_INTERVAL) {
+                ReloadIgpTable(now);
+            }
+        }
+        // TODO: handle onDisconnected (FSM AutomaticStop), and keep polling while waiting for the peer to come back
+        if (established_) {
+            HandleSessionStateChange(std::chrono::steady_clock::now(), false);
         }
     }
 
+    // Loads the Loc-RIB and Adj-RIB-Ins from the last snapshot, if snapshots are enabled and there is one. Returns the
+    // number of paths loaded. A snapshot that cannot be read is moved aside to SNAPSHOT_PATH.corrupt, and the RIBs start
+    // out empty.
+    size_t RestoreSnapshot() {
+        if (!std::filesystem::exists(SNAPSHOT_PATH)) {
+            return 0;
+        }
+        size_t paths = 0;
+        try {
+            const RibSnapshot snapshot(SNAPSHOT_PATH);
+            auto restored = restoreRibSnapshot(snapshot, attributeStore_, locRib_, ribMemory_.resource());
+            for (size_t i = 0; i < restored.size(); ++i) {
+                adjRibsIn_[snapshot.peers()[i].Address] = std::move(restored[i]);
+            }
+            paths = snapshot.header().PathCount;
+        } catch (const std::runtime_error &e) {
+            // Attribute sets are all the restore leaves behind before it can fail
+            attributeStore_.Purge();
+            const auto corruptPath = std::string(SNAPSHOT_PATH) + ".corrupt";
+            std::error_code error;
+            std::filesystem::rename(SNAPSHOT_PATH, corruptPath, error);
+            logging::ERROR(std::string("Starting without the RIB snapshot: ") + e.what() + (error
+                           ? ", unable to move it aside: " + error.message() : ", moved to " + corruptPath));
+        }
+        ApplyChanges();
+        lastSnapshot_ = std::chrono::steady_clock::now();
+        return paths;
+    }
+
+    // Changes the import policy of the session, nullptr to accept everything unchanged. A peer that supports enhanced
+    // route refresh is asked to send its routes again, and they go through the new policy as they arrive. Otherwise
+    // the Adj-RIB-In is run through it.
+    void SetImportPolicy(std::shared_ptr<const RouteMap> policy) {
+        importPolicy_ = std::move(policy);
+        if (established_ && hasCapability(peerCapabilities_, EnhancedRouteRefresh)) {
+            SendMessageToPeer(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4, NormalRouteRefresh,
+                                                             ROUTE_REFRESH_SAFI_UNICAST}));
+            return;
+        }
+        ReapplyImportPolicy();
+    }
+
+    // Changes the prefix-list routes from the session have to pass before import policy, nullptr for none. If the peer
+    // accepts address prefix ORF the prefix-list is pushed to it, so it stops sending what would be dropped here and
+    // sends what is now accepted. What it sent before is run through the new prefix-list either way.
+    void SetImportPrefixList(std::shared_ptr<const PrefixList> prefixList) {
+        importPrefixList_ = std::move(prefixList);
+        ReapplyImportPolicy();
+        if (established_) {
+            PushImportPrefixList();
+        }
+    }
+
+    // Loc-RIB changes for consumers other than the FIB, e.g. archivers and monitoring
+    RouteChangeBus &route_changes() {
+        return routeChanges_;
+    }
+
+    // Everything counted and timed, for scraping from any thread
+    const MetricsRegistry &metrics() const {
+        return metrics_;
+    }
+
+    // Changes the prefix-list best paths have to pass to be advertised to the peer, nullptr for none. What was advertised
+    // before is run through the new prefix-list, the peer is sent the difference.
+    void SetExportPrefixList(std::shared_ptr<const PrefixList> prefixList) {
+        exportPrefixList_ = std::move(prefixList);
+        ExportAll();
+    }
+
+    // Changes how many prefixes the peer may send. Takes effect with its next UPDATE.
+    void SetMaximumPrefix(const MaximumPrefixLimit limit) {
+        maximumPrefix_ = MaximumPrefix(limit);
+    }
+
 private:
+    [[nodiscard]] static std::vector<BgpCapability> LocalCapabilities() {
+        auto capabilities = routeRefreshCapabilities();
+        capabilities.emplace_back(flattenOrfCapability(OrfBoth));
+        capabilities.emplace_back(flattenGracefulRestartCapability({false, GRACEFUL_RESTART_TIME, {}}));
+        return capabilities;
+    }
+
+    // Sends the import prefix-list to the peer as address prefix ORF entries, if it accepts them. No entries at all lets
+    // the peer send everything again.
+    void PushImportPrefixList() {
+        if (!peerOrf_ || !(*peerOrf_ & OrfReceive)) {
+            return;
+        }
+        const auto messages = flattenOrfRouteRefreshMessages(importPrefixList_ ? *importPrefixList_
+                                                                               : PrefixList("", {}));
+        for (const auto &message : messages) {
+            SendMessageToPeer(message);
+        }
+    }
+
     void SendMessageToPeer(const std::vector<uint8_t>& messageBytes) {
-        std::stringstream message;
-        message << "Sending bytes to peer [" << std::accumulate(messageBytes.begin() + 1, messageBytes.end(), std::to_string(messageBytes[0]), [](const std::string &a, int b) { return a + ',' + std::to_string(b); }) << "]";
-        logging::DEBUG(message.str());
+        // Not even built otherwise, a full table goes out through here
+        if constexpr (logging::LOG_LEVEL_CUTOFF <= logging::log_level::DEBUG) {
+            std::stringstream message;
+            message << "Sending bytes to peer [" << std::accumulate(messageBytes.begin() + 1, messageBytes.end(), std::to_string(messageBytes[0]), [](const std::string &a, int b) { return a + ',' + std::to_string(b); }) << "]";
+            logging::DEBUG(message.str());
+        }
+        if (messageBytes.size() >= 19 && peerMetrics_) {
+            peerMetrics_->Sent(static_cast<MessageType>(messageBytes[18]), messageBytes.size());
+        }
+        // Kept for BMP Peer Up and Peer Down
+        if (messageBytes.size() >= 19 && messageBytes[18] == Open) {
+            sentOpen_ = messageBytes;
+        } else if (messageBytes.size() >= 19 && messageBytes[18] == Notification) {
+            sentNotification_ = messageBytes;
+        }
         socket_->Send(messageBytes);
     }
 
-    void HandleMessage(const std::vector<uint8_t>& messageBytes) {
+    void HandleMessage(const std::shared_ptr<const std::vector<uint8_t>> &received) {
+        const auto &messageBytes = *received;
         const std::vector<uint8_t> headerMessageBytes(messageBytes.begin(), messageBytes.begin() + 19);
 
         const auto header = parseBgpHeader(headerMessageBytes);
+        peerMetrics_->Received(header.Type, header.Length);
+        if (mrtWriter_ && !mrtWriter_->ArchiveMessage(mrtSession(), std::span<const uint8_t>(messageBytes).first(
+                std::min<size_t>(header.Length, messageBytes.size()))) && !mrtFailureLogged_) {
+            // The writer stops for good once a file fails, which is worth saying once
+            if (const auto failure = mrtWriter_->failure(); !failure.empty()) {
+                logging::ERROR(failure + ", no longer archiving messages");
+                mrtFailureLogged_ = true;
+            }
+        }
 
         {
             std::stringstream message;
@@ -71,6 +496,13 @@ private:
             switch (header.Type) {
                 case Open: {
                     auto openMessage = parseBgpOpenMessage(payloadMessageBytes);
+                    peerGracefulRestart_ = findGracefulRestartCapability(openMessage.Capabilities);
+                    peerCapabilities_ = openMessage.Capabilities;
+                    peerOrf_ = findOrfCapability(openMessage.Capabilities);
+                    // ORF entries only last as long as the session they were sent on (RFC 5291 6)
+                    orfFilter_ = OrfFilter();
+                    orfChanged_ = false;
+                    receivedOpen_.assign(messageBytes.begin(), messageBytes.begin() + header.Length);
 //                    std::stringstream message;
 //                    message << "Received BGP OPEN message: " << openMessage.DebugOutput();
 //                    logging::DEBUG(message.str());
@@ -81,15 +513,45 @@ private:
                     break;
                 }
                 case Update: {
-                    auto updateMessage = parseBgpUpdateMessage(payloadMessageBytes);
+                    // Pre-policy, exactly as received (RFC 7854 4.6)
+                    if (bmpExporter_) {
+                        bmpExporter_->RouteMonitoring(bmpPeer(), received,
+                                                      std::span<const uint8_t>(messageBytes).first(header.Length));
+                    }
+                    const auto parseStart = std::chrono::steady_clock::now();
+                    auto updateMessage = parseBgpUpdateMessage(payloadMessageBytes, messageArena_.resource());
+                    const auto parseEnd = std::chrono::steady_clock::now();
+                    updateParseTime_.Record(parseEnd - parseStart);
+                    peerMetrics_->PrefixesReceived(updateMessage.NLRI.size(), updateMessage.WithdrawnRoutes.size());
+                    if (convergenceTrace_) {
+                        for (const auto &route : updateMessage.WithdrawnRoutes) {
+                            convergenceTrace_->Begin(route, true, receivedAt_, parseEnd);
+                        }
+                        for (const auto &route : updateMessage.NLRI) {
+                            convergenceTrace_->Begin(route, false, receivedAt_, parseEnd);
+                        }
+                    }
                     std::stringstream message;
                     message << "Received BGP UPDATE message: " << updateMessage.DebugOutput();
+                    if (isEndOfRib(updateMessage)) {
+                        gracefulRestart_->EndOfRib();
+                    }
+                    const auto duplicates = adjRibIn_->duplicate_count();
+                    HandleUpdate(updateMessage, *adjRibIn_, FOUR_OCTET_ASNS);
+                    peerMetrics_->DuplicatesReceived(adjRibIn_->duplicate_count() - duplicates);
+                    bestPathTime_.Record(std::chrono::steady_clock::now() - parseEnd);
+                    ApplyChanges(receivedAt_);
+                    if (convergenceTrace_) {
+                        convergenceTrace_->Commit();
+                    }
                     logging::DEBUG(message.str());
                     fsm_->HandleEvent(BgpUpdateMessageReceived);
+                    CheckMaximumPrefix();
                     break;
                 }
                 case Notification: {
                     auto notificationMessage = parseBgpNotificationMessage(payloadMessageBytes);
+                    receivedNotification_.assign(messageBytes.begin(), messageBytes.begin() + header.Length);
                     std::stringstream message;
                     message << "Received BGP NOTIFICATION message: " << notificationMessage.DebugOutput();
                     logging::DEBUG(message.str());
@@ -102,8 +564,16 @@ private:
                     logging::ERROR(message.str());
                     break;
                 }
+                case RouteRefresh: {
+                    try {
+                        HandleRouteRefresh(parseBgpRouteRefreshMessage(payloadMessageBytes));
+                    } catch (const std::invalid_argument &e) {
+                        logging::ERROR(e.what());
+                        fsm_->SendNotificationMessage(RouteRefreshMessageError, InvalidMessageLength);
+                    }
+                    break;
+                }
                 case ReservedMessageType:
-                case RouteRefresh:
                 default: {
                     std::stringstream message;
                     message << "Unsupported message type " << MessageTypeToString(header.Type);
@@ -121,7 +591,8 @@ private:
                     << "]";
             logging::ERROR(message.str());
         }
-
+        // Whatever was decoded from this message is gone by now, anything kept was copied out of the arena
+        messageArena_.Reset();
 
         {
             std::stringstream message;
@@ -130,15 +601,625 @@ private:
         }
     }
 
+    // Applies an UPDATE to adjRibIn and the Loc-RIB. The caller hands the Loc-RIB changes to the FIB, so they can be
+    // batched when there is more than one message to apply.
+    void HandleUpdate(const BgpUpdateMessage &updateMessage, AdjRibIn &adjRibIn, const bool fourOctetAsns) {
+        // Routes from MRT files are not dampened
+        RouteDampening *dampening = &adjRibIn == adjRibIn_.get() ? dampening_.get() : nullptr;
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto &route : updateMessage.WithdrawnRoutes) {
+            if (adjRibIn.Withdraw(route)) {
+                if (dampening) {
+                    dampening->Withdrawn(adjRibIn.peer(), route, now);
+                }
+                TraceConvergence(route, ConvergenceImported);
+                locRib_.Withdraw(adjRibIn.peer(), route);
+                TraceConvergence(route, ConvergenceBestPath);
+            }
+        }
+        if (!updateMessage.NLRI.empty()) {
+            const auto attributes = attributeStore_.Intern(updateMessage.PathAttributes, fourOctetAsns);
+            // A stale route re-announced unchanged during a refresh still goes through import policy, it may be what
+            // changed
+            const bool refreshing = &adjRibIn == adjRibIn_.get() && gracefulRestart_->refreshing();
+            for (const auto &route : updateMessage.NLRI) {
+                const bool stale = refreshing && adjRibIn.IsStale(route);
+                const bool known = dampening && adjRibIn.Find(route);
+                if (adjRibIn.Update(route, attributes) || stale) {
+                    if (dampening) {
+                        // Update() only reports a known route if its attributes changed
+                        dampening->Announced(adjRibIn.peer(), route, known && !stale, now);
+                    }
+                    ImportRoute(adjRibIn, route, attributes);
+                }
+            }
+        }
+    }
+
+    // Runs a route from adjRibIn through the import prefix-list and policy into the Loc-RIB, or out of it if either
+    // denies it or it is suppressed by dampening
+    void ImportRoute(const AdjRibIn &adjRibIn, const Route &route,
+                     const std::shared_ptr<const PathAttributeSet> &attributes) {
+        auto path = ImportPath(adjRibIn, route, attributes);
+        TraceConvergence(route, ConvergenceImported);
+        if (path) {
+            locRib_.Update(route, std::move(*path));
+        } else {
+            locRib_.Withdraw(adjRibIn.peer(), route);
+        }
+        TraceConvergence(route, ConvergenceBestPath);
+    }
+
+    // What best path gets to see of a route from adjRibIn after import policy, std::nullopt if it is not to be used.
+    // Routes from MRT files are not filtered.
+    std::optional<RibPath> ImportPath(const AdjRibIn &adjRibIn, const Route &route,
+                                      const std::shared_ptr<const PathAttributeSet> &attributes) {
+        if (&adjRibIn == adjRibIn_.get()) {
+            // A suppressed path stays in the Adj-RIB-In only, so best path never sees it
+            if (dampening_ && dampening_->IsSuppressed(adjRibIn.peer(), route)) {
+                return std::nullopt;
+            }
+            if (importPrefixList_ && importPrefixList_->Evaluate(route) == Deny) {
+                return std::nullopt;
+            }
+            if (importPolicy_) {
+                PolicyRoute policyRoute{route, *attributes};
+                if (importPolicy_->Evaluate(policyRoute) == Deny) {
+                    return std::nullopt;
+                }
+                if (policyRoute.Communities && *policyRoute.Communities != attributes->communities()) {
+                    return RibPath{adjRibIn.peer(), WithCommunities(*attributes, policyRoute.communities()),
+                                   policyRoute.Keys};
+                }
+                return RibPath{adjRibIn.peer(), attributes, policyRoute.Keys};
+            }
+        }
+        return RibPath{adjRibIn.peer(), attributes, attributes->keys()};
+    }
+
+    // attributes with the COMMUNITIES attribute replaced by communities, or removed if there are none. Everything
+    // downstream of import, from best path to the NO_EXPORT checks of export, then sees what import policy set.
+    std::shared_ptr<const PathAttributeSet> WithCommunities(const PathAttributeSet &attributes,
+                                                            const StandardCommunitySet *communities) {
+        std::vector<PathAttribute> rewritten;
+        rewritten.reserve(attributes.attributes().size() + 1);
+        for (const auto &attribute : attributes.attributes()) {
+            if (attribute.Type != CommunityAttribute) {
+                rewritten.emplace_back(attribute);
+            }
+        }
+        if (communities && communities->size() > 0) {
+            rewritten.emplace_back(PathAttribute{static_cast<uint8_t>(Optional | Transitive), CommunityAttribute,
+                                                 encodeCommunitiesAttribute(communities->values())});
+            std::stable_sort(rewritten.begin(), rewritten.end(),
+                             [](const auto &a, const auto &b) { return a.Type < b.Type; });
+        }
+        return attributeStore_.Intern(rewritten, attributes.four_octet_asns());
+    }
+
+    void TraceConvergence(const Route &route, const ConvergenceStage stage) {
+        if (convergenceTrace_) {
+            convergenceTrace_->Stamp(route, stage);
+        }
+    }
+
+    // The last TRACE_CAPACITY samples, for ConvergenceTraceDump
+    void WriteConvergenceTrace(const std::chrono::steady_clock::time_point now) {
+        lastTraceWrite_ = now;
+        try {
+            writeConvergenceTrace(TRACE_PATH, convergenceTrace_->sample_every(), convergenceTrace_->samples());
+        } catch (const std::runtime_error &e) {
+            logging::ERROR(e.what());
+        }
+    }
+
+    void ReapplyImportPolicy() {
+        adjRibIn_->ForEach([&](const Route &route, const std::shared_ptr<const PathAttributeSet> &attributes) {
+            ImportRoute(*adjRibIn_, route, attributes);
+        });
+        ApplyChanges();
+    }
+
+    // RFC 2918 and RFC 7313. Only IPv4 unicast is negotiated, anything else is ignored. TODO: [9]
+    void HandleRouteRefresh(const BgpRouteRefreshMessage &routeRefresh) {
+        std::stringstream message;
+        message << "Received ROUTE-REFRESH " << RouteRefreshSubtypeToString(routeRefresh.Subtype) << " for AFI "
+                << routeRefresh.Afi << " SAFI " << std::to_string(routeRefresh.Safi);
+        logging::DEBUG(message.str());
+        if (routeRefresh.Afi != ROUTE_REFRESH_AFI_IPV4 || routeRefresh.Safi != ROUTE_REFRESH_SAFI_UNICAST) {
+            return;
+        }
+        switch (routeRefresh.Subtype) {
+            case NormalRouteRefresh: {
+                // RFC 5291 5: new ORF entries replace the peer's outbound filter, and only trigger a refresh if the
+                // peer asks for it right away
+                if (!routeRefresh.Orf.empty()) {
+                    if (!peerOrf_ || !(*peerOrf_ & OrfSend)) {
+                        return;
+                    }
+                    const auto request = parseOrfRequest(routeRefresh.Orf);
+                    orfFilter_.Apply(request.Entries);
+                    orfChanged_ = true;
+                    if (request.When == OrfDefer) {
+                        return;
+                    }
+                }
+                // The Adj-RIB-Out only reflects the new entries once the Loc-RIB went through export again, which
+                // also withdraws what they now deny
+                if (orfChanged_) {
+                    orfChanged_ = false;
+                    ExportAll();
+                }
+                // Straight from the Adj-RIB-Out, demarcated if the peer understands it
+                const bool enhanced = hasCapability(peerCapabilities_, EnhancedRouteRefresh);
+                if (enhanced) {
+                    SendMessageToPeer(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4, BeginningOfRouteRefresh,
+                                                                     ROUTE_REFRESH_SAFI_UNICAST}));
+                }
+                forEachRefreshUpdate(*adjRibOut_, [&](const std::vector<uint8_t> &update) {
+                    SendMessageToPeer(update);
+                });
+                if (enhanced) {
+                    SendMessageToPeer(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4, EndOfRouteRefresh,
+                                                                     ROUTE_REFRESH_SAFI_UNICAST}));
+                }
+                break;
+            }
+            case BeginningOfRouteRefresh:
+                gracefulRestart_->BeginRouteRefresh(std::chrono::steady_clock::now());
+                break;
+            case EndOfRouteRefresh:
+                gracefulRestart_->EndRouteRefresh();
+                break;
+            default:
+                // RFC 7313 5: unknown subtypes are ignored
+                break;
+        }
+    }
+
+    // Graceful restart (RFC 4724) as the receiving speaker. The restart time and forwarding state the peer advertised
+    // are taken from its last OPEN.
+    void HandleSessionStateChange(const std::chrono::steady_clock::time_point now, const bool established) {
+        established_ = established;
+        if (established) {
+            gracefulRestart_->SessionEstablished(now, peerGracefulRestart_);
+        } else {
+            gracefulRestart_->SessionDown(now, peerGracefulRestart_);
+        }
+        std::stringstream message;
+        message << "Graceful restart: " << GracefulRestartStateToString(gracefulRestart_->state()) << ", "
+                << gracefulRestart_->stale_count() << " stale routes";
+        logging::INFO(message.str());
+        if (!established) {
+            std::stringstream counters;
+            counters << "Adj-RIB-In: " << adjRibIn_->prefix_count() << " prefixes, " << adjRibIn_->duplicate_count()
+                     << " of " << adjRibIn_->announcement_count() << " announcements were duplicates";
+            logging::INFO(counters.str());
+            std::stringstream damping;
+            damping << "Peer oscillation damping: " << (fsm_->IsDamped() ? "damped" : "not damped") << ", IdleHoldTimer "
+                    << fsm_->IdleHoldBackoff << "s, damped " << fsm_->PeerOscillationsDamped << " times";
+            logging::INFO(damping.str());
+        }
+        ExportSessionStateChange(established);
+        // The peer forgot the ORF entries of the last session (RFC 5291 6), and never got any set before Start()
+        if (established && importPrefixList_) {
+            PushImportPrefixList();
+        }
+        StartExport(established);
+    }
+
+    // BMP Peer Up with both OPENs, or Peer Down with whichever NOTIFICATION ended the session
+    void ExportSessionStateChange(const bool established) {
+        if (bmpExporter_) {
+            const auto now = std::chrono::system_clock::now();
+            if (established) {
+                bmpExporter_->PeerUp(bmpPeer(), flattenBmpPeerUp(bmpPeer(), now, fsm_->LocalIpAddress, BGP_PORT,
+                                                                 ntohs(socket_->address()->port()), sentOpen_,
+                                                                 receivedOpen_));
+            } else if (!sentNotification_.empty()) {
+                bmpExporter_->PeerDown(bmpPeer(), flattenBmpPeerDown(bmpPeer(), now, BmpLocalNotification,
+                                                                     sentNotification_));
+            } else if (!receivedNotification_.empty()) {
+                bmpExporter_->PeerDown(bmpPeer(), flattenBmpPeerDown(bmpPeer(), now, BmpRemoteNotification,
+                                                                     receivedNotification_));
+            } else {
+                bmpExporter_->PeerDown(bmpPeer(), flattenBmpPeerDown(bmpPeer(), now, BmpRemoteNoData));
+            }
+        }
+        sentNotification_.clear();
+        receivedNotification_.clear();
+    }
+
+    // Picks up changes to the IGP table file. Next hops whose resolution changed are re-resolved in the Loc-RIB and the
+    // FIB, and the prefixes whose best path moved with them reach the peer like any other change.
+    void ReloadIgpTable(const std::chrono::steady_clock::time_point now) {
+        lastIgpTableCheck_ = now;
+        std::error_code error;
+        const auto writtenAt = std::filesystem::last_write_time(IGP_TABLE_PATH, error);
+        if (error || writtenAt == *igpTableWrittenAt_) {
+            return;
+        }
+        igpTableWrittenAt_ = writtenAt;
+        IgpTable table;
+        try {
+            table = loadIgpTable(IGP_TABLE_PATH);
+        } catch (const std::runtime_error &e) {
+            logging::ERROR(std::string("Keeping the previous IGP table: ") + e.what());
+            return;
+        } catch (const std::invalid_argument &e) {
+            logging::ERROR(std::string("Keeping the previous IGP table: ") + e.what());
+            return;
+        }
+        const auto changes = nextHopResolver_.Replace(table);
+        size_t pathLists = 0;
+        for (const auto &change : changes) {
+            pathLists += locRib_.SetNextHopResolution(change.Address, change.Resolution);
+            fib_.Refresh(change.Address);
+        }
+        std::stringstream message;
+        message << "Reloaded the IGP table, " << changes.size() << " next hop changes, " << pathLists
+                << " path lists with a new best path";
+        logging::INFO(message.str());
+        ApplyChanges();
+    }
+
+    void ReportBmpStats(const std::chrono::steady_clock::time_point now) {
+        lastBmpStatsReport_ = now;
+        if (!bmpExporter_ || !established_) {
+            return;
+        }
+        const BmpStat stats[] = {{BmpStatDuplicatePrefixes, adjRibIn_->duplicate_count()},
+                                 {BmpStatAdjRibInRoutes, adjRibIn_->prefix_count()}};
+        bmpExporter_->StatsReport(flattenBmpStatsReport(bmpPeer(), std::chrono::system_clock::now(), stats));
+        if (const auto dropped = bmpExporter_->dropped_count(); dropped != bmpDropped_) {
+            std::stringstream message;
+            message << "BMP collector is not keeping up, " << dropped << " messages dropped so far";
+            logging::WARN(message.str());
+            bmpDropped_ = dropped;
+        }
+    }
+
+    // Table sizes and queue depths, after every message
+    void UpdateGauges() {
+        peerMetrics_->AdjRibInPrefixes.Set(adjRibIn_->prefix_count());
+        locRibPrefixes_.Set(static_cast<int64_t>(locRib_.size()));
+        locRibPaths_.Set(static_cast<int64_t>(locRib_.path_count()));
+        attributeSets_.Set(static_cast<int64_t>(attributeStore_.size()));
+        if (bmpExporter_) {
+            bmpQueuedBytes_.Set(static_cast<int64_t>(bmpExporter_->queued_bytes()));
+        }
+    }
+
+    // RFC 7854 5: the whole Adj-RIB-In as Route Monitoring messages followed by End-of-RIB, for a collector that
+    // connected after the session came up or missed some of its messages. Withdrawals it missed are not repaired.
+    void ExportBmpAdjRibIn() {
+        const auto peer = bmpPeer();
+        std::unordered_map<const PathAttributeSet *, std::vector<Route>> groups;
+        adjRibIn_->ForEach([&](const Route &route, const std::shared_ptr<const PathAttributeSet> &attributes) {
+            groups[attributes.get()].emplace_back(route);
+        });
+        size_t messages = 0;
+        for (const auto &[attributes, routes] : groups) {
+            messages += forEachAnnouncementUpdate(*attributes, routes, [&](const std::vector<uint8_t> &update) {
+                bmpExporter_->RouteMonitoring(peer, update);
+            });
+        }
+        bmpExporter_->RouteMonitoring(peer, flattenBgpUpdateMessage({0, {}, 0, {}, {}}));
+        std::stringstream message;
+        message << "Sent the BMP collector the Adj-RIB-In: " << adjRibIn_->prefix_count() << " prefixes in "
+                << messages << " Route Monitoring messages";
+        logging::INFO(message.str());
+    }
+
+    [[nodiscard]] BmpPeer bmpPeer() const {
+        return {fsm_->RemoteIpAddress, fsm_->RemoteAsn, fsm_->RemoteRouterId};
+    }
+
+    // Removes a batch of the session's stale routes, if any are due to go
+    void SweepStaleRoutes(const std::chrono::steady_clock::time_point now) {
+        const auto swept = gracefulRestart_->Poll(now, [&](const Route &route) {
+            locRib_.Withdraw(peer_, route);
+        });
+        if (swept > 0) {
+            ApplyChanges();
+        }
+    }
+
+    // Hands what changed in the Loc-RIB since the last call, next hop changes included, to the FIB and the peer, and
+    // publishes it to everything else. receivedAt is when the UPDATE behind the changes came off the socket, if an
+    // UPDATE is what they came from.
+    void ApplyChanges(const std::optional<std::chrono::steady_clock::time_point> receivedAt = std::nullopt) {
+        const auto changes = locRib_.TakeChanges();
+        fib_.Apply(changes);
+        if (convergenceTrace_) {
+            convergenceTrace_->StampAll(ConvergencePublished);
+        }
+        if (routeExporter_) {
+            for (const auto &change : changes) {
+                ExportRoute(change.Prefix, change.Best ? &*change.Best : nullptr);
+            }
+            FlushExports(receivedAt);
+        }
+        routeChanges_.Publish(changes);
+    }
+
+    // Outbound policy: best is only advertised if the export prefix-list and the peer's ORF entries both permit it
+    void ExportRoute(const Route &route, const RibPath *best) {
+        if (best && exportPrefixList_ && exportPrefixList_->Evaluate(route) == Deny) {
+            best = nullptr;
+        }
+        if (best) {
+            if (const auto &orf = orfFilter_.filter(); orf && orf->Evaluate(route) == Deny) {
+                best = nullptr;
+            }
+        }
+        routeExporter_->Export(route, best, best ? &locRib_.peer(best->Peer) : nullptr);
+    }
+
+    // Runs the whole Loc-RIB through export again, e.g. after outbound policy changed. The peer is only sent what ends
+    // up different in the Adj-RIB-Out.
+    void ExportAll() {
+        if (!routeExporter_) {
+            return;
+        }
+        locRib_.ForEach([&](const Route &route, const PathList &list) {
+            ExportRoute(route, list.best());
+        });
+        FlushExports();
+    }
+
+    // Sends the peer what changed in its Adj-RIB-Out. With receivedAt, every UPDATE written counts towards the receive
+    // to send latency.
+    void FlushExports(const std::optional<std::chrono::steady_clock::time_point> receivedAt = std::nullopt) {
+        routeExporter_->Flush([&](const std::vector<uint8_t> &update, const std::span<const Route> routes) {
+            SendMessageToPeer(update);
+            if (receivedAt) {
+                receiveToSendTime_.Record(std::chrono::steady_clock::now() - *receivedAt);
+            }
+            if (convergenceTrace_) {
+                for (const auto &route : routes) {
+                    convergenceTrace_->Stamp(route, ConvergenceSent);
+                }
+            }
+        });
+    }
+
+    // The Adj-RIB-Out starts out empty with every session. Once established the peer gets the whole Loc-RIB through
+    // export, followed by End-of-RIB if it does graceful restart (RFC 4724 2).
+    void StartExport(const bool established) {
+        routeExporter_.reset();
+        adjRibOut_->Clear();
+        if (!established) {
+            return;
+        }
+        routeExporter_ = std::make_unique<RouteExporter>(
+                ExportSession{peer_, fsm_->LocalAsn, fsm_->LocalIpAddress, fsm_->LocalAsn != fsm_->RemoteAsn,
+                              FOUR_OCTET_ASNS}, *adjRibOut_, attributeStore_);
+        ExportAll();
+        if (peerGracefulRestart_) {
+            SendMessageToPeer(flattenBgpUpdateMessage({0, {}, 0, {}, {}}));
+        }
+    }
+
+    // RFC 4486 4: tears the session down once the peer has sent more prefixes than it may. Its routes are removed, a
+    // NOTIFICATION ends graceful restart. The session stays down until it is started again.
+    void CheckMaximumPrefix() {
+        const auto count = adjRibIn_->prefix_count();
+        const auto action = maximumPrefix_.Check(count);
+        if (action == MaximumPrefixNone) {
+            return;
+        }
+        std::stringstream message;
+        message << "Peer sent " << count << " prefixes, maximum is " << maximumPrefix_.limit().Maximum;
+        if (action == MaximumPrefixWarning) {
+            logging::WARN(message.str());
+            return;
+        }
+        message << ", tearing down the session";
+        logging::ERROR(message.str());
+        peerGracefulRestart_ = std::nullopt;
+        fsm_->AutomaticStopSubcode = MaximumNumberOfPrefixesReached;
+        fsm_->HandleEvent(AutomaticStop);
+        fsm_->AutomaticStopSubcode = AdministrativeShutdown;
+        // Ends the receive loop. The session is not started again, Start() only serves one connection.
+        socket_->Close();
+    }
+
+    // Puts paths whose dampening penalty has decayed back into the Loc-RIB, if the peer still announces them
+    void ReuseDampenedRoutes(const std::chrono::steady_clock::time_point now) {
+        if (!dampening_) {
+            return;
+        }
+        const auto reused = dampening_->Poll(now, [&](const PeerId, const Route &route) {
+            if (const auto attributes = adjRibIn_->Find(route)) {
+                ImportRoute(*adjRibIn_, route, *attributes);
+            }
+        });
+        if (reused > 0) {
+            ApplyChanges();
+        }
+    }
+
+    [[nodiscard]] MrtSession mrtSession() const {
+        return {fsm_->RemoteAsn, fsm_->LocalAsn, fsm_->RemoteIpAddress, fsm_->LocalIpAddress, 0, FOUR_OCTET_ASNS};
+    }
+
+    // One Adj-RIB-In per peer seen in MRT files, keyed by address. Collector peers are taken to be eBGP.
+    AdjRibIn &MrtAdjRibIn(const uint32_t address, const uint32_t bgpIdentifier) {
+        auto &adjRibIn = adjRibsIn_[address];
+        if (!adjRibIn) {
+            adjRibIn = std::make_unique<AdjRibIn>(locRib_.AddPeer(address, bgpIdentifier, true), ribMemory_.resource());
+        }
+        return *adjRibIn;
+    }
+
+    // Snapshots are taken only if SNAPSHOT_DIRECTORY exists. The RIBs are captured SNAPSHOT_BATCH routes per message,
+    // or all at once if the peer has been quiet for SNAPSHOT_QUIET, and the capture is written on a thread of its own.
+    // TODO: track this via user-defined config file (or interactive configuration)
+    void ContinueSnapshot(const std::chrono::steady_clock::time_point now,
+                          const std::chrono::steady_clock::duration sinceLastMessage) {
+        if (!snapshotCapture_) {
+            if (now - lastSnapshot_ < SNAPSHOT_INTERVAL) {
+                return;
+            }
+            lastSnapshot_ = now;
+            if (!std::filesystem::is_directory(SNAPSHOT_DIRECTORY)) {
+                return;
+            }
+            if (snapshotWriting_.load(std::memory_order_acquire)) {
+                logging::WARN("The last RIB snapshot is still being written, skipping this one");
+                return;
+            }
+            std::vector<const AdjRibIn *> adjRibsIn = {adjRibIn_.get()};
+            for (const auto &[address, adjRibIn] : adjRibsIn_) {
+                adjRibsIn.emplace_back(adjRibIn.get());
+            }
+            snapshotCapture_ = std::make_unique<RibSnapshotCapturer>(locRib_, std::move(adjRibsIn));
+        }
+        if (!snapshotCapture_->Step(sinceLastMessage >= SNAPSHOT_QUIET ? SIZE_MAX : SNAPSHOT_BATCH)) {
+            return;
+        }
+        if (snapshotWriter_.joinable()) {
+            snapshotWriter_.join();
+        }
+        snapshotWriting_.store(true, std::memory_order_release);
+        snapshotWriter_ = std::thread([this, capture = snapshotCapture_->Take()]() mutable {
+            try {
+                writeRibSnapshot(SNAPSHOT_PATH, std::move(capture));
+            } catch (const std::runtime_error &e) {
+                logging::ERROR(e.what());
+            }
+            snapshotWriting_.store(false, std::memory_order_release);
+        });
+        snapshotCapture_.reset();
+    }
+
+    static constexpr uint16_t BGP_PORT = 179;
+    // The 4-octet AS number capability (RFC 6793) is not advertised, so the session's AS_PATHs are 2-octet
+    static constexpr bool FOUR_OCTET_ASNS = false;
+    static constexpr const char *TRACE_DIRECTORY = "trace";
+    static constexpr const char *TRACE_PATH = "trace/convergence.trace";
+    static constexpr std::chrono::seconds TRACE_INTERVAL{60};
+    // 1 in 64 prefixes, and the last 64k of their changes
+    static constexpr uint32_t TRACE_SAMPLE_EVERY = 64;
+    static constexpr size_t TRACE_CAPACITY = 65536;
+    static constexpr std::chrono::seconds BMP_STATS_INTERVAL{60};
+    static constexpr const char *IGP_TABLE_PATH = "igp.txt";
+    static constexpr std::chrono::seconds IGP_TABLE_CHECK_INTERVAL{5};
+    static constexpr const char *SNAPSHOT_DIRECTORY = "snapshot";
+    static constexpr const char *SNAPSHOT_PATH = "snapshot/rib.snapshot";
+    static constexpr std::chrono::minutes SNAPSHOT_INTERVAL{5};
+    // Routes captured per message while a snapshot is being taken, a few milliseconds' worth
+    static constexpr size_t SNAPSHOT_BATCH = 16384;
+    static constexpr std::chrono::seconds SNAPSHOT_QUIET{1};
+    // Seconds, advertised to the peer and used for routes restored from a snapshot
+    static constexpr uint16_t GRACEFUL_RESTART_TIME = 120;
+    // Seconds a peer that failed is first held in Idle, doubling while it keeps failing
+    static constexpr uint16_t IDLE_HOLD_TIME = 5;
+    // Twice a full IPv4 table, so a peer leaking something bigger cannot take all the memory
+    static constexpr uint32_t MAXIMUM_PREFIXES = 2000000;
+
     std::shared_ptr<ServerSocket> server_;
     std::shared_ptr<TcpSocket> socket_;
     std::shared_ptr<BgpFiniteStateMachine> fsm_;
+    MessageArena messageArena_;
+    // Declared before everything allocating from it
+    RibMemory ribMemory_;
+    PathAttributeStore attributeStore_{ribMemory_.resource()};
+    // TODO: [14] one per session
+    PeerId peer_ = 0;
+    std::unique_ptr<AdjRibIn> adjRibIn_;
+    // What is advertised to the peer, after export policy
+    std::unique_ptr<AdjRibOut> adjRibOut_;
+    // Keeps adjRibOut_ up to date while the session is established, nullptr otherwise
+    std::unique_ptr<RouteExporter> routeExporter_;
+    std::unique_ptr<GracefulRestartHelper> gracefulRestart_;
+    // nullptr if the session's paths are not dampened
+    std::unique_ptr<RouteDampening> dampening_;
+    // TODO: track this via user-defined config file (or interactive configuration)
+    MaximumPrefix maximumPrefix_{{MAXIMUM_PREFIXES}};
+    // From the peer's last OPEN
+    std::vector<BgpCapability> peerCapabilities_;
+    std::optional<GracefulRestartCapability> peerGracefulRestart_;
+    std::optional<OrfSendReceive> peerOrf_;
+    // The peer's ORF entries, applied to everything sent to it
+    OrfFilter orfFilter_;
+    // ORF entries arrived that export has not seen yet, e.g. deferred until the peer's next ROUTE-REFRESH
+    bool orfChanged_ = false;
+    // nullptr accepts every route unchanged
+    std::shared_ptr<const PrefixList> importPrefixList_;
+    std::shared_ptr<const RouteMap> importPolicy_;
+    std::shared_ptr<const PrefixList> exportPrefixList_;
+    bool established_ = false;
+    NextHopResolver nextHopResolver_;
+    // When the IGP table file was last read, std::nullopt if next hops are not resolved against one
+    std::optional<std::filesystem::file_time_type> igpTableWrittenAt_;
+    std::chrono::steady_clock::time_point lastIgpTableCheck_ = std::chrono::steady_clock::now();
+    LocRib locRib_{ribMemory_.resource()};
+    // Adj-RIB-Ins of peers other than the session's, keyed by address: peers seen in MRT files, and peers restored from
+    // a snapshot that have not come back yet
+    std::unordered_map<uint32_t, std::unique_ptr<AdjRibIn>> adjRibsIn_;
+    std::chrono::steady_clock::time_point lastSnapshot_ = std::chrono::steady_clock::now();
+    // The snapshot being captured, nullptr between snapshots
+    std::unique_ptr<RibSnapshotCapturer> snapshotCapture_;
+    std::thread snapshotWriter_;
+    std::atomic<bool> snapshotWriting_ = false;
+    // Archives received messages and state changes, nullptr if disabled
+    std::unique_ptr<MrtWriter> mrtWriter_;
+    bool mrtFailureLogged_ = false;
+    // Exports the session to a BMP collector, nullptr if disabled
+    std::unique_ptr<BmpExporter> bmpExporter_;
+    std::chrono::steady_clock::time_point lastBmpStatsReport_ = std::chrono::steady_clock::now();
+    uint64_t bmpDropped_ = 0;
+    // The last OPEN and NOTIFICATION each side sent, whole, for BMP
+    std::vector<uint8_t> sentOpen_;
+    std::vector<uint8_t> receivedOpen_;
+    std::vector<uint8_t> sentNotification_;
+    std::vector<uint8_t> receivedNotification_;
+    MetricsRegistry metrics_;
+    std::shared_ptr<PeerMetrics> peerMetrics_;
+    LatencyHistogram &updateParseTime_ = metrics_.Histogram("bgp_update_parse", "Time to decode an UPDATE");
+    LatencyHistogram &bestPathTime_ = metrics_.Histogram(
+            "bgp_best_path", "Time to run a decoded UPDATE through the Adj-RIB-In, import policy and best path");
+    LatencyHistogram &receiveToSendTime_ = metrics_.Histogram(
+            "bgp_receive_to_send", "Time from an UPDATE coming off the socket to the UPDATEs it caused being written to "
+                                   "the peer");
+    MetricGauge &locRibPrefixes_ = metrics_.Gauge("bgp_loc_rib_prefixes", "Prefixes in the Loc-RIB");
+    MetricGauge &locRibPaths_ = metrics_.Gauge("bgp_loc_rib_paths", "Paths in the Loc-RIB");
+    MetricGauge &attributeSets_ = metrics_.Gauge("bgp_attribute_sets", "Distinct path attribute sets");
+    MetricGauge &bmpQueuedBytes_ = metrics_.Gauge("bgp_bmp_queued_bytes", "Bytes waiting for the BMP collector");
+    std::chrono::steady_clock::time_point receivedAt_;
+    // Samples prefix changes on their way to the FIB and the peer, nullptr if disabled
+    std::unique_ptr<ConvergenceTrace> convergenceTrace_;
+    std::chrono::steady_clock::time_point lastTraceWrite_ = std::chrono::steady_clock::now();
+    // Declared after metrics_, so it stops serving before the metrics go away
+    std::unique_ptr<MetricsEndpoint> metricsEndpoint_;
+    Fib fib_;
+    RouteChangeBus routeChanges_;
 };
 
-int main() {
+int main(int argc, char **argv) {
     InitializeSocketSubsystem();
 
     BgpServer server;
+    if (const auto paths = server.RestoreSnapshot()) {
+        std::stringstream message;
+        message << "Restored " << paths << " paths from the RIB snapshot";
+        logging::INFO(message.str());
+    }
+    // Seeds the RIB from MRT files given on the command line, e.g. a lab instance loading a RouteViews dump
+    for (int i = 1; i < argc; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            const auto records = server.LoadMrt(argv[i]);
+            std::stringstream message;
+            message << "Loaded " << records << " MRT records from " << argv[i] << " in "
+                    << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s";
+            logging::INFO(message.str());
+        } catch (const std::runtime_error &e) {
+            logging::ERROR(std::string("Skipping MRT file: ") + e.what());
+        }
+    }
     server.Start();
 
     std::string line;
@@ -30,7 +30,6 @@
 // TODO: [10] Support for RFC 5065 (Confederations)
 // TODO: [11] Support for the rest of the possible path attribute types, reference the IANA registry
 // TODO: [12] Evaluate the pros/cons of foregoing using std::vector<uint8_t>, and switching over to raw pointers (uint8_t*, void*, et al). This will require empirical evidence being gathered, via performance/memory tests, including full/multiple table edge cases
-// TODO: [13] If a BGP UPDATE message is received with the same prefix in the WithdrawnRoutes and NLRI fields, ignore the prefix in WithdrawnRoutes
 // TODO: [14] Multithreading, split out BGPServer/BGPSession
 
 #endif //BGP_BGP_H
\ No newline at end of file
@@ -7,6 +7,9 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+#include <sstream>
+#include <cassert>
 
 enum CapabilityCode : uint8_t
 {
@@ -123,12 +126,16 @@ struct BgpCapability
     }
 };
 
+// Each capability goes into an optional parameter of its own (RFC 5492 4), which is what parseBgpCapabilities() expects
 std::vector<uint8_t> flattenBgpCapabilities(const std::vector<BgpCapability>& capabilities)
 {
-    std::vector<uint8_t> flattenedCapabilities(capabilities.size() * 3);
+    std::vector<uint8_t> flattenedCapabilities;
 
     for (const auto& capability : capabilities)
     {
+        // Optional Parameter Type 2, Capabilities
+        flattenedCapabilities.emplace_back(0x02);
+        flattenedCapabilities.emplace_back(static_cast<uint8_t>(capability.Length + 2));
         flattenedCapabilities.emplace_back(static_cast<uint8_t>(capability.Code));
         flattenedCapabilities.emplace_back(capability.Length);
         flattenedCapabilities.insert(flattenedCapabilities.end(), capability.Value.begin(), capability.Value.end());
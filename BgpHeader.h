@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <array>
 #include <vector>
+#include <span>
 #include <cassert>
 #include "MessageType.h"
 #include "Util.h"
@@ -35,7 +36,7 @@ std::array<uint8_t, 19> generateBgpHeader(const uint16_t payloadLength, const Me
             };
 }
 
-BgpHeader parseBgpHeader(const std::vector<uint8_t>& messageBytes)
+BgpHeader parseBgpHeader(const std::span<const uint8_t> messageBytes)
 {
     assert(messageBytes.size() == 19);
 
@@ -29,7 +29,8 @@ struct BgpOpenMessage
 
         for (const auto& capability : Capabilities)
         {
-            capabilitiesLength += capability.Length + 2;
+            // Optional parameter header, then the capability header
+            capabilitiesLength += capability.Length + 4;
         }
 
         return capabilitiesLength;
@@ -11,16 +11,25 @@
 #include <sstream>
 #include <cassert>
 #include <array>
+#include <span>
+#include <algorithm>
+#include <stdexcept>
+#include <memory_resource>
 #include "Util.h"
+#include "MessageType.h"
+#include "BgpHeader.h"
 #include "Route.h"
 #include "Path.h"
 
+// Everything parseBgpUpdateMessage() allocates comes from one memory resource, normally a per-message arena that is reset
+// once the message has been handled. Anything kept past that has to be copied, PathAttributeStore::Intern() does.
 struct BgpUpdateMessage {
     uint16_t WithdrawnRoutesLength;
-    std::vector<Route> WithdrawnRoutes;
+    std::pmr::vector<Route> WithdrawnRoutes;
     uint16_t PathAttributesLength;
-    std::vector<PathAttribute> PathAttributes;
-    std::vector<NLRI> NLRI;
+    std::pmr::vector<PathAttribute> PathAttributes;
+    // Route and NLRI are the same type, spelled Route here so the member does not shadow it
+    std::pmr::vector<Route> NLRI;
 
     [[nodiscard]] std::string DebugOutput() const {
         std::stringstream output;
@@ -47,31 +56,99 @@ struct BgpUpdateMessage {
     }
 };
 
-std::vector<uint8_t> flattenBgpUpdateMessage(const BgpUpdateMessage message) {
-    std::vector<uint8_t> updateMessage = {
-            _16to8(message.WithdrawnRoutesLength)
-    };
+// RFC 4271 4.3: a length octet followed by only as many octets as the length needs. Host bits are cleared. Returns false
+// if bytes ends in the middle of a prefix or a length is over 32. TODO: [9]
+bool parseIpv4Prefixes(const std::span<const uint8_t> bytes, std::pmr::vector<Route> &routes) {
+    size_t i = 0;
+    while (i < bytes.size()) {
+        const auto length = bytes[i++];
+        const size_t octets = (length + 7) / 8;
+        if (length > 32 || i + octets > bytes.size()) {
+            return false;
+        }
+        uint32_t prefix = 0;
+        for (size_t octet = 0; octet < 4; ++octet) {
+            prefix = prefix << 8 | (octet < octets ? bytes[i + octet] : 0);
+        }
+        routes.emplace_back(Route{length, length == 0 ? 0 : prefix & UINT32_MAX << (32 - length)});
+        i += octets;
+    }
+    return true;
+}
 
-    for (const auto &withdrawnRoute : message.WithdrawnRoutes) {
-        updateMessage.emplace_back(withdrawnRoute.Length);
-        uint8_t prefixBytes[4] = {_32to8(withdrawnRoute.Prefix)};
-        updateMessage.emplace_back(prefixBytes[0]);
-        updateMessage.emplace_back(prefixBytes[1]);
-        updateMessage.emplace_back(prefixBytes[2]);
-        updateMessage.emplace_back(prefixBytes[3]);
+void appendIpv4Prefix(std::vector<uint8_t> &bytes, const Route &route) {
+    const uint8_t prefix[4] = {_32to8(route.Prefix)};
+    bytes.emplace_back(route.Length);
+    bytes.insert(bytes.end(), prefix, prefix + (std::min<uint8_t>(route.Length, 32) + 7) / 8);
+}
+
+// RFC 4271 4.3: flags, type, a one or two octet length, and the value. Values are allocated from attributes' resource.
+// Returns false if bytes ends in the middle of an attribute.
+bool parsePathAttributes(const std::span<const uint8_t> bytes, std::pmr::vector<PathAttribute> &attributes) {
+    size_t i = 0;
+    while (i < bytes.size()) {
+        if (i + 3 > bytes.size()) {
+            return false;
+        }
+        PathAttribute attribute = {bytes[i], static_cast<PathAttributeType>(bytes[i + 1]),
+                                   std::pmr::vector<uint8_t>(attributes.get_allocator())};
+        i += 2;
+
+        // if Flags & PathAttributeFlagBits::TwoByteAttribute, the attribute length is two octets. Otherwise, it is one octet.
+        const auto lengthOctets = attribute.Flags & TwoByteAttribute ? 2 : 1;
+        if (i + lengthOctets > bytes.size()) {
+            return false;
+        }
+        const uint16_t valueLength = lengthOctets == 2 ? _8to16(bytes[i], bytes[i + 1]) : static_cast<uint16_t>(bytes[i]);
+        i += lengthOctets;
+        if (i + valueLength > bytes.size()) {
+            return false;
+        }
+
+        attribute.Value.assign(bytes.begin() + i, bytes.begin() + i + valueLength);
+        attributes.emplace_back(std::move(attribute));
+        i += valueLength;
+    }
+    return true;
+}
+
+void appendPathAttribute(std::vector<uint8_t> &bytes, const PathAttribute &attribute) {
+    // The extended length is only used where the value needs it, whatever the flags said when it was parsed
+    const bool extended = attribute.Value.size() > UINT8_MAX;
+    bytes.emplace_back(static_cast<uint8_t>(extended ? attribute.Flags | TwoByteAttribute
+                                                     : attribute.Flags & ~TwoByteAttribute));
+    bytes.emplace_back(attribute.Type);
+    if (extended) {
+        const uint8_t length[2] = {_16to8(attribute.Value.size())};
+        bytes.insert(bytes.end(), length, length + 2);
+    } else {
+        bytes.emplace_back(static_cast<uint8_t>(attribute.Value.size()));
     }
+    bytes.insert(bytes.end(), attribute.Value.begin(), attribute.Value.end());
+}
 
-    uint8_t pathAttributeBytes[2] = {_16to8(message.PathAttributesLength)};
-    updateMessage.emplace_back(pathAttributeBytes[0]);
-    updateMessage.emplace_back(pathAttributeBytes[1]);
+// The length fields are computed from the contents, WithdrawnRoutesLength and PathAttributesLength are ignored
+std::vector<uint8_t> flattenBgpUpdateMessage(const BgpUpdateMessage &message) {
+    std::vector<uint8_t> updateMessage = {0, 0};
+
+    for (const auto &withdrawnRoute : message.WithdrawnRoutes) {
+        appendIpv4Prefix(updateMessage, withdrawnRoute);
+    }
+    const auto withdrawnRoutesLength = updateMessage.size() - 2;
+    updateMessage[0] = static_cast<uint8_t>(withdrawnRoutesLength >> 8);
+    updateMessage[1] = static_cast<uint8_t>(withdrawnRoutesLength);
+
+    const auto pathAttributesStart = updateMessage.size();
+    updateMessage.insert(updateMessage.end(), 2, 0);
+    for (const auto &pathAttribute : message.PathAttributes) {
+        appendPathAttribute(updateMessage, pathAttribute);
+    }
+    const auto pathAttributesLength = updateMessage.size() - pathAttributesStart - 2;
+    updateMessage[pathAttributesStart] = static_cast<uint8_t>(pathAttributesLength >> 8);
+    updateMessage[pathAttributesStart + 1] = static_cast<uint8_t>(pathAttributesLength);
 
     for (const auto &nlriEntry : message.NLRI) {
-        updateMessage.emplace_back(nlriEntry.Length);
-        std::array<uint8_t, 4> nlriEntryBytes = {_32to8(nlriEntry.Prefix)};
-        updateMessage.emplace_back(nlriEntryBytes[0]);
-        updateMessage.emplace_back(nlriEntryBytes[1]);
-        updateMessage.emplace_back(nlriEntryBytes[2]);
-        updateMessage.emplace_back(nlriEntryBytes[3]);
+        appendIpv4Prefix(updateMessage, nlriEntry);
     }
 
     auto header = generateBgpHeader(updateMessage.size(), Update);
@@ -80,61 +157,84 @@ std::vector<uint8_t> flattenBgpUpdateMessage(const BgpUpdateMessage message) {
     return updateMessage;
 }
 
-BgpUpdateMessage parseBgpUpdateMessage(const std::vector<uint8_t> &messageBytes) {
-    assert(messageBytes.size() >= 4);
-    BgpUpdateMessage message;
+// RFC 4271 9: a prefix in both WithdrawnRoutes and NLRI of one UPDATE is treated as if it were only in NLRI. Dropping
+// it from WithdrawnRoutes means it replaces the old route in one step (an implicit withdraw) rather than being
+// withdrawn and learned again, so best path runs once for it and an unchanged route costs nothing at all.
+// WithdrawnRoutesLength is left as it was on the wire.
+void removeReannouncedWithdrawals(BgpUpdateMessage &message) {
+    if (message.WithdrawnRoutes.empty() || message.NLRI.empty()) {
+        return;
+    }
+    const auto key = [](const Route &route) {
+        return static_cast<uint64_t>(route.Prefix) << 8 | route.Length;
+    };
+    std::vector<uint64_t> announced;
+    announced.reserve(message.NLRI.size());
+    for (const auto &route : message.NLRI) {
+        announced.emplace_back(key(route));
+    }
+    std::sort(announced.begin(), announced.end());
+    std::erase_if(message.WithdrawnRoutes, [&](const Route &route) {
+        return std::binary_search(announced.begin(), announced.end(), key(route));
+    });
+}
 
-    message.WithdrawnRoutesLength = _8to16(messageBytes[0], messageBytes[1]);
+// Parses messageBytes, the message without its header, into message up to the first malformed part. Returns what was
+// malformed, nullptr if nothing was.
+const char *parseBgpUpdateMessageInto(const std::span<const uint8_t> messageBytes, BgpUpdateMessage &message) {
+    if (messageBytes.size() < 4) {
+        return "UPDATE shorter than its length fields";
+    }
 
+    message.WithdrawnRoutesLength = _8to16(messageBytes[0], messageBytes[1]);
     size_t i = 2;
-
-    while (i < 2 + message.WithdrawnRoutesLength) {
-        message.WithdrawnRoutes.emplace_back(Route{
-                messageBytes[i], _8to32(messageBytes[i + 1], messageBytes[i + 2], messageBytes[i + 3],
-                                        messageBytes[i + 4])
-        });
-        // TODO: [9]
-
-        i += 5;
+    if (i + message.WithdrawnRoutesLength + 2 > messageBytes.size()) {
+        return "Withdrawn Routes Length past the end of the UPDATE";
+    }
+    if (!parseIpv4Prefixes(messageBytes.subspan(i, message.WithdrawnRoutesLength), message.WithdrawnRoutes)) {
+        return "malformed Withdrawn Routes";
     }
+    i += message.WithdrawnRoutesLength;
 
     message.PathAttributesLength = _8to16(messageBytes[i], messageBytes[i + 1]);
-
     i += 2;
-    auto currentIndex = i;
-
-    while (i < currentIndex + message.PathAttributesLength) {
-        PathAttribute attribute = {messageBytes[i], static_cast<PathAttributeType>(messageBytes[i + 1]), {}};
-
-        // if Flags & PathAttributeFlagBits::TwoByteAttribute, Value[0] and Value[1] contain the length of the attribute data. Otherwise, Value[0] contains the length.
-        const uint16_t valueLength = attribute.Flags & TwoByteAttribute ? _8to16(messageBytes[i], messageBytes[++i])
-                                                                        : static_cast<uint16_t>(messageBytes[i]);
-        ++i;
-
-        assert(messageBytes.size() >= i + valueLength);
-
-        attribute.Value = std::vector<uint8_t>(messageBytes.begin() + i, messageBytes.begin() + i + valueLength);
-
-        message.PathAttributes.emplace_back(attribute);
+    if (i + message.PathAttributesLength > messageBytes.size()) {
+        return "Total Path Attribute Length past the end of the UPDATE";
+    }
+    if (!parsePathAttributes(messageBytes.subspan(i, message.PathAttributesLength), message.PathAttributes)) {
+        return "malformed Path Attributes";
+    }
+    i += message.PathAttributesLength;
 
-        i += valueLength;
+    // Whatever is left is NLRI
+    if (!parseIpv4Prefixes(messageBytes.subspan(i), message.NLRI)) {
+        return "malformed NLRI";
     }
+    removeReannouncedWithdrawals(message);
+    return nullptr;
+}
 
-    const auto nlriLength = messageBytes.size() - (i + 1);
+// messageBytes is the message without its header. Malformed messages are asserted on, and otherwise parsed up to the
+// first malformed part. TODO: [4]
+BgpUpdateMessage parseBgpUpdateMessage(const std::span<const uint8_t> messageBytes,
+                                       std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    BgpUpdateMessage message = {0, std::pmr::vector<Route>(resource), 0, std::pmr::vector<PathAttribute>(resource),
+                                std::pmr::vector<Route>(resource)};
+    [[maybe_unused]] const auto malformed = parseBgpUpdateMessageInto(messageBytes, message);
+    assert(!malformed);
+    return message;
+}
 
-    if (nlriLength > 0) {
-        currentIndex = i;
-        while (i < currentIndex + nlriLength) {
-            message.NLRI.emplace_back(NLRI{
-                    messageBytes[i], _8to32(messageBytes[i + 1], messageBytes[i + 2], messageBytes[i + 3],
-                                            messageBytes[i + 4])
-            });
-            // TODO: [9]
-            // TODO: [13]
-            i += 5;
-        }
+// For UPDATEs that did not come from the session, e.g. ones in an MRT dump, where one malformed message must not end
+// the process or be applied in part. Throws std::runtime_error saying what was malformed.
+BgpUpdateMessage parseUntrustedBgpUpdateMessage(const std::span<const uint8_t> messageBytes,
+                                                std::pmr::memory_resource *resource =
+                                                        std::pmr::get_default_resource()) {
+    BgpUpdateMessage message = {0, std::pmr::vector<Route>(resource), 0, std::pmr::vector<PathAttribute>(resource),
+                                std::pmr::vector<Route>(resource)};
+    if (const auto malformed = parseBgpUpdateMessageInto(messageBytes, message)) {
+        throw std::runtime_error(malformed);
     }
-
     return message;
 }
 
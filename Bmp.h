@@ -0,0 +1,516 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_BMP_H
+#define BGP_BMP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <span>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include "Util.h"
+
+// BGP Monitoring Protocol (RFC 7854), as a monitored router exporting its sessions to a collector. IPv4 peers only.
+// TODO: [9]
+
+constexpr uint8_t BMP_VERSION = 3;
+// Version, Message Length, Message Type
+constexpr size_t BMP_COMMON_HEADER_SIZE = 6;
+// Peer Type, Peer Flags, Peer Distinguisher, Peer Address, Peer AS, Peer BGP ID, Timestamp (seconds, microseconds)
+constexpr size_t BMP_PER_PEER_HEADER_SIZE = 42;
+
+enum BmpMessageType : uint8_t {
+    /*
+     * 0 Route Monitoring [RFC7854]
+     * 1 Statistics Report [RFC7854]
+     * 2 Peer Down Notification [RFC7854]
+     * 3 Peer Up Notification [RFC7854]
+     * 4 Initiation Message [RFC7854]
+     * 5 Termination Message [RFC7854]
+     * 6 Route Mirroring Message [RFC7854]
+     */
+    BmpRouteMonitoring = 0,
+    BmpStatisticsReport = 1,
+    BmpPeerDownNotification = 2,
+    BmpPeerUpNotification = 3,
+    BmpInitiation = 4,
+    BmpTermination = 5,
+    BmpRouteMirroring = 6
+};
+
+std::string BmpMessageTypeToString(const BmpMessageType type) {
+    switch (type) {
+        case BmpRouteMonitoring:
+            return "RouteMonitoring";
+        case BmpStatisticsReport:
+            return "StatisticsReport";
+        case BmpPeerDownNotification:
+            return "PeerDownNotification";
+        case BmpPeerUpNotification:
+            return "PeerUpNotification";
+        case BmpInitiation:
+            return "Initiation";
+        case BmpTermination:
+            return "Termination";
+        case BmpRouteMirroring:
+            return "RouteMirroring";
+        default:
+            return "InvalidBmpMessageType";
+    }
+}
+
+enum BmpPeerDownReason : uint8_t {
+    /*
+     * 1 Local system closed, NOTIFICATION PDU follows [RFC7854]
+     * 2 Local system closed, FSM Event follows [RFC7854]
+     * 3 Remote system closed, NOTIFICATION PDU follows [RFC7854]
+     * 4 Remote system closed, no data [RFC7854]
+     * 5 Peer de-configured [RFC7854]
+     */
+    BmpLocalNotification = 1,
+    BmpLocalFsmEvent = 2,
+    BmpRemoteNotification = 3,
+    BmpRemoteNoData = 4,
+    BmpPeerDeconfigured = 5
+};
+
+enum BmpStatType : uint16_t {
+    /*
+     * 0 Number of prefixes rejected by inbound policy [RFC7854]
+     * 1 Number of (known) duplicate prefix advertisements [RFC7854]
+     * 2 Number of (known) duplicate withdraws [RFC7854]
+     * 7 Number of routes in Adj-RIBs-In [RFC7854]
+     * 8 Number of routes in Loc-RIB [RFC7854]
+     */
+    BmpStatRejectedPrefixes = 0,
+    BmpStatDuplicatePrefixes = 1,
+    BmpStatDuplicateWithdraws = 2,
+    BmpStatAdjRibInRoutes = 7,
+    BmpStatLocRibRoutes = 8
+};
+
+// RFC 7854 4.4 Information TLV types of the Initiation message
+constexpr uint16_t BMP_INFORMATION_STRING = 0;
+constexpr uint16_t BMP_INFORMATION_SYS_DESCR = 1;
+constexpr uint16_t BMP_INFORMATION_SYS_NAME = 2;
+// RFC 7854 4.5 Termination message
+constexpr uint16_t BMP_TERMINATION_REASON = 1;
+constexpr uint16_t BMP_TERMINATION_ADMINISTRATIVELY_CLOSED = 0;
+
+// What the per-peer header says about a peer
+struct BmpPeer {
+    uint32_t Address;
+    uint32_t Asn;
+    uint32_t BgpIdentifier;
+    // The UPDATEs carry 2-octet AS_PATHs, which is all this implementation negotiates. TODO: [3]
+    bool TwoOctetAsPath = true;
+    // Routes after import policy rather than as received. Only pre-policy Adj-RIB-In is exported.
+    bool PostPolicy = false;
+};
+
+struct BmpStat {
+    BmpStatType Type;
+    uint64_t Value;
+};
+
+void appendBmpCommonHeader(std::vector<uint8_t> &bytes, const uint32_t length, const BmpMessageType type) {
+    bytes.insert(bytes.end(), {BMP_VERSION, _32to8(length), type});
+}
+
+// Writes the per-peer header to out, which has to hold BMP_PER_PEER_HEADER_SIZE octets
+void writeBmpPerPeerHeader(uint8_t *out, const BmpPeer &peer, const std::chrono::system_clock::time_point timestamp) {
+    const auto sinceEpoch = timestamp.time_since_epoch();
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch - seconds);
+    // Global instance peer, flags, and a zero Peer Distinguisher
+    out[0] = 0;
+    out[1] = static_cast<uint8_t>((peer.PostPolicy ? 0x40 : 0) | (peer.TwoOctetAsPath ? 0x20 : 0));
+    std::fill(out + 2, out + 10, 0);
+    // An IPv4 address takes the last 4 octets of the 16
+    std::fill(out + 10, out + 22, 0);
+    const uint8_t fields[20] = {_32to8(peer.Address), _32to8(peer.Asn), _32to8(peer.BgpIdentifier),
+                                _32to8(static_cast<uint32_t>(seconds.count())),
+                                _32to8(static_cast<uint32_t>(microseconds.count()))};
+    std::copy(fields, fields + sizeof(fields), out + 22);
+}
+
+void appendBmpPerPeerHeader(std::vector<uint8_t> &bytes, const BmpPeer &peer,
+                            const std::chrono::system_clock::time_point timestamp) {
+    bytes.resize(bytes.size() + BMP_PER_PEER_HEADER_SIZE);
+    writeBmpPerPeerHeader(bytes.data() + bytes.size() - BMP_PER_PEER_HEADER_SIZE, peer, timestamp);
+}
+
+void appendBmpInformationTlv(std::vector<uint8_t> &bytes, const uint16_t type, const std::string &value) {
+    bytes.insert(bytes.end(), {_16to8(type), _16to8(static_cast<uint16_t>(value.size()))});
+    bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+// Fills in the Message Length of a message built with a placeholder common header
+void finishBmpMessage(std::vector<uint8_t> &bytes) {
+    const uint8_t length[4] = {_32to8(static_cast<uint32_t>(bytes.size()))};
+    std::copy(length, length + 4, bytes.begin() + 1);
+}
+
+// RFC 7854 4.3: sysDescr and sysName are mandatory
+std::vector<uint8_t> flattenBmpInitiation(const std::string &sysName, const std::string &sysDescr) {
+    std::vector<uint8_t> bytes;
+    appendBmpCommonHeader(bytes, 0, BmpInitiation);
+    appendBmpInformationTlv(bytes, BMP_INFORMATION_SYS_DESCR, sysDescr);
+    appendBmpInformationTlv(bytes, BMP_INFORMATION_SYS_NAME, sysName);
+    finishBmpMessage(bytes);
+    return bytes;
+}
+
+std::vector<uint8_t> flattenBmpTermination(const uint16_t reason = BMP_TERMINATION_ADMINISTRATIVELY_CLOSED) {
+    std::vector<uint8_t> bytes;
+    appendBmpCommonHeader(bytes, 0, BmpTermination);
+    bytes.insert(bytes.end(), {_16to8(BMP_TERMINATION_REASON), 0, 2, _16to8(reason)});
+    finishBmpMessage(bytes);
+    return bytes;
+}
+
+// RFC 7854 4.10. The OPEN messages are whole BGP messages, header included. Ports are in host order.
+std::vector<uint8_t> flattenBmpPeerUp(const BmpPeer &peer, const std::chrono::system_clock::time_point timestamp,
+                                      const uint32_t localAddress, const uint16_t localPort, const uint16_t remotePort,
+                                      const std::span<const uint8_t> sentOpen,
+                                      const std::span<const uint8_t> receivedOpen) {
+    std::vector<uint8_t> bytes;
+    appendBmpCommonHeader(bytes, 0, BmpPeerUpNotification);
+    appendBmpPerPeerHeader(bytes, peer, timestamp);
+    bytes.insert(bytes.end(), 12, 0);
+    bytes.insert(bytes.end(), {_32to8(localAddress), _16to8(localPort), _16to8(remotePort)});
+    bytes.insert(bytes.end(), sentOpen.begin(), sentOpen.end());
+    bytes.insert(bytes.end(), receivedOpen.begin(), receivedOpen.end());
+    finishBmpMessage(bytes);
+    return bytes;
+}
+
+// RFC 7854 4.9. data is the NOTIFICATION message for BmpLocalNotification and BmpRemoteNotification, the 2 octet FSM
+// event for BmpLocalFsmEvent, and empty otherwise.
+std::vector<uint8_t> flattenBmpPeerDown(const BmpPeer &peer, const std::chrono::system_clock::time_point timestamp,
+                                        const BmpPeerDownReason reason, const std::span<const uint8_t> data = {}) {
+    std::vector<uint8_t> bytes;
+    appendBmpCommonHeader(bytes, 0, BmpPeerDownNotification);
+    appendBmpPerPeerHeader(bytes, peer, timestamp);
+    bytes.emplace_back(reason);
+    bytes.insert(bytes.end(), data.begin(), data.end());
+    finishBmpMessage(bytes);
+    return bytes;
+}
+
+// RFC 7854 4.8. Types 7 to 10 are 64-bit gauges, the rest 32-bit counters.
+std::vector<uint8_t> flattenBmpStatsReport(const BmpPeer &peer, const std::chrono::system_clock::time_point timestamp,
+                                           const std::span<const BmpStat> stats) {
+    std::vector<uint8_t> bytes;
+    appendBmpCommonHeader(bytes, 0, BmpStatisticsReport);
+    appendBmpPerPeerHeader(bytes, peer, timestamp);
+    bytes.insert(bytes.end(), {_32to8(static_cast<uint32_t>(stats.size()))});
+    for (const auto &stat : stats) {
+        const bool gauge = stat.Type >= 7 && stat.Type <= 10;
+        bytes.insert(bytes.end(), {_16to8(stat.Type), 0, static_cast<uint8_t>(gauge ? 8 : 4)});
+        if (gauge) {
+            bytes.insert(bytes.end(), {_32to8(static_cast<uint32_t>(stat.Value >> 32))});
+        }
+        bytes.insert(bytes.end(), {_32to8(static_cast<uint32_t>(stat.Value))});
+    }
+    finishBmpMessage(bytes);
+    return bytes;
+}
+
+// The common and per-peer headers of a Route Monitoring message. The UPDATE itself follows them on the wire as is.
+typedef std::array<uint8_t, BMP_COMMON_HEADER_SIZE + BMP_PER_PEER_HEADER_SIZE> BmpRouteMonitoringHeader;
+
+BmpRouteMonitoringHeader bmpRouteMonitoringHeader(const BmpPeer &peer,
+                                                  const std::chrono::system_clock::time_point timestamp,
+                                                  const size_t updateLength) {
+    BmpRouteMonitoringHeader header{};
+    const uint8_t common[BMP_COMMON_HEADER_SIZE] = {
+            BMP_VERSION, _32to8(static_cast<uint32_t>(header.size() + updateLength)), BmpRouteMonitoring};
+    std::copy(common, common + BMP_COMMON_HEADER_SIZE, header.begin());
+    writeBmpPerPeerHeader(header.data() + BMP_COMMON_HEADER_SIZE, peer, timestamp);
+    return header;
+}
+
+// Where BmpExporter sends to, normally a TCP connection to the collector. Only ever used from the exporter's thread.
+class BmpConnection {
+public:
+    virtual ~BmpConnection() = default;
+
+    // Returns false if the collector cannot be reached, the exporter tries again later
+    virtual bool Connect() = 0;
+
+    // Sends buffers back to back, as one gather write if it can. Returns false if the connection failed.
+    virtual bool Send(std::span<const std::span<const uint8_t>> buffers) = 0;
+
+    virtual void Close() = 0;
+};
+
+struct BmpExporterOptions {
+    // RFC 7854 4.3
+    std::string SysName = "BGP";
+    std::string SysDescr = "BGP";
+    // Messages waiting for the collector may take up to this much memory, any more are dropped
+    size_t MaxQueuedBytes = 64 * 1024 * 1024;
+    std::chrono::milliseconds ReconnectInterval = std::chrono::seconds(5);
+    // Messages sent per gather write
+    size_t MaxBatch = 64;
+};
+
+// Streams BMP to one collector from a thread of its own. The session only queues messages: a Route Monitoring message
+// is the UPDATE exactly as it was received, shared rather than copied, behind a 48 octet header, and goes out with it
+// in one gather write. The queue is bounded by MaxQueuedBytes; when the collector cannot keep up, or is unreachable,
+// messages are dropped and counted rather than ever slowing a BGP session down. After every (re)connect the exporter
+// sends the Initiation message and the Peer Up of every peer that is up, so the collector can start over. The exporter
+// cannot read a session's Adj-RIB-In itself, so it asks for it instead: after a reconnect, and after dropping one of a
+// peer's Route Monitoring messages, TakeResync() is true for the peer until its session sends the Adj-RIB-In again
+// (RFC 7854 5). Thread safe.
+class BmpExporter {
+public:
+    explicit BmpExporter(std::unique_ptr<BmpConnection> connection, BmpExporterOptions options = {})
+            : options_(std::move(options)),
+              connection_(std::move(connection)) {
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    BmpExporter(const BmpExporter &) = delete;
+    BmpExporter &operator=(const BmpExporter &) = delete;
+
+    // Sends what is queued if connected, then the Termination message
+    ~BmpExporter() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // update is the whole UPDATE, header included, as it came off the wire, and stays alive for as long as the message
+    // is queued. Returns false if the message was dropped.
+    bool RouteMonitoring(const BmpPeer &peer, std::shared_ptr<const std::vector<uint8_t>> received,
+                         const std::span<const uint8_t> update) {
+        Output output;
+        output.Header = bmpRouteMonitoringHeader(peer, std::chrono::system_clock::now(), update.size());
+        output.Payload = update;
+        output.Received = std::move(received);
+        output.Peer = peer.Address;
+        return Enqueue(std::move(output));
+    }
+
+    // A Route Monitoring message for an UPDATE encoded from the Adj-RIB-In rather than received, header included
+    bool RouteMonitoring(const BmpPeer &peer, const std::span<const uint8_t> update) {
+        const auto header = bmpRouteMonitoringHeader(peer, std::chrono::system_clock::now(), update.size());
+        Output output;
+        output.Owned.reserve(header.size() + update.size());
+        output.Owned.insert(output.Owned.end(), header.begin(), header.end());
+        output.Owned.insert(output.Owned.end(), update.begin(), update.end());
+        output.Payload = output.Owned;
+        output.Peer = peer.Address;
+        return Enqueue(std::move(output));
+    }
+
+    // True once for every time the collector has to be sent the peer's Adj-RIB-In again, as Route Monitoring messages
+    // followed by End-of-RIB. Waits until the queue is no more than half full, so a collector that is still behind is
+    // not sent a table it would mostly drop. Only the session thread's check is a lock, and only if something is due.
+    bool TakeResync(const BmpPeer &peer) {
+        if (!resyncPending_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        std::lock_guard lock(mutex_);
+        if (queuedBytes_ > options_.MaxQueuedBytes / 2 || !resync_.erase(peer.Address)) {
+            return false;
+        }
+        resyncPending_.store(!resync_.empty(), std::memory_order_release);
+        return true;
+    }
+
+    // Remembered until PeerDown(), and sent again after every reconnect
+    bool PeerUp(const BmpPeer &peer, std::vector<uint8_t> message) {
+        {
+            std::lock_guard lock(mutex_);
+            peersUp_[peer.Address] = message;
+        }
+        return EnqueueOwned(std::move(message));
+    }
+
+    bool PeerDown(const BmpPeer &peer, std::vector<uint8_t> message) {
+        {
+            std::lock_guard lock(mutex_);
+            peersUp_.erase(peer.Address);
+            resync_.erase(peer.Address);
+        }
+        return EnqueueOwned(std::move(message));
+    }
+
+    bool StatsReport(std::vector<uint8_t> message) {
+        return EnqueueOwned(std::move(message));
+    }
+
+    [[nodiscard]] bool connected() const {
+        return connected_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] uint64_t sent_count() const {
+        return sent_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t dropped_count() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t queued_bytes() const {
+        std::lock_guard lock(mutex_);
+        return queuedBytes_;
+    }
+
+private:
+    // One message: Header, if Received is set, followed by Payload, which points into Received or Owned
+    struct Output {
+        BmpRouteMonitoringHeader Header{};
+        std::span<const uint8_t> Payload;
+        std::shared_ptr<const std::vector<uint8_t>> Received;
+        std::vector<uint8_t> Owned;
+        // The peer a Route Monitoring message is about, nullopt for every other message
+        std::optional<uint32_t> Peer;
+
+        [[nodiscard]] size_t size() const {
+            return (Received ? Header.size() : 0) + Payload.size();
+        }
+    };
+
+    bool EnqueueOwned(std::vector<uint8_t> message) {
+        Output output;
+        output.Owned = std::move(message);
+        output.Payload = output.Owned;
+        return Enqueue(std::move(output));
+    }
+
+    bool Enqueue(Output output) {
+        const auto size = output.size();
+        {
+            std::lock_guard lock(mutex_);
+            if (queuedBytes_ + size > options_.MaxQueuedBytes) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                if (output.Peer && peersUp_.contains(*output.Peer)) {
+                    resync_.insert(*output.Peer);
+                    resyncPending_.store(true, std::memory_order_release);
+                }
+                return false;
+            }
+            queuedBytes_ += size;
+            queue_.emplace_back(std::move(output));
+        }
+        wake_.notify_one();
+        return true;
+    }
+
+    void Run() {
+        std::vector<Output> batch;
+        std::vector<std::span<const uint8_t>> buffers;
+        std::unique_lock lock(mutex_);
+        while (true) {
+            if (!connected()) {
+                if (stopping_) {
+                    return;
+                }
+                lock.unlock();
+                const bool connected = Connect();
+                lock.lock();
+                if (!connected) {
+                    wake_.wait_for(lock, options_.ReconnectInterval, [this]() { return stopping_; });
+                    continue;
+                }
+            }
+            wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break;
+            }
+            batch.clear();
+            while (!queue_.empty() && batch.size() < options_.MaxBatch) {
+                queuedBytes_ -= queue_.front().size();
+                batch.emplace_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            lock.unlock();
+            buffers.clear();
+            for (const auto &output : batch) {
+                if (output.Received) {
+                    buffers.emplace_back(output.Header);
+                }
+                buffers.emplace_back(output.Payload);
+            }
+            if (connection_->Send(buffers)) {
+                sent_.fetch_add(batch.size(), std::memory_order_relaxed);
+            } else {
+                // Whatever was in flight is lost with the connection, the collector starts over after reconnecting
+                dropped_.fetch_add(batch.size(), std::memory_order_relaxed);
+                connection_->Close();
+                connected_.store(false, std::memory_order_release);
+            }
+            batch.clear();
+            lock.lock();
+        }
+        lock.unlock();
+        const auto termination = flattenBmpTermination();
+        const std::span<const uint8_t> buffer = termination;
+        connection_->Send({&buffer, 1});
+        connection_->Close();
+    }
+
+    // Connects and sends Initiation and every Peer Up, each peer's Adj-RIB-In to follow once its session gets to it.
+    // Called without mutex_ held.
+    bool Connect() {
+        if (!connection_->Connect()) {
+            return false;
+        }
+        std::vector<std::vector<uint8_t>> messages = {flattenBmpInitiation(options_.SysName, options_.SysDescr)};
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto &[address, peerUp] : peersUp_) {
+                messages.emplace_back(peerUp);
+                resync_.insert(address);
+            }
+            if (!resync_.empty()) {
+                resyncPending_.store(true, std::memory_order_release);
+            }
+        }
+        const std::vector<std::span<const uint8_t>> buffers(messages.begin(), messages.end());
+        if (!connection_->Send(buffers)) {
+            connection_->Close();
+            return false;
+        }
+        connected_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    BmpExporterOptions options_;
+    std::unique_ptr<BmpConnection> connection_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Output> queue_;
+    size_t queuedBytes_ = 0;
+    // The last Peer Up of every peer that is up, keyed by address
+    std::unordered_map<uint32_t, std::vector<uint8_t>> peersUp_;
+    // Peers whose Adj-RIB-In the collector has to be sent again, see TakeResync()
+    std::unordered_set<uint32_t> resync_;
+    std::atomic<bool> resyncPending_ = false;
+    bool stopping_ = false;
+    std::atomic<bool> connected_ = false;
+    std::atomic<uint64_t> sent_ = 0;
+    std::atomic<uint64_t> dropped_ = 0;
+    std::thread thread_;
+};
+
+#endif //BGP_BMP_H
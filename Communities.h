@@ -0,0 +1,230 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_COMMUNITIES_H
+#define BGP_COMMUNITIES_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <span>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <type_traits>
+#include "Util.h"
+#include "Path.h"
+
+// Well-known communities, IANA "BGP Well-known Communities" registry
+constexpr Community GRACEFUL_SHUTDOWN = 0xFFFF0000;
+constexpr Community LLGR_STALE = 0xFFFF0006;
+constexpr Community NO_LLGR = 0xFFFF0007;
+constexpr Community BLACKHOLE = 0xFFFF029A;
+constexpr Community NO_EXPORT = 0xFFFFFF01;
+constexpr Community NO_ADVERTISE = 0xFFFFFF02;
+constexpr Community NO_EXPORT_SUBCONFED = 0xFFFFFF03;
+
+constexpr Community makeCommunity(const uint16_t asn, const uint16_t value) {
+    return static_cast<Community>(asn) << 16 | value;
+}
+
+std::optional<std::vector<Community>> parseCommunitiesAttribute(std::span<const uint8_t> value) {
+    if (value.size() % 4 != 0) {
+        return std::nullopt;
+    }
+    std::vector<Community> communities;
+    communities.reserve(value.size() / 4);
+    for (size_t i = 0; i < value.size(); i += 4) {
+        communities.emplace_back(_8to32(value[i], value[i + 1], value[i + 2], value[i + 3]));
+    }
+    return communities;
+}
+
+// The value of a COMMUNITIES attribute (RFC 1997) holding communities
+std::pmr::vector<uint8_t> encodeCommunitiesAttribute(std::span<const Community> communities) {
+    std::pmr::vector<uint8_t> value;
+    value.reserve(communities.size() * 4);
+    for (const auto community : communities) {
+        value.insert(value.end(), {_32to8(community)});
+    }
+    return value;
+}
+
+std::optional<std::vector<ExtendedCommunity>> parseExtendedCommunitiesAttribute(std::span<const uint8_t> value) {
+    if (value.size() % 8 != 0) {
+        return std::nullopt;
+    }
+    std::vector<ExtendedCommunity> communities;
+    communities.reserve(value.size() / 8);
+    for (size_t i = 0; i < value.size(); i += 8) {
+        communities.emplace_back(static_cast<uint64_t>(_8to32(value[i], value[i + 1], value[i + 2], value[i + 3])) << 32 |
+                                 _8to32(value[i + 4], value[i + 5], value[i + 6], value[i + 7]));
+    }
+    return communities;
+}
+
+std::optional<std::vector<LargeCommunity>> parseLargeCommunitiesAttribute(std::span<const uint8_t> value) {
+    if (value.size() % 12 != 0) {
+        return std::nullopt;
+    }
+    std::vector<LargeCommunity> communities;
+    communities.reserve(value.size() / 12);
+    for (size_t i = 0; i < value.size(); i += 12) {
+        communities.emplace_back(LargeCommunity{_8to32(value[i], value[i + 1], value[i + 2], value[i + 3]),
+                                                _8to32(value[i + 4], value[i + 5], value[i + 6], value[i + 7]),
+                                                _8to32(value[i + 8], value[i + 9], value[i + 10], value[i + 11])});
+    }
+    return communities;
+}
+
+// An immutable, interned, sorted and deduplicated set of communities. Membership and wildcard tests are binary
+// searches, so they stay cheap enough to run for every route on import and export.
+template<typename T>
+class CommunitySet {
+public:
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    CommunitySet(std::vector<T> values, const uint64_t hash, const uint64_t id) : values_(std::move(values)),
+                                                                                  hash_(hash),
+                                                                                  id_(id) {}
+
+    [[nodiscard]] std::span<const T> values() const {
+        return values_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return values_.size();
+    }
+
+    [[nodiscard]] bool Contains(const T &value) const {
+        return std::binary_search(values_.begin(), values_.end(), value);
+    }
+
+    // Whether any member falls in [low, high], e.g. 65000:0 to 65000:65535 for "65000:*"
+    [[nodiscard]] bool ContainsInRange(const T &low, const T &high) const {
+        const auto it = std::lower_bound(values_.begin(), values_.end(), low);
+        return it != values_.end() && !(high < *it);
+    }
+
+    // Whether any member is also in values, which must be sorted
+    [[nodiscard]] bool ContainsAny(std::span<const T> values) const {
+        auto a = values_.begin();
+        auto b = values.begin();
+        while (a != values_.end() && b != values.end()) {
+            if (*a < *b) {
+                a = std::lower_bound(a, values_.end(), *b);
+            } else if (*b < *a) {
+                b = std::lower_bound(b, values.end(), *a);
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]] uint64_t hash() const {
+        return hash_;
+    }
+
+    // Unique for the lifetime of the CommunityStore that interned this set
+    [[nodiscard]] uint64_t id() const {
+        return id_;
+    }
+
+private:
+    std::vector<T> values_;
+    uint64_t hash_;
+    uint64_t id_;
+};
+
+// Deduplicates community sets. Only weak references are kept, like PathAttributeStore and AsPathStore. Every
+// modification returns another interned set, the set passed in is never changed.
+template<typename T>
+class CommunityStore {
+public:
+    typedef std::shared_ptr<const CommunitySet<T>> SetPointer;
+
+    SetPointer Intern(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+
+        const auto hash = hashBytes(reinterpret_cast<const uint8_t *>(values.data()), values.size() * sizeof(T));
+        auto [it, end] = sets_.equal_range(hash);
+
+        while (it != end) {
+            if (auto existing = it->second.lock()) {
+                if (std::equal(values.begin(), values.end(), existing->values().begin(), existing->values().end())) {
+                    return existing;
+                }
+                ++it;
+            } else {
+                it = sets_.erase(it);
+            }
+        }
+
+        auto set = std::make_shared<const CommunitySet<T>>(std::move(values), hash, nextId_++);
+        sets_.emplace(hash, set);
+        return set;
+    }
+
+    // set may be nullptr, i.e. the route carried no communities
+    SetPointer Add(const CommunitySet<T> *set, std::span<const T> values) {
+        std::vector<T> merged(values.begin(), values.end());
+        if (set) {
+            merged.insert(merged.end(), set->values().begin(), set->values().end());
+        }
+        return Intern(std::move(merged));
+    }
+
+    // Returns nullptr when nothing is left, so an empty set is never attached to a route
+    template<typename Predicate>
+    SetPointer RemoveIf(const CommunitySet<T> *set, Predicate predicate) {
+        if (!set) {
+            return nullptr;
+        }
+        std::vector<T> remaining;
+        remaining.reserve(set->size());
+        std::copy_if(set->values().begin(), set->values().end(), std::back_inserter(remaining),
+                     [&](const T &value) { return !predicate(value); });
+        return remaining.empty() ? nullptr : Intern(std::move(remaining));
+    }
+
+    SetPointer Remove(const CommunitySet<T> *set, std::span<const T> values) {
+        return RemoveIf(set, [&](const T &value) {
+            return std::find(values.begin(), values.end(), value) != values.end();
+        });
+    }
+
+    void Purge() {
+        std::erase_if(sets_, [](const auto &entry) { return entry.second.expired(); });
+    }
+
+    [[nodiscard]] size_t size() const {
+        return sets_.size();
+    }
+
+private:
+    uint64_t nextId_ = 1;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const CommunitySet<T>>> sets_;
+};
+
+typedef CommunitySet<Community> StandardCommunitySet;
+typedef CommunitySet<ExtendedCommunity> ExtendedCommunitySet;
+typedef CommunitySet<LargeCommunity> LargeCommunitySet;
+
+// One store per community flavour, shared by the attribute sets that decode into them and by policy set actions
+struct CommunityStores {
+    CommunityStore<Community> Standard;
+    CommunityStore<ExtendedCommunity> Extended;
+    CommunityStore<LargeCommunity> Large;
+
+    void Purge() {
+        Standard.Purge();
+        Extended.Purge();
+        Large.Purge();
+    }
+};
+
+#endif //BGP_COMMUNITIES_H
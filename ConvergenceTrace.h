@@ -0,0 +1,336 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_CONVERGENCETRACE_H
+#define BGP_CONVERGENCETRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include "Route.h"
+
+// Where a traced prefix change was when it was stamped, in the order it goes through them
+enum ConvergenceStage {
+    // The message carrying it came off the socket
+    ConvergenceReceived,
+    // The UPDATE was decoded
+    ConvergenceParsed,
+    // Import prefix-list, policy and dampening have decided on it
+    ConvergenceImported,
+    // The Loc-RIB has run best path for it
+    ConvergenceBestPath,
+    // The best path change was handed to the FIB
+    ConvergencePublished,
+    // The UPDATE carrying it was written to the peer. Never reached by changes that are not advertised, e.g. because
+    // export policy denies them.
+    ConvergenceSent
+};
+
+constexpr size_t CONVERGENCE_STAGES = 6;
+
+std::string ConvergenceStageToString(const ConvergenceStage stage) {
+    switch (stage) {
+        case ConvergenceReceived:
+            return "Received";
+        case ConvergenceParsed:
+            return "Parsed";
+        case ConvergenceImported:
+            return "Imported";
+        case ConvergenceBestPath:
+            return "BestPath";
+        case ConvergencePublished:
+            return "Published";
+        case ConvergenceSent:
+            return "Sent";
+        default:
+            return "InvalidConvergenceStage";
+    }
+}
+
+// One prefix change, with a steady clock timestamp in nanoseconds for every stage, 0 for a stage it never reached
+struct ConvergenceSample {
+    Route Prefix;
+    bool Withdrawn;
+    std::array<int64_t, CONVERGENCE_STAGES> Timestamps;
+};
+
+// Samples prefix changes from one session as they go from the wire to the FIB and back out to the peer. Which prefixes
+// are traced is decided by a hash of the prefix, so every stage of a sampled change is stamped without anything being
+// passed along with it, and a prefix that is not sampled costs a multiply and a compare per stage. Without a
+// ConvergenceTrace nothing is stamped at all.
+//
+// Begin(), Stamp(), StampAll() and Commit() are for the session's thread only. Committed samples go into a fixed size
+// ring that keeps the last capacity of them, which samples() reads from any thread without ever blocking the writer:
+// every slot carries a sequence number, and a slot that was being overwritten while it was read is skipped. TODO: [14]
+class ConvergenceTrace {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Traces 1 in sampleEvery prefixes and keeps the last capacity samples
+    ConvergenceTrace(const uint32_t sampleEvery, const size_t capacity)
+            : sampleEvery_(std::max<uint32_t>(sampleEvery, 1)),
+              slots_(std::max<size_t>(capacity, 1)) {}
+
+    ConvergenceTrace(const ConvergenceTrace &) = delete;
+    ConvergenceTrace &operator=(const ConvergenceTrace &) = delete;
+
+    [[nodiscard]] bool IsSampled(const Route &route) const {
+        const auto key = (static_cast<uint64_t>(route.Prefix) << 8 | route.Length) * 0x9E3779B97F4A7C15ULL;
+        return (key >> 32) % sampleEvery_ == 0;
+    }
+
+    // Starts tracing route, if it is sampled, for a message received and parsed at the given times
+    void Begin(const Route &route, const bool withdrawn, const Clock::time_point received,
+               const Clock::time_point parsed) {
+        if (!IsSampled(route)) {
+            return;
+        }
+        ConvergenceSample sample{route, withdrawn, {}};
+        sample.Timestamps[ConvergenceReceived] = Nanoseconds(received);
+        sample.Timestamps[ConvergenceParsed] = Nanoseconds(parsed);
+        pending_.emplace_back(sample);
+    }
+
+    // Stamps the current time on route, if it is being traced
+    void Stamp(const Route &route, const ConvergenceStage stage) {
+        if (pending_.empty() || !IsSampled(route)) {
+            return;
+        }
+        for (auto &sample : pending_) {
+            if (sample.Prefix.Prefix == route.Prefix && sample.Prefix.Length == route.Length) {
+                sample.Timestamps[stage] = Nanoseconds(Clock::now());
+                return;
+            }
+        }
+    }
+
+    // Stamps the current time on everything traced since the last Commit() that made it to best path, for the stages a
+    // whole batch reaches at once, e.g. ConvergencePublished
+    void StampAll(const ConvergenceStage stage) {
+        if (pending_.empty()) {
+            return;
+        }
+        const auto now = Nanoseconds(Clock::now());
+        for (auto &sample : pending_) {
+            if (sample.Timestamps[ConvergenceBestPath] != 0) {
+                sample.Timestamps[stage] = now;
+            }
+        }
+    }
+
+    // Keeps everything traced since the last Commit() that made it to best path. Prefixes that never got there, e.g.
+    // duplicates, are not changes and are dropped.
+    void Commit() {
+        for (const auto &sample : pending_) {
+            if (sample.Timestamps[ConvergenceBestPath] != 0) {
+                Write(sample);
+            }
+        }
+        pending_.clear();
+    }
+
+    // The samples still in the ring, oldest first
+    [[nodiscard]] std::vector<ConvergenceSample> samples() const {
+        const auto end = written_.load(std::memory_order_acquire);
+        const auto begin = end > slots_.size() ? end - slots_.size() : 0;
+        std::vector<ConvergenceSample> samples;
+        samples.reserve(end - begin);
+        for (auto i = begin; i < end; ++i) {
+            const auto &slot = slots_[i % slots_.size()];
+            const auto sequence = slot.Sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * i + 2) {
+                continue;
+            }
+            const auto prefix = slot.Prefix.load(std::memory_order_relaxed);
+            ConvergenceSample sample{{static_cast<uint8_t>(prefix), static_cast<uint32_t>(prefix >> 8)},
+                                     (prefix >> 40 & 1) != 0, {}};
+            for (size_t stage = 0; stage < CONVERGENCE_STAGES; ++stage) {
+                sample.Timestamps[stage] = slot.Timestamps[stage].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.Sequence.load(std::memory_order_relaxed) == sequence) {
+                samples.emplace_back(sample);
+            }
+        }
+        return samples;
+    }
+
+    [[nodiscard]] uint32_t sample_every() const {
+        return sampleEvery_;
+    }
+
+    // Samples committed so far, including the ones the ring no longer has
+    [[nodiscard]] uint64_t sample_count() const {
+        return written_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        // 2 * index + 1 while sample index is being written, 2 * index + 2 once it is
+        std::atomic<uint64_t> Sequence = 0;
+        // Withdrawn << 40 | Prefix << 8 | Length
+        std::atomic<uint64_t> Prefix = 0;
+        std::array<std::atomic<int64_t>, CONVERGENCE_STAGES> Timestamps{};
+    };
+
+    static int64_t Nanoseconds(const Clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    void Write(const ConvergenceSample &sample) {
+        const auto index = written_.load(std::memory_order_relaxed);
+        auto &slot = slots_[index % slots_.size()];
+        slot.Sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.Prefix.store(static_cast<uint64_t>(sample.Withdrawn) << 40 |
+                          static_cast<uint64_t>(sample.Prefix.Prefix) << 8 | sample.Prefix.Length,
+                          std::memory_order_relaxed);
+        for (size_t stage = 0; stage < CONVERGENCE_STAGES; ++stage) {
+            slot.Timestamps[stage].store(sample.Timestamps[stage], std::memory_order_relaxed);
+        }
+        slot.Sequence.store(2 * index + 2, std::memory_order_release);
+        written_.store(index + 1, std::memory_order_release);
+    }
+
+    uint32_t sampleEvery_;
+    std::vector<ConvergenceSample> pending_;
+    std::vector<Slot> slots_;
+    std::atomic<uint64_t> written_ = 0;
+};
+
+// The trace file format: a header and SampleCount fixed size records. Byte order is the host's, like RIB snapshots.
+constexpr std::array<char, 8> CONVERGENCE_TRACE_MAGIC = {'B', 'G', 'P', 'C', 'O', 'N', 'V', 'T'};
+constexpr uint32_t CONVERGENCE_TRACE_VERSION = 2;
+constexpr uint32_t CONVERGENCE_TRACE_BYTE_ORDER = 0x01020304;
+
+struct ConvergenceTraceHeader {
+    std::array<char, 8> Magic;
+    uint32_t Version;
+    uint32_t ByteOrder;
+    uint32_t SampleEvery;
+    uint32_t Reserved;
+    uint64_t SampleCount;
+};
+
+struct ConvergenceTraceRecord {
+    uint32_t Prefix;
+    uint8_t Length;
+    uint8_t Withdrawn;
+    uint16_t Reserved;
+    std::array<int64_t, CONVERGENCE_STAGES> Timestamps;
+};
+
+// Replaces path with the samples. Throws std::runtime_error if the file cannot be written.
+void writeConvergenceTrace(const std::string &path, const uint32_t sampleEvery,
+                           const std::vector<ConvergenceSample> &samples) {
+    const ConvergenceTraceHeader header{CONVERGENCE_TRACE_MAGIC, CONVERGENCE_TRACE_VERSION,
+                                        CONVERGENCE_TRACE_BYTE_ORDER, sampleEvery, 0, samples.size()};
+    std::vector<ConvergenceTraceRecord> records;
+    records.reserve(samples.size());
+    for (const auto &sample : samples) {
+        records.push_back({sample.Prefix.Prefix, sample.Prefix.Length, sample.Withdrawn, 0, sample.Timestamps});
+    }
+    const auto temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(records.data()),
+                   static_cast<std::streamsize>(records.size() * sizeof(ConvergenceTraceRecord)));
+        if (!file.flush()) {
+            throw std::runtime_error("Unable to write convergence trace " + temporaryPath);
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        throw std::runtime_error("Unable to replace convergence trace " + path + ": " + error.message());
+    }
+}
+
+struct ConvergenceTraceFile {
+    uint32_t SampleEvery;
+    std::vector<ConvergenceSample> Samples;
+};
+
+// Throws std::runtime_error if the file cannot be read or is not a convergence trace written by this machine
+ConvergenceTraceFile readConvergenceTrace(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    ConvergenceTraceHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        throw std::runtime_error("Convergence trace " + path + " is truncated");
+    }
+    if (header.Magic != CONVERGENCE_TRACE_MAGIC || header.Version != CONVERGENCE_TRACE_VERSION ||
+        header.ByteOrder != CONVERGENCE_TRACE_BYTE_ORDER) {
+        throw std::runtime_error(path + " is not a convergence trace, or was written by another version or machine");
+    }
+    ConvergenceTraceFile trace{header.SampleEvery, {}};
+    ConvergenceTraceRecord record{};
+    for (uint64_t i = 0; i < header.SampleCount; ++i) {
+        if (!file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+            throw std::runtime_error("Convergence trace " + path + " is truncated");
+        }
+        trace.Samples.push_back({{record.Length, record.Prefix}, record.Withdrawn != 0, record.Timestamps});
+    }
+    return trace;
+}
+
+// Latencies of one step between stages over a set of samples, in nanoseconds
+struct ConvergenceStepSummary {
+    std::string Name;
+    size_t Count = 0;
+    int64_t P50 = 0;
+    int64_t P90 = 0;
+    int64_t P99 = 0;
+    int64_t P999 = 0;
+    int64_t Max = 0;
+};
+
+// Every step from one stage to the next, then the totals from ConvergenceReceived to ConvergencePublished and to
+// ConvergenceSent. A step
+// includes waiting for the prefixes before it in the same UPDATE, e.g. ConvergenceParsed to ConvergenceImported is
+// import policy for all of them up to this one.
+std::vector<ConvergenceStepSummary> summarizeConvergenceTrace(const std::vector<ConvergenceSample> &samples) {
+    const auto summarize = [&](const ConvergenceStage from, const ConvergenceStage to) {
+        ConvergenceStepSummary summary{ConvergenceStageToString(from) + " to " + ConvergenceStageToString(to)};
+        std::vector<int64_t> latencies;
+        for (const auto &sample : samples) {
+            if (sample.Timestamps[from] != 0 && sample.Timestamps[to] != 0) {
+                latencies.emplace_back(sample.Timestamps[to] - sample.Timestamps[from]);
+            }
+        }
+        if (latencies.empty()) {
+            return summary;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        const auto percentile = [&](const double p) {
+            const auto index = static_cast<size_t>(p * static_cast<double>(latencies.size()));
+            return latencies[std::min(latencies.size() - 1, index)];
+        };
+        summary.Count = latencies.size();
+        summary.P50 = percentile(0.5);
+        summary.P90 = percentile(0.9);
+        summary.P99 = percentile(0.99);
+        summary.P999 = percentile(0.999);
+        summary.Max = latencies.back();
+        return summary;
+    };
+    std::vector<ConvergenceStepSummary> summaries;
+    for (size_t stage = 0; stage + 1 < CONVERGENCE_STAGES; ++stage) {
+        summaries.emplace_back(summarize(static_cast<ConvergenceStage>(stage),
+                                         static_cast<ConvergenceStage>(stage + 1)));
+    }
+    summaries.emplace_back(summarize(ConvergenceReceived, ConvergencePublished));
+    summaries.emplace_back(summarize(ConvergenceReceived, ConvergenceSent));
+    return summaries;
+}
+
+#endif //BGP_CONVERGENCETRACE_H
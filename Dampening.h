@@ -0,0 +1,208 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_DAMPENING_H
+#define BGP_DAMPENING_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include "Route.h"
+#include "Rib.h"
+#include "TimerWheel.h"
+
+// RFC 2439 parameters, with the defaults most implementations ship
+struct DampeningParameters {
+    std::chrono::seconds HalfLife = std::chrono::minutes(15);
+    // A suppressed path is used again once its penalty decays below ReuseThreshold
+    double ReuseThreshold = 750;
+    double SuppressThreshold = 2000;
+    // Penalties are capped so that no path stays suppressed longer than this
+    std::chrono::seconds MaxSuppressTime = std::chrono::minutes(60);
+    double WithdrawPenalty = 1000;
+    double AttributeChangePenalty = 500;
+    // Penalties decay, and timers run, in steps of this
+    std::chrono::seconds Granularity = std::chrono::seconds(5);
+};
+
+// Route flap dampening (RFC 2439) for paths received from peers. Every withdrawal or attribute change of a path adds
+// to its penalty, which decays exponentially with the half-life; while it is above the suppress threshold the path is
+// suppressed, and the caller keeps it out of the Loc-RIB so a flapping prefix stops costing best path runs and
+// outbound UPDATEs. Suppressed paths are not part of any path list, so excluding them from best path costs nothing.
+//
+// Decay is a lookup in a table precomputed for every multiple of the granularity up to the point where any penalty
+// has decayed to nothing, so there is no pow() per event. Reuse and forgetting a path's history are timers on one
+// TimerWheel. Not synchronized. TODO: [14]
+class RouteDampening {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit RouteDampening(DampeningParameters parameters = {}, const Clock::time_point start = Clock::now())
+            : parameters_(parameters),
+              start_(start),
+              // Long enough that timers rarely go round more than once
+              timers_(parameters.Granularity, 1024, start) {
+        // RFC 2439 4.2: the penalty that decays to the reuse threshold in exactly the maximum suppress time
+        ceiling_ = parameters_.ReuseThreshold *
+                   std::exp2(static_cast<double>(parameters_.MaxSuppressTime.count()) / parameters_.HalfLife.count());
+        // History is forgotten once the penalty is below half the reuse threshold, which takes the longest from the
+        // ceiling. That is as far as the table has to go.
+        const auto memory = std::log2(ceiling_ / (parameters_.ReuseThreshold / 2)) * parameters_.HalfLife;
+        const auto steps = static_cast<size_t>(std::ceil(memory / parameters_.Granularity)) + 1;
+        decay_.resize(steps);
+        for (size_t i = 0; i < steps; ++i) {
+            decay_[i] = std::exp2(-static_cast<double>(i * parameters_.Granularity.count()) /
+                                  parameters_.HalfLife.count());
+        }
+    }
+
+    // peer withdrew route. Returns true if the path is suppressed.
+    bool Withdrawn(const PeerId peer, const Route &route, const Clock::time_point now) {
+        return Penalize(peer, route, parameters_.WithdrawPenalty, now);
+    }
+
+    // peer announced route. A new announcement, including one after a withdrawal, costs nothing, but an announcement
+    // replacing different attributes counts as a flap. Returns true if the path is suppressed and has to be kept out of
+    // the Loc-RIB.
+    bool Announced(const PeerId peer, const Route &route, const bool attributesChanged, const Clock::time_point now) {
+        if (attributesChanged) {
+            return Penalize(peer, route, parameters_.AttributeChangePenalty, now);
+        }
+        return IsSuppressed(peer, route);
+    }
+
+    [[nodiscard]] bool IsSuppressed(const PeerId peer, const Route &route) const {
+        if (states_.empty()) {
+            return false;
+        }
+        const auto it = states_.find(Key{peer, routeKey(route)});
+        return it != states_.end() && it->second.Suppressed;
+    }
+
+    // The penalty as of now, 0 for a path without history
+    [[nodiscard]] double penalty(const PeerId peer, const Route &route, const Clock::time_point now) const {
+        const auto it = states_.find(Key{peer, routeKey(route)});
+        return it == states_.end() ? 0 : Decayed(it->second, TickAt(now));
+    }
+
+    // Runs the timers that are due: calls reuse(PeerId, const Route &) for every path no longer suppressed, which the
+    // caller puts back into the Loc-RIB if the peer still announces it, and forgets paths that have been stable long
+    // enough. Returns the number of paths reused.
+    template<typename Function>
+    size_t Poll(const Clock::time_point now, Function &&reuse) {
+        const auto tick = TickAt(now);
+        size_t reused = 0;
+        timers_.Advance(now, [&](const Key &key) {
+            const auto it = states_.find(key);
+            if (it == states_.end()) {
+                return;
+            }
+            auto &state = it->second;
+            state.Scheduled = false;
+            const auto decayed = Decayed(state, tick);
+            if (state.Suppressed && decayed < parameters_.ReuseThreshold) {
+                state.Suppressed = false;
+                --suppressed_;
+                ++reused;
+                reuse(key.Peer, routeFromKey(key.Route));
+            }
+            if (!state.Suppressed && decayed < parameters_.ReuseThreshold / 2) {
+                states_.erase(it);
+                return;
+            }
+            Schedule(key, state, tick);
+        });
+        return reused;
+    }
+
+    // Paths with a penalty
+    [[nodiscard]] size_t size() const {
+        return states_.size();
+    }
+
+    [[nodiscard]] size_t suppressed_count() const {
+        return suppressed_;
+    }
+
+    [[nodiscard]] const DampeningParameters &parameters() const {
+        return parameters_;
+    }
+
+private:
+    struct Key {
+        PeerId Peer;
+        uint64_t Route;
+
+        bool operator==(const Key &other) const {
+            return Peer == other.Peer && Route == other.Route;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return std::hash<uint64_t>()(key.Route * 0x9E3779B97F4A7C15 ^ key.Peer);
+        }
+    };
+
+    struct State {
+        float Penalty = 0;
+        // When Penalty was last brought up to date, in granularity steps
+        uint32_t Updated = 0;
+        bool Suppressed = false;
+        // A timer for this path is on the wheel
+        bool Scheduled = false;
+    };
+
+    [[nodiscard]] uint32_t TickAt(const Clock::time_point now) const {
+        return now <= start_ ? 0 : static_cast<uint32_t>((now - start_) / parameters_.Granularity);
+    }
+
+    [[nodiscard]] double Decayed(const State &state, const uint32_t tick) const {
+        const auto elapsed = tick - state.Updated;
+        return elapsed < decay_.size() ? state.Penalty * decay_[elapsed] : 0;
+    }
+
+    bool Penalize(const PeerId peer, const Route &route, const double amount, const Clock::time_point now) {
+        const auto tick = TickAt(now);
+        const Key key{peer, routeKey(route)};
+        auto &state = states_[key];
+        state.Penalty = static_cast<float>(std::min(Decayed(state, tick) + amount, ceiling_));
+        state.Updated = tick;
+        if (!state.Suppressed && state.Penalty > parameters_.SuppressThreshold) {
+            state.Suppressed = true;
+            ++suppressed_;
+        }
+        if (!state.Scheduled) {
+            Schedule(key, state, tick);
+        }
+        return state.Suppressed;
+    }
+
+    // Sets a timer for when the path can be reused if it is suppressed, or forgotten if it is not. The penalty can only
+    // grow after this, so the timer is never late; if it turns out to be early, Poll() schedules it again.
+    void Schedule(const Key &key, State &state, const uint32_t tick) {
+        const auto threshold = state.Suppressed ? parameters_.ReuseThreshold : parameters_.ReuseThreshold / 2;
+        const auto decayed = Decayed(state, tick);
+        // First step at which the penalty is below the threshold, decay_ is decreasing
+        const auto steps = std::partition_point(decay_.begin(), decay_.end(), [&](const double factor) {
+            return decayed * factor >= threshold;
+        }) - decay_.begin();
+        timers_.Schedule(start_ + (tick + std::max<ptrdiff_t>(steps, 1)) * parameters_.Granularity, key);
+        state.Scheduled = true;
+    }
+
+    DampeningParameters parameters_;
+    Clock::time_point start_;
+    double ceiling_;
+    // decay_[i] is how much of a penalty is left after i granularity steps
+    std::vector<double> decay_;
+    std::unordered_map<Key, State, KeyHash> states_;
+    size_t suppressed_ = 0;
+    TimerWheel<Key> timers_;
+};
+
+#endif //BGP_DAMPENING_H
@@ -0,0 +1,303 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_EXPORT_H
+#define BGP_EXPORT_H
+
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include "Util.h"
+#include "Path.h"
+#include "AsPath.h"
+#include "Communities.h"
+#include "PathAttributes.h"
+#include "BgpHeader.h"
+#include "BgpUpdateMessage.h"
+#include "Rib.h"
+
+// Routes go out to a peer as UPDATEs of at most this many octets, RFC 4271 4
+constexpr size_t MAX_UPDATE_SIZE = 4096;
+
+// Hands an encoded UPDATE to send(std::vector<uint8_t>), or to send(std::vector<uint8_t>, std::span<const Route>) along
+// with the prefixes it carries if send takes them
+template<typename Function>
+void sendUpdate(Function &send, const std::vector<uint8_t> &message, const std::span<const Route> routes) {
+    if constexpr (std::is_invocable_v<Function &, const std::vector<uint8_t> &, std::span<const Route>>) {
+        send(message, routes);
+    } else {
+        send(message);
+    }
+}
+
+// Encodes routes that share attributes as UPDATEs, handing each one to send as a whole message (see sendUpdate()). As
+// many prefixes go in a message as fit, so the attributes are encoded once per set rather than once per prefix. Returns
+// the number of messages sent.
+template<typename Function>
+size_t forEachAnnouncementUpdate(const PathAttributeSet &attributes, const std::span<const Route> routes,
+                                 Function &&send) {
+    // Header, Withdrawn Routes Length, Total Path Attribute Length
+    constexpr size_t FIXED_SIZE = 19 + 2 + 2;
+
+    std::vector<uint8_t> encodedAttributes;
+    for (const auto &attribute : attributes.attributes()) {
+        appendPathAttribute(encodedAttributes, attribute);
+    }
+
+    size_t messages = 0;
+    std::vector<uint8_t> message;
+    for (size_t i = 0; i < routes.size();) {
+        message.assign(FIXED_SIZE, 0);
+        message[21] = static_cast<uint8_t>(encodedAttributes.size() >> 8);
+        message[22] = static_cast<uint8_t>(encodedAttributes.size());
+        message.insert(message.end(), encodedAttributes.begin(), encodedAttributes.end());
+        // A prefix takes at most 5 octets. The first one always goes in, so a message is never sent without NLRI
+        const auto first = i;
+        for (; i < routes.size() && (i == first || message.size() + 5 <= MAX_UPDATE_SIZE); ++i) {
+            appendIpv4Prefix(message, routes[i]);
+        }
+        const auto header = generateBgpHeader(message.size() - 19, Update);
+        std::copy(header.begin(), header.end(), message.begin());
+        sendUpdate(send, message, routes.subspan(first, i - first));
+        ++messages;
+    }
+    return messages;
+}
+
+// Encodes withdrawals as UPDATEs, as many per message as fit, handing each one to send (see sendUpdate()). Returns the
+// number of messages sent.
+template<typename Function>
+size_t forEachWithdrawalUpdate(const std::span<const Route> routes, Function &&send) {
+    // Header and Withdrawn Routes Length. Total Path Attribute Length goes at the end.
+    constexpr size_t FIXED_SIZE = 19 + 2;
+
+    size_t messages = 0;
+    std::vector<uint8_t> message;
+    for (size_t i = 0; i < routes.size();) {
+        message.assign(FIXED_SIZE, 0);
+        const auto first = i;
+        for (; i < routes.size() && message.size() + 5 + 2 <= MAX_UPDATE_SIZE; ++i) {
+            appendIpv4Prefix(message, routes[i]);
+        }
+        const auto withdrawnRoutesLength = message.size() - FIXED_SIZE;
+        message[19] = static_cast<uint8_t>(withdrawnRoutesLength >> 8);
+        message[20] = static_cast<uint8_t>(withdrawnRoutesLength);
+        message.insert(message.end(), {0, 0});
+        const auto header = generateBgpHeader(message.size() - 19, Update);
+        std::copy(header.begin(), header.end(), message.begin());
+        sendUpdate(send, message, routes.subspan(first, i - first));
+        ++messages;
+    }
+    return messages;
+}
+
+// The peer routes are exported to
+struct ExportSession {
+    PeerId Peer;
+    uint32_t LocalAsn;
+    // NEXT_HOP of everything sent to an external peer
+    uint32_t LocalAddress;
+    bool External;
+    // Whether the session negotiated 4-octet ASNs (RFC 6793)
+    bool FourOctetAsns;
+};
+
+// An AS_PATH or AS4_PATH value. Without 4-octet ASNs, the ones that do not fit are written as AS_TRANS (RFC 6793 4.2.2)
+// and asTrans is set.
+std::pmr::vector<uint8_t> encodeAsPath(const DecodedAsPath &path, const bool fourOctetAsns, bool &asTrans) {
+    std::pmr::vector<uint8_t> value;
+    for (const auto &segment : path.Segments) {
+        value.insert(value.end(), {static_cast<uint8_t>(segment.Type), segment.Length});
+        for (uint8_t i = 0; i < segment.Length; ++i) {
+            const auto asn = path.Asns[segment.Offset + i];
+            if (fourOctetAsns) {
+                value.insert(value.end(), {_32to8(asn)});
+            } else {
+                asTrans = asTrans || asn > UINT16_MAX;
+                value.insert(value.end(), {_16to8(asn > UINT16_MAX ? AS_TRANS : asn)});
+            }
+        }
+    }
+    return value;
+}
+
+// RFC 4271 9.1.3 and 5.1: the attributes best is advertised to a peer with, std::nullopt if it is not advertised to it at
+// all. from is the peer best was learned from. Paths are never sent back to the peer they came from, and without route
+// reflection a path learned over iBGP is not sent to an iBGP peer. NO_ADVERTISE keeps a path from every peer,
+// NO_EXPORT and NO_EXPORT_SUBCONFED from external ones.
+//
+// The well-known attributes are rebuilt from the decision keys, so import policy set actions carry over. An external
+// peer gets the local ASN prepended to the AS_PATH, the local address as NEXT_HOP, and neither LOCAL_PREF nor MULTI_EXIT_DISC
+// (RFC 4271 5.1.4 and 5.1.5). Optional transitive attributes are passed on as they are, optional non-transitive ones
+// are dropped. A 2-octet session gets AS4_PATH and AS4_AGGREGATOR where needed (RFC 6793 4.2.2).
+std::optional<std::vector<PathAttribute>> exportPathAttributes(const RibPath &best, const RibPeer &from,
+                                                               const ExportSession &to) {
+    if (best.Peer == to.Peer || (!from.External && !to.External)) {
+        return std::nullopt;
+    }
+    const auto &attributes = *best.Attributes;
+    if (const auto &communities = attributes.communities()) {
+        if (communities->Contains(NO_ADVERTISE) ||
+            (to.External && (communities->Contains(NO_EXPORT) || communities->Contains(NO_EXPORT_SUBCONFED)))) {
+            return std::nullopt;
+        }
+    }
+
+    DecodedAsPath path;
+    if (to.External) {
+        const uint32_t localAsn[1] = {to.LocalAsn};
+        path.AppendSegment(ASSequence, localAsn);
+    }
+    if (const auto &asPath = attributes.as_path()) {
+        for (size_t i = 0; i < asPath->segment_count(); ++i) {
+            const auto segment = asPath->segment(i);
+            path.AppendSegment(segment.Type, asPath->asns().subspan(segment.Offset, segment.Length));
+        }
+    }
+    bool asTrans = false;
+    const auto &keys = best.Keys;
+    std::vector<PathAttribute> exported = {
+            {Transitive, OriginAttribute, {static_cast<uint8_t>(keys.OriginType)}},
+            {Transitive, AsPathAttribute, encodeAsPath(path, to.FourOctetAsns, asTrans)},
+            {Transitive, NextHopAttribute, {_32to8(to.External ? to.LocalAddress : keys.NextHopAddress)}}
+    };
+    if (!to.External) {
+        if (keys.Flags & HasMultiExitDiscriminator) {
+            exported.emplace_back(PathAttribute{Optional, MultiExitDiscriminatorAttribute, {_32to8(keys.Med)}});
+        }
+        exported.emplace_back(PathAttribute{Transitive, LocalPrefAttribute, {_32to8(keys.LocalPreference)}});
+    }
+    if (attributes.atomic_aggregate()) {
+        exported.emplace_back(PathAttribute{Transitive, AtomicAggregateAttribute, {}});
+    }
+    if (const auto &aggregator = attributes.aggregator()) {
+        constexpr uint8_t flags = Optional | Transitive;
+        if (to.FourOctetAsns) {
+            exported.emplace_back(PathAttribute{flags, AggregatorAttribute,
+                                                {_32to8(aggregator->LocalAs), _32to8(aggregator->RouterId)}});
+        } else {
+            const auto asn = aggregator->LocalAs > UINT16_MAX ? AS_TRANS : aggregator->LocalAs;
+            exported.emplace_back(PathAttribute{flags, AggregatorAttribute,
+                                                {_16to8(asn), _32to8(aggregator->RouterId)}});
+            if (asn == AS_TRANS) {
+                exported.emplace_back(PathAttribute{flags, As4AggregatorAttribute,
+                                                    {_32to8(aggregator->LocalAs), _32to8(aggregator->RouterId)}});
+            }
+        }
+    }
+    for (const auto &attribute : attributes.attributes()) {
+        if ((attribute.Flags & Optional) && (attribute.Flags & Transitive) && attribute.Type != AggregatorAttribute &&
+            attribute.Type != As4PathAttribute && attribute.Type != As4AggregatorAttribute) {
+            exported.emplace_back(PathAttribute{attribute.Flags, attribute.Type,
+                                                {attribute.Value.begin(), attribute.Value.end()}});
+        }
+    }
+    if (asTrans) {
+        bool unused = false;
+        exported.emplace_back(PathAttribute{static_cast<uint8_t>(Optional | Transitive), As4PathAttribute,
+                                            encodeAsPath(path, true, unused)});
+    }
+    std::stable_sort(exported.begin(), exported.end(), [](const auto &a, const auto &b) { return a.Type < b.Type; });
+    return exported;
+}
+
+// Exports Loc-RIB best paths to one peer: rewrites their attributes for it (see exportPathAttributes()), keeps its
+// Adj-RIB-Out up to date, and sends it what changed there. Changes are collected until Flush(), so a prefix that changes
+// several times in a batch is sent once, and prefixes that end up with the same attributes share UPDATEs. Exported
+// attribute sets are interned in store, and computed once per batch for paths that share attributes and keys.
+class RouteExporter {
+public:
+    RouteExporter(const ExportSession session, AdjRibOut &adjRibOut, PathAttributeStore &store)
+            : session_(session),
+              adjRibOut_(adjRibOut),
+              store_(store) {}
+
+    // best is route's best path and from the peer it was learned from, best nullptr to withdraw the route, e.g. when it
+    // has no reachable path or outbound policy denies it
+    void Export(const Route &route, const RibPath *best, const RibPeer *from) {
+        const auto attributes = best ? Exported(*best, *from) : nullptr;
+        if (attributes ? adjRibOut_.Update(route, attributes) : adjRibOut_.Withdraw(route)) {
+            pending_.emplace_back(routeKey(route));
+        }
+    }
+
+    // Sends what changed since the last call, withdrawals first, to send (see sendUpdate()). Returns the number of
+    // messages sent.
+    template<typename Function>
+    size_t Flush(Function &&send) {
+        std::sort(pending_.begin(), pending_.end());
+        pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
+        std::vector<Route> withdrawn;
+        std::unordered_map<const PathAttributeSet *, std::vector<Route>> announced;
+        for (const auto key : pending_) {
+            const auto route = routeFromKey(key);
+            if (const auto attributes = adjRibOut_.Find(route)) {
+                announced[attributes->get()].emplace_back(route);
+            } else {
+                withdrawn.emplace_back(route);
+            }
+        }
+        pending_.clear();
+        cache_.clear();
+
+        auto messages = forEachWithdrawalUpdate(withdrawn, send);
+        for (const auto &[attributes, routes] : announced) {
+            messages += forEachAnnouncementUpdate(*attributes, routes, send);
+        }
+        return messages;
+    }
+
+    [[nodiscard]] const ExportSession &session() const {
+        return session_;
+    }
+
+private:
+    std::shared_ptr<const PathAttributeSet> Exported(const RibPath &best, const RibPeer &from) {
+        const CacheKey key{best.Attributes.get(), best.Keys, from.Id};
+        const auto cached = cache_.find(key);
+        if (cached != cache_.end()) {
+            return cached->second.second;
+        }
+        const auto attributes = exportPathAttributes(best, from, session_);
+        auto exported = attributes ? store_.Intern(*attributes, session_.FourOctetAsns) : nullptr;
+        // The source set is held until Flush(), so its address cannot come back as a different set in the meantime
+        cache_.emplace(key, std::make_pair(best.Attributes, exported));
+        return exported;
+    }
+
+    struct CacheKey {
+        const PathAttributeSet *Attributes;
+        DecisionKeys Keys;
+        PeerId From;
+
+        bool operator==(const CacheKey &other) const = default;
+    };
+
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey &key) const {
+            auto hash = std::hash<const void *>()(key.Attributes);
+            for (const uint64_t value : {uint64_t{key.Keys.LocalPreference}, uint64_t{key.Keys.Med},
+                                         uint64_t{key.Keys.NextHopAddress}, uint64_t{key.Keys.OriginType},
+                                         uint64_t{key.Keys.Flags}, uint64_t{key.From}}) {
+                hash = hash * 0x9E3779B97F4A7C15ULL + value;
+            }
+            return hash;
+        }
+    };
+
+    ExportSession session_;
+    AdjRibOut &adjRibOut_;
+    PathAttributeStore &store_;
+    // Routes whose Adj-RIB-Out entry changed since the last Flush(), a route changed twice is in here twice
+    std::vector<uint64_t> pending_;
+    std::unordered_map<CacheKey, std::pair<std::shared_ptr<const PathAttributeSet>,
+            std::shared_ptr<const PathAttributeSet>>, CacheKeyHash> cache_;
+};
+
+#endif //BGP_EXPORT_H
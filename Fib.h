@@ -0,0 +1,445 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_FIB_H
+#define BGP_FIB_H
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include "Route.h"
+#include "Path.h"
+#include "Util.h"
+#include "Rib.h"
+#include "NextHopTable.h"
+
+// An IPv4 longest-prefix-match table in the DIR-24-8 layout: a 2^24 entry table indexed by the top 24 bits of the
+// address, and 256 entry extension groups for the /24s that have longer prefixes below them. A lookup is one memory
+// access, or two for an address covered by a prefix longer than /24.
+//
+// Each entry is one 32 bit word: a valid bit, an extended bit, the length of the prefix that produced it, and either
+// a 24 bit value or the index of an extension group. Every entry is written with a single atomic store and extension
+// groups are filled in before they are linked, so any number of threads can call Lookup() while one thread updates.
+// Extension groups that are unlinked are only reused after the next call to ReclaimGroups(), by which time lookups
+// that might still read them have finished.
+// TODO: [9] IPv6
+class Ipv4Fib {
+public:
+    static constexpr uint32_t MAX_VALUE = 0x00FFFFFF;
+    // Enough for every prefix longer than /24 in a full table several times over, each group is 1 KiB
+    static constexpr uint32_t DEFAULT_EXTENSION_GROUPS = 16384;
+
+    explicit Ipv4Fib(const uint32_t extensionGroups = DEFAULT_EXTENSION_GROUPS)
+            : tbl24_(new std::atomic<uint32_t>[TBL24_SIZE]()),
+              tbl8_(new std::atomic<uint32_t>[static_cast<size_t>(extensionGroups) * GROUP_SIZE]()) {
+        freeGroups_.reserve(extensionGroups);
+        for (uint32_t group = extensionGroups; group > 0; --group) {
+            freeGroups_.emplace_back(group - 1);
+        }
+    }
+
+    [[nodiscard]] std::optional<uint32_t> Lookup(const uint32_t address) const {
+        auto entry = tbl24_[address >> 8].load(std::memory_order_acquire);
+        if (entry & EXTENDED) {
+            entry = tbl8_[(entry & VALUE_MASK) * GROUP_SIZE + (address & 0xFF)].load(std::memory_order_relaxed);
+        }
+        return entry & VALID ? std::optional<uint32_t>(entry & VALUE_MASK) : std::nullopt;
+    }
+
+    // The value installed for exactly this prefix, as opposed to the longest match
+    [[nodiscard]] std::optional<uint32_t> Find(const Route &route) const {
+        const auto length = std::min<uint8_t>(route.Length, 32);
+        const auto &rules = rules_[length];
+        const auto it = rules.find(route.Prefix & mask(length));
+        return it == rules.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+    }
+
+    // Installs or replaces the prefix. Returns false if it needed an extension group and none were left.
+    bool Insert(const Route &route, const uint32_t value) {
+        if (value > MAX_VALUE) {
+            throw std::out_of_range("FIB value " + std::to_string(value) + " does not fit in 24 bits");
+        }
+        const auto length = std::min<uint8_t>(route.Length, 32);
+        const auto prefix = route.Prefix & mask(length);
+        const auto entry = makeEntry(value, length);
+
+        if (length <= 24) {
+            const auto first = prefix >> 8;
+            const auto last = first + (1u << (24 - length));
+            for (auto i = first; i < last; ++i) {
+                const auto current = tbl24_[i].load(std::memory_order_relaxed);
+                if (current & EXTENDED) {
+                    FillGroup(current & VALUE_MASK, 0, GROUP_SIZE, entry, length);
+                } else if (!(current & VALID) || depth(current) <= length) {
+                    tbl24_[i].store(entry, std::memory_order_release);
+                }
+            }
+        } else {
+            const auto index = prefix >> 8;
+            auto current = tbl24_[index].load(std::memory_order_relaxed);
+            if (!(current & EXTENDED)) {
+                if (freeGroups_.empty()) {
+                    return false;
+                }
+                const auto group = freeGroups_.back();
+                freeGroups_.pop_back();
+                // The group starts out as a copy of the /24 entry it replaces, then gets linked in
+                for (uint32_t i = 0; i < GROUP_SIZE; ++i) {
+                    tbl8_[group * GROUP_SIZE + i].store(current, std::memory_order_relaxed);
+                }
+                current = EXTENDED | VALID | group;
+                tbl24_[index].store(current, std::memory_order_release);
+                ++groupsInUse_;
+            }
+            const auto first = prefix & 0xFF;
+            FillGroup(current & VALUE_MASK, first, first + (1u << (32 - length)), entry, length);
+        }
+
+        rules_[length][prefix] = value;
+        return true;
+    }
+
+    // Removes the prefix, the addresses it covered fall back to the next shorter covering prefix
+    bool Remove(const Route &route) {
+        const auto length = std::min<uint8_t>(route.Length, 32);
+        const auto prefix = route.Prefix & mask(length);
+        if (rules_[length].erase(prefix) == 0) {
+            return false;
+        }
+        const auto replacement = FindCovering(prefix, length);
+
+        if (length <= 24) {
+            const auto first = prefix >> 8;
+            const auto last = first + (1u << (24 - length));
+            for (auto i = first; i < last; ++i) {
+                const auto current = tbl24_[i].load(std::memory_order_relaxed);
+                if (current & EXTENDED) {
+                    ReplaceInGroup(current & VALUE_MASK, 0, GROUP_SIZE, length, replacement);
+                    TryCollapse(i);
+                } else if ((current & VALID) && depth(current) == length) {
+                    tbl24_[i].store(replacement, std::memory_order_release);
+                }
+            }
+        } else {
+            const auto index = prefix >> 8;
+            const auto current = tbl24_[index].load(std::memory_order_relaxed);
+            const auto first = prefix & 0xFF;
+            ReplaceInGroup(current & VALUE_MASK, first, first + (1u << (32 - length)), length, replacement);
+            TryCollapse(index);
+        }
+        return true;
+    }
+
+    // Makes the extension groups released since the last call available again. Call this once no lookup that started
+    // before the previous call can still be running, e.g. once per update batch.
+    void ReclaimGroups() {
+        freeGroups_.insert(freeGroups_.end(), retiredGroups_.begin(), retiredGroups_.end());
+        retiredGroups_.clear();
+    }
+
+    // Number of prefixes installed
+    [[nodiscard]] size_t size() const {
+        size_t count = 0;
+        for (const auto &rules : rules_) {
+            count += rules.size();
+        }
+        return count;
+    }
+
+    [[nodiscard]] uint32_t extension_groups() const {
+        return groupsInUse_;
+    }
+
+private:
+    static constexpr uint32_t TBL24_SIZE = 1u << 24;
+    static constexpr uint32_t GROUP_SIZE = 256;
+    static constexpr uint32_t VALID = 0x80000000;
+    static constexpr uint32_t EXTENDED = 0x40000000;
+    static constexpr uint32_t DEPTH_SHIFT = 24;
+    static constexpr uint32_t DEPTH_MASK = 0x3F;
+    static constexpr uint32_t VALUE_MASK = 0x00FFFFFF;
+
+    static constexpr uint32_t mask(const uint8_t length) {
+        return length == 0 ? 0 : UINT32_MAX << (32 - length);
+    }
+
+    static constexpr uint32_t makeEntry(const uint32_t value, const uint8_t length) {
+        return VALID | static_cast<uint32_t>(length) << DEPTH_SHIFT | value;
+    }
+
+    static constexpr uint8_t depth(const uint32_t entry) {
+        return static_cast<uint8_t>(entry >> DEPTH_SHIFT & DEPTH_MASK);
+    }
+
+    // Overwrites the entries in [first, last) of group that are not covered by a longer prefix
+    void FillGroup(const uint32_t group, const uint32_t first, const uint32_t last, const uint32_t entry,
+                   const uint8_t length) {
+        for (auto i = group * GROUP_SIZE + first; i < group * GROUP_SIZE + last; ++i) {
+            const auto current = tbl8_[i].load(std::memory_order_relaxed);
+            if (!(current & VALID) || depth(current) <= length) {
+                tbl8_[i].store(entry, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Replaces the entries in [first, last) of group that came from a prefix of length
+    void ReplaceInGroup(const uint32_t group, const uint32_t first, const uint32_t last, const uint8_t length,
+                        const uint32_t replacement) {
+        for (auto i = group * GROUP_SIZE + first; i < group * GROUP_SIZE + last; ++i) {
+            const auto current = tbl8_[i].load(std::memory_order_relaxed);
+            if ((current & VALID) && depth(current) == length) {
+                tbl8_[i].store(replacement, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Folds an extension group back into its /24 entry once it no longer holds anything longer than /24
+    void TryCollapse(const uint32_t index) {
+        const auto current = tbl24_[index].load(std::memory_order_relaxed);
+        const auto group = current & VALUE_MASK;
+        const auto first = tbl8_[group * GROUP_SIZE].load(std::memory_order_relaxed);
+        if ((first & VALID) && depth(first) > 24) {
+            return;
+        }
+        for (uint32_t i = 1; i < GROUP_SIZE; ++i) {
+            if (tbl8_[group * GROUP_SIZE + i].load(std::memory_order_relaxed) != first) {
+                return;
+            }
+        }
+        tbl24_[index].store(first, std::memory_order_release);
+        retiredGroups_.emplace_back(group);
+        --groupsInUse_;
+    }
+
+    // The entry of the longest installed prefix shorter than length that covers prefix, or an invalid entry
+    [[nodiscard]] uint32_t FindCovering(const uint32_t prefix, const uint8_t length) const {
+        for (auto covering = static_cast<int>(length) - 1; covering >= 0; --covering) {
+            const auto &rules = rules_[covering];
+            if (rules.empty()) {
+                continue;
+            }
+            const auto it = rules.find(prefix & mask(static_cast<uint8_t>(covering)));
+            if (it != rules.end()) {
+                return makeEntry(it->second, static_cast<uint8_t>(covering));
+            }
+        }
+        return 0;
+    }
+
+    std::unique_ptr<std::atomic<uint32_t>[]> tbl24_;
+    std::unique_ptr<std::atomic<uint32_t>[]> tbl8_;
+    std::vector<uint32_t> freeGroups_;
+    std::vector<uint32_t> retiredGroups_;
+    uint32_t groupsInUse_ = 0;
+    // Installed prefixes by length, the source of truth the tables are derived from
+    std::array<std::unordered_map<uint32_t, uint32_t>, 33> rules_;
+};
+
+// The forwarding view of the Loc-RIB. Prefixes in the Ipv4Fib point at forwarding entries rather than next hops: a
+// forwarding entry is a path list's next hops in order of preference, shared by every prefix with the same primary and
+// backup next hops, and it forwards to the first one that is reachable. Losing a next hop therefore only rewrites the
+// forwarding entries that use it, however many prefixes are behind them (prefix independent convergence). Like
+// extension groups, released forwarding entries are only reused from the next batch on.
+class Fib {
+public:
+    // Upper bound on distinct forwarding entries, fixed so that readers never see the table move
+    static constexpr uint32_t MAX_FORWARDING_ENTRIES = 65536;
+
+    explicit Fib(const uint32_t extensionGroups = Ipv4Fib::DEFAULT_EXTENSION_GROUPS)
+            : table_(extensionGroups),
+              active_(new std::atomic<NextHop>[MAX_FORWARDING_ENTRIES]()) {}
+
+    [[nodiscard]] std::optional<NextHop> Lookup(const uint32_t address) const {
+        const auto index = table_.Lookup(address);
+        if (!index) {
+            return std::nullopt;
+        }
+        // 0 when none of the entry's next hops is reachable
+        const auto nextHop = active_[*index].load(std::memory_order_relaxed);
+        return nextHop == 0 ? std::nullopt : std::optional<NextHop>(nextHop);
+    }
+
+    // Applies a batch of Loc-RIB prefix changes. Only the last change per prefix is applied, which is all that matters
+    // for forwarding.
+    void Apply(std::span<const RibChange> changes) {
+        table_.ReclaimGroups();
+        freeEntries_.insert(freeEntries_.end(), retiredEntries_.begin(), retiredEntries_.end());
+        retiredEntries_.clear();
+
+        std::unordered_set<uint64_t> seen;
+        seen.reserve(changes.size());
+        for (auto it = changes.rbegin(); it != changes.rend(); ++it) {
+            if (!seen.insert(routeKey(it->Prefix)).second) {
+                continue;
+            }
+            if (it->Paths) {
+                Install(it->Prefix, *it->Paths);
+            } else {
+                Uninstall(it->Prefix);
+            }
+        }
+    }
+
+    // Re-points the forwarding entries that use address after its reachability changed. Returns the number of entries
+    // rewritten, which is independent of the number of prefixes.
+    size_t Refresh(const NextHop address) {
+        const auto it = byNextHop_.find(address);
+        if (it == byNextHop_.end()) {
+            return 0;
+        }
+        for (const auto index : it->second) {
+            active_[index].store(ActiveNextHop(entries_[index]), std::memory_order_relaxed);
+        }
+        return it->second.size();
+    }
+
+    [[nodiscard]] const Ipv4Fib &table() const {
+        return table_;
+    }
+
+    [[nodiscard]] size_t forwarding_entry_count() const {
+        return entryIndices_.size();
+    }
+
+    // Prefixes that could not be installed because the table ran out of extension groups or forwarding entries
+    [[nodiscard]] uint64_t failed_installs() const {
+        return failedInstalls_;
+    }
+
+private:
+    struct ForwardingEntry {
+        // In order of preference, without duplicates
+        std::vector<std::shared_ptr<const NextHopEntry>> NextHops;
+        uint64_t Hash = 0;
+        uint32_t References = 0;
+    };
+
+    static NextHop ActiveNextHop(const ForwardingEntry &entry) {
+        for (const auto &nextHop : entry.NextHops) {
+            if (nextHop->reachable()) {
+                return nextHop->address();
+            }
+        }
+        return 0;
+    }
+
+    void Install(const Route &route, const PathList &paths) {
+        const auto previous = table_.Find(route);
+        const auto acquired = AcquireEntry(paths);
+        if (!acquired) {
+            ++failedInstalls_;
+            return;
+        }
+        const auto index = *acquired;
+        if (previous == index) {
+            ReleaseEntry(index);
+            return;
+        }
+        if (!table_.Insert(route, index)) {
+            ReleaseEntry(index);
+            ++failedInstalls_;
+            return;
+        }
+        if (previous) {
+            ReleaseEntry(*previous);
+        }
+    }
+
+    void Uninstall(const Route &route) {
+        const auto previous = table_.Find(route);
+        if (previous && table_.Remove(route)) {
+            ReleaseEntry(*previous);
+        }
+    }
+
+    // std::nullopt if the ordering is new and all MAX_FORWARDING_ENTRIES entries are taken
+    std::optional<uint32_t> AcquireEntry(const PathList &paths) {
+        std::vector<std::shared_ptr<const NextHopEntry>> nextHops;
+        nextHops.reserve(paths.preference().size());
+        uint64_t hash = hashBytes(nullptr, 0);
+        for (const auto index : paths.preference()) {
+            const auto &nextHop = paths.next_hop(index);
+            if (std::find(nextHops.begin(), nextHops.end(), nextHop) == nextHops.end()) {
+                const auto id = nextHop->id();
+                hash = hashBytes(reinterpret_cast<const uint8_t *>(&id), sizeof(id), hash);
+                nextHops.emplace_back(nextHop);
+            }
+        }
+
+        auto [it, end] = entryIndices_.equal_range(hash);
+        for (; it != end; ++it) {
+            auto &entry = entries_[it->second];
+            if (entry.NextHops == nextHops) {
+                ++entry.References;
+                return it->second;
+            }
+        }
+
+        uint32_t index;
+        if (!freeEntries_.empty()) {
+            index = freeEntries_.back();
+            freeEntries_.pop_back();
+        } else if (entries_.size() < MAX_FORWARDING_ENTRIES) {
+            index = static_cast<uint32_t>(entries_.size());
+            entries_.emplace_back();
+        } else {
+            return std::nullopt;
+        }
+
+        auto &entry = entries_[index];
+        entry.NextHops = std::move(nextHops);
+        entry.Hash = hash;
+        entry.References = 1;
+        active_[index].store(ActiveNextHop(entry), std::memory_order_relaxed);
+        entryIndices_.emplace(hash, index);
+        for (const auto &nextHop : entry.NextHops) {
+            byNextHop_[nextHop->address()].emplace_back(index);
+        }
+        return index;
+    }
+
+    void ReleaseEntry(const uint32_t index) {
+        auto &entry = entries_[index];
+        if (--entry.References > 0) {
+            return;
+        }
+        auto [it, end] = entryIndices_.equal_range(entry.Hash);
+        for (; it != end; ++it) {
+            if (it->second == index) {
+                entryIndices_.erase(it);
+                break;
+            }
+        }
+        for (const auto &nextHop : entry.NextHops) {
+            auto &indices = byNextHop_[nextHop->address()];
+            std::erase(indices, index);
+            if (indices.empty()) {
+                byNextHop_.erase(nextHop->address());
+            }
+        }
+        entry.NextHops.clear();
+        retiredEntries_.emplace_back(index);
+    }
+
+    Ipv4Fib table_;
+    // The next hop each forwarding entry currently forwards to, the only part of an entry lookups read
+    std::unique_ptr<std::atomic<NextHop>[]> active_;
+    std::vector<ForwardingEntry> entries_;
+    std::unordered_multimap<uint64_t, uint32_t> entryIndices_;
+    std::unordered_map<NextHop, std::vector<uint32_t>> byNextHop_;
+    std::vector<uint32_t> freeEntries_;
+    std::vector<uint32_t> retiredEntries_;
+    uint64_t failedInstalls_ = 0;
+};
+
+#endif //BGP_FIB_H
@@ -8,6 +8,8 @@
 #include <cstdint>
 #include <utility>
 #include <functional>
+#include <chrono>
+#include <algorithm>
 #include "Log.h"
 
 enum BgpSessionState {
@@ -256,6 +258,19 @@ struct BgpFiniteStateMachine {
     uint16_t MinRouteAdvertisementIntervalTime;
     uint16_t DelayOpenTime;
     uint16_t IdleHoldTime;
+    // Peer oscillation damping: the IdleHoldTimer doubles up to MaxIdleHoldTime with every failure, and halves for
+    // every IdleHoldStableTime the session then stays Established
+    uint16_t MaxIdleHoldTime = 600;
+    uint16_t IdleHoldStableTime = 600;
+
+    // Peer oscillation damping counters: the IdleHoldTimer value for the last failure, 0 if the peer has not failed
+    // since it was last stable, and how many times the peer was held in Idle
+    uint16_t IdleHoldBackoff = 0;
+    uint32_t PeerOscillationsDamped = 0;
+    // When the session last reached Established
+    std::chrono::steady_clock::time_point EstablishedAt;
+    // The Cease subcode an AutomaticStop sends, for whoever stops the session to say why
+    uint8_t AutomaticStopSubcode = AdministrativeShutdown;
 
     // Timers
     BgpSessionTimer ConnectRetryTimer;
@@ -270,6 +285,9 @@ struct BgpFiniteStateMachine {
 
     std::vector<BgpCapability> Capabilities;
 
+    // Called with the old and the new state after an event moved the session to a different state
+    std::function<void(BgpSessionState, BgpSessionState)> OnStateChange;
+
 
     BgpFiniteStateMachine(const uint32_t localIpAddress, const uint32_t remoteIpAddress, const uint16_t localAsn,
                           const uint16_t remoteAsn, const uint32_t localRouterId, const uint32_t remoteRouterId,
@@ -349,6 +367,13 @@ struct BgpFiniteStateMachine {
         this->MinRouteAdvertisementIntervalTime = other.MinRouteAdvertisementIntervalTime;
         this->DelayOpenTime = other.DelayOpenTime;
         this->IdleHoldTime = other.IdleHoldTime;
+        this->MaxIdleHoldTime = other.MaxIdleHoldTime;
+        this->IdleHoldStableTime = other.IdleHoldStableTime;
+
+        this->IdleHoldBackoff = other.IdleHoldBackoff;
+        this->PeerOscillationsDamped = other.PeerOscillationsDamped;
+        this->EstablishedAt = other.EstablishedAt;
+        this->AutomaticStopSubcode = other.AutomaticStopSubcode;
 
         this->ConnectRetryTimer = other.ConnectRetryTimer;
         this->HoldTimer = other.HoldTimer;
@@ -361,6 +386,8 @@ struct BgpFiniteStateMachine {
         this->SendMessageToPeer = other.SendMessageToPeer;
 
         this->Capabilities = other.Capabilities;
+
+        this->OnStateChange = other.OnStateChange;
     }
 
     uint16_t ApplyJitter(const uint16_t value) {
@@ -378,6 +405,7 @@ struct BgpFiniteStateMachine {
         std::stringstream message;
         message << "Handling FSM event " << FsmEventTypeToString(eventType) << " in state " << BgpSessionStateToString(State);
         logging::DEBUG(message.str());
+        const auto previousState = State;
         switch (State) {
             case Idle:
                 HandleEventInIdleState(eventType);
@@ -398,6 +426,43 @@ struct BgpFiniteStateMachine {
                 HandleEventInEstablishedState(eventType);
                 break;
         }
+        if (State == Established && previousState != Established) {
+            EstablishedAt = std::chrono::steady_clock::now();
+        }
+        if (State != previousState && OnStateChange) {
+            OnStateChange(previousState, State);
+        }
+    }
+
+    // True while the IdleHoldTimer keeps the peer in Idle
+    [[nodiscard]] bool IsDamped() const {
+        return IdleHoldTimer.Active.load(std::memory_order_acquire);
+    }
+
+    // RFC 4271 8.1.1: called on every transition to Idle that counts as a failure. A peer that keeps failing is held
+    // in Idle by the IdleHoldTimer, for IdleHoldTime the first time and twice as long for every failure after that, so
+    // its table is not loaded and purged over and over. Time spent Established decays the backoff again.
+    void DampPeerOscillation() {
+        if (!(Attributes & DampPeerOscillations)) {
+            return;
+        }
+        if (State == Established && IdleHoldStableTime != 0) {
+            const auto stable = (std::chrono::steady_clock::now() - EstablishedAt) /
+                                std::chrono::seconds(IdleHoldStableTime);
+            IdleHoldBackoff = stable >= 16 ? 0 : static_cast<uint16_t>(IdleHoldBackoff >> stable);
+            if (IdleHoldBackoff < IdleHoldTime) {
+                IdleHoldBackoff = 0;
+            }
+        }
+        // An IdleHoldTime of 0 still backs off, starting from a second
+        IdleHoldBackoff = IdleHoldBackoff == 0 ? std::max<uint16_t>(IdleHoldTime, 1)
+                                               : static_cast<uint16_t>(std::min(IdleHoldBackoff * 2, +MaxIdleHoldTime));
+        ++PeerOscillationsDamped;
+        IdleHoldTimer.Restart(IdleHoldBackoff);
+        std::stringstream message;
+        message << "Damping peer oscillation: holding peer in Idle for " << IdleHoldBackoff << "s ("
+                << PeerOscillationsDamped << " times)";
+        logging::INFO(message.str());
     }
 
     void HandleEventInIdleState(const FsmEventType eventType) {
@@ -409,25 +474,36 @@ struct BgpFiniteStateMachine {
             case KeepaliveTimerExpires:
             case DelayOpenTimerExpires:
                 break;
-            case ManualStart:
             case AutomaticStart:
+            case AutomaticStartWithPassiveTcpEstablishment:
+            case AutomaticStartWithDampPeerOscillations:
+            case AutomaticStartWithDampPeerOscillationsAndPassiveTcpEstablishment:
+                // A damped peer stays in Idle until the IdleHoldTimer expires
+                if (IsDamped()) {
+                    break;
+                }
                 ConnectRetryCounter = 0;
                 ConnectRetryTimer.Start();
-                // Initiate TCP connection to peer
+                // Initiate TCP connection to peer, unless passive
                 // Listen for TCP connection from peer
-                State = Connect;
+                State = eventType == AutomaticStart || eventType == AutomaticStartWithDampPeerOscillations ? Connect
+                                                                                                          : Active;
                 break;
+            case ManualStart:
             case ManualStartWithPassiveTcpEstablishment:
-            case AutomaticStartWithPassiveTcpEstablishment:
+                // The operator overrides damping
+                IdleHoldTimer.Stop();
                 ConnectRetryCounter = 0;
                 ConnectRetryTimer.Start();
+                // Initiate TCP connection to peer, unless passive
                 // Listen for TCP connection from peer
-                State = Active;
+                State = eventType == ManualStart ? Connect : Active;
                 break;
-            case AutomaticStartWithDampPeerOscillations:
-            case AutomaticStartWithDampPeerOscillationsAndPassiveTcpEstablishment:
             case IdleHoldTimerExpires:
-                // TODO: implement damp peer oscillation
+                // The back-off period is over, start again the way the session is configured to
+                ConnectRetryCounter = 0;
+                ConnectRetryTimer.Start();
+                State = Attributes & PassiveTcpEstablishment ? Active : Connect;
                 break;
             default:
                 break;
@@ -527,9 +603,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             }
@@ -545,9 +619,7 @@ struct BgpFiniteStateMachine {
                     // Release all resources
                     // Drop TCP connection
                     ++ConnectRetryCounter;
-                    if (Attributes & DampPeerOscillations) {
-                        // TODO: support for damp peer oscillations
-                    }
+                    DampPeerOscillation();
                     State = Idle;
                 }
                 break;
@@ -624,9 +696,7 @@ struct BgpFiniteStateMachine {
                 DelayOpenTimer.Reset(0);
                 // Release all resources
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpOpenWithDelayOpenTimerRunning:
@@ -656,9 +726,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpNotificationMessageVersionError:
@@ -673,9 +741,7 @@ struct BgpFiniteStateMachine {
                     // Release all resources
                     // Drop TCP connection
                     ++ConnectRetryCounter;
-                    if (Attributes & DampPeerOscillations) {
-                        // TODO: support for damp peer oscillations
-                    }
+                    DampPeerOscillation();
                     State = Idle;
                 }
                 break;
@@ -693,9 +759,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             default:
@@ -738,14 +802,12 @@ struct BgpFiniteStateMachine {
             }
             case AutomaticStop: {
                 // Send NOTIFICATION with CEASE
-                SendNotificationMessage(CeaseError, AdministrativeShutdown);
+                SendNotificationMessage(CeaseError, AutomaticStopSubcode);
                 ConnectRetryTimer.Reset(0);
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             }
@@ -756,9 +818,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case TcpConnectionValid:
@@ -794,9 +854,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpOpenCollisionDump:
@@ -806,9 +864,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpNotificationMessageVersionError:
@@ -832,9 +888,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             default:
@@ -862,14 +916,12 @@ struct BgpFiniteStateMachine {
                 break;
             case AutomaticStop:
                 // Send NOTIFICATION with CEASE
-                SendNotificationMessage(CeaseError, AdministrativeShutdown);
+                SendNotificationMessage(CeaseError, AutomaticStopSubcode);
                 ConnectRetryTimer.Reset(0);
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case HoldTimerExpires:
@@ -879,9 +931,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case KeepaliveTimerExpires:
@@ -903,9 +953,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpNotificationMessageVersionError:
@@ -922,9 +970,7 @@ struct BgpFiniteStateMachine {
                     // Release all resources
                     // Drop TCP connection (TCP FIN)
                     ++ConnectRetryCounter;
-                    if (Attributes & DampPeerOscillations) {
-                        // TODO: support for damp peer oscillations
-                    }
+                    DampPeerOscillation();
                     State = Idle;
                 }
                 break;
@@ -936,9 +982,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpOpenCollisionDump:
@@ -948,9 +992,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case BgpKeepaliveMessageReceived:
@@ -969,9 +1011,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
         }
@@ -998,15 +1038,13 @@ struct BgpFiniteStateMachine {
                 break;
             case AutomaticStop:
                 // Send NOTIFICATION with CEASE
-                SendNotificationMessage(CeaseError, AdministrativeShutdown);
+                SendNotificationMessage(CeaseError, AutomaticStopSubcode);
                 ConnectRetryTimer.Reset(0);
                 // Delete all routes associated with this connection
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case HoldTimerExpires:
@@ -1016,9 +1054,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case KeepaliveTimerExpires:
@@ -1053,9 +1089,7 @@ struct BgpFiniteStateMachine {
                     // Release all resources
                     // Drop TCP connection
                     ++ConnectRetryCounter;
-                    if (Attributes & DampPeerOscillations) {
-                        // TODO: support for damp peer oscillations
-                    }
+                    DampPeerOscillation();
                     State = Idle;
                     break;
                 }
@@ -1089,9 +1123,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
             case ConnectRetryTimerExpires:
@@ -1107,9 +1139,7 @@ struct BgpFiniteStateMachine {
                 // Release all resources
                 // Drop TCP connection
                 ++ConnectRetryCounter;
-                if (Attributes & DampPeerOscillations) {
-                    // TODO: support for damp peer oscillations
-                }
+                DampPeerOscillation();
                 State = Idle;
                 break;
         }
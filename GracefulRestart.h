@@ -0,0 +1,233 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_GRACEFULRESTART_H
+#define BGP_GRACEFULRESTART_H
+
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include "Util.h"
+#include "BgpCapability.h"
+#include "BgpUpdateMessage.h"
+#include "Rib.h"
+
+// An <AFI, SAFI> the sender of the capability can preserve forwarding state for across a restart
+struct GracefulRestartFamily {
+    uint16_t Afi;
+    uint8_t Safi;
+    // F bit: forwarding state was actually preserved across this restart
+    bool ForwardingPreserved;
+};
+
+// RFC 4724 3
+struct GracefulRestartCapability {
+    // R bit: the sender has restarted
+    bool Restarted = false;
+    // Seconds, 12 bits
+    uint16_t RestartTime = 0;
+    // No families means the sender only helps peers that restart, which is all this implementation does
+    std::vector<GracefulRestartFamily> Families;
+
+    [[nodiscard]] const GracefulRestartFamily *Find(const uint16_t afi, const uint8_t safi) const {
+        const auto it = std::find_if(Families.begin(), Families.end(), [&](const auto &family) {
+            return family.Afi == afi && family.Safi == safi;
+        });
+        return it == Families.end() ? nullptr : &*it;
+    }
+};
+
+constexpr uint16_t GRACEFUL_RESTART_AFI_IPV4 = 1;
+constexpr uint8_t GRACEFUL_RESTART_SAFI_UNICAST = 1;
+
+BgpCapability flattenGracefulRestartCapability(const GracefulRestartCapability &capability) {
+    const auto flagsAndTime = static_cast<uint16_t>((capability.Restarted ? 0x8000 : 0) |
+                                                    (capability.RestartTime & 0x0FFF));
+    std::vector<uint8_t> value = {_16to8(flagsAndTime)};
+    for (const auto &family : capability.Families) {
+        value.insert(value.end(), {_16to8(family.Afi), family.Safi,
+                                   static_cast<uint8_t>(family.ForwardingPreserved ? 0x80 : 0)});
+    }
+    return {GracefulRestart, static_cast<uint8_t>(value.size()), value};
+}
+
+// std::nullopt if the peer did not advertise the capability. Malformed trailing tuples are ignored.
+std::optional<GracefulRestartCapability> findGracefulRestartCapability(const std::vector<BgpCapability> &capabilities) {
+    const auto it = std::find_if(capabilities.begin(), capabilities.end(), [](const auto &capability) {
+        return capability.Code == GracefulRestart;
+    });
+    if (it == capabilities.end() || it->Value.size() < 2) {
+        return std::nullopt;
+    }
+    const auto &value = it->Value;
+    GracefulRestartCapability capability;
+    capability.Restarted = value[0] & 0x80;
+    capability.RestartTime = _8to16(value[0], value[1]) & 0x0FFF;
+    for (size_t i = 2; i + 4 <= value.size(); i += 4) {
+        capability.Families.emplace_back(GracefulRestartFamily{_8to16(value[i], value[i + 1]), value[i + 2],
+                                                               static_cast<bool>(value[i + 3] & 0x80)});
+    }
+    return capability;
+}
+
+// RFC 4724 2: for IPv4 unicast, End-of-RIB is an UPDATE with nothing in it. TODO: [9] (an empty MP_UNREACH_NLRI)
+bool isEndOfRib(const BgpUpdateMessage &message) {
+    return message.WithdrawnRoutes.empty() && message.PathAttributes.empty() && message.NLRI.empty();
+}
+
+enum GracefulRestartState {
+    // Nothing is stale
+    GracefulRestartIdle,
+    // The session went down, the peer's routes are kept until it comes back or the restart time runs out
+    GracefulRestartWaiting,
+    // The session is back, stale routes are kept until End-of-RIB or the stale path time runs out
+    GracefulRestartRecovering,
+    // The peer sent BoRR, stale routes are kept until EoRR or the stale path time runs out
+    GracefulRestartRefreshing,
+    // Whatever is still stale is being removed, a batch per Poll()
+    GracefulRestartSweeping
+};
+
+std::string GracefulRestartStateToString(const GracefulRestartState state) {
+    switch (state) {
+        case GracefulRestartIdle:
+            return "Idle";
+        case GracefulRestartWaiting:
+            return "Waiting";
+        case GracefulRestartRecovering:
+            return "Recovering";
+        case GracefulRestartRefreshing:
+            return "Refreshing";
+        case GracefulRestartSweeping:
+            return "Sweeping";
+        default:
+            return "InvalidGracefulRestartState";
+    }
+}
+
+// Receiving speaker ("helper") procedures of RFC 4724 4.2 for one peer's IPv4 unicast routes. When the session goes
+// down the peer's routes are marked stale in O(1) (AdjRibIn::MarkStale()) and keep forwarding. Routes the peer
+// re-announces unchanged become fresh again without the Loc-RIB or FIB noticing, so a restart that ends with the same
+// table costs no churn at all. Whatever is still stale after End-of-RIB, or once a timer runs out, is removed by
+// Poll() in bounded batches so a full table never stalls the session. Enhanced route refresh uses the same stale
+// handling between BoRR and EoRR. Not synchronized. TODO: [14]
+class GracefulRestartHelper {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // How long stale routes are kept once the session is back, if End-of-RIB never arrives
+    static constexpr std::chrono::seconds DEFAULT_STALE_PATH_TIME{360};
+    // Routes looked at per Poll(), stale or not
+    static constexpr size_t DEFAULT_SWEEP_BATCH = 10000;
+
+    explicit GracefulRestartHelper(AdjRibIn &adjRibIn,
+                                   const std::chrono::seconds stalePathTime = DEFAULT_STALE_PATH_TIME,
+                                   const size_t sweepBatch = DEFAULT_SWEEP_BATCH) : adjRibIn_(adjRibIn),
+                                                                                    stalePathTime_(stalePathTime),
+                                                                                    sweepBatch_(sweepBatch) {}
+
+    // The session left Established. negotiated is what the peer advertised in its last OPEN: if it did not cover IPv4
+    // unicast its routes are swept straight away, as if there was no graceful restart.
+    void SessionDown(const Clock::time_point now, const std::optional<GracefulRestartCapability> &negotiated) {
+        adjRibIn_.MarkStale();
+        if (!negotiated || !negotiated->Find(GRACEFUL_RESTART_AFI_IPV4, GRACEFUL_RESTART_SAFI_UNICAST)) {
+            state_ = GracefulRestartSweeping;
+            return;
+        }
+        state_ = GracefulRestartWaiting;
+        deadline_ = now + std::chrono::seconds(negotiated->RestartTime);
+    }
+
+    // Keeps routes that were learned before this process restarted (see RibSnapshot.h) as stale until the peer sends
+    // End-of-RIB, or for at most stalePathTime. It is this side that restarted, so the peer's forwarding state does
+    // not matter.
+    void Restored(const Clock::time_point now, const std::chrono::seconds stalePathTime) {
+        adjRibIn_.MarkStale();
+        state_ = GracefulRestartRecovering;
+        deadline_ = now + stalePathTime;
+    }
+
+    // The session reached Established. capability is what the peer advertised in this OPEN: unless it says forwarding
+    // state for IPv4 unicast was preserved, the stale routes cannot be trusted and are swept.
+    void SessionEstablished(const Clock::time_point now, const std::optional<GracefulRestartCapability> &capability) {
+        if (state_ != GracefulRestartWaiting) {
+            return;
+        }
+        const auto family = capability ? capability->Find(GRACEFUL_RESTART_AFI_IPV4, GRACEFUL_RESTART_SAFI_UNICAST)
+                                       : nullptr;
+        if (!family || !family->ForwardingPreserved) {
+            state_ = GracefulRestartSweeping;
+            return;
+        }
+        state_ = GracefulRestartRecovering;
+        deadline_ = now + stalePathTime_;
+    }
+
+    // The peer sent End-of-RIB for IPv4 unicast: anything it did not re-announce is gone
+    void EndOfRib() {
+        if (state_ == GracefulRestartRecovering) {
+            state_ = GracefulRestartSweeping;
+        }
+    }
+
+    // Enhanced route refresh (RFC 7313 4) demarcates a refresh the same way: routes are stale from the peer's BoRR
+    // until they are re-announced, and whatever is still stale at its EoRR, or after the stale path time, is gone.
+    // A refresh while graceful restart is still recovering is left to finish that first.
+    void BeginRouteRefresh(const Clock::time_point now) {
+        if (state_ == GracefulRestartRecovering) {
+            return;
+        }
+        adjRibIn_.MarkStale();
+        state_ = GracefulRestartRefreshing;
+        deadline_ = now + stalePathTime_;
+    }
+
+    void EndRouteRefresh() {
+        if (state_ == GracefulRestartRefreshing) {
+            state_ = GracefulRestartSweeping;
+        }
+    }
+
+    // True while routes re-announced by the peer replace stale ones: after the session came back from a graceful
+    // restart, or during an enhanced route refresh
+    [[nodiscard]] bool refreshing() const {
+        return state_ == GracefulRestartRecovering || state_ == GracefulRestartRefreshing;
+    }
+
+    // Runs the timers, then sweeps the next batch of the Adj-RIB-In. Stale routes in it are removed and handed to
+    // withdrawn(const Route &), so the caller can take them out of the Loc-RIB. Returns the number removed.
+    template<typename Function>
+    size_t Poll(const Clock::time_point now, Function &&withdrawn) {
+        if ((state_ == GracefulRestartWaiting || refreshing()) && now >= deadline_) {
+            state_ = GracefulRestartSweeping;
+        }
+        if (state_ != GracefulRestartSweeping) {
+            return 0;
+        }
+        const auto swept = adjRibIn_.SweepStale(sweepBatch_, withdrawn);
+        if (adjRibIn_.stale_count() == 0) {
+            state_ = GracefulRestartIdle;
+        }
+        return swept;
+    }
+
+    [[nodiscard]] GracefulRestartState state() const {
+        return state_;
+    }
+
+    [[nodiscard]] size_t stale_count() const {
+        return adjRibIn_.stale_count();
+    }
+
+private:
+    AdjRibIn &adjRibIn_;
+    std::chrono::seconds stalePathTime_;
+    size_t sweepBatch_;
+    GracefulRestartState state_ = GracefulRestartIdle;
+    Clock::time_point deadline_;
+};
+
+#endif //BGP_GRACEFULRESTART_H
@@ -0,0 +1,110 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_MAPPEDFILE_H
+#define BGP_MAPPEDFILE_H
+
+#include <cstdint>
+#include <string>
+#include <span>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// A read-only memory mapping of a whole file. Nothing is read up front, the OS pages the file in as it is accessed.
+// sequential tells the OS to read ahead aggressively, for files that are walked front to back. Throws
+// std::runtime_error if the file cannot be opened or mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path, const bool sequential = true) {
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size)) {
+            Close();
+            throw std::runtime_error("Unable to open " + path);
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ > 0) {
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data_ = mapping_ ? static_cast<const uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        }
+#else
+        file_ = open(path.c_str(), O_RDONLY);
+        struct stat status{};
+        if (file_ < 0 || fstat(file_, &status) != 0) {
+            Close();
+            throw std::runtime_error("Unable to open " + path);
+        }
+        size_ = static_cast<size_t>(status.st_size);
+        if (size_ > 0) {
+            const auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, size_, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+                data_ = static_cast<const uint8_t *>(data);
+            }
+        }
+#endif
+        if (size_ > 0 && !data_) {
+            Close();
+            throw std::runtime_error("Unable to map " + path);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        Close();
+    }
+
+    [[nodiscard]] std::span<const uint8_t> bytes() const {
+        return {data_, size_};
+    }
+
+private:
+    void Close() {
+#if defined(_WIN32)
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = nullptr;
+#else
+        if (data_) {
+            munmap(const_cast<uint8_t *>(data_), size_);
+        }
+        if (file_ >= 0) {
+            close(file_);
+        }
+        file_ = -1;
+#endif
+        data_ = nullptr;
+    }
+
+#if defined(_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int file_ = -1;
+#endif
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif //BGP_MAPPEDFILE_H
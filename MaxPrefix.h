@@ -0,0 +1,93 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_MAXPREFIX_H
+#define BGP_MAXPREFIX_H
+
+#include <cstdint>
+#include <string>
+
+// How many prefixes a peer may send us for one address family, i.e. one Adj-RIB-In. Maximum 0 means no limit.
+struct MaximumPrefixLimit {
+    uint32_t Maximum = 0;
+    // Percent of Maximum at which a warning is logged
+    uint8_t WarningThreshold = 75;
+    // Only warn at Maximum too, never tear the session down
+    bool WarningOnly = false;
+};
+
+enum MaximumPrefixAction {
+    MaximumPrefixNone,
+    // The count crossed the warning threshold, or Maximum with WarningOnly
+    MaximumPrefixWarning,
+    // The count went over Maximum: send a NOTIFICATION Cease with Maximum Number of Prefixes Reached (RFC 4486 4)
+    MaximumPrefixTeardown
+};
+
+std::string MaximumPrefixActionToString(const MaximumPrefixAction action) {
+    switch (action) {
+        case MaximumPrefixNone:
+            return "None";
+        case MaximumPrefixWarning:
+            return "Warning";
+        case MaximumPrefixTeardown:
+            return "Teardown";
+        default:
+            return "InvalidMaximumPrefixAction";
+    }
+}
+
+// RFC 4271 8.1.1 leaves the limit to the implementation and RFC 4486 4 gives it a Cease subcode. The count itself is
+// kept by the Adj-RIB-In (AdjRibIn::prefix_count()), which already knows whether a route was added, replaced or
+// removed, so the limit costs no lookup per prefix and stays exact under implicit withdraws. Check() compares it once
+// per UPDATE and only reports a threshold when it is crossed, not for every message above it.
+class MaximumPrefix {
+public:
+    explicit MaximumPrefix(const MaximumPrefixLimit limit = {}) : limit_(limit) {}
+
+    MaximumPrefixAction Check(const uint32_t count) {
+        if (limit_.Maximum == 0) {
+            return MaximumPrefixNone;
+        }
+        if (count > limit_.Maximum) {
+            if (limit_.WarningOnly) {
+                return Warn(exceeded_);
+            }
+            ++teardowns_;
+            return MaximumPrefixTeardown;
+        }
+        exceeded_ = false;
+        if (static_cast<uint64_t>(count) * 100 >= static_cast<uint64_t>(limit_.Maximum) * limit_.WarningThreshold) {
+            return Warn(warned_);
+        }
+        warned_ = false;
+        return MaximumPrefixNone;
+    }
+
+    [[nodiscard]] const MaximumPrefixLimit &limit() const {
+        return limit_;
+    }
+
+    // How many times the session was torn down for going over the limit
+    [[nodiscard]] uint32_t teardown_count() const {
+        return teardowns_;
+    }
+
+private:
+    MaximumPrefixAction Warn(bool &warned) {
+        if (warned) {
+            return MaximumPrefixNone;
+        }
+        warned = true;
+        return MaximumPrefixWarning;
+    }
+
+    MaximumPrefixLimit limit_;
+    // Whether the warning threshold, and Maximum with WarningOnly, have been reported since the count last went below
+    bool warned_ = false;
+    bool exceeded_ = false;
+    uint32_t teardowns_ = 0;
+};
+
+#endif //BGP_MAXPREFIX_H
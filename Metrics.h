@@ -0,0 +1,432 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_METRICS_H
+#define BGP_METRICS_H
+
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <bit>
+#include <algorithm>
+#include <unordered_map>
+#include "MessageType.h"
+#include "Route.h"
+
+// Metrics in the Prometheus text exposition format (version 0.0.4). Recording only touches the calling thread's shard
+// with relaxed atomics, so it takes a few nanoseconds and never waits on another thread; shards are only added up when
+// the metrics are scraped.
+
+// The first METRIC_SHARDS - 1 threads to record anything get a shard each, which only they write, so they can add with a
+// plain load and store instead of a locked read-modify-write. Any threads after them share shard 0.
+constexpr size_t METRIC_SHARDS = 16;
+// ReservedMessageType to RouteRefresh. Unknown types are counted as ReservedMessageType.
+constexpr size_t METRIC_MESSAGE_TYPES = 6;
+// Idle to Established, in BgpSessionState order
+constexpr size_t METRIC_SESSION_STATES = 6;
+constexpr const char *METRIC_SESSION_STATE_NAMES[METRIC_SESSION_STATES] = {"Idle", "Connect", "Active", "OpenSent",
+                                                                           "OpenConfirm", "Established"};
+
+// The calling thread's shard, assigned the first time it records anything
+size_t metricShard() {
+    static std::atomic<size_t> nextShard = 1;
+    thread_local const size_t shard = [] {
+        const auto next = nextShard.fetch_add(1, std::memory_order_relaxed);
+        return next < METRIC_SHARDS ? next : 0;
+    }();
+    return shard;
+}
+
+// Adds to a counter in the calling thread's shard
+void metricAdd(std::atomic<uint64_t> &counter, const size_t shard, const uint64_t value) {
+    if (shard == 0) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    } else {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+}
+
+// Set by whichever thread owns the value, e.g. a table size after each UPDATE
+class MetricGauge {
+public:
+    void Set(const int64_t value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] int64_t value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value_ = 0;
+};
+
+// Durations in nanoseconds, HDR-style: every power of two is split into SUB_BUCKETS linear buckets, so any value is
+// known to within 1 / SUB_BUCKETS of itself from 1 ns up to 2^MAGNITUDES ns (about 18 minutes), in a fixed 1280 bytes
+// per shard. Longer durations land in the last bucket.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 2;
+    static constexpr uint64_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned MAGNITUDES = 40;
+    static constexpr size_t BUCKETS = MAGNITUDES * SUB_BUCKETS;
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> Buckets{};
+        uint64_t Count = 0;
+        // Nanoseconds
+        uint64_t Sum = 0;
+
+        // The upper bound of the bucket holding the q-th quantile, in nanoseconds, 0 if nothing was recorded
+        [[nodiscard]] uint64_t Quantile(const double q) const {
+            if (Count == 0) {
+                return 0;
+            }
+            const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(Count) + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += Buckets[i];
+                if (seen >= rank) {
+                    return BucketUpperBound(i);
+                }
+            }
+            return BucketUpperBound(BUCKETS - 1);
+        }
+    };
+
+    void Record(const uint64_t nanoseconds) {
+        const auto index = metricShard();
+        auto &shard = shards_[index];
+        metricAdd(shard.Buckets[BucketIndex(nanoseconds)], index, 1);
+        metricAdd(shard.Sum, index, nanoseconds);
+    }
+
+    template<typename Rep, typename Period>
+    void Record(const std::chrono::duration<Rep, Period> duration) {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        Record(static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0)));
+    }
+
+    [[nodiscard]] Snapshot snapshot() const {
+        Snapshot snapshot;
+        for (const auto &shard : shards_) {
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                const auto count = shard.Buckets[i].load(std::memory_order_relaxed);
+                snapshot.Buckets[i] += count;
+                snapshot.Count += count;
+            }
+            snapshot.Sum += shard.Sum.load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    static size_t BucketIndex(const uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        const unsigned magnitude = std::bit_width(value) - 1;
+        const auto sub = (value >> (magnitude - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return std::min<size_t>((magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub, BUCKETS - 1);
+    }
+
+    // Exclusive
+    static uint64_t BucketUpperBound(const size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index + 1;
+        }
+        const auto shift = index / SUB_BUCKETS - 1;
+        return (SUB_BUCKETS + index % SUB_BUCKETS + 1) << shift;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> Buckets{};
+        std::atomic<uint64_t> Sum = 0;
+    };
+
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// Everything counted for one peer, added up over the shards
+struct PeerCounters {
+    std::array<uint64_t, METRIC_MESSAGE_TYPES> MessagesReceived{};
+    std::array<uint64_t, METRIC_MESSAGE_TYPES> BytesReceived{};
+    std::array<uint64_t, METRIC_MESSAGE_TYPES> MessagesSent{};
+    std::array<uint64_t, METRIC_MESSAGE_TYPES> BytesSent{};
+    uint64_t PrefixesAnnounced = 0;
+    uint64_t PrefixesWithdrawn = 0;
+    // NLRI the Adj-RIB-In already held with the same attributes
+    uint64_t DuplicateAnnouncements = 0;
+    // Transitions into each state
+    std::array<uint64_t, METRIC_SESSION_STATES> Transitions{};
+    // Peer oscillation damping as of the last state change: whether the IdleHoldTimer holds the peer in Idle, what it
+    // was last set to in seconds, and how often the peer was damped
+    bool Damped = false;
+    uint64_t IdleHoldBackoff = 0;
+    uint64_t PeerOscillationsDamped = 0;
+};
+
+// Counters of one peer. Each shard is a cache line aligned block of its own, so threads recording for the same peer
+// do not share cache lines.
+class PeerMetrics {
+public:
+    explicit PeerMetrics(const uint32_t address) : address_(address) {}
+
+    void Received(const MessageType type, const size_t bytes) {
+        const auto index = metricShard();
+        auto &shard = shards_[index];
+        metricAdd(shard.MessagesReceived[TypeIndex(type)], index, 1);
+        metricAdd(shard.BytesReceived[TypeIndex(type)], index, bytes);
+    }
+
+    void Sent(const MessageType type, const size_t bytes) {
+        const auto index = metricShard();
+        auto &shard = shards_[index];
+        metricAdd(shard.MessagesSent[TypeIndex(type)], index, 1);
+        metricAdd(shard.BytesSent[TypeIndex(type)], index, bytes);
+    }
+
+    // NLRI and withdrawn routes as they arrive, before anything is filtered or found to be a duplicate
+    void PrefixesReceived(const size_t announced, const size_t withdrawn) {
+        const auto index = metricShard();
+        auto &shard = shards_[index];
+        metricAdd(shard.PrefixesAnnounced, index, announced);
+        metricAdd(shard.PrefixesWithdrawn, index, withdrawn);
+    }
+
+    // NLRI that changed nothing, see AdjRibIn::duplicate_count()
+    void DuplicatesReceived(const size_t duplicates) {
+        const auto index = metricShard();
+        metricAdd(shards_[index].DuplicateAnnouncements, index, duplicates);
+    }
+
+    // state is a BgpSessionState
+    void StateChanged(const uint8_t state) {
+        if (state < METRIC_SESSION_STATES) {
+            const auto index = metricShard();
+            metricAdd(shards_[index].Transitions[state], index, 1);
+        }
+    }
+
+    // Set by the session whenever its state changes, the FSM only damps or stops damping then
+    void Damping(const bool damped, const uint16_t idleHoldBackoff, const uint32_t oscillationsDamped) {
+        damped_.store(damped, std::memory_order_relaxed);
+        idleHoldBackoff_.store(idleHoldBackoff, std::memory_order_relaxed);
+        oscillationsDamped_.store(oscillationsDamped, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint32_t address() const {
+        return address_;
+    }
+
+    [[nodiscard]] PeerCounters counters() const {
+        PeerCounters counters;
+        counters.Damped = damped_.load(std::memory_order_relaxed);
+        counters.IdleHoldBackoff = idleHoldBackoff_.load(std::memory_order_relaxed);
+        counters.PeerOscillationsDamped = oscillationsDamped_.load(std::memory_order_relaxed);
+        for (const auto &shard : shards_) {
+            for (size_t i = 0; i < METRIC_MESSAGE_TYPES; ++i) {
+                counters.MessagesReceived[i] += shard.MessagesReceived[i].load(std::memory_order_relaxed);
+                counters.BytesReceived[i] += shard.BytesReceived[i].load(std::memory_order_relaxed);
+                counters.MessagesSent[i] += shard.MessagesSent[i].load(std::memory_order_relaxed);
+                counters.BytesSent[i] += shard.BytesSent[i].load(std::memory_order_relaxed);
+            }
+            counters.PrefixesAnnounced += shard.PrefixesAnnounced.load(std::memory_order_relaxed);
+            counters.PrefixesWithdrawn += shard.PrefixesWithdrawn.load(std::memory_order_relaxed);
+            counters.DuplicateAnnouncements += shard.DuplicateAnnouncements.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < METRIC_SESSION_STATES; ++i) {
+                counters.Transitions[i] += shard.Transitions[i].load(std::memory_order_relaxed);
+            }
+        }
+        return counters;
+    }
+
+    // Prefixes in the peer's Adj-RIB-In
+    MetricGauge AdjRibInPrefixes;
+
+private:
+    static size_t TypeIndex(const MessageType type) {
+        return type < METRIC_MESSAGE_TYPES ? type : ReservedMessageType;
+    }
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, METRIC_MESSAGE_TYPES> MessagesReceived{};
+        std::array<std::atomic<uint64_t>, METRIC_MESSAGE_TYPES> BytesReceived{};
+        std::array<std::atomic<uint64_t>, METRIC_MESSAGE_TYPES> MessagesSent{};
+        std::array<std::atomic<uint64_t>, METRIC_MESSAGE_TYPES> BytesSent{};
+        std::atomic<uint64_t> PrefixesAnnounced = 0;
+        std::atomic<uint64_t> PrefixesWithdrawn = 0;
+        std::atomic<uint64_t> DuplicateAnnouncements = 0;
+        std::array<std::atomic<uint64_t>, METRIC_SESSION_STATES> Transitions{};
+    };
+
+    uint32_t address_;
+    std::array<Shard, METRIC_SHARDS> shards_;
+    std::atomic<bool> damped_ = false;
+    std::atomic<uint64_t> idleHoldBackoff_ = 0;
+    std::atomic<uint64_t> oscillationsDamped_ = 0;
+};
+
+// Owns every metric and renders them for a scrape. Metrics are registered once, up front, and recorded through the
+// references and pointers handed out here, so the hot path never looks anything up. Thread safe.
+class MetricsRegistry {
+public:
+    // The same PeerMetrics for as long as the registry lives
+    std::shared_ptr<PeerMetrics> Peer(const uint32_t address) {
+        std::lock_guard lock(mutex_);
+        auto &peer = peers_[address];
+        if (!peer) {
+            peer = std::make_shared<PeerMetrics>(address);
+        }
+        return peer;
+    }
+
+    // name is the metric name without the unit suffix, e.g. "bgp_update_parse" for bgp_update_parse_seconds
+    LatencyHistogram &Histogram(const std::string &name, const std::string &help) {
+        std::lock_guard lock(mutex_);
+        histograms_.emplace_back(std::make_unique<Named<LatencyHistogram>>(name + "_seconds", help));
+        return histograms_.back()->Metric;
+    }
+
+    MetricGauge &Gauge(const std::string &name, const std::string &help) {
+        std::lock_guard lock(mutex_);
+        gauges_.emplace_back(std::make_unique<Named<MetricGauge>>(name, help));
+        return gauges_.back()->Metric;
+    }
+
+    // Histograms are exposed with a bucket per power of two from about 1 us to about 68 s
+    [[nodiscard]] std::string Scrape() const {
+        std::vector<std::shared_ptr<PeerMetrics>> peers;
+        std::vector<const Named<LatencyHistogram> *> histograms;
+        std::vector<const Named<MetricGauge> *> gauges;
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto &[address, peer] : peers_) {
+                peers.emplace_back(peer);
+            }
+            for (const auto &histogram : histograms_) {
+                histograms.emplace_back(histogram.get());
+            }
+            for (const auto &gauge : gauges_) {
+                gauges.emplace_back(gauge.get());
+            }
+        }
+        std::sort(peers.begin(), peers.end(), [](const auto &a, const auto &b) {
+            return a->address() < b->address();
+        });
+        std::vector<std::pair<std::string, PeerCounters>> counters;
+        for (const auto &peer : peers) {
+            counters.emplace_back("peer=\"" + formatIpv4Address(peer->address()) + '"', peer->counters());
+        }
+
+        std::stringstream output;
+        output << std::setprecision(10);
+        const auto perType = [&](const std::string &name, const std::string &help,
+                                 std::array<uint64_t, METRIC_MESSAGE_TYPES> PeerCounters::*field) {
+            Header(output, name, help, "counter");
+            for (const auto &[labels, peer] : counters) {
+                for (size_t i = 0; i < METRIC_MESSAGE_TYPES; ++i) {
+                    output << name << '{' << labels << ",type=\""
+                           << MessageTypeToString(static_cast<MessageType>(i)) << "\"} " << (peer.*field)[i] << '\n';
+                }
+            }
+        };
+        perType("bgp_messages_received_total", "BGP messages received, by type", &PeerCounters::MessagesReceived);
+        perType("bgp_received_bytes_total", "Bytes of BGP messages received, by type", &PeerCounters::BytesReceived);
+        perType("bgp_messages_sent_total", "BGP messages sent, by type", &PeerCounters::MessagesSent);
+        perType("bgp_sent_bytes_total", "Bytes of BGP messages sent, by type", &PeerCounters::BytesSent);
+
+        const auto perPeer = [&](const std::string &name, const std::string &help, uint64_t PeerCounters::*field) {
+            Header(output, name, help, "counter");
+            for (const auto &[labels, peer] : counters) {
+                output << name << '{' << labels << "} " << peer.*field << '\n';
+            }
+        };
+        perPeer("bgp_prefixes_announced_total", "NLRI received in UPDATEs", &PeerCounters::PrefixesAnnounced);
+        perPeer("bgp_prefixes_withdrawn_total", "Withdrawn routes received in UPDATEs", &PeerCounters::PrefixesWithdrawn);
+        perPeer("bgp_duplicate_announcements_total", "NLRI received with the attributes the Adj-RIB-In already had",
+                &PeerCounters::DuplicateAnnouncements);
+
+        Header(output, "bgp_fsm_transitions_total", "Session FSM transitions, by the state entered", "counter");
+        for (const auto &[labels, peer] : counters) {
+            for (size_t i = 0; i < METRIC_SESSION_STATES; ++i) {
+                output << "bgp_fsm_transitions_total{" << labels << ",state=\"" << METRIC_SESSION_STATE_NAMES[i]
+                       << "\"} " << peer.Transitions[i] << '\n';
+            }
+        }
+        perPeer("bgp_peer_oscillations_damped_total", "Times the peer was held in Idle for failing again",
+                &PeerCounters::PeerOscillationsDamped);
+        Header(output, "bgp_peer_damped", "1 while the peer is held in Idle by oscillation damping", "gauge");
+        for (const auto &[labels, peer] : counters) {
+            output << "bgp_peer_damped{" << labels << "} " << (peer.Damped ? 1 : 0) << '\n';
+        }
+        Header(output, "bgp_idle_hold_backoff_seconds", "What the IdleHoldTimer was last set to, 0 if never", "gauge");
+        for (const auto &[labels, peer] : counters) {
+            output << "bgp_idle_hold_backoff_seconds{" << labels << "} " << peer.IdleHoldBackoff << '\n';
+        }
+        Header(output, "bgp_adj_rib_in_prefixes", "Prefixes in the peer's Adj-RIB-In", "gauge");
+        for (size_t i = 0; i < peers.size(); ++i) {
+            output << "bgp_adj_rib_in_prefixes{" << counters[i].first << "} " << peers[i]->AdjRibInPrefixes.value()
+                   << '\n';
+        }
+
+        for (const auto *gauge : gauges) {
+            Header(output, gauge->Name, gauge->Help, "gauge");
+            output << gauge->Name << ' ' << gauge->Metric.value() << '\n';
+        }
+        for (const auto *histogram : histograms) {
+            const auto snapshot = histogram->Metric.snapshot();
+            Header(output, histogram->Name, histogram->Help, "histogram");
+            uint64_t cumulative = 0;
+            size_t bucket = 0;
+            for (unsigned power = EXPOSED_POWER_MIN; power <= EXPOSED_POWER_MAX; ++power) {
+                const uint64_t bound = 1ull << power;
+                for (; bucket < LatencyHistogram::BUCKETS && LatencyHistogram::BucketUpperBound(bucket) <= bound;
+                       ++bucket) {
+                    cumulative += snapshot.Buckets[bucket];
+                }
+                output << histogram->Name << "_bucket{le=\"" << static_cast<double>(bound) / 1e9 << "\"} "
+                       << cumulative << '\n';
+            }
+            output << histogram->Name << "_bucket{le=\"+Inf\"} " << snapshot.Count << '\n';
+            output << histogram->Name << "_sum " << static_cast<double>(snapshot.Sum) / 1e9 << '\n';
+            output << histogram->Name << "_count " << snapshot.Count << '\n';
+        }
+        return output.str();
+    }
+
+private:
+    template<typename T>
+    struct Named {
+        Named(std::string name, std::string help) : Name(std::move(name)), Help(std::move(help)) {}
+
+        std::string Name;
+        std::string Help;
+        T Metric;
+    };
+
+    static void Header(std::stringstream &output, const std::string &name, const std::string &help,
+                       const std::string &type) {
+        output << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << ' ' << type << '\n';
+    }
+
+    // 2^10 ns to 2^36 ns
+    static constexpr unsigned EXPOSED_POWER_MIN = 10;
+    static constexpr unsigned EXPOSED_POWER_MAX = 36;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, std::shared_ptr<PeerMetrics>> peers_;
+    // Never removed, so references stay valid
+    std::vector<std::unique_ptr<Named<LatencyHistogram>>> histograms_;
+    std::vector<std::unique_ptr<Named<MetricGauge>>> gauges_;
+};
+
+#endif //BGP_METRICS_H
@@ -0,0 +1,298 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_MRT_H
+#define BGP_MRT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <span>
+#include <optional>
+#include <stdexcept>
+#include "Util.h"
+#include "Route.h"
+#include "MappedFile.h"
+
+enum MrtType : uint16_t {
+    /*
+     * 13 TABLE_DUMP_V2 [RFC6396]
+     * 16 BGP4MP [RFC6396]
+     * 17 BGP4MP_ET [RFC6396]
+     */
+    TableDumpV2 = 13,
+    Bgp4mp = 16,
+    Bgp4mpEt = 17
+};
+
+std::string MrtTypeToString(const MrtType type) {
+    switch (type) {
+        case TableDumpV2:
+            return "TableDumpV2";
+        case Bgp4mp:
+            return "Bgp4mp";
+        case Bgp4mpEt:
+            return "Bgp4mpEt";
+        default:
+            return "UnsupportedMrtType";
+    }
+}
+
+enum TableDumpV2Subtype : uint16_t {
+    /*
+     * 1 PEER_INDEX_TABLE [RFC6396]
+     * 2 RIB_IPV4_UNICAST [RFC6396]
+     * 3 RIB_IPV4_MULTICAST [RFC6396]
+     * 4 RIB_IPV6_UNICAST [RFC6396]
+     * 5 RIB_IPV6_MULTICAST [RFC6396]
+     * 6 RIB_GENERIC [RFC6396]
+     */
+    PeerIndexTable = 1,
+    RibIpv4Unicast = 2,
+    RibIpv4Multicast = 3,
+    RibIpv6Unicast = 4,
+    RibIpv6Multicast = 5,
+    RibGeneric = 6
+};
+
+enum Bgp4mpSubtype : uint16_t {
+    /*
+     * 0 BGP4MP_STATE_CHANGE [RFC6396]
+     * 1 BGP4MP_MESSAGE [RFC6396]
+     * 4 BGP4MP_MESSAGE_AS4 [RFC6396]
+     * 5 BGP4MP_STATE_CHANGE_AS4 [RFC6396]
+     * 6 BGP4MP_MESSAGE_LOCAL [RFC6396]
+     * 7 BGP4MP_MESSAGE_AS4_LOCAL [RFC6396]
+     */
+    Bgp4mpStateChange = 0,
+    Bgp4mpMessage = 1,
+    Bgp4mpMessageAs4 = 4,
+    Bgp4mpStateChangeAs4 = 5,
+    Bgp4mpMessageLocal = 6,
+    Bgp4mpMessageAs4Local = 7
+};
+
+// One MRT record. Body points into the file, it is only valid as long as the MrtFile it came from.
+struct MrtRecord {
+    uint32_t Timestamp;
+    // Only set for BGP4MP_ET
+    uint32_t Microseconds;
+    MrtType Type;
+    uint16_t Subtype;
+    std::span<const uint8_t> Body;
+};
+
+// An entry of a TABLE_DUMP_V2 PEER_INDEX_TABLE. TODO: [9]
+struct MrtPeer {
+    uint32_t BgpIdentifier;
+    uint32_t Address;
+    uint32_t Asn;
+    bool Ipv6;
+};
+
+// One peer's path for a prefix. Attributes always use four octet ASNs (RFC 6396 4.3.4).
+struct MrtRibEntry {
+    uint16_t PeerIndex;
+    uint32_t OriginatedTime;
+    std::span<const uint8_t> Attributes;
+};
+
+// A TABLE_DUMP_V2 RIB_IPV4_UNICAST record: a prefix and every peer's path for it, in Entries. TODO: [9]
+struct MrtRib {
+    uint32_t SequenceNumber;
+    Route Prefix;
+    uint16_t EntryCount;
+    std::span<const uint8_t> Entries;
+
+    // function(const MrtRibEntry &). Throws std::runtime_error if the entries run past the record.
+    template<typename Function>
+    void ForEachEntry(Function &&function) const {
+        size_t i = 0;
+        for (uint16_t entry = 0; entry < EntryCount; ++entry) {
+            if (i + 8 > Entries.size()) {
+                throw std::runtime_error("MRT RIB entry " + std::to_string(entry) + " is truncated");
+            }
+            const auto attributesLength = _8to16(Entries[i + 6], Entries[i + 7]);
+            if (i + 8 + attributesLength > Entries.size()) {
+                throw std::runtime_error("MRT RIB entry " + std::to_string(entry) + " attributes are truncated");
+            }
+            function(MrtRibEntry{
+                    _8to16(Entries[i], Entries[i + 1]),
+                    _8to32(Entries[i + 2], Entries[i + 3], Entries[i + 4], Entries[i + 5]),
+                    Entries.subspan(i + 8, attributesLength)
+            });
+            i += 8 + attributesLength;
+        }
+    }
+};
+
+// A BGP4MP MESSAGE record: a BGP message, header included, as exchanged with a peer. TODO: [9]
+struct MrtBgp4mpMessage {
+    uint32_t PeerAsn;
+    uint32_t LocalAsn;
+    uint16_t InterfaceIndex;
+    uint16_t AddressFamily;
+    // 0 for IPv6 peers
+    uint32_t PeerAddress;
+    uint32_t LocalAddress;
+    bool FourOctetAsns;
+    std::span<const uint8_t> Message;
+};
+
+// The file has to be decompressed first, dumps are usually distributed gzip or bzip2 compressed
+typedef MappedFile MrtFile;
+
+// Walks the records in an MRT byte stream (RFC 6396 2), usually an MrtFile. Records of any type are returned, what to
+// do with them is up to the caller. Throws std::runtime_error, naming the offset, if a record runs past the end.
+class MrtReader {
+public:
+    static constexpr size_t HEADER_SIZE = 12;
+
+    explicit MrtReader(const std::span<const uint8_t> bytes) : bytes_(bytes) {}
+
+    // std::nullopt at the end of the stream
+    std::optional<MrtRecord> Next() {
+        if (offset_ == bytes_.size()) {
+            return std::nullopt;
+        }
+        if (offset_ + HEADER_SIZE > bytes_.size()) {
+            throw std::runtime_error("MRT record header at offset " + std::to_string(offset_) + " is truncated");
+        }
+        const auto header = bytes_.subspan(offset_, HEADER_SIZE);
+        MrtRecord record = {
+                _8to32(header[0], header[1], header[2], header[3]),
+                0,
+                static_cast<MrtType>(_8to16(header[4], header[5])),
+                _8to16(header[6], header[7]),
+                {}
+        };
+        const size_t length = _8to32(header[8], header[9], header[10], header[11]);
+        if (offset_ + HEADER_SIZE + length > bytes_.size()) {
+            throw std::runtime_error("MRT record at offset " + std::to_string(offset_) + " is truncated");
+        }
+        record.Body = bytes_.subspan(offset_ + HEADER_SIZE, length);
+        offset_ += HEADER_SIZE + length;
+
+        // RFC 6396 3: the microsecond timestamp counts towards the length, but is not part of the body
+        if (record.Type == Bgp4mpEt) {
+            if (record.Body.size() < 4) {
+                throw std::runtime_error("MRT BGP4MP_ET record before offset " + std::to_string(offset_) + " is truncated");
+            }
+            record.Microseconds = _8to32(record.Body[0], record.Body[1], record.Body[2], record.Body[3]);
+            record.Body = record.Body.subspan(4);
+        }
+        return record;
+    }
+
+    // Bytes consumed so far
+    [[nodiscard]] size_t offset() const {
+        return offset_;
+    }
+
+private:
+    std::span<const uint8_t> bytes_;
+    size_t offset_ = 0;
+};
+
+// Bounds checked reads for the record parsers below
+class MrtCursor {
+public:
+    MrtCursor(const std::span<const uint8_t> bytes, const char *record) : bytes_(bytes), record_(record) {}
+
+    std::span<const uint8_t> Take(const size_t length) {
+        if (offset_ + length > bytes_.size()) {
+            throw std::runtime_error(std::string("MRT ") + record_ + " record is truncated");
+        }
+        const auto taken = bytes_.subspan(offset_, length);
+        offset_ += length;
+        return taken;
+    }
+
+    uint8_t Read8() {
+        return Take(1)[0];
+    }
+
+    uint16_t Read16() {
+        const auto bytes = Take(2);
+        return _8to16(bytes[0], bytes[1]);
+    }
+
+    uint32_t Read32() {
+        const auto bytes = Take(4);
+        return _8to32(bytes[0], bytes[1], bytes[2], bytes[3]);
+    }
+
+    [[nodiscard]] std::span<const uint8_t> rest() const {
+        return bytes_.subspan(offset_);
+    }
+
+private:
+    std::span<const uint8_t> bytes_;
+    const char *record_;
+    size_t offset_ = 0;
+};
+
+// RFC 6396 4.3.1. The returned peers are indexed by MrtRibEntry::PeerIndex.
+std::vector<MrtPeer> parseMrtPeerIndexTable(const MrtRecord &record) {
+    MrtCursor cursor(record.Body, "PEER_INDEX_TABLE");
+    cursor.Read32();
+    cursor.Take(cursor.Read16());
+
+    std::vector<MrtPeer> peers(cursor.Read16());
+    for (auto &peer : peers) {
+        const auto type = cursor.Read8();
+        peer.Ipv6 = type & 0x01;
+        peer.BgpIdentifier = cursor.Read32();
+        if (peer.Ipv6) {
+            // TODO: [9]
+            cursor.Take(16);
+        } else {
+            peer.Address = cursor.Read32();
+        }
+        peer.Asn = type & 0x02 ? cursor.Read32() : cursor.Read16();
+    }
+    return peers;
+}
+
+// RFC 6396 4.3.2, RIB_IPV4_UNICAST and RIB_IPV4_MULTICAST only. TODO: [9]
+MrtRib parseMrtRib(const MrtRecord &record) {
+    MrtCursor cursor(record.Body, "RIB_IPV4");
+    MrtRib rib{};
+    rib.SequenceNumber = cursor.Read32();
+    const auto length = cursor.Read8();
+    if (length > 32) {
+        throw std::runtime_error("MRT RIB_IPV4 record has prefix length " + std::to_string(length));
+    }
+    const auto prefixBytes = cursor.Take((length + 7) / 8);
+    uint32_t prefix = 0;
+    for (size_t octet = 0; octet < 4; ++octet) {
+        prefix = prefix << 8 | (octet < prefixBytes.size() ? prefixBytes[octet] : 0);
+    }
+    rib.Prefix = Route{length, length == 0 ? 0 : prefix & UINT32_MAX << (32 - length)};
+    rib.EntryCount = cursor.Read16();
+    rib.Entries = cursor.rest();
+    return rib;
+}
+
+// RFC 6396 4.4.2 to 4.4.6, the MESSAGE subtypes only
+MrtBgp4mpMessage parseMrtBgp4mpMessage(const MrtRecord &record) {
+    MrtCursor cursor(record.Body, "BGP4MP_MESSAGE");
+    MrtBgp4mpMessage message{};
+    message.FourOctetAsns = record.Subtype == Bgp4mpMessageAs4 || record.Subtype == Bgp4mpMessageAs4Local;
+    message.PeerAsn = message.FourOctetAsns ? cursor.Read32() : cursor.Read16();
+    message.LocalAsn = message.FourOctetAsns ? cursor.Read32() : cursor.Read16();
+    message.InterfaceIndex = cursor.Read16();
+    message.AddressFamily = cursor.Read16();
+    if (message.AddressFamily == 2) {
+        // TODO: [9]
+        cursor.Take(32);
+    } else {
+        message.PeerAddress = cursor.Read32();
+        message.LocalAddress = cursor.Read32();
+    }
+    message.Message = cursor.rest();
+    return message;
+}
+
+#endif //BGP_MRT_H
@@ -0,0 +1,308 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_MRTWRITER_H
+#define BGP_MRTWRITER_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <stdexcept>
+#include <condition_variable>
+#include "Util.h"
+#include "Mrt.h"
+#include "AsPath.h"
+
+struct MrtWriterOptions {
+    // Files are named <Directory>/<Prefix>.<YYYYMMDD>.<HHMMSS>.mrt after the UTC time they were opened
+    std::string Directory = ".";
+    std::string Prefix = "updates";
+    // A file is closed and the next one opened once either limit is reached
+    size_t MaxFileBytes = 256 * 1024 * 1024;
+    std::chrono::seconds MaxFileAge = std::chrono::minutes(15);
+    // Records are batched into buffers of BufferBytes, at most BufferCount of them exist at once. That is all the
+    // memory the writer uses, records that arrive while every buffer is waiting to be written are dropped.
+    size_t BufferBytes = 1024 * 1024;
+    size_t BufferCount = 16;
+    // A partially filled buffer is written after this long, so a quiet session still reaches the disk
+    std::chrono::milliseconds FlushInterval = std::chrono::seconds(1);
+};
+
+// The session a record belongs to. TODO: [9]
+struct MrtSession {
+    uint32_t PeerAsn;
+    uint32_t LocalAsn;
+    uint32_t PeerAddress;
+    uint32_t LocalAddress;
+    uint16_t InterfaceIndex = 0;
+    // Whether the session negotiated 4-octet ASNs (RFC 6793). Readers take the subtype to say how the AS_PATHs in the
+    // archived messages are encoded, so this picks MESSAGE_AS4 over MESSAGE.
+    bool FourOctetAsns = false;
+};
+
+// Archives BGP messages and FSM state changes as BGP4MP_ET records (RFC 6396 4.4), MESSAGE and STATE_CHANGE or their
+// AS4 variants depending on the session, to files rotated by size and age. The receive path only encodes a record into
+// the current buffer; full buffers are written by a background thread in large sequential writes. A file that cannot be
+// opened or written stops the writer for good, see failure(). Thread safe.
+class MrtWriter {
+public:
+    // Opens the first file right away. Throws std::runtime_error if it cannot be opened.
+    explicit MrtWriter(MrtWriterOptions options = {}) : options_(std::move(options)) {
+        if (!Open(std::chrono::system_clock::now())) {
+            throw std::runtime_error(failure_);
+        }
+        for (size_t i = 0; i < std::max<size_t>(options_.BufferCount, 2); ++i) {
+            free_.emplace_back().reserve(options_.BufferBytes);
+        }
+        current_ = TakeFreeBuffer();
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    MrtWriter(const MrtWriter &) = delete;
+    MrtWriter &operator=(const MrtWriter &) = delete;
+
+    // Writes whatever is still buffered
+    ~MrtWriter() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // message is a whole BGP message, header included, as it came off the wire. Returns false if it was dropped.
+    bool ArchiveMessage(const MrtSession &session, const std::span<const uint8_t> message) {
+        return Append(session.FourOctetAsns ? Bgp4mpMessageAs4 : Bgp4mpMessage, session, message, {});
+    }
+
+    // States are RFC 6396 4.4.1 codes, 1 (Idle) to 6 (Established). Returns false if the record was dropped.
+    bool ArchiveStateChange(const MrtSession &session, const uint16_t oldState, const uint16_t newState) {
+        const uint8_t states[4] = {_16to8(oldState), _16to8(newState)};
+        return Append(session.FourOctetAsns ? Bgp4mpStateChangeAs4 : Bgp4mpStateChange, session, {}, states);
+    }
+
+    // Blocks until everything archived so far has been written to the current file
+    void Flush() {
+        std::unique_lock lock(mutex_);
+        if (!current_.empty()) {
+            flushed_.wait(lock, [&]() { return !free_.empty(); });
+            QueueCurrent();
+        }
+        const auto target = queued_;
+        wake_.notify_one();
+        flushed_.wait(lock, [&]() { return written_ >= target; });
+    }
+
+    [[nodiscard]] uint64_t records() const {
+        return records_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t files() const {
+        return files_.load(std::memory_order_relaxed);
+    }
+
+    // Why the writer stopped, empty while it is still archiving. Everything archived after that is dropped.
+    [[nodiscard]] std::string failure() const {
+        return failed_.load(std::memory_order_acquire) ? failure_ : std::string();
+    }
+
+private:
+    static constexpr size_t RECORD_HEADER_SIZE = MrtReader::HEADER_SIZE + 4 + 20;
+    // ASNs that do not fit in 2 octets are written as AS_TRANS, RFC 6793 4.2.2
+    static uint16_t twoOctetAsn(const uint32_t asn) {
+        return static_cast<uint16_t>(asn > UINT16_MAX ? AS_TRANS : asn);
+    }
+
+    bool Append(const Bgp4mpSubtype subtype, const MrtSession &session, const std::span<const uint8_t> message,
+                const std::span<const uint8_t> states) {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now);
+        const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(now - seconds);
+        // 2-octet ASNs take 4 octets less
+        const auto headerSize = session.FourOctetAsns ? RECORD_HEADER_SIZE : RECORD_HEADER_SIZE - 4;
+        if (failed_.load(std::memory_order_acquire)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        const auto size = headerSize + message.size() + states.size();
+        // The length covers the microsecond timestamp, RFC 6396 3
+        const auto length = static_cast<uint32_t>(size - MrtReader::HEADER_SIZE);
+        uint8_t header[RECORD_HEADER_SIZE] = {
+                _32to8(static_cast<uint32_t>(seconds.count())), _16to8(Bgp4mpEt), _16to8(subtype), _32to8(length),
+                _32to8(static_cast<uint32_t>(microseconds.count()))
+        };
+        auto *field = header + MrtReader::HEADER_SIZE + 4;
+        if (session.FourOctetAsns) {
+            const uint8_t asns[8] = {_32to8(session.PeerAsn), _32to8(session.LocalAsn)};
+            field = std::copy(asns, asns + sizeof(asns), field);
+        } else {
+            const uint8_t asns[4] = {_16to8(twoOctetAsn(session.PeerAsn)), _16to8(twoOctetAsn(session.LocalAsn))};
+            field = std::copy(asns, asns + sizeof(asns), field);
+        }
+        // AFI 1, IPv4
+        const uint8_t rest[12] = {_16to8(session.InterfaceIndex), 0, 1, _32to8(session.PeerAddress),
+                                  _32to8(session.LocalAddress)};
+        std::copy(rest, rest + sizeof(rest), field);
+
+        std::unique_lock lock(mutex_);
+        if (current_.size() + size > options_.BufferBytes && !current_.empty()) {
+            if (free_.empty()) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            QueueCurrent();
+            wake_.notify_one();
+        }
+        if (current_.empty()) {
+            currentStarted_ = std::chrono::steady_clock::now();
+        }
+        current_.insert(current_.end(), header, header + headerSize);
+        current_.insert(current_.end(), message.begin(), message.end());
+        current_.insert(current_.end(), states.begin(), states.end());
+        records_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::vector<uint8_t> TakeFreeBuffer() {
+        auto buffer = std::move(free_.back());
+        free_.pop_back();
+        return buffer;
+    }
+
+    // Needs mutex_ held and a free buffer to replace current_ with
+    void QueueCurrent() {
+        full_.emplace_back(std::move(current_));
+        current_ = TakeFreeBuffer();
+        ++queued_;
+    }
+
+    void Run() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            wake_.wait_for(lock, options_.FlushInterval, [&]() { return stopping_ || !full_.empty(); });
+            const auto stale = !current_.empty() &&
+                               std::chrono::steady_clock::now() - currentStarted_ >= options_.FlushInterval;
+            if ((stopping_ || stale) && !current_.empty() && !free_.empty()) {
+                QueueCurrent();
+            }
+            while (!full_.empty()) {
+                auto buffer = std::move(full_.front());
+                full_.pop_front();
+                lock.unlock();
+                Write(buffer);
+                buffer.clear();
+                lock.lock();
+                free_.emplace_back(std::move(buffer));
+                ++written_;
+            }
+            flushed_.notify_all();
+            if (stopping_ && current_.empty()) {
+                break;
+            }
+        }
+        lock.unlock();
+        file_.close();
+    }
+
+    // Only called from the writer thread. Once a file failed, buffers are thrown away.
+    void Write(const std::vector<uint8_t> &buffer) {
+        if (failed_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const auto now = std::chrono::system_clock::now();
+        if (file_.is_open() && (fileBytes_ + buffer.size() > options_.MaxFileBytes ||
+                                now - fileOpened_ >= options_.MaxFileAge)) {
+            file_.close();
+        }
+        if (!file_.is_open() && !Open(now)) {
+            failed_.store(true, std::memory_order_release);
+            return;
+        }
+        file_.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        file_.flush();
+        if (!file_) {
+            failure_ = "Unable to write MRT archive " + filePath_;
+            failed_.store(true, std::memory_order_release);
+            return;
+        }
+        fileBytes_ += buffer.size();
+    }
+
+    // Returns false, with failure_ set, if the file cannot be opened
+    bool Open(const std::chrono::system_clock::time_point now) {
+        const auto time = std::chrono::system_clock::to_time_t(now);
+        std::tm utc{};
+#if defined(_WIN32)
+        gmtime_s(&utc, &time);
+#else
+        gmtime_r(&time, &utc);
+#endif
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y%m%d.%H%M%S", &utc);
+        auto path = options_.Directory + "/" + options_.Prefix + "." + timestamp;
+        // More than one file in a second only happens with a tiny MaxFileBytes, but should not overwrite anything
+        if (path == lastPath_) {
+            path += "." + std::to_string(++samePathCount_);
+        } else {
+            lastPath_ = path;
+            samePathCount_ = 0;
+        }
+        filePath_ = path + ".mrt";
+        file_.open(filePath_, std::ios::binary | std::ios::app);
+        if (!file_.is_open()) {
+            failure_ = "Unable to open MRT archive " + filePath_;
+            return false;
+        }
+        fileOpened_ = now;
+        fileBytes_ = 0;
+        files_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    MrtWriterOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<uint8_t> current_;
+    std::chrono::steady_clock::time_point currentStarted_;
+    std::deque<std::vector<uint8_t>> full_;
+    std::vector<std::vector<uint8_t>> free_;
+    uint64_t queued_ = 0;
+    uint64_t written_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> records_ = 0;
+    std::atomic<uint64_t> dropped_ = 0;
+    std::atomic<uint64_t> files_ = 0;
+    // failure_ is only written before failed_ is set
+    std::atomic<bool> failed_ = false;
+    std::string failure_;
+
+    // Writer thread only
+    std::ofstream file_;
+    std::string filePath_;
+    std::chrono::system_clock::time_point fileOpened_;
+    size_t fileBytes_ = 0;
+    std::string lastPath_;
+    size_t samePathCount_ = 0;
+
+    std::thread thread_;
+};
+
+#endif //BGP_MRTWRITER_H
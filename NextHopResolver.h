@@ -0,0 +1,302 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_NEXTHOPRESOLVER_H
+#define BGP_NEXTHOPRESOLVER_H
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <set>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <charconv>
+#include <system_error>
+#include "Route.h"
+#include "Path.h"
+#include "NextHopTable.h"
+
+// A route from the IGP or a static route, what BGP next hops are resolved against
+struct IgpRoute {
+    Route Prefix;
+    uint32_t Metric = 0;
+    uint32_t Interface = 0;
+};
+
+// The local IGP/static routing table. Small enough that a hash table per prefix length is the simplest LPM, and a lookup
+// only probes the lengths actually in use.
+class IgpTable {
+public:
+    void Add(const IgpRoute &route) {
+        const auto length = std::min<uint8_t>(route.Prefix.Length, 32);
+        auto stored = route;
+        stored.Prefix = Route{length, route.Prefix.Prefix & mask(length)};
+        routes_[length][stored.Prefix.Prefix] = stored;
+        UpdateLengths();
+    }
+
+    bool Remove(const Route &prefix) {
+        const auto length = std::min<uint8_t>(prefix.Length, 32);
+        if (routes_[length].erase(prefix.Prefix & mask(length)) == 0) {
+            return false;
+        }
+        UpdateLengths();
+        return true;
+    }
+
+    // Longest match, nullptr if nothing covers address
+    [[nodiscard]] const IgpRoute *Lookup(const uint32_t address) const {
+        for (const auto length : lengths_) {
+            const auto &routes = routes_[length];
+            const auto it = routes.find(address & mask(length));
+            if (it != routes.end()) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] const IgpRoute *Find(const Route &prefix) const {
+        const auto length = std::min<uint8_t>(prefix.Length, 32);
+        const auto it = routes_[length].find(prefix.Prefix & mask(length));
+        return it == routes_[length].end() ? nullptr : &it->second;
+    }
+
+    [[nodiscard]] size_t size() const {
+        size_t count = 0;
+        for (const auto &routes : routes_) {
+            count += routes.size();
+        }
+        return count;
+    }
+
+    // function(const IgpRoute &)
+    template<typename Function>
+    void ForEach(Function &&function) const {
+        for (const auto &routes : routes_) {
+            for (const auto &[prefix, route] : routes) {
+                function(route);
+            }
+        }
+    }
+
+    static constexpr uint32_t mask(const uint8_t length) {
+        return length == 0 ? 0 : UINT32_MAX << (32 - length);
+    }
+
+private:
+    void UpdateLengths() {
+        lengths_.clear();
+        for (int length = 32; length >= 0; --length) {
+            if (!routes_[length].empty()) {
+                lengths_.emplace_back(static_cast<uint8_t>(length));
+            }
+        }
+    }
+
+    std::array<std::unordered_map<uint32_t, IgpRoute>, 33> routes_;
+    // Lengths with at least one route, longest first
+    std::vector<uint8_t> lengths_;
+};
+
+// Loads an IGP/static table from a text file, one route per line: "<prefix>/<length> <metric> [interface]". Blank lines
+// and anything after a '#' are ignored. Throws std::runtime_error if the file cannot be read and std::invalid_argument
+// naming the line for anything malformed.
+IgpTable loadIgpTable(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Unable to open IGP table " + path);
+    }
+
+    IgpTable table;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string prefixText;
+        if (!(fields >> prefixText)) {
+            continue;
+        }
+
+        std::vector<std::string> tokens = {prefixText};
+        std::string token;
+        while (fields >> token) {
+            tokens.emplace_back(token);
+        }
+        const auto parseNumber = [](const std::string &text) -> std::optional<uint32_t> {
+            uint32_t value = 0;
+            const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return error == std::errc() && end == text.data() + text.size() ? std::optional<uint32_t>(value) : std::nullopt;
+        };
+
+        const auto prefix = parseIpv4Prefix(tokens[0]);
+        const auto metric = tokens.size() >= 2 ? parseNumber(tokens[1]) : std::nullopt;
+        const auto interface = tokens.size() >= 3 ? parseNumber(tokens[2]) : std::optional<uint32_t>(0);
+        if (!prefix || !metric || !interface || tokens.size() > 3) {
+            throw std::invalid_argument(path + ":" + std::to_string(lineNumber) +
+                                        ": expected '<prefix>/<length> <metric> [interface]', got '" + line + "'");
+        }
+        table.Add(IgpRoute{*prefix, *metric, *interface});
+    }
+    return table;
+}
+
+// Resolves BGP next hops against an IgpTable and caches the result per next hop, so importing a route with an already
+// seen next hop costs a hash lookup instead of an LPM lookup. Each cached next hop remembers the IGP prefix that
+// resolved it, and an IGP change only re-resolves the cached next hops inside the changed prefix, instead of all of them.
+// A next hop with no covering IGP route is unreachable.
+class NextHopResolver {
+public:
+    struct Change {
+        NextHop Address;
+        NextHopResolution Resolution;
+    };
+
+    explicit NextHopResolver(IgpTable table = {}) : table_(std::move(table)) {}
+
+    const NextHopResolution &Resolve(const NextHop address) {
+        const auto it = cache_.find(address);
+        if (it != cache_.end()) {
+            ++hits_;
+            return it->second.Resolution;
+        }
+        ++misses_;
+        addresses_.insert(address);
+        return cache_.emplace(address, Lookup(address)).first->second.Resolution;
+    }
+
+    // For NextHopTable::SetResolver and LocRib::SetNextHopResolver, the resolver has to outlive them
+    [[nodiscard]] NextHopTable::Resolver resolver() {
+        return [this](const NextHop address) { return Resolve(address); };
+    }
+
+    // Adds or replaces an IGP route. Returns the cached next hops whose resolution changed, which is what
+    // LocRib::SetNextHopResolution() and Fib::Refresh() need to be told about.
+    std::vector<Change> AddRoute(const IgpRoute &route) {
+        table_.Add(route);
+        const auto length = std::min<uint8_t>(route.Prefix.Length, 32);
+        // Only next hops resolved through this prefix or a shorter one can now resolve through it
+        return Reresolve(route.Prefix, [&](const CacheEntry &entry) {
+            return !entry.Covering || entry.Covering->Length <= length;
+        });
+    }
+
+    std::vector<Change> RemoveRoute(const Route &prefix) {
+        if (!table_.Remove(prefix)) {
+            return {};
+        }
+        const auto length = std::min<uint8_t>(prefix.Length, 32);
+        const auto network = prefix.Prefix & IgpTable::mask(length);
+        // Only next hops resolved through exactly this prefix are affected
+        return Reresolve(prefix, [&](const CacheEntry &entry) {
+            return entry.Covering && entry.Covering->Length == length && entry.Covering->Prefix == network;
+        });
+    }
+
+    // Moves to table, e.g. the IGP table read again, one route at a time: new and changed routes are added first, so a
+    // next hop moving to another route does not pass through unreachable, then routes missing from table are removed.
+    // Returns the changes of all those steps in order. A next hop can appear more than once, its last change is its
+    // current resolution.
+    std::vector<Change> Replace(const IgpTable &table) {
+        std::vector<Route> removed;
+        table_.ForEach([&](const IgpRoute &route) {
+            if (!table.Find(route.Prefix)) {
+                removed.emplace_back(route.Prefix);
+            }
+        });
+        std::vector<IgpRoute> added;
+        table.ForEach([&](const IgpRoute &route) {
+            const auto current = table_.Find(route.Prefix);
+            if (!current || current->Metric != route.Metric || current->Interface != route.Interface) {
+                added.emplace_back(route);
+            }
+        });
+
+        std::vector<Change> changes;
+        for (const auto &route : added) {
+            const auto addChanges = AddRoute(route);
+            changes.insert(changes.end(), addChanges.begin(), addChanges.end());
+        }
+        for (const auto &prefix : removed) {
+            const auto removeChanges = RemoveRoute(prefix);
+            changes.insert(changes.end(), removeChanges.begin(), removeChanges.end());
+        }
+        return changes;
+    }
+
+    // Forgets cached next hops, e.g. ones no path uses anymore
+    void Evict(const NextHop address) {
+        cache_.erase(address);
+        addresses_.erase(address);
+    }
+
+    [[nodiscard]] const IgpTable &table() const {
+        return table_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return cache_.size();
+    }
+
+    [[nodiscard]] uint64_t hits() const {
+        return hits_;
+    }
+
+    [[nodiscard]] uint64_t misses() const {
+        return misses_;
+    }
+
+private:
+    struct CacheEntry {
+        NextHopResolution Resolution;
+        // The IGP prefix that resolved this next hop, std::nullopt if none did
+        std::optional<Route> Covering;
+    };
+
+    [[nodiscard]] CacheEntry Lookup(const NextHop address) const {
+        const auto route = table_.Lookup(address);
+        if (!route) {
+            return {NextHopResolution{false, 0, 0}, std::nullopt};
+        }
+        return {NextHopResolution{true, route->Metric, route->Interface}, route->Prefix};
+    }
+
+    template<typename Predicate>
+    std::vector<Change> Reresolve(const Route &prefix, Predicate affected) {
+        const auto length = std::min<uint8_t>(prefix.Length, 32);
+        const auto first = prefix.Prefix & IgpTable::mask(length);
+        const auto last = first | ~IgpTable::mask(length);
+
+        std::vector<Change> changes;
+        for (auto it = addresses_.lower_bound(first); it != addresses_.end() && *it <= last; ++it) {
+            auto &entry = cache_[*it];
+            if (!affected(entry)) {
+                continue;
+            }
+            auto resolved = Lookup(*it);
+            if (!(resolved.Resolution == entry.Resolution)) {
+                changes.emplace_back(Change{*it, resolved.Resolution});
+            }
+            entry = std::move(resolved);
+        }
+        return changes;
+    }
+
+    IgpTable table_;
+    std::unordered_map<NextHop, CacheEntry> cache_;
+    // The cached next hops in address order, for finding the ones inside a changed IGP prefix
+    std::set<NextHop> addresses_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+#endif //BGP_NEXTHOPRESOLVER_H
@@ -0,0 +1,128 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_NEXTHOPTABLE_H
+#define BGP_NEXTHOPTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include "Path.h"
+
+// How a BGP next hop is reached: whether it is reachable at all, the IGP metric towards it (RFC 4271 9.1.2.2 e), and the
+// interface it resolves through
+struct NextHopResolution {
+    bool Reachable = true;
+    uint32_t Metric = 0;
+    uint32_t Interface = 0;
+
+    bool operator==(const NextHopResolution &other) const = default;
+};
+
+// A next hop shared by every path that uses it, so resolution state lives once per next hop rather than once per route
+class NextHopEntry {
+public:
+    NextHopEntry(const NextHop address, const uint64_t id, const NextHopResolution &resolution)
+            : address_(address),
+              id_(id),
+              resolution_(resolution) {}
+
+    [[nodiscard]] NextHop address() const {
+        return address_;
+    }
+
+    // Unique for the lifetime of the NextHopTable that created this entry
+    [[nodiscard]] uint64_t id() const {
+        return id_;
+    }
+
+    [[nodiscard]] const NextHopResolution &resolution() const {
+        return resolution_;
+    }
+
+    [[nodiscard]] bool reachable() const {
+        return resolution_.Reachable;
+    }
+
+    [[nodiscard]] uint32_t metric() const {
+        return resolution_.Metric;
+    }
+
+private:
+    friend class NextHopTable;
+
+    NextHop address_;
+    uint64_t id_;
+    NextHopResolution resolution_;
+};
+
+// Hands out one NextHopEntry per next hop address. Like the other stores only weak references are kept, an entry lives
+// as long as some path list uses it. New entries are resolved with the resolver if there is one, and otherwise start
+// out reachable with metric 0 until told otherwise.
+class NextHopTable {
+public:
+    typedef std::function<NextHopResolution(NextHop)> Resolver;
+
+    // Only affects entries created from now on
+    void SetResolver(Resolver resolver) {
+        resolver_ = std::move(resolver);
+    }
+
+    std::shared_ptr<const NextHopEntry> Acquire(const NextHop address) {
+        auto &slot = entries_[address];
+        if (auto existing = slot.lock()) {
+            return existing;
+        }
+        auto entry = std::make_shared<NextHopEntry>(address, nextId_++,
+                                                    resolver_ ? resolver_(address) : NextHopResolution{});
+        slot = entry;
+        return entry;
+    }
+
+    [[nodiscard]] std::shared_ptr<const NextHopEntry> Find(const NextHop address) const {
+        const auto it = entries_.find(address);
+        return it == entries_.end() ? nullptr : it->second.lock();
+    }
+
+    // Returns false if nothing uses address or its resolution did not change
+    bool SetResolution(const NextHop address, const NextHopResolution &resolution) {
+        const auto it = entries_.find(address);
+        if (it == entries_.end()) {
+            return false;
+        }
+        const auto entry = it->second.lock();
+        if (!entry || entry->resolution_ == resolution) {
+            return false;
+        }
+        entry->resolution_ = resolution;
+        return true;
+    }
+
+    // function(const std::shared_ptr<const NextHopEntry> &)
+    template<typename Function>
+    void ForEach(Function &&function) const {
+        for (const auto &[address, slot] : entries_) {
+            if (const auto entry = slot.lock()) {
+                function(std::shared_ptr<const NextHopEntry>(entry));
+            }
+        }
+    }
+
+    void Purge() {
+        std::erase_if(entries_, [](const auto &entry) { return entry.second.expired(); });
+    }
+
+    [[nodiscard]] size_t size() const {
+        return entries_.size();
+    }
+
+private:
+    Resolver resolver_;
+    uint64_t nextId_ = 1;
+    std::unordered_map<NextHop, std::weak_ptr<NextHopEntry>> entries_;
+};
+
+#endif //BGP_NEXTHOPTABLE_H
@@ -0,0 +1,262 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ORF_H
+#define BGP_ORF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <span>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include "Util.h"
+#include "BgpCapability.h"
+#include "Policy.h"
+#include "RouteRefresh.h"
+
+// Outbound Route Filtering (RFC 5291) with address prefix ORF entries (RFC 5292): a peer tells us which prefixes it
+// will accept, so we never encode routes it would drop, and we tell upstreams which prefixes our import prefix-list
+// accepts, so they do not send us a full table only for most of it to be discarded. IPv4 unicast only. TODO: [9]
+
+constexpr uint8_t ORF_TYPE_ADDRESS_PREFIX = 64;
+
+enum OrfSendReceive : uint8_t {
+    /*
+     * 1 Receive [RFC5291]
+     * 2 Send [RFC5291]
+     * 3 Both [RFC5291]
+     */
+    OrfReceive = 1,
+    OrfSend = 2,
+    OrfBoth = 3
+};
+
+enum OrfWhenToRefresh : uint8_t {
+    /*
+     * 1 IMMEDIATE [RFC5291]
+     * 2 DEFER [RFC5291]
+     */
+    OrfImmediate = 1,
+    OrfDefer = 2
+};
+
+enum OrfAction : uint8_t {
+    /*
+     * 0 ADD [RFC5291]
+     * 1 REMOVE [RFC5291]
+     * 2 REMOVE-ALL [RFC5291]
+     */
+    OrfAdd = 0,
+    OrfRemove = 1,
+    OrfRemoveAll = 2
+};
+
+std::string OrfActionToString(const OrfAction action) {
+    switch (action) {
+        case OrfAdd:
+            return "Add";
+        case OrfRemove:
+            return "Remove";
+        case OrfRemoveAll:
+            return "RemoveAll";
+        default:
+            return "InvalidOrfAction";
+    }
+}
+
+// One address prefix ORF entry. Entry is unused for OrfRemoveAll, and only its Sequence matters for OrfRemove.
+struct OrfEntry {
+    OrfAction Action;
+    PrefixListEntry Entry;
+};
+
+// The ORFs of one ROUTE-REFRESH message
+struct OrfRequest {
+    OrfWhenToRefresh When;
+    std::vector<OrfEntry> Entries;
+};
+
+// RFC 5291 4, address prefix ORF for IPv4 unicast only
+BgpCapability flattenOrfCapability(const OrfSendReceive sendReceive) {
+    std::vector<uint8_t> value = {_16to8(ROUTE_REFRESH_AFI_IPV4), 0, ROUTE_REFRESH_SAFI_UNICAST, 1,
+                                  ORF_TYPE_ADDRESS_PREFIX, sendReceive};
+    return {OutboundRouteFiltering, static_cast<uint8_t>(value.size()), value};
+}
+
+// What the peer said it can do with address prefix ORF for IPv4 unicast, std::nullopt if nothing
+std::optional<OrfSendReceive> findOrfCapability(const std::vector<BgpCapability> &capabilities) {
+    for (const auto &capability : capabilities) {
+        if (capability.Code != OutboundRouteFiltering) {
+            continue;
+        }
+        const auto &value = capability.Value;
+        for (size_t i = 0; i + 5 <= value.size();) {
+            const auto afi = _8to16(value[i], value[i + 1]);
+            const auto safi = value[i + 3];
+            const auto count = value[i + 4];
+            i += 5;
+            for (uint8_t orf = 0; orf < count && i + 2 <= value.size(); ++orf, i += 2) {
+                if (afi == ROUTE_REFRESH_AFI_IPV4 && safi == ROUTE_REFRESH_SAFI_UNICAST &&
+                    value[i] == ORF_TYPE_ADDRESS_PREFIX && value[i + 1] >= OrfReceive && value[i + 1] <= OrfBoth) {
+                    return static_cast<OrfSendReceive>(value[i + 1]);
+                }
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+// RFC 5292 3 leaves Minlen and Maxlen 0 when they are not needed: both 0 is an exact match, Minlen alone goes up to /32
+void appendOrfEntry(std::vector<uint8_t> &bytes, const OrfEntry &orfEntry) {
+    // Action in the top two bits, Match (0 permit, 1 deny) in the next
+    bytes.emplace_back(static_cast<uint8_t>(orfEntry.Action << 6 | (orfEntry.Entry.Action == Deny ? 0x20 : 0)));
+    if (orfEntry.Action == OrfRemoveAll) {
+        return;
+    }
+    const auto &entry = orfEntry.Entry;
+    const uint8_t minLength = entry.MinLength <= entry.Length ? 0 : entry.MinLength;
+    const uint8_t maxLength = entry.MaxLength == (minLength == 0 ? entry.Length : 32) ? 0 : entry.MaxLength;
+    const uint8_t header[7] = {_32to8(entry.Sequence), minLength, maxLength, entry.Length};
+    bytes.insert(bytes.end(), header, header + sizeof(header));
+    for (uint8_t octet = 0; octet < (entry.Length + 7) / 8; ++octet) {
+        bytes.emplace_back(static_cast<uint8_t>(entry.Prefix >> (24 - octet * 8)));
+    }
+}
+
+// RFC 5291 5: the ORF part of a ROUTE-REFRESH message, BgpRouteRefreshMessage::Orf. Entries of ORF types other than
+// address prefix are skipped. Throws std::invalid_argument if it is malformed.
+OrfRequest parseOrfRequest(const std::span<const uint8_t> bytes) {
+    if (bytes.empty()) {
+        throw std::invalid_argument("ROUTE-REFRESH ORF is missing When-to-refresh");
+    }
+    OrfRequest request{static_cast<OrfWhenToRefresh>(bytes[0]), {}};
+    for (size_t i = 1; i < bytes.size();) {
+        if (i + 3 > bytes.size()) {
+            throw std::invalid_argument("ROUTE-REFRESH ORF header is truncated");
+        }
+        const auto type = bytes[i];
+        const size_t length = _8to16(bytes[i + 1], bytes[i + 2]);
+        i += 3;
+        if (i + length > bytes.size()) {
+            throw std::invalid_argument("ROUTE-REFRESH ORF entries are truncated");
+        }
+        const auto entries = bytes.subspan(i, length);
+        i += length;
+        if (type != ORF_TYPE_ADDRESS_PREFIX) {
+            continue;
+        }
+        for (size_t j = 0; j < entries.size();) {
+            OrfEntry orfEntry{static_cast<OrfAction>(entries[j] >> 6), {}};
+            orfEntry.Entry.Action = entries[j] & 0x20 ? Deny : Permit;
+            ++j;
+            if (orfEntry.Action != OrfRemoveAll) {
+                if (j + 7 > entries.size()) {
+                    throw std::invalid_argument("ROUTE-REFRESH address prefix ORF entry is truncated");
+                }
+                auto &entry = orfEntry.Entry;
+                entry.Sequence = _8to32(entries[j], entries[j + 1], entries[j + 2], entries[j + 3]);
+                const auto minLength = entries[j + 4];
+                const auto maxLength = entries[j + 5];
+                entry.Length = entries[j + 6];
+                j += 7;
+                const size_t prefixBytes = (entry.Length + 7) / 8;
+                if (entry.Length > 32 || j + prefixBytes > entries.size()) {
+                    throw std::invalid_argument("ROUTE-REFRESH address prefix ORF entry has a bad prefix");
+                }
+                entry.Prefix = 0;
+                for (size_t octet = 0; octet < 4; ++octet) {
+                    entry.Prefix = entry.Prefix << 8 | (octet < prefixBytes ? entries[j + octet] : 0);
+                }
+                j += prefixBytes;
+                entry.MinLength = minLength == 0 ? entry.Length : minLength;
+                entry.MaxLength = maxLength != 0 ? maxLength : minLength == 0 ? entry.Length : 32;
+            }
+            request.Entries.emplace_back(orfEntry);
+        }
+    }
+    return request;
+}
+
+// Pushes prefixList to a peer as ROUTE-REFRESH messages replacing whatever was pushed before: REMOVE-ALL, then an ADD
+// for every entry. A large prefix-list takes several messages, all but the last DEFER, so the peer only refreshes once
+// it has the whole list.
+std::vector<std::vector<uint8_t>> flattenOrfRouteRefreshMessages(const PrefixList &prefixList) {
+    // Header, AFI, Subtype, SAFI, When-to-refresh, ORF Type and Length of ORF entries
+    constexpr size_t MAX_ENTRIES_SIZE = 4096 - 19 - 4 - 1 - 3;
+    // Action/Match, Sequence, Minlen, Maxlen, Length and up to 4 octets of prefix
+    constexpr size_t MAX_ENTRY_SIZE = 12;
+
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<uint8_t> entries;
+    appendOrfEntry(entries, {OrfRemoveAll, {}});
+    const auto flush = [&](const OrfWhenToRefresh when) {
+        std::vector<uint8_t> orf = {when, ORF_TYPE_ADDRESS_PREFIX, _16to8(entries.size())};
+        orf.insert(orf.end(), entries.begin(), entries.end());
+        messages.emplace_back(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4, NormalRouteRefresh,
+                                                             ROUTE_REFRESH_SAFI_UNICAST, orf}));
+        entries.clear();
+    };
+    for (const auto &entry : prefixList.entries()) {
+        if (entries.size() + MAX_ENTRY_SIZE > MAX_ENTRIES_SIZE) {
+            flush(OrfDefer);
+        }
+        appendOrfEntry(entries, {OrfAdd, entry});
+    }
+    flush(OrfImmediate);
+    return messages;
+}
+
+// The address prefix ORF entries a peer has sent us, compiled into the prefix-list applied to everything we send it
+class OrfFilter {
+public:
+    // Applies the entries of one ROUTE-REFRESH message in order. Compiling waits for filter(), so a list that arrives
+    // over several DEFER messages is compiled once.
+    void Apply(const std::vector<OrfEntry> &entries) {
+        for (const auto &orfEntry : entries) {
+            switch (orfEntry.Action) {
+                case OrfAdd:
+                    entries_[orfEntry.Entry.Sequence] = orfEntry.Entry;
+                    break;
+                case OrfRemove:
+                    entries_.erase(orfEntry.Entry.Sequence);
+                    break;
+                case OrfRemoveAll:
+                    entries_.clear();
+                    break;
+                default:
+                    break;
+            }
+        }
+        compiled_ = false;
+    }
+
+    // nullptr if the peer has no entries, which means it takes everything
+    [[nodiscard]] const std::shared_ptr<const PrefixList> &filter() {
+        if (!compiled_) {
+            std::vector<PrefixListEntry> entries;
+            entries.reserve(entries_.size());
+            for (const auto &[sequence, entry] : entries_) {
+                entries.emplace_back(entry);
+            }
+            filter_ = entries.empty() ? nullptr : std::make_shared<const PrefixList>("ORF", std::move(entries));
+            compiled_ = true;
+        }
+        return filter_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return entries_.size();
+    }
+
+private:
+    std::map<uint32_t, PrefixListEntry> entries_;
+    std::shared_ptr<const PrefixList> filter_;
+    bool compiled_ = true;
+};
+
+#endif //BGP_ORF_H
@@ -9,16 +9,18 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <compare>
+#include <memory_resource>
 
 enum PathAttributeFlagBits : uint8_t {
     WellKnown = 0x00,
-    Optional = 0x01,
+    Optional = 0x80,
     NonTransitive = 0x00,
-    Transitive = 0x02,
+    Transitive = 0x40,
     Complete = 0x00,
-    Partial = 0x04,
+    Partial = 0x20,
     OneByteAttribute = 0x00,
-    TwoByteAttribute = 0x08
+    TwoByteAttribute = 0x10
 };
 
 enum PathAttributeType : uint8_t {
@@ -147,15 +149,8 @@ enum AsPathSegmentType : uint8_t {
     ASSequence = 0x02
 };
 
-struct AsPathSegment {
-    AsPathSegmentType Type;
-    uint8_t Length;
-    // TODO: [3]
-    std::vector<uint16_t> Value;
-};
-
 // Well-known mandatory
-typedef std::vector<AsPathSegment> AsPath;
+// AsPath is interned, see AsPath.h
 
 // TODO: [9], possibly use std::vector<uint8_t>?
 // Well-known mandatory
@@ -172,20 +167,37 @@ typedef uint8_t AtomicAggregate;
 
 // Optional transitive
 struct Aggregator {
-    // TODO: [3]
-    uint16_t LocalAs;
+    uint32_t LocalAs;
     // TODO: [9]
     uint32_t RouterId;
 };
 
+// Optional transitive, ASN in the high 16 bits and value in the low 16 bits. Sets of these are interned, see Communities.h
+typedef uint32_t Community;
+
+// Optional transitive
+typedef uint64_t ExtendedCommunity;
+
+// Optional transitive
+struct LargeCommunity {
+    uint32_t GlobalAdministrator;
+    uint32_t LocalData1;
+    uint32_t LocalData2;
+
+    auto operator<=>(const LargeCommunity &other) const = default;
+};
+
 // TODO: [11]
 
 struct PathAttribute {
     uint8_t Flags;
     PathAttributeType Type;
 
-    // TODO: if Flags & PathAttributeFlagBits::TwoByteAttribute, Value[0] and Value[1] contain the length of the attribute data. Otherwise, Value[0] contains the length.
-    std::vector<uint8_t> Value;
+    // Attribute data only, the length octet(s) are consumed by parseBgpUpdateMessage(). Parsed attributes live in the
+    // message's arena, copies go to the default resource unless given another one.
+    std::pmr::vector<uint8_t> Value;
+
+    bool operator==(const PathAttribute &other) const = default;
 
     [[nodiscard]] std::string DebugOutput() const {
         std::stringstream output;
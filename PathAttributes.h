@@ -0,0 +1,396 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_PATHATTRIBUTES_H
+#define BGP_PATHATTRIBUTES_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <span>
+#include <memory_resource>
+#include "Util.h"
+#include "Path.h"
+#include "AsPath.h"
+#include "Communities.h"
+
+// Typed decoders for PathAttribute::Value. These return std::nullopt for a value whose length or contents are malformed,
+// leaving the caller to decide how to treat the attribute.
+// TODO: [4] surface these as UPDATE message errors instead.
+
+std::optional<Origin> parseOriginAttribute(std::span<const uint8_t> value) {
+    if (value.size() != 1 || value[0] > Incomplete) {
+        return std::nullopt;
+    }
+    return static_cast<Origin>(value[0]);
+}
+
+// NEXT_HOP, MULTI_EXIT_DISC and LOCAL_PREF are all a single 4-octet value
+std::optional<uint32_t> parseUint32Attribute(std::span<const uint8_t> value) {
+    if (value.size() != 4) {
+        return std::nullopt;
+    }
+    return _8to32(value[0], value[1], value[2], value[3]);
+}
+
+// AGGREGATOR carries a 2 or 4-octet ASN depending on the session, AS4_AGGREGATOR always a 4-octet one
+std::optional<Aggregator> parseAggregatorAttribute(std::span<const uint8_t> value, const bool fourOctetAsns) {
+    if (value.size() == 6 && !fourOctetAsns) {
+        return Aggregator{_8to16(value[0], value[1]), _8to32(value[2], value[3], value[4], value[5])};
+    }
+    if (value.size() == 8 && fourOctetAsns) {
+        return Aggregator{_8to32(value[0], value[1], value[2], value[3]), _8to32(value[4], value[5], value[6], value[7])};
+    }
+    return std::nullopt;
+}
+
+enum DecisionKeyFlagBits : uint8_t {
+    HasOrigin = 0x01,
+    HasAsPath = 0x02,
+    HasNextHop = 0x04,
+    HasMultiExitDiscriminator = 0x08,
+    HasLocalPref = 0x10,
+    HasAtomicAggregate = 0x20
+};
+
+// The fields the decision process and policy consult for every path, extracted once when an attribute set is interned.
+// A missing LOCAL_PREF takes the conventional default of 100, a missing MULTI_EXIT_DISC is treated as 0 (RFC 4271 9.1.2.2).
+struct DecisionKeys {
+    LocalPref LocalPreference = 100;
+    MultiExitDiscriminator Med = 0;
+    NextHop NextHopAddress = 0;
+    // Leftmost AS of the leading AS_SEQUENCE, i.e. the neighbor AS. 0 if the path is empty or starts with an AS_SET.
+    uint32_t FirstAs = 0;
+    uint16_t AsPathLength = 0;
+    Origin OriginType = Incomplete;
+    uint8_t Flags = 0;
+
+    bool operator==(const DecisionKeys &other) const = default;
+
+    [[nodiscard]] std::string DebugOutput() const {
+        std::stringstream output;
+
+        output << "LocalPref: " << std::to_string(LocalPreference) << std::endl;
+        output << "AsPathLength: " << std::to_string(AsPathLength) << std::endl;
+        output << "FirstAs: " << std::to_string(FirstAs) << std::endl;
+        output << "Origin: " << std::to_string(OriginType) << std::endl;
+        output << "MED: " << std::to_string(Med) << std::endl;
+        const std::array<uint8_t, 4> nextHopDottedDecimal = {_32to8(NextHopAddress)};
+        output << "NextHop: " << std::to_string(nextHopDottedDecimal[0]) << "." << std::to_string(nextHopDottedDecimal[1])
+               << "." << std::to_string(nextHopDottedDecimal[2]) << "." << std::to_string(nextHopDottedDecimal[3])
+               << std::endl;
+
+        return output.str();
+    }
+};
+
+// RFC 4271 9.1.2.2 steps a) through c). Returns < 0 if a is preferred, > 0 if b is preferred, and 0 if the remaining
+// tie-breakers (eBGP over iBGP, IGP cost, BGP Identifier) have to decide.
+int compareDecisionKeys(const DecisionKeys &a, const DecisionKeys &b) {
+    if (a.LocalPreference != b.LocalPreference) {
+        return a.LocalPreference > b.LocalPreference ? -1 : 1;
+    }
+    if (a.AsPathLength != b.AsPathLength) {
+        return a.AsPathLength < b.AsPathLength ? -1 : 1;
+    }
+    if (a.OriginType != b.OriginType) {
+        return a.OriginType < b.OriginType ? -1 : 1;
+    }
+    // MED is only comparable between paths learned from the same neighbor AS
+    if (a.FirstAs == b.FirstAs && a.Med != b.Med) {
+        return a.Med < b.Med ? -1 : 1;
+    }
+    return 0;
+}
+
+uint64_t hashPathAttributes(const std::span<const PathAttribute> attributes, const bool fourOctetAsns) {
+    uint64_t hash = hashBytes(nullptr, 0);
+    for (const auto &attribute : attributes) {
+        const uint8_t header[4] = {attribute.Flags, attribute.Type, _16to8(attribute.Value.size())};
+        hash = hashBytes(header, sizeof(header), hash);
+        hash = hashBytes(attribute.Value.data(), attribute.Value.size(), hash);
+    }
+    // The same bytes decode to a different AS_PATH depending on the session's ASN size
+    return fourOctetAsns ? ~hash : hash;
+}
+
+// An immutable, interned list of path attributes as received on the wire. The decision keys and the interned AS_PATH
+// are resolved up front, everything else is decoded on first access and cached alongside the raw bytes.
+// Lazy decodes are not synchronized. TODO: [14]
+class PathAttributeSet {
+public:
+    // Every type in PathAttributeType fits, anything above is found with a linear search
+    static constexpr size_t INDEXED_ATTRIBUTE_TYPES = BGPsecPathAttribute + 1;
+
+    PathAttributeSet(std::vector<PathAttribute> attributes, const uint64_t hash, const bool fourOctetAsns,
+                     AsPathStore &asPathStore, std::shared_ptr<CommunityStores> communityStores)
+            : attributes_(std::move(attributes)),
+              hash_(hash),
+              fourOctetAsns_(fourOctetAsns),
+              communityStores_(std::move(communityStores)) {
+        index_.fill(0);
+        for (size_t i = 0; i < attributes_.size() && i < UINT8_MAX; ++i) {
+            const auto type = attributes_[i].Type;
+            // RFC 4271 5: an attribute type appears at most once, keep the first if a peer disagrees
+            if (type < INDEXED_ATTRIBUTE_TYPES && index_[type] == 0) {
+                index_[type] = static_cast<uint8_t>(i + 1);
+            }
+        }
+        ResolveAsPath(asPathStore);
+        ExtractDecisionKeys();
+    }
+
+    [[nodiscard]] const std::vector<PathAttribute> &attributes() const {
+        return attributes_;
+    }
+
+    [[nodiscard]] uint64_t hash() const {
+        return hash_;
+    }
+
+    [[nodiscard]] bool four_octet_asns() const {
+        return fourOctetAsns_;
+    }
+
+    [[nodiscard]] const DecisionKeys &keys() const {
+        return keys_;
+    }
+
+    [[nodiscard]] const PathAttribute *find(const PathAttributeType type) const {
+        if (type < INDEXED_ATTRIBUTE_TYPES) {
+            return index_[type] == 0 ? nullptr : &attributes_[index_[type] - 1];
+        }
+        for (const auto &attribute : attributes_) {
+            if (attribute.Type == type) {
+                return &attribute;
+            }
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] std::optional<Origin> origin() const {
+        return keys_.Flags & HasOrigin ? std::optional<Origin>(keys_.OriginType) : std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<NextHop> next_hop() const {
+        return keys_.Flags & HasNextHop ? std::optional<NextHop>(keys_.NextHopAddress) : std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<MultiExitDiscriminator> multi_exit_discriminator() const {
+        return keys_.Flags & HasMultiExitDiscriminator ? std::optional<MultiExitDiscriminator>(keys_.Med) : std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<LocalPref> local_pref() const {
+        return keys_.Flags & HasLocalPref ? std::optional<LocalPref>(keys_.LocalPreference) : std::nullopt;
+    }
+
+    [[nodiscard]] bool atomic_aggregate() const {
+        return keys_.Flags & HasAtomicAggregate;
+    }
+
+    // nullptr if the AS_PATH is missing or malformed
+    [[nodiscard]] const std::shared_ptr<const AsPath> &as_path() const {
+        return asPath_;
+    }
+
+    [[nodiscard]] const std::optional<Aggregator> &aggregator() const {
+        if (!aggregator_.has_value()) {
+            const auto attribute = find(AggregatorAttribute);
+            auto aggregator = attribute ? parseAggregatorAttribute(attribute->Value, fourOctetAsns_) : std::nullopt;
+            // RFC 6793 4.2.3, AS4_AGGREGATOR only counts if the AGGREGATOR was rewritten to AS_TRANS
+            const auto as4Aggregator = find(As4AggregatorAttribute);
+            if (aggregator && aggregator->LocalAs == AS_TRANS && as4Aggregator && !fourOctetAsns_) {
+                if (const auto merged = parseAggregatorAttribute(as4Aggregator->Value, true)) {
+                    aggregator = merged;
+                }
+            }
+            aggregator_.emplace(aggregator);
+        }
+        return *aggregator_;
+    }
+
+    // The community accessors return nullptr if the attribute is missing or malformed
+    [[nodiscard]] const std::shared_ptr<const StandardCommunitySet> &communities() const {
+        return DecodeCommunities(communities_, CommunityAttribute, parseCommunitiesAttribute,
+                                 communityStores_->Standard);
+    }
+
+    [[nodiscard]] const std::shared_ptr<const ExtendedCommunitySet> &extended_communities() const {
+        return DecodeCommunities(extendedCommunities_, ExtendedCommunitiesAttribute, parseExtendedCommunitiesAttribute,
+                                 communityStores_->Extended);
+    }
+
+    [[nodiscard]] const std::shared_ptr<const LargeCommunitySet> &large_communities() const {
+        return DecodeCommunities(largeCommunities_, LargeCommunityAttribute, parseLargeCommunitiesAttribute,
+                                 communityStores_->Large);
+    }
+
+    // Where policy set actions intern the community sets they build
+    [[nodiscard]] CommunityStores &community_stores() const {
+        return *communityStores_;
+    }
+
+private:
+    template<typename T, typename Parser>
+    const std::shared_ptr<const CommunitySet<T>> &DecodeCommunities(
+            std::optional<std::shared_ptr<const CommunitySet<T>>> &cache, const PathAttributeType type, Parser parser,
+            CommunityStore<T> &store) const {
+        if (!cache.has_value()) {
+            const auto attribute = find(type);
+            auto values = attribute ? parser(attribute->Value) : std::nullopt;
+            cache.emplace(values && !values->empty() ? store.Intern(std::move(*values)) : nullptr);
+        }
+        return *cache;
+    }
+
+    // RFC 6793 4.2.3: an AS4_PATH from a 2-octet session is merged in, unless an AGGREGATOR without AS_TRANS says the
+    // path was aggregated by an OLD speaker after the AS4_PATH was attached
+    void ResolveAsPath(AsPathStore &asPathStore) {
+        const auto attribute = find(AsPathAttribute);
+        if (!attribute) {
+            return;
+        }
+        auto path = parseAsPathAttribute(attribute->Value, fourOctetAsns_);
+        if (!path) {
+            return;
+        }
+        const auto as4Path = fourOctetAsns_ ? nullptr : find(As4PathAttribute);
+        if (as4Path) {
+            const auto &aggregator = this->aggregator();
+            const auto decodedAs4Path = parseAsPathAttribute(as4Path->Value, true);
+            if ((!aggregator || aggregator->LocalAs == AS_TRANS) && decodedAs4Path) {
+                path = mergeAs4Path(*path, *decodedAs4Path);
+            }
+        }
+        asPath_ = asPathStore.Intern(*path);
+    }
+
+    void ExtractDecisionKeys() {
+        if (const auto attribute = find(OriginAttribute)) {
+            if (const auto origin = parseOriginAttribute(attribute->Value)) {
+                keys_.OriginType = *origin;
+                keys_.Flags |= HasOrigin;
+            }
+        }
+        if (const auto attribute = find(NextHopAttribute)) {
+            if (const auto nextHop = parseUint32Attribute(attribute->Value)) {
+                keys_.NextHopAddress = *nextHop;
+                keys_.Flags |= HasNextHop;
+            }
+        }
+        if (const auto attribute = find(MultiExitDiscriminatorAttribute)) {
+            if (const auto med = parseUint32Attribute(attribute->Value)) {
+                keys_.Med = *med;
+                keys_.Flags |= HasMultiExitDiscriminator;
+            }
+        }
+        if (const auto attribute = find(LocalPrefAttribute)) {
+            if (const auto localPref = parseUint32Attribute(attribute->Value)) {
+                keys_.LocalPreference = *localPref;
+                keys_.Flags |= HasLocalPref;
+            }
+        }
+        if (find(AtomicAggregateAttribute)) {
+            keys_.Flags |= HasAtomicAggregate;
+        }
+        if (asPath_) {
+            keys_.AsPathLength = asPath_->length();
+            keys_.FirstAs = asPath_->first_as();
+            keys_.Flags |= HasAsPath;
+        }
+    }
+
+    std::vector<PathAttribute> attributes_;
+    uint64_t hash_;
+    bool fourOctetAsns_;
+    std::array<uint8_t, INDEXED_ATTRIBUTE_TYPES> index_{};
+    DecisionKeys keys_;
+    std::shared_ptr<const AsPath> asPath_;
+
+    std::shared_ptr<CommunityStores> communityStores_;
+
+    mutable std::optional<std::optional<Aggregator>> aggregator_;
+    mutable std::optional<std::shared_ptr<const StandardCommunitySet>> communities_;
+    mutable std::optional<std::shared_ptr<const ExtendedCommunitySet>> extendedCommunities_;
+    mutable std::optional<std::shared_ptr<const LargeCommunitySet>> largeCommunities_;
+};
+
+// Deduplicates attribute sets so every path with byte-identical attributes shares one PathAttributeSet, and with it one
+// set of decoded values. The store only holds weak references, sets are freed once the last path using them goes away.
+// Attributes are only copied when they are new, into resource, so they can be parsed into a short lived arena.
+class PathAttributeStore {
+public:
+    explicit PathAttributeStore(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : resource_(resource) {}
+
+    // fourOctetAsns is whether the session the attributes arrived on negotiated the FourByteAsn capability
+    std::shared_ptr<const PathAttributeSet> Intern(const std::span<const PathAttribute> attributes,
+                                                   const bool fourOctetAsns = false) {
+        const auto hash = hashPathAttributes(attributes, fourOctetAsns);
+        auto [it, end] = sets_.equal_range(hash);
+
+        while (it != end) {
+            if (auto existing = it->second.lock()) {
+                if (existing->four_octet_asns() == fourOctetAsns &&
+                    std::equal(existing->attributes().begin(), existing->attributes().end(),
+                               attributes.begin(), attributes.end())) {
+                    return existing;
+                }
+                ++it;
+            } else {
+                it = sets_.erase(it);
+            }
+        }
+
+        std::vector<PathAttribute> copy;
+        copy.reserve(attributes.size());
+        for (const auto &attribute : attributes) {
+            copy.emplace_back(PathAttribute{attribute.Flags, attribute.Type,
+                                            std::pmr::vector<uint8_t>(attribute.Value.begin(), attribute.Value.end(),
+                                                                      resource_)});
+        }
+        auto set = std::allocate_shared<const PathAttributeSet>(std::pmr::polymorphic_allocator<PathAttributeSet>(resource_),
+                                                                std::move(copy), hash, fourOctetAsns, asPaths_,
+                                                                communities_);
+        sets_.emplace(hash, set);
+        return set;
+    }
+
+    // Drops bookkeeping for sets that are no longer referenced
+    void Purge() {
+        std::erase_if(sets_, [](const auto &entry) { return entry.second.expired(); });
+        asPaths_.Purge();
+        communities_->Purge();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return sets_.size();
+    }
+
+    [[nodiscard]] const AsPathStore &as_paths() const {
+        return asPaths_;
+    }
+
+    [[nodiscard]] const CommunityStores &community_stores() const {
+        return *communities_;
+    }
+
+    [[nodiscard]] std::pmr::memory_resource *resource() const {
+        return resource_;
+    }
+
+private:
+    std::pmr::memory_resource *resource_;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const PathAttributeSet>> sets_;
+    AsPathStore asPaths_;
+    std::shared_ptr<CommunityStores> communities_ = std::make_shared<CommunityStores>();
+};
+
+#endif //BGP_PATHATTRIBUTES_H
@@ -0,0 +1,430 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_POLICY_H
+#define BGP_POLICY_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include "Route.h"
+#include "PathAttributes.h"
+#include "AsPathRegex.h"
+#include "Communities.h"
+
+enum PolicyAction : uint8_t {
+    Deny = 0,
+    Permit = 1
+};
+
+std::string PolicyActionToString(const PolicyAction action) {
+    switch (action) {
+        case Deny:
+            return "Deny";
+        case Permit:
+            return "Permit";
+        default:
+            return "InvalidPolicyAction";
+    }
+}
+
+struct PrefixListEntry {
+    uint32_t Sequence;
+    PolicyAction Action;
+    uint32_t Prefix;
+    uint8_t Length;
+    // "ge" and "le", both equal to Length for an exact match
+    uint8_t MinLength;
+    uint8_t MaxLength;
+};
+
+// A prefix-list compiled into a binary trie over the entries' prefixes. Every node holds the entries anchored at it,
+// sorted by sequence number, so a lookup walks at most route.Length + 1 nodes no matter how many entries there are.
+class PrefixList {
+public:
+    PrefixList(std::string name, std::vector<PrefixListEntry> entries) : name_(std::move(name)) {
+        std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.Sequence < b.Sequence; });
+
+        nodes_.emplace_back();
+        std::vector<std::vector<Rule>> nodeRules(1);
+
+        for (const auto &entry : entries) {
+            const auto length = std::min<uint8_t>(entry.Length, 32);
+            uint32_t node = 0;
+            for (uint8_t depth = 0; depth < length; ++depth) {
+                const auto bit = entry.Prefix >> (31 - depth) & 0x01;
+                if (nodes_[node].Children[bit] == 0) {
+                    nodes_[node].Children[bit] = static_cast<uint32_t>(nodes_.size());
+                    nodes_.emplace_back();
+                    nodeRules.emplace_back();
+                }
+                node = nodes_[node].Children[bit];
+            }
+            nodeRules[node].emplace_back(Rule{entry.Sequence, std::max(entry.MinLength, length),
+                                              std::min<uint8_t>(entry.MaxLength, 32), entry.Action});
+        }
+
+        // Flatten the per-node rules into one array, entries were already sorted by sequence
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            nodes_[i].FirstRule = static_cast<uint32_t>(rules_.size());
+            nodes_[i].RuleCount = static_cast<uint32_t>(nodeRules[i].size());
+            rules_.insert(rules_.end(), nodeRules[i].begin(), nodeRules[i].end());
+        }
+        entries_ = std::move(entries);
+    }
+
+    // First matching entry by sequence number, or std::nullopt if nothing matches
+    [[nodiscard]] std::optional<PolicyAction> Match(const Route &route) const {
+        const Rule *best = nullptr;
+        uint32_t node = 0;
+        const auto length = std::min<uint8_t>(route.Length, 32);
+
+        for (uint8_t depth = 0;; ++depth) {
+            const auto &current = nodes_[node];
+            for (uint32_t i = current.FirstRule; i < current.FirstRule + current.RuleCount; ++i) {
+                const auto &rule = rules_[i];
+                if (best && rule.Sequence > best->Sequence) {
+                    break;
+                }
+                if (length >= rule.MinLength && length <= rule.MaxLength) {
+                    best = &rule;
+                    break;
+                }
+            }
+            if (depth == length) {
+                break;
+            }
+            node = current.Children[route.Prefix >> (31 - depth) & 0x01];
+            if (node == 0) {
+                break;
+            }
+        }
+
+        return best ? std::optional<PolicyAction>(best->Action) : std::nullopt;
+    }
+
+    // Prefix-lists deny anything they do not explicitly match
+    [[nodiscard]] PolicyAction Evaluate(const Route &route) const {
+        return Match(route).value_or(Deny);
+    }
+
+    [[nodiscard]] const std::string &name() const {
+        return name_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return entries_.size();
+    }
+
+    // As configured, sorted by sequence number, e.g. to push them to a peer as ORF entries
+    [[nodiscard]] const std::vector<PrefixListEntry> &entries() const {
+        return entries_;
+    }
+
+private:
+    struct Rule {
+        uint32_t Sequence;
+        uint8_t MinLength;
+        uint8_t MaxLength;
+        PolicyAction Action;
+    };
+
+    struct Node {
+        // 0 means no child, the root is never anyone's child
+        uint32_t Children[2] = {0, 0};
+        uint32_t FirstRule = 0;
+        uint32_t RuleCount = 0;
+    };
+
+    std::string name_;
+    std::vector<PrefixListEntry> entries_;
+    std::vector<Node> nodes_;
+    std::vector<Rule> rules_;
+};
+
+enum RouteMapMatchType : uint8_t {
+    MatchPrefixList,
+    MatchLocalPref,
+    MatchMultiExitDiscriminator,
+    MatchOrigin,
+    MatchNextHop,
+    MatchAsPathLengthAtMost,
+    MatchAsPathLengthAtLeast,
+    MatchFirstAs,
+    MatchOriginAs,
+    MatchAsPathContains,
+    MatchAsPathRegex,
+    MatchCommunity,
+    // Any community of the ASN in Value, i.e. "65000:*"
+    MatchCommunityAsn,
+    MatchExtendedCommunity,
+    MatchLargeCommunity,
+    // Any large community with Value as its global administrator, i.e. "65000:*:*"
+    MatchLargeCommunityGlobalAdministrator
+};
+
+enum RouteMapSetType : uint8_t {
+    SetLocalPref,
+    SetMultiExitDiscriminator,
+    SetOrigin,
+    SetNextHop,
+    // Value is the community to add or remove, SetCommunityNone strips all standard communities
+    SetCommunityAdditive,
+    SetCommunityDelete,
+    SetCommunityNone
+};
+
+struct RouteMapMatch {
+    RouteMapMatchType Type;
+    uint32_t Value = 0;
+    // Only for MatchPrefixList
+    std::shared_ptr<const PrefixList> List = nullptr;
+    // Only for MatchAsPathRegex
+    std::shared_ptr<const AsPathRegex> Regex = nullptr;
+    // Only for MatchExtendedCommunity and MatchLargeCommunity
+    ExtendedCommunity Extended = 0;
+    LargeCommunity Large{};
+};
+
+struct RouteMapSet {
+    RouteMapSetType Type;
+    uint32_t Value;
+};
+
+// Route-map clause as configured. A clause matches when all of its Matches do, an empty Matches matches everything.
+struct RouteMapClause {
+    uint32_t Sequence;
+    PolicyAction Action;
+    std::vector<RouteMapMatch> Matches;
+    std::vector<RouteMapSet> Sets;
+};
+
+// The route a policy runs against. Keys starts out as the attribute set's decision keys and collects the route-map's
+// set actions, the interned attributes themselves are never modified. Community set actions likewise leave their
+// result in Communities, which stays std::nullopt while the route's own communities are unchanged.
+struct PolicyRoute {
+    const Route &Prefix;
+    const PathAttributeSet &Attributes;
+    DecisionKeys Keys = Attributes.keys();
+    std::optional<std::shared_ptr<const StandardCommunitySet>> Communities = std::nullopt;
+
+    // The standard communities as of the set actions applied so far, nullptr if there are none
+    [[nodiscard]] const StandardCommunitySet *communities() const {
+        return Communities ? Communities->get() : Attributes.communities().get();
+    }
+};
+
+// A route-map compiled into a flat program. Each clause becomes a run of match instructions that jump to the next
+// clause on failure, followed by its set instructions and a terminal Permit/Deny, so evaluation is a single forward
+// pass over an array with no per-route allocation. Throws std::invalid_argument for a match that can never be
+// evaluated, e.g. a community ASN that does not fit in 16 bits.
+class RouteMap {
+public:
+    RouteMap(std::string name, std::vector<RouteMapClause> clauses) : name_(std::move(name)) {
+        std::sort(clauses.begin(), clauses.end(), [](const auto &a, const auto &b) { return a.Sequence < b.Sequence; });
+
+        for (const auto &clause : clauses) {
+            std::vector<size_t> failJumps;
+
+            for (const auto &match : clause.Matches) {
+                uint32_t operand = match.Value;
+                if (match.Type == MatchPrefixList) {
+                    operand = static_cast<uint32_t>(prefixLists_.size());
+                    prefixLists_.emplace_back(match.List);
+                } else if (match.Type == MatchAsPathRegex) {
+                    operand = static_cast<uint32_t>(regexes_.size());
+                    regexes_.emplace_back(match.Regex);
+                } else if (match.Type == MatchExtendedCommunity) {
+                    operand = static_cast<uint32_t>(extendedCommunities_.size());
+                    extendedCommunities_.emplace_back(match.Extended);
+                } else if (match.Type == MatchLargeCommunity) {
+                    operand = static_cast<uint32_t>(largeCommunities_.size());
+                    largeCommunities_.emplace_back(match.Large);
+                } else if (match.Type == MatchCommunityAsn && match.Value > UINT16_MAX) {
+                    // A standard community only has 16 bits for the ASN (RFC 1997)
+                    throw std::invalid_argument("route-map " + name_ + " " + std::to_string(clause.Sequence) +
+                                                ": community ASN " + std::to_string(match.Value) +
+                                                " does not fit in 16 bits");
+                }
+                failJumps.emplace_back(program_.size());
+                program_.emplace_back(Instruction{static_cast<Opcode>(match.Type), operand, 0});
+            }
+            for (const auto &set : clause.Sets) {
+                program_.emplace_back(Instruction{static_cast<Opcode>(OpSetLocalPref + static_cast<uint8_t>(set.Type)), set.Value, 0});
+            }
+            program_.emplace_back(Instruction{clause.Action == Permit ? OpPermit : OpDeny, 0, 0});
+
+            for (const auto jump : failJumps) {
+                program_[jump].OnFail = static_cast<uint32_t>(program_.size());
+            }
+        }
+
+        // Route-maps deny anything no clause matched
+        program_.emplace_back(Instruction{OpDeny, 0, 0});
+    }
+
+    // Runs the program against route, applying the set actions of the matching clause to route.Keys and
+    // route.Communities
+    [[nodiscard]] PolicyAction Evaluate(PolicyRoute &route) const {
+        uint32_t pc = 0;
+
+        while (true) {
+            const auto &instruction = program_[pc];
+            bool matched = true;
+
+            switch (instruction.Code) {
+                case OpMatchPrefixList:
+                    matched = prefixLists_[instruction.Operand]->Evaluate(route.Prefix) == Permit;
+                    break;
+                case OpMatchLocalPref:
+                    matched = route.Keys.LocalPreference == instruction.Operand;
+                    break;
+                case OpMatchMultiExitDiscriminator:
+                    matched = route.Keys.Med == instruction.Operand;
+                    break;
+                case OpMatchOrigin:
+                    matched = route.Keys.OriginType == instruction.Operand;
+                    break;
+                case OpMatchNextHop:
+                    matched = route.Keys.NextHopAddress == instruction.Operand;
+                    break;
+                case OpMatchAsPathLengthAtMost:
+                    matched = route.Keys.AsPathLength <= instruction.Operand;
+                    break;
+                case OpMatchAsPathLengthAtLeast:
+                    matched = route.Keys.AsPathLength >= instruction.Operand;
+                    break;
+                case OpMatchFirstAs:
+                    matched = route.Keys.FirstAs == instruction.Operand;
+                    break;
+                case OpMatchOriginAs:
+                    matched = route.Attributes.as_path() && route.Attributes.as_path()->origin_as() == instruction.Operand;
+                    break;
+                case OpMatchAsPathContains:
+                    matched = route.Attributes.as_path() && route.Attributes.as_path()->Contains(instruction.Operand);
+                    break;
+                case OpMatchAsPathRegex:
+                    matched = route.Attributes.as_path() && regexes_[instruction.Operand]->Matches(*route.Attributes.as_path());
+                    break;
+                case OpMatchCommunity: {
+                    const auto communities = route.communities();
+                    matched = communities && communities->Contains(instruction.Operand);
+                    break;
+                }
+                case OpMatchCommunityAsn: {
+                    const auto communities = route.communities();
+                    matched = communities && communities->ContainsInRange(instruction.Operand << 16,
+                                                                          instruction.Operand << 16 | 0xFFFF);
+                    break;
+                }
+                case OpMatchExtendedCommunity: {
+                    const auto &communities = route.Attributes.extended_communities();
+                    matched = communities && communities->Contains(extendedCommunities_[instruction.Operand]);
+                    break;
+                }
+                case OpMatchLargeCommunity: {
+                    const auto &communities = route.Attributes.large_communities();
+                    matched = communities && communities->Contains(largeCommunities_[instruction.Operand]);
+                    break;
+                }
+                case OpMatchLargeCommunityGlobalAdministrator: {
+                    const auto &communities = route.Attributes.large_communities();
+                    matched = communities && communities->ContainsInRange({instruction.Operand, 0, 0},
+                                                                          {instruction.Operand, UINT32_MAX, UINT32_MAX});
+                    break;
+                }
+                case OpSetLocalPref:
+                    route.Keys.LocalPreference = instruction.Operand;
+                    route.Keys.Flags |= HasLocalPref;
+                    break;
+                case OpSetMultiExitDiscriminator:
+                    route.Keys.Med = instruction.Operand;
+                    route.Keys.Flags |= HasMultiExitDiscriminator;
+                    break;
+                case OpSetOrigin:
+                    route.Keys.OriginType = static_cast<Origin>(instruction.Operand);
+                    route.Keys.Flags |= HasOrigin;
+                    break;
+                case OpSetNextHop:
+                    route.Keys.NextHopAddress = instruction.Operand;
+                    route.Keys.Flags |= HasNextHop;
+                    break;
+                case OpSetCommunityAdditive: {
+                    const Community community = instruction.Operand;
+                    route.Communities = route.Attributes.community_stores().Standard.Add(route.communities(), {&community, 1});
+                    break;
+                }
+                case OpSetCommunityDelete: {
+                    const Community community = instruction.Operand;
+                    route.Communities = route.Attributes.community_stores().Standard.Remove(route.communities(), {&community, 1});
+                    break;
+                }
+                case OpSetCommunityNone:
+                    route.Communities = nullptr;
+                    break;
+                case OpPermit:
+                    return Permit;
+                case OpDeny:
+                    return Deny;
+            }
+
+            pc = matched ? pc + 1 : instruction.OnFail;
+        }
+    }
+
+    [[nodiscard]] const std::string &name() const {
+        return name_;
+    }
+
+private:
+    // The match opcodes mirror RouteMapMatchType, the set opcodes RouteMapSetType
+    enum Opcode : uint8_t {
+        OpMatchPrefixList = MatchPrefixList,
+        OpMatchLocalPref = MatchLocalPref,
+        OpMatchMultiExitDiscriminator = MatchMultiExitDiscriminator,
+        OpMatchOrigin = MatchOrigin,
+        OpMatchNextHop = MatchNextHop,
+        OpMatchAsPathLengthAtMost = MatchAsPathLengthAtMost,
+        OpMatchAsPathLengthAtLeast = MatchAsPathLengthAtLeast,
+        OpMatchFirstAs = MatchFirstAs,
+        OpMatchOriginAs = MatchOriginAs,
+        OpMatchAsPathContains = MatchAsPathContains,
+        OpMatchAsPathRegex = MatchAsPathRegex,
+        OpMatchCommunity = MatchCommunity,
+        OpMatchCommunityAsn = MatchCommunityAsn,
+        OpMatchExtendedCommunity = MatchExtendedCommunity,
+        OpMatchLargeCommunity = MatchLargeCommunity,
+        OpMatchLargeCommunityGlobalAdministrator = MatchLargeCommunityGlobalAdministrator,
+        OpSetLocalPref,
+        OpSetMultiExitDiscriminator,
+        OpSetOrigin,
+        OpSetNextHop,
+        OpSetCommunityAdditive,
+        OpSetCommunityDelete,
+        OpSetCommunityNone,
+        OpPermit,
+        OpDeny
+    };
+
+    struct Instruction {
+        Opcode Code;
+        uint32_t Operand;
+        // Where a failed match continues, i.e. the first instruction of the next clause
+        uint32_t OnFail;
+    };
+
+    std::string name_;
+    std::vector<Instruction> program_;
+    std::vector<std::shared_ptr<const PrefixList>> prefixLists_;
+    std::vector<std::shared_ptr<const AsPathRegex>> regexes_;
+    std::vector<ExtendedCommunity> extendedCommunities_;
+    std::vector<LargeCommunity> largeCommunities_;
+};
+
+#endif //BGP_POLICY_H
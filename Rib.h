@@ -0,0 +1,769 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_RIB_H
+#define BGP_RIB_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <unordered_set>
+#include <memory_resource>
+#include <atomic>
+#include "Route.h"
+#include "PathAttributes.h"
+#include "NextHopTable.h"
+
+typedef uint32_t PeerId;
+
+// Packs a prefix and its length into a single key. TODO: [9]
+constexpr uint64_t routeKey(const Route &route) {
+    return static_cast<uint64_t>(route.Prefix) << 8 | route.Length;
+}
+
+constexpr Route routeFromKey(const uint64_t key) {
+    return Route{static_cast<uint8_t>(key & 0xFF), static_cast<uint32_t>(key >> 8)};
+}
+
+// What the decision process needs to know about a peer beyond the path attributes
+struct RibPeer {
+    PeerId Id;
+    uint32_t Address;
+    uint32_t BgpIdentifier;
+    bool External;
+};
+
+// A path as installed in the Loc-RIB: the interned attributes as received, and the decision keys after import policy
+struct RibPath {
+    PeerId Peer = 0;
+    std::shared_ptr<const PathAttributeSet> Attributes;
+    DecisionKeys Keys;
+};
+
+// Every candidate path for a prefix, shared by all prefixes that have exactly the same candidates. This is the unit the
+// decision process works on: when a next hop goes away, only the path lists that use it pick a new best path, no
+// matter how many prefixes point at them. Paths are sorted by peer, preference() orders them by RFC 4271 9.1.2.2.
+class PathList {
+public:
+    static constexpr uint32_t NO_PATH = UINT32_MAX;
+
+    PathList(std::vector<RibPath> paths, std::vector<std::shared_ptr<const NextHopEntry>> nextHops, const uint64_t hash,
+             const uint64_t id) : paths_(std::move(paths)),
+                                  nextHops_(std::move(nextHops)),
+                                  hash_(hash),
+                                  id_(id) {}
+
+    [[nodiscard]] std::span<const RibPath> paths() const {
+        return paths_;
+    }
+
+    // The shared next hop of paths()[index]
+    [[nodiscard]] const std::shared_ptr<const NextHopEntry> &next_hop(const size_t index) const {
+        return nextHops_[index];
+    }
+
+    // Indices into paths(), most preferred first, whether or not their next hops are reachable. The first reachable
+    // one is the best path, the ones after it are its backups.
+    [[nodiscard]] std::span<const uint32_t> preference() const {
+        return order_;
+    }
+
+    // nullptr if no path has a reachable next hop
+    [[nodiscard]] const RibPath *best() const {
+        return best_ == NO_PATH ? nullptr : &paths_[best_];
+    }
+
+    [[nodiscard]] uint64_t hash() const {
+        return hash_;
+    }
+
+    // Unique for the lifetime of the LocRib that created this path list
+    [[nodiscard]] uint64_t id() const {
+        return id_;
+    }
+
+private:
+    friend class LocRib;
+
+    std::vector<RibPath> paths_;
+    std::vector<std::shared_ptr<const NextHopEntry>> nextHops_;
+    std::vector<uint32_t> order_;
+    uint32_t best_ = NO_PATH;
+    uint64_t hash_;
+    uint64_t id_;
+    // Keys of the prefixes pointing at this list, in no particular order. LocRib keeps them so a next hop event reaches
+    // the prefixes of the lists it affects without walking the whole table.
+    std::vector<uint64_t> prefixes_;
+};
+
+// Emitted whenever a prefix moves to a different path list. Best is std::nullopt if the prefix is no longer reachable,
+// Paths is nullptr if it has no candidate paths left.
+struct RibChange {
+    Route Prefix;
+    std::optional<RibPath> Best;
+    std::shared_ptr<const PathList> Paths;
+    bool BestChanged = true;
+};
+
+// The routes one peer advertised, before import policy. Attribute sets are interned, so this is one pointer per prefix.
+// Table nodes come from resource, normally the RIB's pool (see Allocators.h).
+//
+// Every route carries the generation it was last announced in. MarkStale() starts a new generation, which makes every
+// route present stale in O(1), and a route becomes fresh again when it is re-announced. That is how graceful restart
+// (see GracefulRestart.h) keeps a restarting peer's routes without touching each of them, and SweepStale() removes the
+// ones that were not re-announced a batch at a time.
+class AdjRibIn {
+public:
+    explicit AdjRibIn(const PeerId peer, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : peer_(peer),
+              routes_(resource) {}
+
+    // Returns false if the route was already present with exactly these attributes. That includes a stale route being
+    // re-announced unchanged, which only makes it fresh again.
+    bool Update(const Route &route, std::shared_ptr<const PathAttributeSet> attributes) {
+        auto [it, inserted] = routes_.try_emplace(routeKey(route), Entry{attributes, generation_});
+        Increment(announcements_, 1);
+        if (inserted) {
+            ++fresh_;
+            Increment(prefixCount_, 1);
+            return true;
+        }
+        const bool wasStale = it->second.Generation != generation_;
+        if (wasStale) {
+            it->second.Generation = generation_;
+            ++fresh_;
+        }
+        if (it->second.Attributes == attributes) {
+            // Attribute sets are interned, so this is the whole comparison. A stale route coming back is expected
+            // rather than a duplicate.
+            if (!wasStale) {
+                Increment(duplicates_, 1);
+            }
+            return false;
+        }
+        it->second.Attributes = std::move(attributes);
+        return true;
+    }
+
+    // Returns false if the route was not present
+    bool Withdraw(const Route &route) {
+        const auto it = routes_.find(routeKey(route));
+        if (it == routes_.end()) {
+            return false;
+        }
+        if (it->second.Generation == generation_) {
+            --fresh_;
+        }
+        routes_.erase(it);
+        Increment(prefixCount_, -1);
+        return true;
+    }
+
+    [[nodiscard]] const std::shared_ptr<const PathAttributeSet> *Find(const Route &route) const {
+        const auto it = routes_.find(routeKey(route));
+        return it == routes_.end() ? nullptr : &it->second.Attributes;
+    }
+
+    // function(const Route &, const std::shared_ptr<const PathAttributeSet> &)
+    template<typename Function>
+    void ForEach(Function &&function) const {
+        for (const auto &[key, entry] : routes_) {
+            function(routeFromKey(key), entry.Attributes);
+        }
+    }
+
+    // For walking the table a bucket at a time with ForEachInBucket(). It changes when the table grows, which moves
+    // routes between buckets.
+    [[nodiscard]] size_t bucket_count() const {
+        return routes_.bucket_count();
+    }
+
+    // function(const Route &, const std::shared_ptr<const PathAttributeSet> &) for the routes in one hash bucket.
+    // Returns how many there were.
+    template<typename Function>
+    size_t ForEachInBucket(const size_t bucket, Function &&function) const {
+        size_t visited = 0;
+        for (auto it = routes_.begin(bucket); it != routes_.end(bucket); ++it, ++visited) {
+            function(routeFromKey(it->first), it->second.Attributes);
+        }
+        return visited;
+    }
+
+    // Makes every route present stale until it is announced again
+    void MarkStale() {
+        ++generation_;
+        fresh_ = 0;
+    }
+
+    [[nodiscard]] bool IsStale(const Route &route) const {
+        const auto it = routes_.find(routeKey(route));
+        return it != routes_.end() && it->second.Generation != generation_;
+    }
+
+    // Looks at up to limit routes and removes the stale ones, calling function(const Route &) for each after it is gone.
+    // Picks up where the last call left off, so a full table can be swept in small batches between messages. Returns
+    // the number removed.
+    template<typename Function>
+    size_t SweepStale(const size_t limit, Function &&function) {
+        size_t visited = 0;
+        size_t swept = 0;
+        std::vector<uint64_t> keys;
+        while (visited < limit && stale_count() > 0) {
+            // Growing the table moves routes between buckets, start over rather than skip some
+            if (sweepBucket_ >= routes_.bucket_count() || routes_.bucket_count() != sweepBucketCount_) {
+                sweepBucket_ = 0;
+                sweepBucketCount_ = routes_.bucket_count();
+            }
+            keys.clear();
+            for (auto it = routes_.begin(sweepBucket_); it != routes_.end(sweepBucket_); ++it) {
+                if (it->second.Generation != generation_) {
+                    keys.emplace_back(it->first);
+                }
+            }
+            visited += routes_.bucket_size(sweepBucket_) + 1;
+            ++sweepBucket_;
+            for (const auto key : keys) {
+                routes_.erase(key);
+                function(routeFromKey(key));
+            }
+            Increment(prefixCount_, -static_cast<int32_t>(keys.size()));
+            swept += keys.size();
+        }
+        return swept;
+    }
+
+    void Clear() {
+        routes_.clear();
+        fresh_ = 0;
+        prefixCount_.store(0, std::memory_order_relaxed);
+    }
+
+    void Reserve(const size_t routes) {
+        routes_.reserve(routes);
+    }
+
+    // Same as size(), but safe to read from any thread while the session is updating the table, e.g. for maximum-prefix
+    // limits and counters
+    [[nodiscard]] uint32_t prefix_count() const {
+        return prefixCount_.load(std::memory_order_relaxed);
+    }
+
+    // Every Update(), and the ones dropped because the route was already there with the same attributes, so never got
+    // to best path. Readable from any thread, like prefix_count().
+    [[nodiscard]] uint64_t announcement_count() const {
+        return announcements_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t duplicate_count() const {
+        return duplicates_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] PeerId peer() const {
+        return peer_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return routes_.size();
+    }
+
+    [[nodiscard]] size_t stale_count() const {
+        return routes_.size() - fresh_;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const PathAttributeSet> Attributes;
+        uint32_t Generation;
+    };
+
+    PeerId peer_;
+    std::pmr::unordered_map<uint64_t, Entry> routes_;
+    uint32_t generation_ = 0;
+    // Routes announced in the current generation
+    size_t fresh_ = 0;
+    size_t sweepBucket_ = 0;
+    size_t sweepBucketCount_ = 0;
+    // Only routes that are added or removed change the prefix count, never one replacing another (an implicit
+    // withdraw)
+    std::atomic<uint32_t> prefixCount_ = 0;
+    std::atomic<uint64_t> announcements_ = 0;
+    std::atomic<uint64_t> duplicates_ = 0;
+
+    // Only the session that owns the table writes the counters, so a plain load and store is enough, there is no
+    // locked read-modify-write
+    template<typename T>
+    static void Increment(std::atomic<T> &counter, const int32_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+};
+
+// The routes advertised to one peer, after export policy. Keeping them means a ROUTE-REFRESH from the peer is answered
+// by re-sending what is here (see RouteRefresh.h), without running the Loc-RIB through export policy again.
+class AdjRibOut {
+public:
+    explicit AdjRibOut(const PeerId peer, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : peer_(peer),
+              routes_(resource) {}
+
+    // Returns false if the route was already advertised with exactly these attributes
+    bool Update(const Route &route, std::shared_ptr<const PathAttributeSet> attributes) {
+        auto [it, inserted] = routes_.try_emplace(routeKey(route), attributes);
+        if (!inserted) {
+            if (it->second == attributes) {
+                return false;
+            }
+            it->second = std::move(attributes);
+        }
+        return true;
+    }
+
+    // Returns false if the route was not advertised
+    bool Withdraw(const Route &route) {
+        return routes_.erase(routeKey(route)) > 0;
+    }
+
+    [[nodiscard]] const std::shared_ptr<const PathAttributeSet> *Find(const Route &route) const {
+        const auto it = routes_.find(routeKey(route));
+        return it == routes_.end() ? nullptr : &it->second;
+    }
+
+    // function(const Route &, const std::shared_ptr<const PathAttributeSet> &)
+    template<typename Function>
+    void ForEach(Function &&function) const {
+        for (const auto &[key, attributes] : routes_) {
+            function(routeFromKey(key), attributes);
+        }
+    }
+
+    void Clear() {
+        routes_.clear();
+    }
+
+    [[nodiscard]] PeerId peer() const {
+        return peer_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return routes_.size();
+    }
+
+private:
+    PeerId peer_;
+    std::pmr::unordered_map<uint64_t, std::shared_ptr<const PathAttributeSet>> routes_;
+};
+
+// The Loc-RIB: every prefix points at an interned PathList holding its candidate paths. Prefix level changes are queued
+// and handed out in batches by TakeChanges(), which is what the FIB and the Adj-RIBs-Out consume. Next hop
+// reachability changes are handled per path list, so they cost O(path lists using the next hop) rather than
+// O(prefixes) until TakeChanges() turns them into prefix changes, by which time the FIB has already converged through
+// Fib::Refresh(). Prefix entries and path lists come from resource, normally
+// the RIB's pool (see Allocators.h).
+class LocRib {
+public:
+    explicit LocRib(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : resource_(resource),
+              entries_(resource) {}
+
+    PeerId AddPeer(const uint32_t address, const uint32_t bgpIdentifier, const bool external) {
+        const auto id = static_cast<PeerId>(peers_.size());
+        peers_.emplace_back(RibPeer{id, address, bgpIdentifier, external});
+        return id;
+    }
+
+    [[nodiscard]] const RibPeer &peer(const PeerId id) const {
+        return peers_[id];
+    }
+
+    [[nodiscard]] size_t peer_count() const {
+        return peers_.size();
+    }
+
+    // Sizes the prefix table for routes prefixes up front, e.g. before loading a full table
+    void Reserve(const size_t routes) {
+        entries_.reserve(routes);
+    }
+
+    // Adds or replaces path.Peer's path for route. Returns true if the best path changed.
+    bool Update(const Route &route, RibPath path) {
+        const auto key = routeKey(route);
+        auto &entry = entries_[key];
+        std::vector<RibPath> paths;
+        if (entry.List) {
+            paths.reserve(entry.List->paths_.size() + 1);
+            paths.assign(entry.List->paths_.begin(), entry.List->paths_.end());
+        }
+
+        const auto existing = std::lower_bound(paths.begin(), paths.end(), path.Peer,
+                                               [](const auto &other, const PeerId peer) { return other.Peer < peer; });
+        if (existing != paths.end() && existing->Peer == path.Peer) {
+            if (samePath(&*existing, &path)) {
+                return false;
+            }
+            *existing = std::move(path);
+        } else {
+            paths.insert(existing, std::move(path));
+            ++pathCount_;
+        }
+
+        const auto previous = Attach(key, entry, InternPathList(std::move(paths)));
+        return QueueChange(route, previous.get(), entry.List);
+    }
+
+    // Replaces every path for route at once, which is how a snapshot is loaded without building each path list one
+    // path at a time. Returns true if the best path changed.
+    bool Replace(const Route &route, std::vector<RibPath> paths) {
+        std::sort(paths.begin(), paths.end(), [](const auto &a, const auto &b) { return a.Peer < b.Peer; });
+        const auto key = routeKey(route);
+        auto &entry = entries_[key];
+        pathCount_ = pathCount_ - (entry.List ? entry.List->paths_.size() : 0) + paths.size();
+        if (paths.empty()) {
+            const auto previous = Detach(key, entry);
+            entries_.erase(key);
+            return QueueChange(route, previous.get(), nullptr);
+        }
+        const auto previous = Attach(key, entry, InternPathList(std::move(paths)));
+        return QueueChange(route, previous.get(), entry.List);
+    }
+
+    // Removes peer's path for route. Returns true if the best path changed.
+    bool Withdraw(const PeerId peer, const Route &route) {
+        const auto key = routeKey(route);
+        const auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return false;
+        }
+        const auto &current = it->second.List->paths_;
+        const auto existing = std::lower_bound(current.begin(), current.end(), peer,
+                                               [](const auto &other, const PeerId peer) { return other.Peer < peer; });
+        if (existing == current.end() || existing->Peer != peer) {
+            return false;
+        }
+        --pathCount_;
+
+        if (current.size() == 1) {
+            const auto previous = Detach(key, it->second);
+            entries_.erase(it);
+            return QueueChange(route, previous.get(), nullptr);
+        }
+
+        std::vector<RibPath> paths;
+        paths.reserve(current.size() - 1);
+        paths.insert(paths.end(), current.begin(), existing);
+        paths.insert(paths.end(), std::next(existing), current.end());
+        const auto previous = Attach(key, it->second, InternPathList(std::move(paths)));
+        return QueueChange(route, previous.get(), it->second.List);
+    }
+
+    // Applies a new resolution for a next hop. Path lists using it pick a new best path, which takes O(path lists). The
+    // lists whose best path changed are remembered, and TakeChanges() hands out a change for every prefix on them. A
+    // metric change can also reorder the backups, which changes what gets forwarded to, so the prefixes on lists that
+    // were only reordered are queued straight away. Returns the number of path lists whose best path changed.
+    size_t SetNextHopResolution(const NextHop address, const NextHopResolution &resolution) {
+        const auto entry = nextHops_.Find(address);
+        if (!entry) {
+            return 0;
+        }
+        // An unreachable next hop keeps its last metric. Nothing is forwarded via it either way, and reordering every
+        // path list using it on the way down, and again on the way back up, would queue their prefixes for nothing.
+        auto applied = resolution;
+        if (!applied.Reachable) {
+            applied.Metric = entry->metric();
+        }
+        const bool reorder = entry->metric() != applied.Metric;
+        if (!nextHops_.SetResolution(address, applied)) {
+            return 0;
+        }
+
+        size_t changed = 0;
+        auto &lists = dependents_[address];
+        std::erase_if(lists, [](const auto &list) { return list.expired(); });
+        for (const auto &weakList : lists) {
+            const auto list = weakList.lock();
+            const auto previousBest = list->best_;
+            const auto previousOrder = reorder ? list->order_ : std::vector<uint32_t>();
+            if (reorder) {
+                SelectBest(*list);
+            } else {
+                PickBest(*list);
+            }
+            if (list->best_ != previousBest) {
+                pathListChanges_.emplace_back(list);
+                ++changed;
+            } else if (reorder && list->order_ != previousOrder) {
+                QueuePrefixes(list, false);
+            }
+        }
+        return changed;
+    }
+
+    [[nodiscard]] const RibPath *Best(const Route &route) const {
+        const auto it = entries_.find(routeKey(route));
+        return it == entries_.end() ? nullptr : it->second.List->best();
+    }
+
+    [[nodiscard]] const PathList *Find(const Route &route) const {
+        const auto it = entries_.find(routeKey(route));
+        return it == entries_.end() ? nullptr : it->second.List.get();
+    }
+
+    // function(const Route &, const PathList &)
+    template<typename Function>
+    void ForEach(Function &&function) const {
+        for (const auto &[key, entry] : entries_) {
+            function(routeFromKey(key), *entry.List);
+        }
+    }
+
+    // For walking the table a bucket at a time with ForEachInBucket(). It changes when the table grows, which moves
+    // prefixes between buckets.
+    [[nodiscard]] size_t bucket_count() const {
+        return entries_.bucket_count();
+    }
+
+    // function(const Route &, const PathList &) for the prefixes in one hash bucket. Returns how many there were.
+    template<typename Function>
+    size_t ForEachInBucket(const size_t bucket, Function &&function) const {
+        size_t visited = 0;
+        for (auto it = entries_.begin(bucket); it != entries_.end(bucket); ++it, ++visited) {
+            function(routeFromKey(it->first), *it->second.List);
+        }
+        return visited;
+    }
+
+    // function(const Route &, const RibPath &best), prefixes without a reachable path are skipped
+    template<typename Function>
+    void ForEachBest(Function &&function) const {
+        for (const auto &[key, entry] : entries_) {
+            if (const auto best = entry.List->best()) {
+                function(routeFromKey(key), *best);
+            }
+        }
+    }
+
+    // Hands out the prefix changes queued since the last call, including one for every prefix on a path list whose best
+    // path changed with a next hop's resolution. A prefix can appear more than once, the last change for it is the
+    // current state.
+    std::vector<RibChange> TakeChanges() {
+        std::sort(pathListChanges_.begin(), pathListChanges_.end());
+        pathListChanges_.erase(std::unique(pathListChanges_.begin(), pathListChanges_.end()), pathListChanges_.end());
+        for (const auto &list : pathListChanges_) {
+            QueuePrefixes(list, true);
+        }
+        pathListChanges_.clear();
+        return std::exchange(changes_, {});
+    }
+
+    // RFC 4271 9.1.2.2, reachability aside. Returns < 0 if a is preferred over b.
+    [[nodiscard]] int ComparePaths(const RibPath &a, const NextHopEntry &nextHopA, const RibPath &b,
+                                   const NextHopEntry &nextHopB) const {
+        if (const auto result = compareDecisionKeys(a.Keys, b.Keys); result != 0) {
+            return result;
+        }
+        const auto &peerA = peers_[a.Peer];
+        const auto &peerB = peers_[b.Peer];
+        // d) eBGP over iBGP
+        if (peerA.External != peerB.External) {
+            return peerA.External ? -1 : 1;
+        }
+        // e) lowest IGP cost to the next hop
+        if (nextHopA.metric() != nextHopB.metric()) {
+            return nextHopA.metric() < nextHopB.metric() ? -1 : 1;
+        }
+        // f) lowest BGP Identifier
+        if (peerA.BgpIdentifier != peerB.BgpIdentifier) {
+            return peerA.BgpIdentifier < peerB.BgpIdentifier ? -1 : 1;
+        }
+        // g) lowest peer address
+        if (peerA.Address != peerB.Address) {
+            return peerA.Address < peerB.Address ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // How next hops of paths added from now on are resolved, see NextHopResolver
+    void SetNextHopResolver(NextHopTable::Resolver resolver) {
+        nextHops_.SetResolver(std::move(resolver));
+    }
+
+    [[nodiscard]] const NextHopTable &next_hops() const {
+        return nextHops_;
+    }
+
+    // Drops the bookkeeping for path lists and next hops nothing uses anymore
+    void Purge() {
+        std::erase_if(pathLists_, [](const auto &entry) { return entry.second.expired(); });
+        for (auto it = dependents_.begin(); it != dependents_.end();) {
+            std::erase_if(it->second, [](const auto &list) { return list.expired(); });
+            it = it->second.empty() ? dependents_.erase(it) : std::next(it);
+        }
+        nextHops_.Purge();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return entries_.size();
+    }
+
+    [[nodiscard]] size_t path_count() const {
+        return pathCount_;
+    }
+
+    [[nodiscard]] size_t path_list_count() const {
+        return pathLists_.size();
+    }
+
+private:
+    struct PrefixEntry {
+        std::shared_ptr<PathList> List;
+        // Where the prefix's key sits in List->prefixes_
+        uint32_t Slot = 0;
+    };
+
+    // Moves the prefix at key onto list. Returns the list it was on, nullptr if it is new.
+    std::shared_ptr<PathList> Attach(const uint64_t key, PrefixEntry &entry, std::shared_ptr<PathList> list) {
+        auto previous = Detach(key, entry);
+        entry.Slot = static_cast<uint32_t>(list->prefixes_.size());
+        list->prefixes_.emplace_back(key);
+        entry.List = std::move(list);
+        return previous;
+    }
+
+    // Takes the prefix at key off its list, by moving the list's last prefix into its slot. Returns the list.
+    std::shared_ptr<PathList> Detach(const uint64_t key, PrefixEntry &entry) {
+        if (!entry.List) {
+            return nullptr;
+        }
+        auto &prefixes = entry.List->prefixes_;
+        const auto last = prefixes.back();
+        if (last != key) {
+            prefixes[entry.Slot] = last;
+            entries_.find(last)->second.Slot = entry.Slot;
+        }
+        prefixes.pop_back();
+        return std::move(entry.List);
+    }
+
+    static bool samePath(const RibPath *a, const RibPath *b) {
+        if (!a || !b) {
+            return a == b;
+        }
+        return a->Peer == b->Peer && a->Attributes == b->Attributes && a->Keys == b->Keys;
+    }
+
+    static uint64_t hashPaths(const std::vector<RibPath> &paths) {
+        uint64_t hash = hashBytes(nullptr, 0);
+        for (const auto &path : paths) {
+            const uint32_t fields[] = {path.Peer, path.Keys.LocalPreference, path.Keys.Med, path.Keys.NextHopAddress,
+                                       path.Keys.FirstAs, path.Keys.AsPathLength,
+                                       static_cast<uint32_t>(path.Keys.OriginType) << 8 | path.Keys.Flags};
+            hash = hashBytes(reinterpret_cast<const uint8_t *>(fields), sizeof(fields), hash);
+            const auto attributesHash = path.Attributes ? path.Attributes->hash() : 0;
+            hash = hashBytes(reinterpret_cast<const uint8_t *>(&attributesHash), sizeof(attributesHash), hash);
+        }
+        return hash;
+    }
+
+    std::shared_ptr<PathList> InternPathList(std::vector<RibPath> paths) {
+        const auto hash = hashPaths(paths);
+        auto [it, end] = pathLists_.equal_range(hash);
+
+        while (it != end) {
+            if (auto existing = it->second.lock()) {
+                if (std::equal(paths.begin(), paths.end(), existing->paths_.begin(), existing->paths_.end(),
+                               [](const auto &a, const auto &b) { return samePath(&a, &b); })) {
+                    return existing;
+                }
+                ++it;
+            } else {
+                it = pathLists_.erase(it);
+            }
+        }
+
+        std::vector<std::shared_ptr<const NextHopEntry>> nextHops;
+        nextHops.reserve(paths.size());
+        for (const auto &path : paths) {
+            nextHops.emplace_back(nextHops_.Acquire(path.Keys.NextHopAddress));
+        }
+
+        auto list = std::allocate_shared<PathList>(std::pmr::polymorphic_allocator<PathList>(resource_), std::move(paths),
+                                                   std::move(nextHops), hash, nextPathListId_++);
+        SelectBest(*list);
+        pathLists_.emplace(hash, list);
+
+        std::unordered_set<NextHop> registered;
+        for (const auto &nextHop : list->nextHops_) {
+            if (registered.insert(nextHop->address()).second) {
+                auto &lists = dependents_[nextHop->address()];
+                // Prune before growing, so churn does not pile up dead entries
+                if (lists.size() == lists.capacity()) {
+                    std::erase_if(lists, [](const auto &other) { return other.expired(); });
+                }
+                lists.emplace_back(list);
+            }
+        }
+        return list;
+    }
+
+    // Recomputes the preference order, then picks the best reachable path
+    void SelectBest(PathList &list) const {
+        list.order_.resize(list.paths_.size());
+        for (uint32_t i = 0; i < list.order_.size(); ++i) {
+            list.order_[i] = i;
+        }
+        std::stable_sort(list.order_.begin(), list.order_.end(), [&](const uint32_t a, const uint32_t b) {
+            return ComparePaths(list.paths_[a], *list.nextHops_[a], list.paths_[b], *list.nextHops_[b]) < 0;
+        });
+        PickBest(list);
+    }
+
+    static void PickBest(PathList &list) {
+        list.best_ = PathList::NO_PATH;
+        for (const auto index : list.order_) {
+            if (list.nextHops_[index]->reachable()) {
+                list.best_ = index;
+                break;
+            }
+        }
+    }
+
+    bool QueueChange(const Route &route, const PathList *previous, const std::shared_ptr<PathList> &current) {
+        if (previous == current.get()) {
+            return false;
+        }
+        const auto best = current ? current->best() : nullptr;
+        const bool bestChanged = !samePath(previous ? previous->best() : nullptr, best);
+        changes_.emplace_back(RibChange{route, best ? std::optional<RibPath>(*best) : std::nullopt, current, bestChanged});
+        return bestChanged;
+    }
+
+    // A change to the list's current state for every prefix on it
+    void QueuePrefixes(const std::shared_ptr<PathList> &list, const bool bestChanged) {
+        const auto best = list->best();
+        for (const auto key : list->prefixes_) {
+            changes_.emplace_back(RibChange{routeFromKey(key), best ? std::optional<RibPath>(*best) : std::nullopt,
+                                            list, bestChanged});
+        }
+    }
+
+    std::pmr::memory_resource *resource_;
+    std::vector<RibPeer> peers_;
+    std::pmr::unordered_map<uint64_t, PrefixEntry> entries_;
+    size_t pathCount_ = 0;
+    std::vector<RibChange> changes_;
+
+    NextHopTable nextHops_;
+    uint64_t nextPathListId_ = 1;
+    std::unordered_multimap<uint64_t, std::weak_ptr<PathList>> pathLists_;
+    // The path lists using each next hop
+    std::unordered_map<NextHop, std::vector<std::weak_ptr<PathList>>> dependents_;
+    // Path lists whose best path changed in place since the last TakeChanges()
+    std::vector<std::shared_ptr<PathList>> pathListChanges_;
+};
+
+#endif //BGP_RIB_H
@@ -0,0 +1,509 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_RIBSNAPSHOT_H
+#define BGP_RIBSNAPSHOT_H
+
+#include <cstdint>
+#include <ctime>
+#include <array>
+#include <string>
+#include <vector>
+#include <span>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include <unordered_map>
+#include <memory_resource>
+#include "Route.h"
+#include "PathAttributes.h"
+#include "BgpUpdateMessage.h"
+#include "Rib.h"
+#include "MappedFile.h"
+
+// The snapshot file format. Every section is an array of the fixed size records below, found through offsets in the
+// header rather than pointers, so the file works wherever it is mapped and is used in place. Byte order is the host's,
+// a snapshot is only meant to be read back by the machine that wrote it.
+constexpr std::array<char, 8> RIB_SNAPSHOT_MAGIC = {'B', 'G', 'P', 'R', 'I', 'B', 'S', 'N'};
+constexpr uint32_t RIB_SNAPSHOT_VERSION = 1;
+constexpr uint32_t RIB_SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+struct RibSnapshotHeader {
+    std::array<char, 8> Magic;
+    uint32_t Version;
+    uint32_t ByteOrder;
+    // Seconds since the epoch
+    uint64_t Created;
+    uint64_t PeerCount;
+    uint64_t AttributeSetCount;
+    uint64_t AttributeBytes;
+    uint64_t RouteCount;
+    uint64_t PathCount;
+    uint64_t AdjRibInRouteCount;
+    uint64_t PeersOffset;
+    uint64_t AttributeSetsOffset;
+    uint64_t AttributeDataOffset;
+    uint64_t RoutesOffset;
+    uint64_t PathsOffset;
+    uint64_t AdjRibInRoutesOffset;
+};
+
+// Indexed by the PeerId the peer had when the snapshot was written. Its Adj-RIB-In is AdjRibInRouteCount routes
+// starting at FirstAdjRibInRoute.
+struct SnapshotPeer {
+    uint32_t Address;
+    uint32_t BgpIdentifier;
+    uint32_t External;
+    uint32_t Reserved;
+    uint64_t FirstAdjRibInRoute;
+    uint64_t AdjRibInRouteCount;
+};
+
+// Path attributes as they appear in an UPDATE, Length bytes at Offset in the attribute data
+struct SnapshotAttributeSet {
+    uint64_t Offset;
+    uint32_t Length;
+    uint32_t FourOctetAsns;
+};
+
+// A Loc-RIB prefix, sorted by Key (see routeKey()). Its candidate paths are PathCount paths starting at FirstPath,
+// sorted by peer, and Best indexes the best one among them.
+struct SnapshotRoute {
+    static constexpr uint32_t NO_PATH = UINT32_MAX;
+
+    uint64_t Key;
+    uint64_t FirstPath;
+    uint32_t PathCount;
+    uint32_t Best;
+};
+
+// A Loc-RIB path: the attribute set as received, and the decision keys after import policy
+struct SnapshotPath {
+    uint32_t Peer;
+    uint32_t AttributeSet;
+    LocalPref LocalPreference;
+    MultiExitDiscriminator Med;
+    NextHop NextHopAddress;
+    uint32_t FirstAs;
+    uint16_t AsPathLength;
+    uint8_t OriginType;
+    uint8_t Flags;
+
+    [[nodiscard]] DecisionKeys keys() const {
+        return {LocalPreference, Med, NextHopAddress, FirstAs, AsPathLength, static_cast<Origin>(OriginType), Flags};
+    }
+};
+
+// A route in a peer's Adj-RIB-In, sorted by Key per peer
+struct SnapshotAdjRibInRoute {
+    uint64_t Key;
+    uint32_t AttributeSet;
+    uint32_t Reserved;
+};
+
+static_assert(sizeof(SnapshotPeer) == 32 && sizeof(SnapshotAttributeSet) == 16 && sizeof(SnapshotRoute) == 24 &&
+              sizeof(SnapshotPath) == 28 && sizeof(SnapshotAdjRibInRoute) == 16, "RIB snapshot records must not change size");
+
+// What a snapshot holds, copied out of the RIBs but not yet sorted or written. It shares nothing with the RIBs, so it can
+// be written on another thread. Routes are in Loc-RIB order and each peer's Adj-RIB-In routes in Adj-RIB-In order,
+// writeRibSnapshot() sorts them.
+struct RibSnapshotCapture {
+    std::vector<SnapshotPeer> Peers;
+    std::vector<SnapshotAttributeSet> AttributeSets;
+    std::vector<uint8_t> AttributeData;
+    std::vector<SnapshotRoute> Routes;
+    std::vector<SnapshotPath> Paths;
+    std::vector<SnapshotAdjRibInRoute> AdjRibInRoutes;
+};
+
+// Copies the Loc-RIB and Adj-RIB-Ins into a RibSnapshotCapture a few hash buckets at a time, so a full table can be
+// captured in small batches between messages rather than holding up the session for a whole pass. Each prefix is
+// captured as it was when its bucket was visited, not all at the same moment, which is as much as a warm start needs:
+// sessions that come back replace what was restored anyway. A table that grows midway moves its routes between buckets
+// and is captured again from the start. The RIBs must outlive the capturer.
+class RibSnapshotCapturer {
+public:
+    RibSnapshotCapturer(const LocRib &locRib, std::vector<const AdjRibIn *> adjRibsIn)
+            : locRib_(locRib),
+              adjRibsIn_(std::move(adjRibsIn)),
+              adjRibInRanges_(adjRibsIn_.size()),
+              bucketCount_(locRib.bucket_count()) {
+        // Growing these midway would copy everything captured so far in one batch
+        capture_.Routes.reserve(locRib.size());
+        capture_.Paths.reserve(locRib.path_count());
+        size_t adjRibInRoutes = 0;
+        for (const auto adjRibIn : adjRibsIn_) {
+            adjRibInRoutes += adjRibIn->size();
+        }
+        capture_.AdjRibInRoutes.reserve(adjRibInRoutes);
+    }
+
+    // Looks at about limit routes, picking up where the last call left off. Returns true once everything is captured.
+    bool Step(const size_t limit) {
+        size_t visited = 0;
+        while (visited < limit && !done()) {
+            if (TableBucketCount() != bucketCount_) {
+                Restart();
+            }
+            if (bucket_ == bucketCount_) {
+                NextTable();
+                continue;
+            }
+            visited += (table_ == 0 ? CaptureLocRibBucket() : CaptureAdjRibInBucket()) + 1;
+            ++bucket_;
+        }
+        return done();
+    }
+
+    [[nodiscard]] bool done() const {
+        return table_ > adjRibsIn_.size();
+    }
+
+    // Hands out the capture once Step() has returned true
+    RibSnapshotCapture Take() {
+        auto &peers = capture_.Peers;
+        peers.resize(locRib_.peer_count());
+        for (PeerId id = 0; id < peers.size(); ++id) {
+            const auto &peer = locRib_.peer(id);
+            peers[id] = SnapshotPeer{peer.Address, peer.BgpIdentifier, peer.External, 0, 0, 0};
+        }
+        for (size_t i = 0; i < adjRibsIn_.size(); ++i) {
+            if (adjRibsIn_[i]->peer() < peers.size()) {
+                peers[adjRibsIn_[i]->peer()].FirstAdjRibInRoute = adjRibInRanges_[i].first;
+                peers[adjRibsIn_[i]->peer()].AdjRibInRouteCount = adjRibInRanges_[i].second;
+            }
+        }
+        held_.clear();
+        attributeIndex_.clear();
+        return std::move(capture_);
+    }
+
+private:
+    [[nodiscard]] size_t TableBucketCount() const {
+        return table_ == 0 ? locRib_.bucket_count() : adjRibsIn_[table_ - 1]->bucket_count();
+    }
+
+    void Restart() {
+        if (table_ == 0) {
+            capture_.Routes.clear();
+            capture_.Paths.clear();
+        } else {
+            capture_.AdjRibInRoutes.resize(adjRibInRanges_[table_ - 1].first);
+        }
+        bucket_ = 0;
+        bucketCount_ = TableBucketCount();
+    }
+
+    void NextTable() {
+        if (table_ > 0) {
+            auto &range = adjRibInRanges_[table_ - 1];
+            range.second = capture_.AdjRibInRoutes.size() - range.first;
+        }
+        ++table_;
+        bucket_ = 0;
+        if (!done()) {
+            adjRibInRanges_[table_ - 1].first = capture_.AdjRibInRoutes.size();
+            bucketCount_ = TableBucketCount();
+        }
+    }
+
+    size_t CaptureLocRibBucket() {
+        return locRib_.ForEachInBucket(bucket_, [&](const Route &route, const PathList &list) {
+            const auto best = list.best();
+            capture_.Routes.emplace_back(SnapshotRoute{routeKey(route), capture_.Paths.size(),
+                                                       static_cast<uint32_t>(list.paths().size()),
+                                                       best ? static_cast<uint32_t>(best - list.paths().data())
+                                                            : SnapshotRoute::NO_PATH});
+            for (const auto &path : list.paths()) {
+                capture_.Paths.emplace_back(SnapshotPath{path.Peer, IndexOf(path.Attributes), path.Keys.LocalPreference,
+                                                         path.Keys.Med, path.Keys.NextHopAddress, path.Keys.FirstAs,
+                                                         path.Keys.AsPathLength,
+                                                         static_cast<uint8_t>(path.Keys.OriginType), path.Keys.Flags});
+            }
+        });
+    }
+
+    size_t CaptureAdjRibInBucket() {
+        return adjRibsIn_[table_ - 1]->ForEachInBucket(bucket_, [&](const Route &route,
+                                                                     const std::shared_ptr<const PathAttributeSet> &attributes) {
+            capture_.AdjRibInRoutes.emplace_back(SnapshotAdjRibInRoute{routeKey(route), IndexOf(attributes), 0});
+        });
+    }
+
+    // Sets are kept until Take(), so an address in attributeIndex_ cannot be reused by another set midway
+    uint32_t IndexOf(const std::shared_ptr<const PathAttributeSet> &attributes) {
+        const auto [it, inserted] = attributeIndex_.try_emplace(attributes.get(),
+                                                                static_cast<uint32_t>(capture_.AttributeSets.size()));
+        if (inserted) {
+            auto &data = capture_.AttributeData;
+            const auto offset = data.size();
+            for (const auto &attribute : attributes->attributes()) {
+                appendPathAttribute(data, attribute);
+            }
+            capture_.AttributeSets.emplace_back(SnapshotAttributeSet{offset, static_cast<uint32_t>(data.size() - offset),
+                                                                     attributes->four_octet_asns()});
+            held_.emplace_back(attributes);
+        }
+        return it->second;
+    }
+
+    const LocRib &locRib_;
+    std::vector<const AdjRibIn *> adjRibsIn_;
+    // First route and count in capture_.AdjRibInRoutes, per Adj-RIB-In
+    std::vector<std::pair<uint64_t, uint64_t>> adjRibInRanges_;
+    // 0 is the Loc-RIB, then the Adj-RIB-Ins
+    size_t table_ = 0;
+    size_t bucket_ = 0;
+    size_t bucketCount_;
+    RibSnapshotCapture capture_;
+    std::unordered_map<const PathAttributeSet *, uint32_t> attributeIndex_;
+    std::vector<std::shared_ptr<const PathAttributeSet>> held_;
+};
+
+// Captures locRib and adjRibsIn in one pass
+RibSnapshotCapture captureRibSnapshot(const LocRib &locRib, std::vector<const AdjRibIn *> adjRibsIn) {
+    RibSnapshotCapturer capturer(locRib, std::move(adjRibsIn));
+    capturer.Step(SIZE_MAX);
+    return capturer.Take();
+}
+
+// Writes a captured snapshot to path. The snapshot is written next to path and renamed over it once complete, so a
+// reader never sees half a snapshot. Throws std::runtime_error if the file cannot be written. TODO: [14]
+void writeRibSnapshot(const std::string &path, RibSnapshotCapture capture) {
+    const auto &peers = capture.Peers;
+    const auto &attributeSets = capture.AttributeSets;
+    const auto &attributeData = capture.AttributeData;
+    auto &routes = capture.Routes;
+    auto &adjRibInRoutes = capture.AdjRibInRoutes;
+    // Paths are laid out in route order too, so a restore reads them front to back
+    std::sort(routes.begin(), routes.end(), [](const auto &a, const auto &b) { return a.Key < b.Key; });
+    std::vector<SnapshotPath> paths;
+    paths.reserve(capture.Paths.size());
+    for (auto &route : routes) {
+        const auto first = capture.Paths.begin() + static_cast<ptrdiff_t>(route.FirstPath);
+        route.FirstPath = paths.size();
+        paths.insert(paths.end(), first, first + route.PathCount);
+    }
+    capture.Paths = {};
+    for (const auto &peer : peers) {
+        const auto first = adjRibInRoutes.begin() + static_cast<ptrdiff_t>(peer.FirstAdjRibInRoute);
+        std::sort(first, first + static_cast<ptrdiff_t>(peer.AdjRibInRouteCount),
+                  [](const auto &a, const auto &b) { return a.Key < b.Key; });
+    }
+
+    RibSnapshotHeader header{};
+    header.Magic = RIB_SNAPSHOT_MAGIC;
+    header.Version = RIB_SNAPSHOT_VERSION;
+    header.ByteOrder = RIB_SNAPSHOT_BYTE_ORDER;
+    header.Created = static_cast<uint64_t>(std::time(nullptr));
+    header.PeerCount = peers.size();
+    header.AttributeSetCount = attributeSets.size();
+    header.AttributeBytes = attributeData.size();
+    header.RouteCount = routes.size();
+    header.PathCount = paths.size();
+    header.AdjRibInRouteCount = adjRibInRoutes.size();
+
+    // Every section starts 8 byte aligned, so the records can be used straight from the mapping
+    uint64_t offset = sizeof(header);
+    const auto place = [&](const size_t bytes) {
+        offset = (offset + 7) / 8 * 8;
+        const auto placed = offset;
+        offset += bytes;
+        return placed;
+    };
+    header.PeersOffset = place(peers.size() * sizeof(SnapshotPeer));
+    header.AttributeSetsOffset = place(attributeSets.size() * sizeof(SnapshotAttributeSet));
+    header.AttributeDataOffset = place(attributeData.size());
+    header.RoutesOffset = place(routes.size() * sizeof(SnapshotRoute));
+    header.PathsOffset = place(paths.size() * sizeof(SnapshotPath));
+    header.AdjRibInRoutesOffset = place(adjRibInRoutes.size() * sizeof(SnapshotAdjRibInRoute));
+
+    const auto temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        uint64_t written = 0;
+        const auto write = [&](const uint64_t at, const void *data, const size_t bytes) {
+            static constexpr char padding[8] = {};
+            file.write(padding, static_cast<std::streamsize>(at - written));
+            file.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+            written = at + bytes;
+        };
+        write(0, &header, sizeof(header));
+        write(header.PeersOffset, peers.data(), peers.size() * sizeof(SnapshotPeer));
+        write(header.AttributeSetsOffset, attributeSets.data(), attributeSets.size() * sizeof(SnapshotAttributeSet));
+        write(header.AttributeDataOffset, attributeData.data(), attributeData.size());
+        write(header.RoutesOffset, routes.data(), routes.size() * sizeof(SnapshotRoute));
+        write(header.PathsOffset, paths.data(), paths.size() * sizeof(SnapshotPath));
+        write(header.AdjRibInRoutesOffset, adjRibInRoutes.data(), adjRibInRoutes.size() * sizeof(SnapshotAdjRibInRoute));
+        if (!file.flush()) {
+            throw std::runtime_error("Unable to write RIB snapshot " + temporaryPath);
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        throw std::runtime_error("Unable to replace RIB snapshot " + path + ": " + error.message());
+    }
+}
+
+// A RIB snapshot mapped read-only, for restoreRibSnapshot(). The whole file is validated on open, a snapshot that does
+// not check out throws std::runtime_error rather than being half used.
+class RibSnapshot {
+public:
+    explicit RibSnapshot(const std::string &path) : file_(path, false) {
+        const auto bytes = file_.bytes();
+        if (bytes.size() < sizeof(RibSnapshotHeader)) {
+            throw std::runtime_error("RIB snapshot " + path + " is truncated");
+        }
+        header_ = reinterpret_cast<const RibSnapshotHeader *>(bytes.data());
+        if (header_->Magic != RIB_SNAPSHOT_MAGIC || header_->Version != RIB_SNAPSHOT_VERSION ||
+            header_->ByteOrder != RIB_SNAPSHOT_BYTE_ORDER) {
+            throw std::runtime_error(path + " is not a RIB snapshot this build can read");
+        }
+
+        peers_ = Section<SnapshotPeer>(path, header_->PeersOffset, header_->PeerCount);
+        attributeSets_ = Section<SnapshotAttributeSet>(path, header_->AttributeSetsOffset, header_->AttributeSetCount);
+        attributeData_ = Section<uint8_t>(path, header_->AttributeDataOffset, header_->AttributeBytes);
+        routes_ = Section<SnapshotRoute>(path, header_->RoutesOffset, header_->RouteCount);
+        paths_ = Section<SnapshotPath>(path, header_->PathsOffset, header_->PathCount);
+        adjRibInRoutes_ = Section<SnapshotAdjRibInRoute>(path, header_->AdjRibInRoutesOffset,
+                                                         header_->AdjRibInRouteCount);
+        Validate(path);
+    }
+
+    [[nodiscard]] const RibSnapshotHeader &header() const {
+        return *header_;
+    }
+
+    [[nodiscard]] std::span<const SnapshotPeer> peers() const {
+        return peers_;
+    }
+
+    [[nodiscard]] size_t attribute_set_count() const {
+        return attributeSets_.size();
+    }
+
+    // The attributes in UPDATE encoding, for parsePathAttributes()
+    [[nodiscard]] std::span<const uint8_t> attributes(const uint32_t index) const {
+        return attributeData_.subspan(attributeSets_[index].Offset, attributeSets_[index].Length);
+    }
+
+    [[nodiscard]] bool four_octet_asns(const uint32_t index) const {
+        return attributeSets_[index].FourOctetAsns != 0;
+    }
+
+    [[nodiscard]] std::span<const SnapshotRoute> routes() const {
+        return routes_;
+    }
+
+    [[nodiscard]] std::span<const SnapshotPath> paths(const SnapshotRoute &route) const {
+        return paths_.subspan(route.FirstPath, route.PathCount);
+    }
+
+    [[nodiscard]] std::span<const SnapshotAdjRibInRoute> adj_rib_in(const uint32_t peer) const {
+        return adjRibInRoutes_.subspan(peers_[peer].FirstAdjRibInRoute, peers_[peer].AdjRibInRouteCount);
+    }
+
+private:
+    template<typename T>
+    std::span<const T> Section(const std::string &path, const uint64_t offset, const uint64_t count) const {
+        const auto bytes = file_.bytes();
+        if (offset % alignof(T) != 0 || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T)) {
+            throw std::runtime_error("RIB snapshot " + path + " has a section outside the file");
+        }
+        return {reinterpret_cast<const T *>(bytes.data() + offset), static_cast<size_t>(count)};
+    }
+
+    void Validate(const std::string &path) const {
+        const auto fail = [&](const std::string &what) {
+            throw std::runtime_error("RIB snapshot " + path + " is corrupt: " + what);
+        };
+        for (const auto &peer : peers_) {
+            if (peer.FirstAdjRibInRoute > adjRibInRoutes_.size() ||
+                peer.AdjRibInRouteCount > adjRibInRoutes_.size() - peer.FirstAdjRibInRoute) {
+                fail("Adj-RIB-In out of range");
+            }
+        }
+        for (const auto &attributeSet : attributeSets_) {
+            if (attributeSet.Offset > attributeData_.size() || attributeSet.Length > attributeData_.size() - attributeSet.Offset) {
+                fail("attribute set out of range");
+            }
+        }
+        for (size_t i = 0; i < routes_.size(); ++i) {
+            const auto &route = routes_[i];
+            if ((i > 0 && routes_[i - 1].Key >= route.Key) || route.FirstPath > paths_.size() ||
+                route.PathCount > paths_.size() - route.FirstPath ||
+                (route.Best != SnapshotRoute::NO_PATH && route.Best >= route.PathCount)) {
+                fail("route " + std::to_string(i) + " out of order or out of range");
+            }
+        }
+        for (const auto &path : paths_) {
+            if (path.Peer >= peers_.size() || path.AttributeSet >= attributeSets_.size()) {
+                fail("path out of range");
+            }
+        }
+        for (const auto &route : adjRibInRoutes_) {
+            if (route.AttributeSet >= attributeSets_.size()) {
+                fail("Adj-RIB-In route out of range");
+            }
+        }
+    }
+
+    MappedFile file_;
+    const RibSnapshotHeader *header_ = nullptr;
+    std::span<const SnapshotPeer> peers_;
+    std::span<const SnapshotAttributeSet> attributeSets_;
+    std::span<const uint8_t> attributeData_;
+    std::span<const SnapshotRoute> routes_;
+    std::span<const SnapshotPath> paths_;
+    std::span<const SnapshotAdjRibInRoute> adjRibInRoutes_;
+};
+
+// Loads a snapshot into locRib, interning its attribute sets in store. Every snapshot peer is added to locRib, the
+// returned Adj-RIB-Ins are indexed like RibSnapshot::peers() and hold what each peer had advertised. Loaded paths are
+// only as good as the snapshot, sessions that come back up replace them. The Loc-RIB changes are queued as usual.
+std::vector<std::unique_ptr<AdjRibIn>> restoreRibSnapshot(const RibSnapshot &snapshot, PathAttributeStore &store,
+                                                          LocRib &locRib,
+                                                          std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    std::vector<std::shared_ptr<const PathAttributeSet>> attributeSets(snapshot.attribute_set_count());
+    std::pmr::monotonic_buffer_resource arena;
+    for (uint32_t i = 0; i < attributeSets.size(); ++i) {
+        {
+            std::pmr::vector<PathAttribute> attributes(&arena);
+            if (!parsePathAttributes(snapshot.attributes(i), attributes)) {
+                throw std::runtime_error("RIB snapshot attribute set " + std::to_string(i) + " is malformed");
+            }
+            attributeSets[i] = store.Intern(attributes, snapshot.four_octet_asns(i));
+        }
+        arena.release();
+    }
+
+    std::vector<PeerId> peers;
+    std::vector<std::unique_ptr<AdjRibIn>> adjRibsIn;
+    for (uint32_t i = 0; i < snapshot.peers().size(); ++i) {
+        const auto &peer = snapshot.peers()[i];
+        peers.emplace_back(locRib.AddPeer(peer.Address, peer.BgpIdentifier, peer.External != 0));
+        auto &adjRibIn = adjRibsIn.emplace_back(std::make_unique<AdjRibIn>(peers.back(), resource));
+        const auto routes = snapshot.adj_rib_in(i);
+        adjRibIn->Reserve(routes.size());
+        for (const auto &route : routes) {
+            adjRibIn->Update(routeFromKey(route.Key), attributeSets[route.AttributeSet]);
+        }
+    }
+
+    locRib.Reserve(locRib.size() + snapshot.routes().size());
+    std::vector<RibPath> paths;
+    for (const auto &route : snapshot.routes()) {
+        paths.clear();
+        for (const auto &path : snapshot.paths(route)) {
+            paths.emplace_back(RibPath{peers[path.Peer], attributeSets[path.AttributeSet], path.keys()});
+        }
+        locRib.Replace(routeFromKey(route.Key), std::move(paths));
+    }
+    return adjRibsIn;
+}
+
+#endif //BGP_RIBSNAPSHOT_H
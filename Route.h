@@ -10,6 +10,9 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <optional>
+#include <algorithm>
+#include <cctype>
 #include "Util.h"
 
 typedef struct ROUTE {
@@ -31,6 +34,60 @@ typedef struct ROUTE {
     }
 } Route, NLRI;
 
+// Parses dotted-decimal, e.g. "192.0.2.1". TODO: [9]
+std::optional<uint32_t> parseIpv4Address(const std::string &text) {
+    uint32_t address = 0;
+    size_t position = 0;
+    for (int octet = 0; octet < 4; ++octet) {
+        if (octet > 0) {
+            if (position >= text.size() || text[position] != '.') {
+                return std::nullopt;
+            }
+            ++position;
+        }
+        uint32_t value = 0;
+        const auto start = position;
+        while (position < text.size() && position - start < 3 && std::isdigit(static_cast<unsigned char>(text[position]))) {
+            value = value * 10 + (text[position++] - '0');
+        }
+        if (position == start || value > 255) {
+            return std::nullopt;
+        }
+        address = address << 8 | value;
+    }
+    return position == text.size() ? std::optional<uint32_t>(address) : std::nullopt;
+}
+
+// Dotted-decimal, the inverse of parseIpv4Address(). TODO: [9]
+std::string formatIpv4Address(const uint32_t address) {
+    const uint8_t octets[4] = {_32to8(address)};
+    return std::to_string(octets[0]) + '.' + std::to_string(octets[1]) + '.' + std::to_string(octets[2]) + '.' +
+           std::to_string(octets[3]);
+}
+
+// Parses "192.0.2.0/24". Host bits are cleared, a missing length means /32.
+std::optional<Route> parseIpv4Prefix(const std::string &text) {
+    const auto slash = text.find('/');
+    const auto address = parseIpv4Address(text.substr(0, slash));
+    if (!address) {
+        return std::nullopt;
+    }
+    uint8_t length = 32;
+    if (slash != std::string::npos) {
+        const auto lengthText = text.substr(slash + 1);
+        if (lengthText.empty() || lengthText.size() > 2 ||
+            !std::all_of(lengthText.begin(), lengthText.end(), [](const char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+            return std::nullopt;
+        }
+        const auto value = std::stoi(lengthText);
+        if (value > 32) {
+            return std::nullopt;
+        }
+        length = static_cast<uint8_t>(value);
+    }
+    return Route{length, length == 0 ? 0 : *address & UINT32_MAX << (32 - length)};
+}
+
 /* TODO: [9]
  *Route generateIPv4Route(const uint8_t length, const uint32_t prefix)
 {
@@ -0,0 +1,244 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ROUTECHANGEBUS_H
+#define BGP_ROUTECHANGEBUS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <span>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_map>
+#include <optional>
+#include <memory_resource>
+#include "Route.h"
+#include "Rib.h"
+
+// The best path of a published RouteChange. The next hop is Keys.NextHopAddress.
+struct RouteChangePath {
+    PeerId Peer = 0;
+    DecisionKeys Keys;
+    // Copied out of the RIB onto the default heap, shared by the changes of one batch that have the same attributes
+    std::shared_ptr<const std::vector<PathAttribute>> Attributes;
+};
+
+// A Loc-RIB change as RouteChangeBus hands it out. Unlike RibChange it holds nothing allocated from the RIB's pool,
+// which is not thread safe and goes away with the RIB, so a consumer may keep it on any thread for as long as it
+// likes. Best is std::nullopt if the prefix is no longer reachable.
+struct RouteChange {
+    Route Prefix;
+    std::optional<RouteChangePath> Best;
+    bool BestChanged = true;
+};
+
+// One consumer's queue of Loc-RIB changes, see RouteChangeBus. Thread safe.
+//
+// Changes are queued in the order they were published until more than maxQueued are waiting. Past that the consumer is
+// not keeping up, and the queue turns into the latest change per prefix: a prefix that changes again replaces its
+// queued change instead of adding one, so memory is bounded by the number of prefixes rather than by churn. A
+// coalesced change has BestChanged set if any of the changes it replaced did. The consumer still ends up with the
+// current state of every prefix, only the order between prefixes and the intermediate states are lost.
+class RouteChangeSubscription {
+public:
+    RouteChangeSubscription(std::string name, const size_t maxQueued) : name_(std::move(name)),
+                                                                        maxQueued_(maxQueued) {}
+
+    RouteChangeSubscription(const RouteChangeSubscription &) = delete;
+    RouteChangeSubscription &operator=(const RouteChangeSubscription &) = delete;
+
+    // Everything waiting, in one batch. Empty if nothing is.
+    std::vector<RouteChange> Take() {
+        std::lock_guard lock(mutex_);
+        return TakeLocked();
+    }
+
+    // Like Take(), but waits up to timeout for something to arrive
+    template<typename Rep, typename Period>
+    std::vector<RouteChange> Wait(const std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock lock(mutex_);
+        ready_.wait_for(lock, timeout, [this]() {
+            return !queue_.empty() || !latest_.empty();
+        });
+        return TakeLocked();
+    }
+
+    [[nodiscard]] const std::string &name() const {
+        return name_;
+    }
+
+    [[nodiscard]] size_t pending() const {
+        std::lock_guard lock(mutex_);
+        return coalescing_ ? latest_.size() : queue_.size();
+    }
+
+    // Changes handed out by Take() and Wait()
+    [[nodiscard]] uint64_t delivered_count() const {
+        std::lock_guard lock(mutex_);
+        return delivered_;
+    }
+
+    // Changes replaced by a later change to the same prefix before they were taken
+    [[nodiscard]] uint64_t coalesced_count() const {
+        std::lock_guard lock(mutex_);
+        return coalesced_;
+    }
+
+private:
+    friend class RouteChangeBus;
+
+    void Push(const std::span<const RouteChange> changes) {
+        bool wasEmpty;
+        {
+            std::lock_guard lock(mutex_);
+            wasEmpty = queue_.empty() && latest_.empty();
+            if (!coalescing_ && queue_.size() + changes.size() > maxQueued_) {
+                coalescing_ = true;
+                for (auto &change : queue_) {
+                    Coalesce(std::move(change));
+                }
+                queue_.clear();
+            }
+            if (coalescing_) {
+                for (const auto &change : changes) {
+                    Coalesce(change);
+                }
+            } else {
+                queue_.insert(queue_.end(), changes.begin(), changes.end());
+            }
+        }
+        // A consumer can only be waiting on an empty queue
+        if (wasEmpty) {
+            ready_.notify_one();
+        }
+    }
+
+    // Needs mutex_ held
+    void Coalesce(RouteChange change) {
+        auto [it, inserted] = latest_.try_emplace(routeKey(change.Prefix), change);
+        if (!inserted) {
+            change.BestChanged = change.BestChanged || it->second.BestChanged;
+            it->second = std::move(change);
+            ++coalesced_;
+        }
+    }
+
+    // Needs mutex_ held
+    std::vector<RouteChange> TakeLocked() {
+        std::vector<RouteChange> changes;
+        if (coalescing_) {
+            changes.reserve(latest_.size());
+            for (auto &[key, change] : latest_) {
+                changes.emplace_back(std::move(change));
+            }
+            latest_.clear();
+            coalescing_ = false;
+        } else {
+            changes.swap(queue_);
+        }
+        delivered_ += changes.size();
+        return changes;
+    }
+
+    std::string name_;
+    size_t maxQueued_;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::vector<RouteChange> queue_;
+    // Replaces queue_ while coalescing_, keyed by routeKey()
+    std::unordered_map<uint64_t, RouteChange> latest_;
+    bool coalescing_ = false;
+    uint64_t delivered_ = 0;
+    uint64_t coalesced_ = 0;
+};
+
+// Hands Loc-RIB changes (LocRib::TakeChanges()) to everything else that wants them, e.g. archivers, monitoring and show
+// commands, without calling any of them: Publish() only copies each batch into every subscriber's queue, as RouteChange
+// values, and each consumer takes whatever has piled up as one batch whenever it gets to it. A consumer that falls
+// behind coalesces instead of growing without bound (see RouteChangeSubscription), so it cannot slow best path or the
+// other consumers down. Thread safe.
+class RouteChangeBus {
+public:
+    // Changes a subscriber may have queued before it coalesces
+    static constexpr size_t DEFAULT_MAX_QUEUED = 65536;
+
+    // The subscription ends when the last reference to it goes away
+    std::shared_ptr<RouteChangeSubscription> Subscribe(std::string name, const size_t maxQueued = DEFAULT_MAX_QUEUED) {
+        auto subscription = std::make_shared<RouteChangeSubscription>(std::move(name), maxQueued);
+        std::lock_guard lock(mutex_);
+        subscribers_.emplace_back(subscription);
+        return subscription;
+    }
+
+    // Must be called on the thread that owns the RIB the changes came from, they are only copied out of it here
+    void Publish(const std::span<const RibChange> changes) {
+        if (changes.empty()) {
+            return;
+        }
+        std::vector<std::shared_ptr<RouteChangeSubscription>> subscribers;
+        {
+            std::lock_guard lock(mutex_);
+            if (subscribers_.empty()) {
+                return;
+            }
+            subscribers.reserve(subscribers_.size());
+            std::erase_if(subscribers_, [&](const auto &weak) {
+                auto subscriber = weak.lock();
+                if (!subscriber) {
+                    return true;
+                }
+                subscribers.emplace_back(std::move(subscriber));
+                return false;
+            });
+        }
+        const auto published = Copy(changes);
+        for (const auto &subscriber : subscribers) {
+            subscriber->Push(published);
+        }
+    }
+
+    [[nodiscard]] size_t subscriber_count() const {
+        std::lock_guard lock(mutex_);
+        return subscribers_.size();
+    }
+
+private:
+    static std::vector<RouteChange> Copy(const std::span<const RibChange> changes) {
+        std::vector<RouteChange> published;
+        published.reserve(changes.size());
+        std::unordered_map<const PathAttributeSet *, std::shared_ptr<const std::vector<PathAttribute>>> copies;
+        for (const auto &change : changes) {
+            std::optional<RouteChangePath> best;
+            if (change.Best) {
+                auto &attributes = copies[change.Best->Attributes.get()];
+                if (!attributes) {
+                    attributes = CopyAttributes(*change.Best->Attributes);
+                }
+                best = RouteChangePath{change.Best->Peer, change.Best->Keys, attributes};
+            }
+            published.emplace_back(RouteChange{change.Prefix, std::move(best), change.BestChanged});
+        }
+        return published;
+    }
+
+    static std::shared_ptr<const std::vector<PathAttribute>> CopyAttributes(const PathAttributeSet &set) {
+        std::vector<PathAttribute> attributes;
+        attributes.reserve(set.attributes().size());
+        for (const auto &attribute : set.attributes()) {
+            attributes.emplace_back(PathAttribute{attribute.Flags, attribute.Type,
+                                                  std::pmr::vector<uint8_t>(attribute.Value.begin(),
+                                                                            attribute.Value.end(),
+                                                                            std::pmr::new_delete_resource())});
+        }
+        return std::make_shared<const std::vector<PathAttribute>>(std::move(attributes));
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<std::weak_ptr<RouteChangeSubscription>> subscribers_;
+};
+
+#endif //BGP_ROUTECHANGEBUS_H
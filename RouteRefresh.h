@@ -0,0 +1,107 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_ROUTEREFRESH_H
+#define BGP_ROUTEREFRESH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "Util.h"
+#include "MessageType.h"
+#include "BgpHeader.h"
+#include "BgpCapability.h"
+#include "BgpUpdateMessage.h"
+#include "Rib.h"
+#include "Export.h"
+
+enum RouteRefreshSubtype : uint8_t {
+    /*
+     * 0 Normal route refresh request [RFC2918]
+     * 1 Demarcation of the beginning of a route refresh (BoRR) [RFC7313]
+     * 2 Demarcation of the ending of a route refresh (EoRR) [RFC7313]
+     */
+    NormalRouteRefresh = 0,
+    BeginningOfRouteRefresh = 1,
+    EndOfRouteRefresh = 2
+};
+
+std::string RouteRefreshSubtypeToString(const RouteRefreshSubtype subtype) {
+    switch (subtype) {
+        case NormalRouteRefresh:
+            return "NormalRouteRefresh";
+        case BeginningOfRouteRefresh:
+            return "BeginningOfRouteRefresh";
+        case EndOfRouteRefresh:
+            return "EndOfRouteRefresh";
+        default:
+            return "InvalidRouteRefreshSubtype";
+    }
+}
+
+// RFC 2918 3, with the Reserved octet used as the subtype by RFC 7313 3.2
+struct BgpRouteRefreshMessage {
+    uint16_t Afi;
+    RouteRefreshSubtype Subtype;
+    uint8_t Safi;
+    // Outbound route filters (RFC 5291 5) following a normal request, empty if there are none. Points into the
+    // message it was parsed from, see Orf.h.
+    std::span<const uint8_t> Orf = {};
+};
+
+constexpr uint16_t ROUTE_REFRESH_AFI_IPV4 = 1;
+constexpr uint8_t ROUTE_REFRESH_SAFI_UNICAST = 1;
+
+std::vector<uint8_t> flattenBgpRouteRefreshMessage(const BgpRouteRefreshMessage &message) {
+    std::vector<uint8_t> routeRefreshMessage = {_16to8(message.Afi), message.Subtype, message.Safi};
+    routeRefreshMessage.insert(routeRefreshMessage.end(), message.Orf.begin(), message.Orf.end());
+    const auto header = generateBgpHeader(routeRefreshMessage.size(), RouteRefresh);
+    routeRefreshMessage.insert(routeRefreshMessage.begin(), header.begin(), header.end());
+    return routeRefreshMessage;
+}
+
+// messageBytes is the message without its header. Throws std::invalid_argument if it is shorter than 4 octets, or
+// longer for anything but a normal request carrying ORF entries, which RFC 7313 5 answers with a NOTIFICATION.
+BgpRouteRefreshMessage parseBgpRouteRefreshMessage(const std::span<const uint8_t> messageBytes) {
+    if (messageBytes.size() < 4 || (messageBytes.size() > 4 && messageBytes[2] != NormalRouteRefresh)) {
+        throw std::invalid_argument("ROUTE-REFRESH message has length " + std::to_string(messageBytes.size() + 19));
+    }
+    return {_8to16(messageBytes[0], messageBytes[1]), static_cast<RouteRefreshSubtype>(messageBytes[2]),
+            messageBytes[3], messageBytes.subspan(4)};
+}
+
+// Route refresh (RFC 2918) and enhanced route refresh (RFC 7313), both with no value
+std::vector<BgpCapability> routeRefreshCapabilities() {
+    return {{RouteRefreshCapability, 0, {}}, {EnhancedRouteRefresh, 0, {}}};
+}
+
+bool hasCapability(const std::vector<BgpCapability> &capabilities, const CapabilityCode code) {
+    return std::any_of(capabilities.begin(), capabilities.end(), [&](const auto &capability) {
+        return capability.Code == code;
+    });
+}
+
+// Answers a ROUTE-REFRESH by encoding everything in adjRibOut as UPDATEs, handing each one to send(std::vector<uint8_t>)
+// as a whole message. Prefixes that share an attribute set go out together (see forEachAnnouncementUpdate()). Nothing
+// goes through export policy or the peer's ORF entries here, the Adj-RIB-Out already holds their result (see
+// RouteExporter). Returns the number of messages sent.
+template<typename Function>
+size_t forEachRefreshUpdate(const AdjRibOut &adjRibOut, Function &&send) {
+    std::unordered_map<const PathAttributeSet *, std::vector<Route>> groups;
+    adjRibOut.ForEach([&](const Route &route, const std::shared_ptr<const PathAttributeSet> &attributes) {
+        groups[attributes.get()].emplace_back(route);
+    });
+
+    size_t messages = 0;
+    for (const auto &[attributes, routes] : groups) {
+        messages += forEachAnnouncementUpdate(*attributes, routes, send);
+    }
+    return messages;
+}
+
+#endif //BGP_ROUTEREFRESH_H
@@ -26,7 +26,7 @@ public:
         };
         // TODO: this might not work...
         // TODO: spoiler alert, it didn't
-        auto bindResult = bind(socketHandle_, reinterpret_cast<const sockaddr*>(&saddr), address->length());
+        auto bindResult = bind(socketHandle_.load(), reinterpret_cast<const sockaddr*>(&saddr), address->length());
 
         if (bindResult != 0) {
             logging::sockets::ERROR("ServerSocket::ServerSocket()::bind()");
@@ -35,7 +35,7 @@ public:
 
         // TODO: figure out what # is best for backlog
         constexpr auto BACKLOG = 10;
-        auto listenResult = listen(socketHandle_, BACKLOG);
+        auto listenResult = listen(socketHandle_.load(), BACKLOG);
         if (listenResult == SOCKET_ERROR) {
             logging::sockets::ERROR("ServerSocket::ServerSocket()::listen()");
             // TODO: error handling
@@ -43,14 +43,15 @@ public:
     }
 
     // TODO: multithreaded Accept()
+    // Returns nullptr if accept() failed, e.g. because the listener was closed
     std::shared_ptr<TcpSocket> Accept() {
         sockaddr_storage remoteAddressInfo{};
         socklen_t remoteAddressSize = sizeof(remoteAddressInfo);
         const auto remoteAddress = reinterpret_cast<sockaddr *>(&remoteAddressInfo);
-        auto acceptedSocketHandle = accept(socketHandle_, remoteAddress, &remoteAddressSize);
+        auto acceptedSocketHandle = accept(socketHandle_.load(), remoteAddress, &remoteAddressSize);
         if (acceptedSocketHandle == INVALID_SOCKET) {
             logging::sockets::ERROR("ServerSocket::Accept()::accept()");
-            // TODO: error handling
+            return nullptr;
         }
 
 //    sockaddr remoteAddress{};
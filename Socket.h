@@ -12,7 +12,9 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <vector>
+#include <span>
 #include <algorithm>
+#include <atomic>
 
 #include "SocketAddress.h"
 #include "Log.h"
@@ -52,8 +54,14 @@ public:
 
     virtual std::string to_string() const = 0;
 
-    void Close() const {
-        if (closesocket(socketHandle_) != 0) {
+    // Only the first call closes the handle, so the destructor never closes one the system handed out again since.
+    // Safe to call from another thread, e.g. to fail a pending Accept() or Receive().
+    void Close() {
+        const auto handle = socketHandle_.exchange(static_cast<int>(INVALID_SOCKET));
+        if (handle == static_cast<int>(INVALID_SOCKET)) {
+            return;
+        }
+        if (closesocket(handle) != 0) {
             logging::sockets::ERROR("Socket::Close()::closesocket()");
             // TODO: error handling
         }
@@ -71,7 +79,28 @@ public:
         }
     }
 
+    // Sends buffers back to back with a single gather write. Returns false if the connection failed.
+    bool Send(const std::span<const std::span<const uint8_t>> buffers) const {
+        std::vector<WSABUF> wsaBuffers(buffers.size());
+        std::transform(buffers.begin(), buffers.end(), wsaBuffers.begin(), [](const std::span<const uint8_t> buffer) {
+            return WSABUF{static_cast<ULONG>(buffer.size()),
+                          reinterpret_cast<CHAR *>(const_cast<uint8_t *>(buffer.data()))};
+        });
+        DWORD bytesSent = 0;
+        // A blocking socket only returns once everything was sent, or the connection failed
+        if (WSASend(socketHandle_, wsaBuffers.data(), static_cast<DWORD>(wsaBuffers.size()), &bytesSent, 0, nullptr,
+                    nullptr) == SOCKET_ERROR) {
+            logging::sockets::ERROR("Socket::Send()::WSASend()");
+            return false;
+        }
+        return true;
+    }
+
+    // Returns nothing once the connection is closed, from either end
     std::vector<uint8_t> Receive() const {
+        if (socketHandle_ == static_cast<int>(INVALID_SOCKET)) {
+            return {};
+        }
         constexpr auto RECEIVE_BUFFER_SIZE = 4096;
         char receiveBuffer[RECEIVE_BUFFER_SIZE];
         auto bytesReceived = recv(socketHandle_, receiveBuffer, RECEIVE_BUFFER_SIZE, NULL);
@@ -90,7 +119,8 @@ public:
     }
 protected:
     std::shared_ptr<SocketAddress> address_;
-    int socketHandle_;
+    // INVALID_SOCKET once closed
+    std::atomic<int> socketHandle_;
 
 private:
     static std::vector<char> convertToSigned(const std::vector<uint8_t>& vector) {
@@ -121,6 +151,23 @@ public:
 
     }
 
+    // Connects to address(). Returns false if it could not.
+    bool Connect() const {
+        // TODO: this definitely doesn't work for IPv6...
+        auto addr = reinterpret_cast<const in_addr*>(address_->addr()->bytes());
+        const sockaddr_in saddr = {
+                .sin_family = static_cast<uint16_t>(address_->addr()->family()),
+                .sin_port = address_->port(),
+                .sin_addr = *addr,
+                .sin_zero = {}
+        };
+        if (connect(socketHandle_, reinterpret_cast<const sockaddr*>(&saddr), sizeof(saddr)) == SOCKET_ERROR) {
+            logging::sockets::ERROR("TcpSocket::Connect()::connect()");
+            return false;
+        }
+        return true;
+    }
+
     // TODO: do I need this outside the Socket::Socket() constructor?
     SocketType type() const override {
         return SocketType::TCP;
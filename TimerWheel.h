@@ -0,0 +1,97 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_TIMERWHEEL_H
+#define BGP_TIMERWHEEL_H
+
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+
+// A hashed timing wheel: many timers that only need tick precision, e.g. one per dampened path, share one array of
+// slots instead of a thread or heap entry each. Scheduling and expiring are O(1) per timer, a timer further out than
+// one turn of the wheel waits in its slot for the turns in between. Timers cannot be cancelled, whoever handles one
+// decides whether it still matters, and schedules it again if it fired early. Not synchronized, driven by Advance().
+template<typename T>
+class TimerWheel {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TimerWheel(const Clock::duration tick, const size_t slots, const Clock::time_point start = Clock::now())
+            : tick_(tick),
+              start_(start),
+              slots_(slots) {}
+
+    // Fires at the first Advance() at or after when, and never before it. Anything in the past fires at the next one.
+    void Schedule(const Clock::time_point when, T value) {
+        auto tick = TickAt(when);
+        if (when > start_ + tick * tick_) {
+            ++tick;
+        }
+        tick = std::max(tick, current_ + 1);
+        slots_[tick % slots_.size()].emplace_back(Entry{tick, std::move(value)});
+        ++size_;
+    }
+
+    // Calls expired(T &&) for every timer due by now, in no particular order within a tick. expired may schedule more
+    // timers. Returns the number that fired.
+    template<typename Function>
+    size_t Advance(const Clock::time_point now, Function &&expired) {
+        const auto target = TickAt(now);
+        size_t fired = 0;
+        std::vector<Entry> due;
+        while (current_ < target && size_ > 0) {
+            // Nothing can be due in a slot until its tick comes round, so a long gap only needs one pass over the wheel
+            const auto next = target - current_ > slots_.size() ? target - slots_.size() + 1 : current_ + 1;
+            current_ = next;
+            auto &slot = slots_[current_ % slots_.size()];
+            due.clear();
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].Tick <= target) {
+                    due.emplace_back(std::move(slot[i]));
+                    slot[i] = std::move(slot.back());
+                    slot.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+            size_ -= due.size();
+            for (auto &entry : due) {
+                expired(std::move(entry.Value));
+            }
+            fired += due.size();
+        }
+        current_ = std::max(current_, target);
+        return fired;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] Clock::duration tick() const {
+        return tick_;
+    }
+
+private:
+    struct Entry {
+        uint64_t Tick;
+        T Value;
+    };
+
+    [[nodiscard]] uint64_t TickAt(const Clock::time_point when) const {
+        return when <= start_ ? 0 : static_cast<uint64_t>((when - start_) / tick_);
+    }
+
+    Clock::duration tick_;
+    Clock::time_point start_;
+    std::vector<std::vector<Entry>> slots_;
+    // Every tick up to and including this one has been expired
+    uint64_t current_ = 0;
+    size_t size_ = 0;
+};
+
+#endif //BGP_TIMERWHEEL_H
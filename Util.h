@@ -5,6 +5,9 @@
 #ifndef BGP_UTIL_H
 #define BGP_UTIL_H
 
+#include <cstdint>
+#include <cstddef>
+
 #define _16to8(x) static_cast<uint8_t>((x) >> 0x08 & 0xFF), static_cast<uint8_t>((x) & 0xFF)
 #define _32to8(x) static_cast<uint8_t>((x) >> 0x18 & 0xFF), static_cast<uint8_t>((x) >> 0x10 & 0xFF), static_cast<uint8_t>((x) >> 0x08 & 0xFF), static_cast<uint8_t>((x) & 0xFF)
 #define _128to8(x) static_cast<uint8_t>((x) & 0xFF), static_cast<uint8_t>((x) >> 0x08 & 0xFF), static_cast<uint8_t>((x) >> 0x10 & 0xFF), static_cast<uint8_t>((x) >> 0x18 & 0xFF), static_cast<uint8_t>((x) >> 0x20 & 0xFF), static_cast<uint8_t>((x) >> 0x28 & 0xFF), static_cast<uint8_t>((x) >> 0x30 & 0xFF), static_cast<uint8_t>((x) >> 0x38 & 0xFF), static_cast<uint8_t>((x) >> 0x40 & 0xFF), static_cast<uint8_t>((x) >> 0x48 & 0xFF), static_cast<uint8_t>((x) >> 0x50 & 0xFF), static_cast<uint8_t>((x) >> 0x58 & 0xFF), static_cast<uint8_t>((x) >> 0x60 & 0xFF), static_cast<uint8_t>((x) >> 0x68 & 0xFF), static_cast<uint8_t>((x) >> 0x70 & 0xFF), static_cast<uint8_t>((x) >> 0x78 & 0xFF)
@@ -12,4 +15,13 @@
 #define _8to16(x, y) static_cast<uint16_t>((y) | static_cast<uint16_t>(x) << 0x08)
 #define _8to32(x, y, z, w) static_cast<uint32_t>((w) | static_cast<uint32_t>(z) << 0x08 | static_cast<uint32_t>(y) << 0x10 | static_cast<uint32_t>(x) << 0x18)
 
+// FNV-1a, used to key the interning stores. Chain calls by passing the previous result as the seed.
+inline uint64_t hashBytes(const uint8_t *data, const size_t length, uint64_t seed = 0xCBF29CE484222325ULL) {
+    for (size_t i = 0; i < length; ++i) {
+        seed ^= data[i];
+        seed *= 0x100000001B3ULL;
+    }
+    return seed;
+}
+
 #endif //BGP_UTIL_H
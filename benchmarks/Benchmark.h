@@ -0,0 +1,57 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_BENCHMARK_H
+#define BGP_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <utility>
+
+// Results are folded into this so the optimizer cannot drop the work being measured
+inline volatile uint64_t benchmarkSink = 0;
+
+template<typename T>
+inline void doNotOptimize(const T &value) {
+    benchmarkSink = benchmarkSink + static_cast<uint64_t>(value);
+}
+
+struct BenchmarkResult {
+    std::string Name;
+    uint64_t Operations;
+    double Seconds;
+
+    [[nodiscard]] double NanosecondsPerOperation() const {
+        return Operations == 0 ? 0.0 : Seconds * 1e9 / static_cast<double>(Operations);
+    }
+
+    [[nodiscard]] double OperationsPerSecond() const {
+        return Seconds == 0.0 ? 0.0 : static_cast<double>(Operations) / Seconds;
+    }
+};
+
+void printBenchmarkResult(const BenchmarkResult &result) {
+    std::cout << std::left << std::setw(56) << result.Name << std::right
+              << std::setw(12) << result.Operations << " ops"
+              << std::setw(12) << std::fixed << std::setprecision(1) << result.Seconds * 1e3 << " ms"
+              << std::setw(12) << std::setprecision(1) << result.NanosecondsPerOperation() << " ns/op"
+              << std::setw(14) << std::setprecision(0) << result.OperationsPerSecond() << " ops/s" << std::endl;
+}
+
+// Times a single call of function, which is expected to perform operations operations, and prints the result
+template<typename Function>
+BenchmarkResult runBenchmark(const std::string &name, const uint64_t operations, Function &&function) {
+    const auto start = std::chrono::steady_clock::now();
+    std::forward<Function>(function)();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    BenchmarkResult result{name, operations, elapsed.count()};
+    printBenchmarkResult(result);
+    return result;
+}
+
+#endif //BGP_BENCHMARK_H
@@ -0,0 +1,130 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../BgpUpdateMessage.h"
+#include "../Bmp.h"
+
+constexpr size_t UPDATE_COUNT = 100000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 10000;
+// How long the slow collector takes to read each batch, and how little the exporter may queue for it
+constexpr std::chrono::milliseconds SLOW_COLLECTOR_DELAY{2};
+constexpr size_t SLOW_COLLECTOR_QUEUE_BYTES = 1024 * 1024;
+
+// Stands in for the TCP connection to the collector: takes everything, optionally slowly
+class SinkConnection : public BmpConnection {
+public:
+    explicit SinkConnection(std::atomic<uint64_t> &bytes, const std::chrono::milliseconds delay = {})
+            : bytes_(bytes), delay_(delay) {}
+
+    bool Connect() override {
+        return true;
+    }
+
+    bool Send(const std::span<const std::span<const uint8_t>> buffers) override {
+        uint64_t bytes = 0;
+        for (const auto &buffer : buffers) {
+            bytes += buffer.size();
+            doNotOptimize(buffer.back());
+        }
+        if (delay_.count() > 0) {
+            std::this_thread::sleep_for(delay_);
+        }
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Close() override {}
+
+private:
+    std::atomic<uint64_t> &bytes_;
+    std::chrono::milliseconds delay_;
+};
+
+// UPDATEs as the receive path has them: whole messages, shared
+std::vector<std::shared_ptr<const std::vector<uint8_t>>> generateUpdates() {
+    const auto table = generateSyntheticTable(ATTRIBUTE_SET_COUNT, ATTRIBUTE_SET_COUNT);
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> updates;
+    for (size_t i = 0; i < ATTRIBUTE_SET_COUNT; ++i) {
+        BgpUpdateMessage update = {0, {}, 0, {table.Attributes[i].begin(), table.Attributes[i].end()},
+                                   {table.Routes[i]}};
+        updates.emplace_back(std::make_shared<const std::vector<uint8_t>>(flattenBgpUpdateMessage(update)));
+    }
+    return updates;
+}
+
+int main() {
+    const auto updates = generateUpdates();
+    const BmpPeer peer{0xC0000201, 64500, 0xC0000201};
+    size_t updateBytes = 0;
+    for (const auto &update : updates) {
+        updateBytes += update->size();
+    }
+    std::cout << "Average UPDATE: " << updateBytes / updates.size() << " bytes" << std::endl;
+
+    // What the receive path pays to build one Route Monitoring message, with and without copying the UPDATE
+    const auto now = std::chrono::system_clock::now();
+    runBenchmark("BMP Route Monitoring, UPDATE copied", UPDATE_COUNT, [&]() {
+        for (size_t i = 0; i < UPDATE_COUNT; ++i) {
+            const auto &update = *updates[i % updates.size()];
+            std::vector<uint8_t> message;
+            appendBmpCommonHeader(message, 0, BmpRouteMonitoring);
+            appendBmpPerPeerHeader(message, peer, now);
+            message.insert(message.end(), update.begin(), update.end());
+            finishBmpMessage(message);
+            doNotOptimize(message.back());
+        }
+    });
+    runBenchmark("BMP Route Monitoring, UPDATE by reference", UPDATE_COUNT, [&]() {
+        for (size_t i = 0; i < UPDATE_COUNT; ++i) {
+            const auto &update = updates[i % updates.size()];
+            const auto header = bmpRouteMonitoringHeader(peer, now, update->size());
+            const std::shared_ptr<const std::vector<uint8_t>> reference = update;
+            doNotOptimize(header.back() + reference->back());
+        }
+    });
+
+    // Through the exporter to a collector that keeps up: everything arrives
+    {
+        std::atomic<uint64_t> received = 0;
+        BmpExporter exporter(std::make_unique<SinkConnection>(received));
+        runBenchmark("BMP exporter, collector keeping up", UPDATE_COUNT, [&]() {
+            for (size_t i = 0; i < UPDATE_COUNT; ++i) {
+                const auto &update = updates[i % updates.size()];
+                exporter.RouteMonitoring(peer, update, *update);
+            }
+            while (exporter.sent_count() + exporter.dropped_count() < UPDATE_COUNT) {
+                std::this_thread::yield();
+            }
+        });
+        std::cout << "Sent " << exporter.sent_count() << ", dropped " << exporter.dropped_count() << ", "
+                  << received.load() / (1024 * 1024) << " MiB to the collector" << std::endl;
+    }
+
+    // A collector that reads a batch every SLOW_COLLECTOR_DELAY: the session only ever pays for queueing, the
+    // collector gets what fits and the rest is counted as dropped
+    {
+        std::atomic<uint64_t> received = 0;
+        BmpExporterOptions options;
+        options.MaxQueuedBytes = SLOW_COLLECTOR_QUEUE_BYTES;
+        BmpExporter exporter(std::make_unique<SinkConnection>(received, SLOW_COLLECTOR_DELAY), options);
+        runBenchmark("BMP exporter, slow collector, receive path", UPDATE_COUNT, [&]() {
+            for (size_t i = 0; i < UPDATE_COUNT; ++i) {
+                const auto &update = updates[i % updates.size()];
+                exporter.RouteMonitoring(peer, update, *update);
+            }
+        });
+        std::cout << "Sent " << exporter.sent_count() << ", dropped " << exporter.dropped_count() << ", "
+                  << exporter.queued_bytes() / 1024 << " KiB still queued" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,435 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <unordered_map>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../BgpHeader.h"
+#include "../BgpOpenMessage.h"
+#include "../BgpUpdateMessage.h"
+#include "../BgpNotificationMessage.h"
+#include "../RouteRefresh.h"
+#include "../Orf.h"
+#include "../GracefulRestart.h"
+#include "../AsPath.h"
+#include "../Communities.h"
+#include "../Bmp.h"
+
+constexpr size_t TABLE_SIZE = 100000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 10000;
+// Passes over each corpus, so every benchmark runs long enough to time
+constexpr size_t PASSES = 20;
+constexpr size_t MAX_MESSAGE_SIZE = 4096;
+// Withdrawals come in bursts, a whole origin or upstream at a time
+constexpr size_t WITHDRAWALS_PER_UPDATE = 200;
+constexpr size_t ORF_ENTRY_COUNT = 1000;
+
+// Every allocation the process makes goes through these, so each codec is charged for the heap allocations it makes
+// as well as for its time. The benchmark is single threaded, plain counters are enough.
+uint64_t allocationCount = 0;
+uint64_t allocatedBytes = 0;
+
+void *operator new(const std::size_t size) {
+    ++allocationCount;
+    allocatedBytes += size;
+    if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// std::pmr::new_delete_resource() allocates through these
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+    ++allocationCount;
+    allocatedBytes += size;
+    const auto align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    if (void *pointer = _aligned_malloc(size == 0 ? 1 : size, align)) {
+#else
+    if (void *pointer = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+#endif
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void operator delete(void *pointer, std::size_t, const std::align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
+
+void printCodecResult(const BenchmarkResult &result, const uint64_t allocations, const uint64_t bytes) {
+    const auto operations = static_cast<double>(std::max<uint64_t>(result.Operations, 1));
+    std::cout << std::left << std::setw(52) << result.Name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1) << result.NanosecondsPerOperation() << " ns/op"
+              << std::setw(10) << std::setprecision(2) << static_cast<double>(allocations) / operations << " allocs/op"
+              << std::setw(10) << std::setprecision(0) << static_cast<double>(bytes) / operations << " B/op"
+              << std::endl;
+}
+
+// runBenchmark() with the allocations made while function ran, per operation
+template<typename Function>
+BenchmarkResult runCodecBenchmark(const std::string &name, const uint64_t operations, Function &&function) {
+    const auto allocations = allocationCount;
+    const auto bytes = allocatedBytes;
+    const auto start = std::chrono::steady_clock::now();
+    std::forward<Function>(function)();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    const auto allocationsMade = allocationCount - allocations;
+    const auto bytesAllocated = allocatedBytes - bytes;
+
+    BenchmarkResult result{name, operations, elapsed.count()};
+    printCodecResult(result, allocationsMade, bytesAllocated);
+    return result;
+}
+
+// Runs function over every message of corpus, PASSES times
+template<typename Function>
+void runCorpusBenchmark(const std::string &name, const std::vector<std::vector<uint8_t>> &corpus, Function &&function) {
+    runCodecBenchmark(name, corpus.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &message : corpus) {
+                function(message);
+            }
+        }
+    });
+}
+
+std::span<const uint8_t> payload(const std::vector<uint8_t> &message) {
+    return std::span<const uint8_t>(message).subspan(19);
+}
+
+// What parseBgpNotificationMessage() and parseBgpOpenMessage() take, the message without its header
+std::vector<std::vector<uint8_t>> payloads(const std::vector<std::vector<uint8_t>> &corpus) {
+    std::vector<std::vector<uint8_t>> result;
+    for (const auto &message : corpus) {
+        result.emplace_back(message.begin() + 19, message.end());
+    }
+    return result;
+}
+
+// A full table as forEachRefreshUpdate() would send it: prefixes sharing an attribute set packed into as few UPDATEs
+// as fit in 4096 octets
+std::vector<BgpUpdateMessage> generateAnnouncements(const SyntheticTable &table) {
+    std::unordered_map<uint32_t, std::vector<Route>> groups;
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        groups[table.AttributeIndex[i]].emplace_back(table.Routes[i]);
+    }
+    std::vector<BgpUpdateMessage> messages;
+    for (const auto &[index, routes] : groups) {
+        const auto &attributes = table.Attributes[index];
+        size_t attributesSize = 0;
+        for (const auto &attribute : attributes) {
+            attributesSize += 3 + attribute.Value.size();
+        }
+        for (size_t i = 0; i < routes.size();) {
+            BgpUpdateMessage message{0, {}, 0, {attributes.begin(), attributes.end()}, {}};
+            for (size_t size = 23 + attributesSize; i < routes.size() && size + 5 <= MAX_MESSAGE_SIZE; size += 5) {
+                message.NLRI.emplace_back(routes[i++]);
+            }
+            messages.emplace_back(std::move(message));
+        }
+    }
+    return messages;
+}
+
+std::vector<BgpUpdateMessage> generateWithdrawals(const SyntheticTable &table) {
+    std::vector<BgpUpdateMessage> messages;
+    for (size_t i = 0; i < table.Routes.size(); i += WITHDRAWALS_PER_UPDATE) {
+        const auto last = std::min(i + WITHDRAWALS_PER_UPDATE, table.Routes.size());
+        messages.emplace_back(BgpUpdateMessage{0, {table.Routes.begin() + static_cast<ptrdiff_t>(i),
+                                                   table.Routes.begin() + static_cast<ptrdiff_t>(last)}, 0, {}, {}});
+    }
+    return messages;
+}
+
+// What the peers of a route server open with: this implementation's capabilities, plus the multiprotocol and 4-octet
+// AS capabilities nearly every other one sends
+std::vector<BgpOpenMessage> generateOpens() {
+    std::vector<BgpOpenMessage> opens;
+    for (uint16_t i = 0; i < 64; ++i) {
+        auto capabilities = routeRefreshCapabilities();
+        capabilities.emplace_back(flattenOrfCapability(OrfBoth));
+        capabilities.emplace_back(flattenGracefulRestartCapability(
+                {i % 8 == 0, 120, {{GRACEFUL_RESTART_AFI_IPV4, GRACEFUL_RESTART_SAFI_UNICAST, i % 8 == 0}}}));
+        capabilities.insert(capabilities.begin(), BgpCapability{MPBGP, 4, {0, 1, 0, 1}});
+        const uint32_t asn = 64500u + i;
+        capabilities.emplace_back(BgpCapability{FourByteAsn, 4, {_32to8(asn)}});
+        opens.emplace_back(BgpOpenMessage{0x04, static_cast<uint16_t>(asn), 90, 0x0A000001u + i, capabilities});
+    }
+    return opens;
+}
+
+std::vector<BgpNotificationMessage> generateNotifications() {
+    // RFC 8203 shutdown communication
+    const std::string shutdown = "Scheduled maintenance, back by 04:00 UTC. NOC ticket 20261019-0042";
+    std::vector<uint8_t> communication = {static_cast<uint8_t>(shutdown.size())};
+    communication.insert(communication.end(), shutdown.begin(), shutdown.end());
+    return {
+            {{CeaseError, AdministrativeShutdown}, communication},
+            {{HoldTimerExpired, 0}, {}},
+            // RFC 4486 4: AFI, SAFI and the upper bound
+            {{CeaseError, MaximumNumberOfPrefixesReached}, {0, 1, 1, _32to8(1000000u)}},
+            {{OpenMessageError, UnsupportedCapability}, {FourByteAsn, 4, _32to8(4200000000u)}},
+            {{UpdateMessageError, MalformedAttributeList}, {}}
+    };
+}
+
+PrefixList generateOrfPrefixList() {
+    std::vector<PrefixListEntry> entries;
+    for (uint32_t i = 0; i < ORF_ENTRY_COUNT; ++i) {
+        entries.emplace_back(PrefixListEntry{(i + 1) * 5, i % 10 == 0 ? Deny : Permit, 0xC6120000u + (i << 8),
+                                             24, 24, 24});
+    }
+    return {"orf", entries};
+}
+
+// parseBgpUpdateMessage() without materializing anything: one pass over the attributes and prefixes, as a raw-pointer
+// codec would make. The floor for TODO: [12].
+uint64_t walkBgpUpdateMessage(const std::span<const uint8_t> messageBytes) {
+    uint64_t sum = 0;
+    const auto walkPrefixes = [&](const std::span<const uint8_t> bytes) {
+        for (size_t i = 0; i < bytes.size(); i += 1 + (bytes[i] + 7) / 8) {
+            sum += bytes[i];
+        }
+    };
+    const size_t withdrawnLength = _8to16(messageBytes[0], messageBytes[1]);
+    walkPrefixes(messageBytes.subspan(2, withdrawnLength));
+    const size_t attributesStart = 2 + withdrawnLength + 2;
+    const size_t attributesLength = _8to16(messageBytes[attributesStart - 2], messageBytes[attributesStart - 1]);
+    const auto attributes = messageBytes.subspan(attributesStart, attributesLength);
+    for (size_t i = 0; i + 3 <= attributes.size();) {
+        const bool extended = attributes[i] & TwoByteAttribute;
+        const size_t length = extended ? _8to16(attributes[i + 2], attributes[i + 3]) : attributes[i + 2];
+        sum += attributes[i + 1];
+        i += (extended ? 4 : 3) + length;
+    }
+    walkPrefixes(messageBytes.subspan(attributesStart + attributesLength));
+    return sum;
+}
+
+int main() {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+
+    std::vector<BgpUpdateMessage> updates = generateAnnouncements(table);
+    const auto announcementCount = updates.size();
+    auto withdrawals = generateWithdrawals(table);
+    std::move(withdrawals.begin(), withdrawals.end(), std::back_inserter(updates));
+    std::vector<std::vector<uint8_t>> updateCorpus;
+    size_t updateBytes = 0;
+    for (const auto &update : updates) {
+        updateCorpus.emplace_back(flattenBgpUpdateMessage(update));
+        updateBytes += updateCorpus.back().size();
+    }
+    std::cout << "UPDATE corpus: " << announcementCount << " announcements and " << updates.size() - announcementCount
+              << " withdrawals of " << TABLE_SIZE << " prefixes, " << updateBytes / updateCorpus.size()
+              << " octets per message" << std::endl;
+
+    const auto opens = generateOpens();
+    std::vector<std::vector<uint8_t>> openCorpus;
+    for (const auto &open : opens) {
+        openCorpus.emplace_back(flattenBgpOpenMessage(open));
+    }
+    const auto openPayloads = payloads(openCorpus);
+    // The optional parameters, as parseBgpOpenMessage() hands them to parseBgpCapabilities()
+    std::vector<std::vector<uint8_t>> capabilityCorpus;
+    for (const auto &open : openPayloads) {
+        capabilityCorpus.emplace_back(open.begin() + 9, open.end());
+    }
+    const auto notifications = generateNotifications();
+    std::vector<std::vector<uint8_t>> notificationCorpus;
+    for (const auto &notification : notifications) {
+        notificationCorpus.emplace_back(flattenBgpNotificationMessage(notification));
+    }
+    const auto notificationPayloads = payloads(notificationCorpus);
+    std::vector<std::vector<uint8_t>> refreshCorpus;
+    for (const auto subtype : {NormalRouteRefresh, BeginningOfRouteRefresh, EndOfRouteRefresh}) {
+        refreshCorpus.emplace_back(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4, subtype,
+                                                                  ROUTE_REFRESH_SAFI_UNICAST}));
+    }
+    const auto orfPrefixList = generateOrfPrefixList();
+    const auto orfCorpus = flattenOrfRouteRefreshMessages(orfPrefixList);
+    std::vector<std::vector<uint8_t>> headerCorpus;
+    for (const auto *corpus : {&updateCorpus, &openCorpus, &notificationCorpus, &refreshCorpus}) {
+        for (const auto &message : *corpus) {
+            headerCorpus.emplace_back(message.begin(), message.begin() + 19);
+        }
+    }
+
+    std::cout << std::endl << "Parsing" << std::endl;
+    runCorpusBenchmark("parseBgpHeader", headerCorpus, [](const auto &header) {
+        doNotOptimize(parseBgpHeader(header).Length);
+    });
+    runCorpusBenchmark("parseBgpOpenMessage", openPayloads, [](const auto &open) {
+        doNotOptimize(parseBgpOpenMessage(open).Capabilities.size());
+    });
+    runCorpusBenchmark("parseBgpCapabilities", capabilityCorpus, [](const auto &capabilities) {
+        doNotOptimize(parseBgpCapabilities(capabilities).size());
+    });
+    MessageArena arena;
+    runCorpusBenchmark("parseBgpUpdateMessage, message arena", updateCorpus, [&](const auto &update) {
+        arena.Reset();
+        doNotOptimize(parseBgpUpdateMessage(payload(update), arena.resource()).NLRI.size());
+    });
+    runCorpusBenchmark("parseBgpUpdateMessage, default resource", updateCorpus, [](const auto &update) {
+        doNotOptimize(parseBgpUpdateMessage(payload(update)).NLRI.size());
+    });
+    runCorpusBenchmark("walkBgpUpdateMessage, no copies", updateCorpus, [](const auto &update) {
+        doNotOptimize(walkBgpUpdateMessage(payload(update)));
+    });
+    runCorpusBenchmark("parseBgpNotificationMessage", notificationPayloads, [](const auto &notification) {
+        doNotOptimize(parseBgpNotificationMessage(notification).Data.size());
+    });
+    runCorpusBenchmark("parseBgpRouteRefreshMessage", refreshCorpus, [](const auto &refresh) {
+        doNotOptimize(parseBgpRouteRefreshMessage(payload(refresh)).Subtype);
+    });
+    runCorpusBenchmark("parseOrfRequest, " + std::to_string(ORF_ENTRY_COUNT) + " entries", orfCorpus,
+                       [](const auto &refresh) {
+        doNotOptimize(parseOrfRequest(parseBgpRouteRefreshMessage(payload(refresh)).Orf).Entries.size());
+    });
+
+    // The attribute decoders import runs over every parsed UPDATE
+    std::vector<std::vector<uint8_t>> asPathCorpus;
+    std::vector<std::vector<uint8_t>> communitiesCorpus;
+    for (const auto &attributes : table.Attributes) {
+        for (const auto &attribute : attributes) {
+            if (attribute.Type == AsPathAttribute) {
+                asPathCorpus.emplace_back(attribute.Value.begin(), attribute.Value.end());
+            } else if (attribute.Type == CommunityAttribute) {
+                communitiesCorpus.emplace_back(attribute.Value.begin(), attribute.Value.end());
+            }
+        }
+    }
+    runCorpusBenchmark("parseAsPathAttribute", asPathCorpus, [](const auto &value) {
+        doNotOptimize(parseAsPathAttribute(value, true).has_value());
+    });
+    runCorpusBenchmark("parseCommunitiesAttribute", communitiesCorpus, [](const auto &value) {
+        doNotOptimize(parseCommunitiesAttribute(value)->size());
+    });
+
+    std::cout << std::endl << "Encoding" << std::endl;
+    runCodecBenchmark("generateBgpHeader", headerCorpus.size() * PASSES, [&]() {
+        for (size_t i = 0; i < headerCorpus.size() * PASSES; ++i) {
+            doNotOptimize(generateBgpHeader(static_cast<uint16_t>(i & 0x0FFF), Update)[17]);
+        }
+    });
+    runCodecBenchmark("flattenBgpOpenMessage", opens.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &open : opens) {
+                doNotOptimize(flattenBgpOpenMessage(open).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenBgpCapabilities", opens.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &open : opens) {
+                doNotOptimize(flattenBgpCapabilities(open.Capabilities).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenGracefulRestartCapability", opens.size() * PASSES, [&]() {
+        for (size_t i = 0; i < opens.size() * PASSES; ++i) {
+            doNotOptimize(flattenGracefulRestartCapability({false, static_cast<uint16_t>(i & 0x0FFF), {}}).Length);
+        }
+    });
+    runCodecBenchmark("flattenOrfCapability", opens.size() * PASSES, [&]() {
+        for (size_t i = 0; i < opens.size() * PASSES; ++i) {
+            doNotOptimize(flattenOrfCapability(static_cast<OrfSendReceive>(1 + i % 3)).Length);
+        }
+    });
+    runCodecBenchmark("flattenBgpUpdateMessage", updates.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &update : updates) {
+                doNotOptimize(flattenBgpUpdateMessage(update).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenBgpNotificationMessage", notifications.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &notification : notifications) {
+                doNotOptimize(flattenBgpNotificationMessage(notification).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenBgpRouteRefreshMessage", refreshCorpus.size() * PASSES, [&]() {
+        for (size_t i = 0; i < refreshCorpus.size() * PASSES; ++i) {
+            doNotOptimize(flattenBgpRouteRefreshMessage({ROUTE_REFRESH_AFI_IPV4,
+                                                         static_cast<RouteRefreshSubtype>(i % 3),
+                                                         ROUTE_REFRESH_SAFI_UNICAST}).size());
+        }
+    });
+    runCodecBenchmark("flattenOrfRouteRefreshMessages, " + std::to_string(ORF_ENTRY_COUNT) + " entries", PASSES,
+                      [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            doNotOptimize(flattenOrfRouteRefreshMessages(orfPrefixList).size());
+        }
+    });
+
+    const BmpPeer peer{0x0A000001, 64500, 0x0A000001};
+    const auto now = std::chrono::system_clock::now();
+    const std::vector<BmpStat> stats = {{BmpStatRejectedPrefixes, 12}, {BmpStatDuplicatePrefixes, 3400},
+                                        {BmpStatDuplicateWithdraws, 56}, {BmpStatAdjRibInRoutes, TABLE_SIZE},
+                                        {BmpStatLocRibRoutes, TABLE_SIZE}};
+    runCodecBenchmark("flattenBmpInitiation", PASSES * 1000, [&]() {
+        for (size_t i = 0; i < PASSES * 1000; ++i) {
+            doNotOptimize(flattenBmpInitiation("bgp1.example.net", "BGP").size());
+        }
+    });
+    runCodecBenchmark("flattenBmpTermination", PASSES * 1000, [&]() {
+        for (size_t i = 0; i < PASSES * 1000; ++i) {
+            doNotOptimize(flattenBmpTermination().size());
+        }
+    });
+    runCodecBenchmark("flattenBmpPeerUp", openCorpus.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &open : openCorpus) {
+                doNotOptimize(flattenBmpPeerUp(peer, now, 0x0A000002, 179, 50000, openCorpus.front(), open).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenBmpPeerDown", notificationCorpus.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &notification : notificationCorpus) {
+                doNotOptimize(flattenBmpPeerDown(peer, now, BmpRemoteNotification, notification).size());
+            }
+        }
+    });
+    runCodecBenchmark("flattenBmpStatsReport", PASSES * 1000, [&]() {
+        for (size_t i = 0; i < PASSES * 1000; ++i) {
+            doNotOptimize(flattenBmpStatsReport(peer, now, stats).size());
+        }
+    });
+    runCodecBenchmark("bmpRouteMonitoringHeader", updateCorpus.size() * PASSES, [&]() {
+        for (size_t pass = 0; pass < PASSES; ++pass) {
+            for (const auto &update : updateCorpus) {
+                doNotOptimize(bmpRouteMonitoringHeader(peer, now, update.size())[5]);
+            }
+        }
+    });
+    return 0;
+}
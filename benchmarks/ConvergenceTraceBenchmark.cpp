@@ -0,0 +1,94 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+#include "../ConvergenceTrace.h"
+
+constexpr size_t TABLE_SIZE = 500000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 50000;
+// Prefixes per UPDATE, about what a full table load packs into one
+constexpr size_t PREFIXES_PER_UPDATE = 64;
+constexpr size_t TRACE_CAPACITY = 65536;
+
+// Loads the table UPDATE by UPDATE through an Adj-RIB-In and the Loc-RIB, stamping every stage the way BgpServer does.
+// trace is nullptr when tracing is off.
+void loadTable(const SyntheticTable &table, const std::vector<std::shared_ptr<const PathAttributeSet>> &sets,
+               ConvergenceTrace *trace) {
+    RibMemory ribMemory;
+    LocRib locRib(ribMemory.resource());
+    AdjRibIn adjRibIn(locRib.AddPeer(0xC0000201, 0x0A000001, true), ribMemory.resource());
+    const auto stamp = [&](const Route &route, const ConvergenceStage stage) {
+        if (trace) {
+            trace->Stamp(route, stage);
+        }
+    };
+    for (size_t first = 0; first < table.Routes.size(); first += PREFIXES_PER_UPDATE) {
+        const auto last = std::min(first + PREFIXES_PER_UPDATE, table.Routes.size());
+        if (trace) {
+            const auto now = ConvergenceTrace::Clock::now();
+            for (size_t i = first; i < last; ++i) {
+                trace->Begin(table.Routes[i], false, now, now);
+            }
+        }
+        for (size_t i = first; i < last; ++i) {
+            const auto &route = table.Routes[i];
+            const auto &attributes = sets[table.AttributeIndex[i]];
+            if (adjRibIn.Update(route, attributes)) {
+                stamp(route, ConvergenceImported);
+                locRib.Update(route, RibPath{adjRibIn.peer(), attributes, attributes->keys()});
+                stamp(route, ConvergenceBestPath);
+            }
+        }
+        doNotOptimize(locRib.TakeChanges().size());
+        if (trace) {
+            trace->StampAll(ConvergencePublished);
+            trace->Commit();
+        }
+    }
+}
+
+int main() {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+    for (const auto &attributes : table.Attributes) {
+        sets.emplace_back(store.Intern(attributes, true));
+    }
+
+    runBenchmark("Table load, tracing off", TABLE_SIZE, [&]() {
+        loadTable(table, sets, nullptr);
+    });
+    std::unique_ptr<ConvergenceTrace> kept;
+    for (const uint32_t sampleEvery : {64u, 1u}) {
+        auto trace = std::make_unique<ConvergenceTrace>(sampleEvery, TRACE_CAPACITY);
+        runBenchmark("Table load, tracing 1 in " + std::to_string(sampleEvery), TABLE_SIZE, [&]() {
+            loadTable(table, sets, trace.get());
+        });
+        std::cout << "Sampled " << trace->sample_count() << " prefix changes" << std::endl;
+        if (!kept) {
+            kept = std::move(trace);
+        }
+    }
+
+    // What ConvergenceTraceDump reports for the 1 in 64 run
+    const auto path = (std::filesystem::temp_directory_path() / "ConvergenceTraceBenchmark.trace").string();
+    writeConvergenceTrace(path, kept->sample_every(), kept->samples());
+    const auto trace = readConvergenceTrace(path);
+    std::remove(path.c_str());
+    for (const auto &step : summarizeConvergenceTrace(trace.Samples)) {
+        std::cout << step.Name << ": " << step.Count << " samples, p50 " << step.P50 << " ns, p99 " << step.P99
+                  << " ns, max " << step.Max << " ns" << std::endl;
+    }
+    return 0;
+}
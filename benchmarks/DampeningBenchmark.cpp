@@ -0,0 +1,133 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+#include "../Dampening.h"
+
+constexpr size_t TABLE_SIZE = 100000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 10000;
+// 1 in FLAPPING_EVERY prefixes of the customer goes down and comes back every FLAP_INTERVAL
+constexpr size_t FLAPPING_EVERY = 10;
+constexpr std::chrono::seconds FLAP_INTERVAL{60};
+constexpr std::chrono::minutes STORM_TIME{30};
+// After the storm, long enough for every suppressed path to be reused
+constexpr std::chrono::minutes QUIET_TIME{90};
+// Every best path change is an UPDATE to each of these, as on a route server
+constexpr size_t OUTBOUND_PEER_COUNT = 50;
+
+struct StormResult {
+    size_t Events = 0;
+    size_t BestChanges = 0;
+    size_t Reused = 0;
+};
+
+// A customer announcing TABLE_SIZE prefixes flaps some of them for STORM_TIME, then goes quiet. Events are fed through
+// the Adj-RIB-In, dampening when it is enabled, and the Loc-RIB the way BgpServer does, on a simulated clock.
+StormResult runStorm(const SyntheticTable &table, const std::vector<std::shared_ptr<const PathAttributeSet>> &sets,
+                     const bool dampen) {
+    typedef RouteDampening::Clock Clock;
+    RibMemory ribMemory;
+    LocRib locRib(ribMemory.resource());
+    AdjRibIn adjRibIn(locRib.AddPeer(0xC0000201, 0x0A000001, true), ribMemory.resource());
+    const auto start = Clock::now();
+    std::unique_ptr<RouteDampening> dampening = dampen ? std::make_unique<RouteDampening>(DampeningParameters{}, start)
+                                                       : nullptr;
+    StormResult result;
+
+    const auto import = [&](const Route &route, const std::shared_ptr<const PathAttributeSet> &attributes) {
+        if (dampening && dampening->IsSuppressed(adjRibIn.peer(), route)) {
+            locRib.Withdraw(adjRibIn.peer(), route);
+        } else {
+            locRib.Update(route, RibPath{adjRibIn.peer(), attributes, attributes->keys()});
+        }
+    };
+    const auto announce = [&](const size_t i, const Clock::time_point now) {
+        const auto &route = table.Routes[i];
+        const auto &attributes = sets[table.AttributeIndex[i]];
+        const bool known = dampening && adjRibIn.Find(route);
+        if (adjRibIn.Update(route, attributes)) {
+            if (dampening) {
+                dampening->Announced(adjRibIn.peer(), route, known, now);
+            }
+            import(route, attributes);
+        }
+    };
+    const auto withdraw = [&](const size_t i, const Clock::time_point now) {
+        const auto &route = table.Routes[i];
+        if (adjRibIn.Withdraw(route)) {
+            if (dampening) {
+                dampening->Withdrawn(adjRibIn.peer(), route, now);
+            }
+            locRib.Withdraw(adjRibIn.peer(), route);
+        }
+    };
+    const auto poll = [&](const Clock::time_point now) {
+        if (dampening) {
+            result.Reused += dampening->Poll(now, [&](const PeerId, const Route &route) {
+                if (const auto attributes = adjRibIn.Find(route)) {
+                    import(route, *attributes);
+                }
+            });
+        }
+        for (const auto &change : locRib.TakeChanges()) {
+            result.BestChanges += change.BestChanged;
+        }
+    };
+
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        announce(i, start);
+    }
+    locRib.TakeChanges();
+
+    // Down at the start of every interval, back up half way through it, polling at the dampening granularity
+    const auto step = DampeningParameters{}.Granularity;
+    for (auto elapsed = Clock::duration::zero(); elapsed < STORM_TIME + QUIET_TIME; elapsed += step) {
+        const auto now = start + elapsed;
+        if (elapsed < STORM_TIME) {
+            const auto phase = elapsed % FLAP_INTERVAL;
+            if (phase == Clock::duration::zero() || phase == FLAP_INTERVAL / 2) {
+                for (size_t i = 0; i < table.Routes.size(); i += FLAPPING_EVERY) {
+                    if (phase == Clock::duration::zero()) {
+                        withdraw(i, now);
+                    } else {
+                        announce(i, now);
+                    }
+                    ++result.Events;
+                }
+            }
+        }
+        poll(now);
+    }
+    return result;
+}
+
+int main() {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+    for (const auto &attributes : table.Attributes) {
+        sets.emplace_back(store.Intern(attributes, true));
+    }
+
+    const auto events = (TABLE_SIZE / FLAPPING_EVERY) * 2 * (STORM_TIME / FLAP_INTERVAL);
+    for (const bool dampen : {false, true}) {
+        const std::string name = dampen ? "Flap storm with dampening" : "Flap storm without dampening";
+        StormResult result;
+        runBenchmark(name, events, [&]() {
+            result = runStorm(table, sets, dampen);
+        });
+        std::cout << name << ": " << result.Events << " events, " << result.BestChanges << " best path changes, "
+                  << result.BestChanges * OUTBOUND_PEER_COUNT << " outbound UPDATEs to " << OUTBOUND_PEER_COUNT
+                  << " peers, " << result.Reused << " paths reused" << std::endl;
+    }
+    return 0;
+}
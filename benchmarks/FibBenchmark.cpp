@@ -0,0 +1,140 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Rib.h"
+#include "../Fib.h"
+
+constexpr size_t TABLE_SIZE = 900000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 90000;
+// Real tables carry a few thousand prefixes longer than /24, mostly blackhole and customer host routes
+constexpr size_t MORE_SPECIFIC_COUNT = 5000;
+constexpr size_t LOOKUP_COUNT = 1 << 24;
+constexpr size_t CHURN_BATCH_SIZE = 10000;
+
+int main() {
+    std::mt19937 random(11);
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> attributeSets;
+    for (const auto &attributes : table.Attributes) {
+        attributeSets.emplace_back(store.Intern(attributes, true));
+    }
+
+    // One eBGP peer per synthetic neighbor AS, each path comes from the peer at the head of its AS_PATH
+    LocRib locRib;
+    for (uint32_t neighbor = 0; neighbor < 16; ++neighbor) {
+        locRib.AddPeer(0xC0000201 + neighbor, 0x0A000001 + neighbor, true);
+    }
+    const auto pathFor = [&](const uint32_t attributeIndex) {
+        const auto &attributes = attributeSets[attributeIndex];
+        return RibPath{attributes->keys().FirstAs - 64500, attributes, attributes->keys()};
+    };
+
+    std::vector<Route> moreSpecifics;
+    std::uniform_int_distribution<size_t> anyRoute(0, table.Routes.size() - 1);
+    while (moreSpecifics.size() < MORE_SPECIFIC_COUNT) {
+        const auto &covering = table.Routes[anyRoute(random)];
+        const auto length = static_cast<uint8_t>(25 + random() % 8);
+        const auto prefix = static_cast<uint32_t>((covering.Prefix | (random() & UINT32_MAX >> covering.Length)) &
+                                                  ~(UINT32_MAX >> length));
+        moreSpecifics.emplace_back(Route{length, prefix});
+    }
+
+    runBenchmark("LocRib insert, full table", table.Routes.size() + moreSpecifics.size(), [&]() {
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            locRib.Update(table.Routes[i], pathFor(table.AttributeIndex[i]));
+        }
+        for (size_t i = 0; i < moreSpecifics.size(); ++i) {
+            locRib.Update(moreSpecifics[i], pathFor(static_cast<uint32_t>(i % attributeSets.size())));
+        }
+    });
+
+    Fib fib;
+    auto changes = locRib.TakeChanges();
+    runBenchmark("Fib build from Loc-RIB, one batch", changes.size(), [&]() {
+        fib.Apply(changes);
+    });
+    std::cout << "Fib prefixes: " << fib.table().size() << ", extension groups: " << fib.table().extension_groups()
+              << ", forwarding entries: " << fib.forwarding_entry_count() << ", failed installs: " << fib.failed_installs() << std::endl;
+
+    // Destinations drawn from installed prefixes, like traffic towards routed space
+    std::vector<uint32_t> addresses(LOOKUP_COUNT);
+    for (auto &address : addresses) {
+        const auto &route = random() % 64 == 0 ? moreSpecifics[random() % moreSpecifics.size()]
+                                               : table.Routes[anyRoute(random)];
+        address = route.Prefix | (route.Length >= 32 ? 0 : random() & UINT32_MAX >> route.Length);
+    }
+
+    const auto lookups = [&](const size_t offset, const size_t count) {
+        uint64_t found = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto nextHop = fib.Lookup(addresses[(offset + i) & (LOOKUP_COUNT - 1)]);
+            found += nextHop ? *nextHop : 0;
+        }
+        doNotOptimize(found);
+    };
+
+    runBenchmark("Fib lookup, 1 thread", LOOKUP_COUNT, [&]() {
+        lookups(0, LOOKUP_COUNT);
+    });
+
+    const auto threadCount = std::max(2u, std::thread::hardware_concurrency());
+    runBenchmark("Fib lookup, " + std::to_string(threadCount) + " threads", LOOKUP_COUNT * threadCount, [&]() {
+        std::vector<std::thread> readers;
+        for (unsigned int thread = 0; thread < threadCount; ++thread) {
+            readers.emplace_back(lookups, thread * (LOOKUP_COUNT / threadCount), LOOKUP_COUNT);
+        }
+        for (auto &reader : readers) {
+            reader.join();
+        }
+    });
+
+    // Churn: move a batch of prefixes to another neighbor and back while readers keep looking up
+    std::atomic<bool> churning = true;
+    std::atomic<uint64_t> concurrentLookups = 0;
+    std::vector<std::thread> readers;
+    for (unsigned int thread = 0; thread + 1 < threadCount; ++thread) {
+        readers.emplace_back([&, thread]() {
+            size_t offset = thread * (LOOKUP_COUNT / threadCount);
+            while (churning.load(std::memory_order_relaxed)) {
+                lookups(offset, 4096);
+                offset += 4096;
+                concurrentLookups.fetch_add(4096, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    constexpr size_t churnRounds = 20;
+    const auto churn = runBenchmark("Fib incremental update, " + std::to_string(CHURN_BATCH_SIZE) + " route batches",
+                                    churnRounds * CHURN_BATCH_SIZE, [&]() {
+        for (size_t round = 0; round < churnRounds; ++round) {
+            for (size_t i = 0; i < CHURN_BATCH_SIZE; ++i) {
+                const auto index = anyRoute(random);
+                auto path = pathFor(table.AttributeIndex[index]);
+                path.Keys.NextHopAddress = 0xC0000201 + static_cast<uint32_t>(round % 16);
+                locRib.Update(table.Routes[index], std::move(path));
+            }
+            fib.Apply(locRib.TakeChanges());
+        }
+    });
+
+    churning.store(false, std::memory_order_relaxed);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    std::cout << "Lookups during updates: " << concurrentLookups.load() / churn.Seconds / 1e6 << " M/s over "
+              << threadCount - 1 << " threads" << std::endl;
+
+    return 0;
+}
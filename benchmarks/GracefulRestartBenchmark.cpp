@@ -0,0 +1,139 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+#include "../GracefulRestart.h"
+
+constexpr size_t TABLE_SIZE = 1000000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 100000;
+// Besides the one that restarts
+constexpr uint32_t OTHER_PEER_COUNT = 2;
+// While it was away the restarting peer's table moved on a little: 1 in CHANGED_EVERY prefixes comes back with other
+// attributes, 1 in GONE_EVERY does not come back at all
+constexpr size_t CHANGED_EVERY = 100;
+constexpr size_t GONE_EVERY = 200;
+
+struct Churn {
+    size_t Changes = 0;
+    size_t BestChanges = 0;
+};
+
+Churn takeChurn(LocRib &locRib) {
+    Churn churn;
+    for (const auto &change : locRib.TakeChanges()) {
+        ++churn.Changes;
+        churn.BestChanges += change.BestChanged;
+    }
+    return churn;
+}
+
+void printChurn(const std::string &name, const Churn &churn) {
+    std::cout << name << ": " << churn.Changes << " Loc-RIB changes, " << churn.BestChanges << " best path changes"
+              << std::endl;
+}
+
+// A full table peer restarts while two others keep theirs. Without graceful restart its routes are withdrawn and then
+// learned again; as a helper they are marked stale and only the difference moves.
+int main() {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    RibMemory ribMemory;
+    PathAttributeStore store(ribMemory.resource());
+    LocRib locRib(ribMemory.resource());
+    std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+    for (const auto &attributes : table.Attributes) {
+        sets.emplace_back(store.Intern(attributes, true));
+    }
+
+    std::vector<std::unique_ptr<AdjRibIn>> adjRibsIn;
+    for (uint32_t peer = 0; peer <= OTHER_PEER_COUNT; ++peer) {
+        adjRibsIn.emplace_back(std::make_unique<AdjRibIn>(locRib.AddPeer(0xC0000201 + peer, 0x0A000001 + peer, true),
+                                                          ribMemory.resource()));
+    }
+    const auto announce = [&](AdjRibIn &adjRibIn, const size_t i, const size_t offset) {
+        const auto &attributes = sets[(table.AttributeIndex[i] + adjRibIn.peer() + offset) % sets.size()];
+        if (adjRibIn.Update(table.Routes[i], attributes)) {
+            locRib.Update(table.Routes[i], RibPath{adjRibIn.peer(), attributes, attributes->keys()});
+        }
+    };
+    for (auto &adjRibIn : adjRibsIn) {
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            announce(*adjRibIn, i, 0);
+        }
+    }
+    locRib.TakeChanges();
+    auto &restarting = *adjRibsIn.front();
+    const auto relearn = [&]() {
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            if (i % GONE_EVERY != 0) {
+                announce(restarting, i, i % CHANGED_EVERY == 0 ? 1 : 0);
+            }
+        }
+    };
+
+    // Graceful restart: the session drops, comes back, re-announces, sends End-of-RIB
+    GracefulRestartHelper helper(restarting);
+    GracefulRestartCapability capability{false, 120, {{GRACEFUL_RESTART_AFI_IPV4, GRACEFUL_RESTART_SAFI_UNICAST, true}}};
+    const auto now = GracefulRestartHelper::Clock::now();
+    runBenchmark("Graceful restart mark peer stale", restarting.size(), [&]() {
+        helper.SessionDown(now, capability);
+    });
+    std::cout << "Stale routes: " << helper.stale_count() << std::endl;
+    const auto downChurn = takeChurn(locRib);
+    helper.SessionEstablished(now, capability);
+    runBenchmark("Graceful restart re-announce", restarting.size(), [&]() {
+        relearn();
+    });
+    const auto relearnChurn = takeChurn(locRib);
+    helper.EndOfRib();
+    const auto stale = helper.stale_count();
+    size_t batches = 0;
+    runBenchmark("Graceful restart sweep after End-of-RIB, whole table", restarting.size(), [&]() {
+        while (helper.state() == GracefulRestartSweeping) {
+            helper.Poll(now, [&](const Route &route) {
+                locRib.Withdraw(restarting.peer(), route);
+            });
+            ++batches;
+        }
+    });
+    const auto sweepChurn = takeChurn(locRib);
+    std::cout << "Swept " << stale << " stale routes in " << batches << " batches" << std::endl;
+    printChurn("Graceful restart, session down", downChurn);
+    printChurn("Graceful restart, re-announce", relearnChurn);
+    printChurn("Graceful restart, sweep", sweepChurn);
+    const auto gracefulChanges = downChurn.Changes + relearnChurn.Changes + sweepChurn.Changes;
+    const auto gracefulBestChanges = downChurn.BestChanges + relearnChurn.BestChanges + sweepChurn.BestChanges;
+
+    // Put the original table back, then restart without graceful restart: withdraw everything, learn it again
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        announce(restarting, i, 0);
+    }
+    locRib.TakeChanges();
+    runBenchmark("Plain restart withdraw peer", restarting.size(), [&]() {
+        restarting.ForEach([&](const Route &route, const auto &) {
+            locRib.Withdraw(restarting.peer(), route);
+        });
+        restarting.Clear();
+    });
+    const auto withdrawChurn = takeChurn(locRib);
+    runBenchmark("Plain restart re-announce", TABLE_SIZE - TABLE_SIZE / GONE_EVERY, [&]() {
+        relearn();
+    });
+    const auto plainRelearnChurn = takeChurn(locRib);
+    printChurn("Plain restart, withdraw", withdrawChurn);
+    printChurn("Plain restart, re-announce", plainRelearnChurn);
+    const auto plainChanges = withdrawChurn.Changes + plainRelearnChurn.Changes;
+    const auto plainBestChanges = withdrawChurn.BestChanges + plainRelearnChurn.BestChanges;
+
+    std::cout << "Churn avoided: " << plainChanges - gracefulChanges << " of " << plainChanges << " Loc-RIB changes, "
+              << plainBestChanges - gracefulBestChanges << " of " << plainBestChanges << " best path changes"
+              << std::endl;
+    return 0;
+}
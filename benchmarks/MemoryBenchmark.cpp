@@ -0,0 +1,121 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <optional>
+#include <algorithm>
+#include <memory_resource>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "MemoryUsage.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+
+constexpr size_t TABLE_SIZE = 900000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 90000;
+constexpr size_t FLAP_COUNT = 10;
+
+void printMemory(const std::string &configuration, const std::string &phase, const size_t baseline,
+                 const CountingResource &counting) {
+    const auto current = residentBytes();
+    const auto resident = current - std::min(current, baseline);
+    std::cout << std::left << std::setw(10) << configuration << std::setw(20) << phase << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << resident / 1048576.0 << " MiB RSS"
+              << std::setw(10) << counting.live() / 1048576.0 << " MiB live"
+              << std::setw(10) << std::setprecision(2)
+              << (counting.live() == 0 ? 0.0 : static_cast<double>(resident) / static_cast<double>(counting.live()))
+              << " RSS/live" << std::endl;
+}
+
+// Two eBGP peers carrying the full table, the first one flapping: every flap withdraws its whole table, lets go of its
+// attribute sets, and announces it again. Run once per allocator configuration, each in a fresh process so they do not
+// inherit each other's heap.
+int runConfiguration(const std::string &configuration) {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    const auto baseline = residentBytes();
+
+    std::optional<RibMemory> ribMemory;
+    if (configuration != "default") {
+        ribMemory.emplace(configuration == "hugepage");
+    }
+    CountingResource counting(ribMemory ? ribMemory->resource() : std::pmr::new_delete_resource());
+    {
+        PathAttributeStore store(&counting);
+        LocRib locRib(&counting);
+        const PeerId flapping = locRib.AddPeer(0xC0000201, 0x0A000001, true);
+        const PeerId stable = locRib.AddPeer(0xC0000202, 0x0A000002, true);
+        AdjRibIn flappingIn(flapping, &counting);
+        AdjRibIn stableIn(stable, &counting);
+
+        const auto announce = [&](AdjRibIn &adjRibIn, const size_t offset) {
+            std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+            for (const auto &attributes : table.Attributes) {
+                sets.emplace_back(store.Intern(attributes, true));
+            }
+            for (size_t i = 0; i < table.Routes.size(); ++i) {
+                const auto &attributes = sets[(table.AttributeIndex[i] + offset) % sets.size()];
+                if (adjRibIn.Update(table.Routes[i], attributes)) {
+                    locRib.Update(table.Routes[i], RibPath{adjRibIn.peer(), attributes, attributes->keys()});
+                }
+            }
+            locRib.TakeChanges();
+        };
+
+        runBenchmark(configuration + ", full table from two peers", 2 * table.Routes.size(), [&]() {
+            announce(stableIn, 1);
+            announce(flappingIn, 0);
+        });
+        printMemory(configuration, "loaded", baseline, counting);
+
+        runBenchmark(configuration + ", " + std::to_string(FLAP_COUNT) + " full table flaps",
+                     2 * FLAP_COUNT * table.Routes.size(), [&]() {
+            for (size_t flap = 0; flap < FLAP_COUNT; ++flap) {
+                for (const auto &route : table.Routes) {
+                    if (flappingIn.Withdraw(route)) {
+                        locRib.Withdraw(flapping, route);
+                    }
+                }
+                locRib.TakeChanges();
+                locRib.Purge();
+                store.Purge();
+                announce(flappingIn, 0);
+            }
+        });
+        printMemory(configuration, "after flaps", baseline, counting);
+
+        stableIn.Clear();
+        flappingIn.Clear();
+        for (const auto &route : table.Routes) {
+            locRib.Withdraw(flapping, route);
+            locRib.Withdraw(stable, route);
+        }
+        locRib.TakeChanges();
+        locRib.Purge();
+        store.Purge();
+        printMemory(configuration, "after teardown", baseline, counting);
+    }
+    if (const auto hugePages = ribMemory ? ribMemory->huge_pages() : nullptr) {
+        std::cout << configuration << ": " << hugePages->mapped() / 1048576 << " MiB mapped, "
+                  << hugePages->huge_mapped() / 1048576 << " MiB of it huge pages" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        return runConfiguration(argv[1]);
+    }
+    for (const auto configuration : {"default", "pool", "hugepage"}) {
+        const auto command = std::string("\"") + argv[0] + "\" " + configuration;
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << configuration << " failed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
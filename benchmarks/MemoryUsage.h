@@ -0,0 +1,88 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_MEMORYUSAGE_H
+#define BGP_MEMORYUSAGE_H
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <memory_resource>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+// Counts what the RIB asks for, as opposed to what the process ends up holding, the difference is overhead and
+// fragmentation
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource *upstream) : upstream_(upstream) {}
+
+    [[nodiscard]] size_t live() const {
+        return live_;
+    }
+
+private:
+    void *do_allocate(const size_t bytes, const size_t alignment) override {
+        live_ += bytes;
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, const size_t bytes, const size_t alignment) override {
+        live_ -= bytes;
+        upstream_->deallocate(pointer, bytes, alignment);
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource *upstream_;
+    size_t live_ = 0;
+};
+
+// Resident set size of this process, 0 if it cannot be read
+size_t residentBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Highest resident set size this process has had so far, 0 if it cannot be read
+size_t peakResidentBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string field;
+    while (status >> field) {
+        if (field == "VmHWM:") {
+            size_t kibibytes = 0;
+            status >> kibibytes;
+            return kibibytes * 1024;
+        }
+    }
+    return 0;
+#endif
+}
+
+#endif //BGP_MEMORYUSAGE_H
@@ -0,0 +1,78 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "Benchmark.h"
+#include "../Metrics.h"
+
+constexpr size_t OPERATION_COUNT = 10000000;
+// A route server's worth of peers, for scraping
+constexpr size_t PEER_COUNT = 200;
+constexpr size_t SCRAPE_COUNT = 100;
+constexpr size_t THREAD_COUNT = 4;
+
+int main() {
+    MetricsRegistry metrics;
+    const auto peer = metrics.Peer(0xC0000201);
+    auto &histogram = metrics.Histogram("bgp_benchmark", "Benchmark");
+
+    // What the receive path pays per message and per UPDATE
+    runBenchmark("Metrics count received message", OPERATION_COUNT, [&]() {
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            peer->Received(Update, 64 + (i & 63));
+        }
+    });
+    runBenchmark("Metrics record latency", OPERATION_COUNT, [&]() {
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            histogram.Record(static_cast<uint64_t>(1000 + (i & 0xFFFF)));
+        }
+    });
+    auto &clock = metrics.Histogram("bgp_benchmark_clock", "Benchmark clock to clock");
+    runBenchmark("Metrics time and record latency", OPERATION_COUNT, [&]() {
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            clock.Record(std::chrono::steady_clock::now() - start);
+        }
+    });
+    const auto snapshot = clock.snapshot();
+    std::cout << "Clock to clock: p50 " << snapshot.Quantile(0.5) << " ns, p99 " << snapshot.Quantile(0.99)
+              << " ns, p99.9 " << snapshot.Quantile(0.999) << " ns" << std::endl;
+
+    // Threads recording for the same peer write shards of their own, and nothing is lost
+    const auto shared = metrics.Peer(0xC0000202);
+    runBenchmark("Metrics count received message, " + std::to_string(THREAD_COUNT) + " threads", OPERATION_COUNT, [&]() {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < THREAD_COUNT; ++t) {
+            threads.emplace_back([&]() {
+                for (size_t i = 0; i < OPERATION_COUNT / THREAD_COUNT; ++i) {
+                    shared->Received(Keepalive, 19);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    });
+    std::cout << "Counted " << shared->counters().MessagesReceived[Keepalive] << " of "
+              << OPERATION_COUNT / THREAD_COUNT * THREAD_COUNT << std::endl;
+
+    for (uint32_t i = 0; i < PEER_COUNT; ++i) {
+        const auto other = metrics.Peer(0x0A000000 + i);
+        other->Received(Update, 100);
+        other->StateChanged(5);
+    }
+    size_t scrapeBytes = 0;
+    runBenchmark("Metrics scrape, " + std::to_string(PEER_COUNT) + " peers", SCRAPE_COUNT, [&]() {
+        for (size_t i = 0; i < SCRAPE_COUNT; ++i) {
+            scrapeBytes = metrics.Scrape().size();
+        }
+    });
+    std::cout << "Scrape: " << scrapeBytes / 1024 << " KiB" << std::endl;
+    return 0;
+}
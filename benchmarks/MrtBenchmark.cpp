@@ -0,0 +1,250 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <unordered_map>
+#include <filesystem>
+#include <optional>
+#include <algorithm>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Mrt.h"
+#include "../AsPath.h"
+#include "../MrtWriter.h"
+#include "../BgpUpdateMessage.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+
+constexpr size_t TABLE_SIZE = 1000000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 100000;
+// Collectors usually have a few dozen peers, but most of them only send a partial table
+constexpr uint16_t PEER_COUNT = 4;
+constexpr size_t ARCHIVE_COUNT = 2000000;
+
+void appendMrtRecord(std::vector<uint8_t> &bytes, const MrtType type, const uint16_t subtype,
+                     const std::vector<uint8_t> &body) {
+    const uint8_t header[12] = {_32to8(1700000000), _16to8(type), _16to8(subtype), _32to8(body.size())};
+    bytes.insert(bytes.end(), header, header + sizeof(header));
+    bytes.insert(bytes.end(), body.begin(), body.end());
+}
+
+// A TABLE_DUMP_V2 dump of the synthetic table as PEER_COUNT peers would have sent it, each peer's path for a prefix
+// using a different attribute set
+std::vector<uint8_t> generateSyntheticDump(const SyntheticTable &table) {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> body = {_32to8(0x0A0000FE), 0, 0, _16to8(PEER_COUNT)};
+    for (uint16_t peer = 0; peer < PEER_COUNT; ++peer) {
+        const uint8_t entry[] = {0x02, _32to8(0x0A000001 + peer), _32to8(0xC0000201 + peer), _32to8(64500 + peer)};
+        body.insert(body.end(), entry, entry + sizeof(entry));
+    }
+    appendMrtRecord(bytes, TableDumpV2, PeerIndexTable, body);
+
+    std::vector<std::vector<uint8_t>> encodedAttributes;
+    for (const auto &attributes : table.Attributes) {
+        std::vector<uint8_t> encoded;
+        for (const auto &attribute : attributes) {
+            appendPathAttribute(encoded, attribute);
+        }
+        encodedAttributes.emplace_back(std::move(encoded));
+    }
+
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        body.clear();
+        const uint8_t sequence[4] = {_32to8(i)};
+        body.insert(body.end(), sequence, sequence + 4);
+        appendIpv4Prefix(body, table.Routes[i]);
+        body.insert(body.end(), {_16to8(PEER_COUNT)});
+        for (uint16_t peer = 0; peer < PEER_COUNT; ++peer) {
+            const auto &attributes = encodedAttributes[(table.AttributeIndex[i] + peer) % encodedAttributes.size()];
+            const uint8_t entry[8] = {_16to8(peer), _32to8(1700000000), _16to8(attributes.size())};
+            body.insert(body.end(), entry, entry + sizeof(entry));
+            body.insert(body.end(), attributes.begin(), attributes.end());
+        }
+        appendMrtRecord(bytes, TableDumpV2, RibIpv4Unicast, body);
+    }
+    return bytes;
+}
+
+// Archives an UPDATE for a session with and without 4-octet ASNs and reads it back the way BgpServer::LoadMrt() does,
+// checking the record's subtype tells the AS_PATH's encoding apart. Returns false if either comes back different.
+bool checkArchiveRoundTrip(const std::filesystem::path &directory) {
+    const std::vector<uint32_t> asns = {64500, 13335, 3356};
+    for (const auto fourOctetAsns : {false, true}) {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        std::vector<uint8_t> asPath = {ASSequence, static_cast<uint8_t>(asns.size())};
+        for (const auto asn : asns) {
+            if (fourOctetAsns) {
+                asPath.insert(asPath.end(), {_32to8(asn)});
+            } else {
+                asPath.insert(asPath.end(), {_16to8(asn)});
+            }
+        }
+        const BgpUpdateMessage update = {0, {}, 0, {{Transitive, OriginAttribute, {IGP}},
+                                                    {Transitive, AsPathAttribute, {asPath.begin(), asPath.end()}},
+                                                    {Transitive, NextHopAttribute, {_32to8(0xC0000201)}}},
+                                         {Route{24, 0xC6336400}}};
+        const auto bytes = flattenBgpUpdateMessage(update);
+        {
+            MrtWriter writer(MrtWriterOptions{directory.string()});
+            writer.ArchiveMessage(MrtSession{64500, 64496, 0xC0000201, 0xC0000202, 0, fourOctetAsns}, bytes);
+        }
+
+        std::optional<DecodedAsPath> decoded;
+        for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+            const MrtFile file(entry.path().string());
+            MrtReader reader(file.bytes());
+            while (const auto record = reader.Next()) {
+                const auto message = parseMrtBgp4mpMessage(*record);
+                if (message.PeerAsn != 64500 || message.LocalAsn != 64496 || message.PeerAddress != 0xC0000201 ||
+                    message.FourOctetAsns != fourOctetAsns || !std::ranges::equal(message.Message, bytes)) {
+                    return false;
+                }
+                MessageArena arena;
+                const auto parsed = parseBgpUpdateMessage(message.Message.subspan(19), arena.resource());
+                for (const auto &attribute : parsed.PathAttributes) {
+                    if (attribute.Type == AsPathAttribute) {
+                        decoded = parseAsPathAttribute(attribute.Value, message.FourOctetAsns);
+                    }
+                }
+            }
+        }
+        if (!decoded || decoded->Asns != asns) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walks a dump the way BgpServer::LoadMrt() does: every RIB entry becomes an UPDATE decoded into the message arena,
+// interned, and applied to the peer's Adj-RIB-In and the Loc-RIB
+int main(int argc, char **argv) {
+    std::string path;
+    if (argc > 1) {
+        path = argv[1];
+    } else {
+        path = "MrtBenchmark.mrt";
+        const auto dump = generateSyntheticDump(generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT));
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(dump.data()),
+                                                    static_cast<std::streamsize>(dump.size()));
+    }
+
+    // Unmapped before the generated dump is removed
+    {
+        const MrtFile file(path);
+        std::cout << path << ": " << file.bytes().size() / 1048576 << " MiB" << std::endl;
+
+        size_t recordCount = 0;
+        size_t entryCount = 0;
+        for (MrtReader reader(file.bytes()); reader.Next();) {
+            ++recordCount;
+        }
+        runBenchmark("MRT walk records", recordCount, [&]() {
+            MrtReader reader(file.bytes());
+            while (const auto record = reader.Next()) {
+                doNotOptimize(record->Body.size());
+            }
+        });
+
+        MessageArena arena;
+        runBenchmark("MRT decode RIB entries and attributes", recordCount, [&]() {
+            MrtReader reader(file.bytes());
+            while (const auto record = reader.Next()) {
+                if (record->Type == TableDumpV2 && record->Subtype == RibIpv4Unicast) {
+                    parseMrtRib(*record).ForEachEntry([&](const MrtRibEntry &entry) {
+                        std::pmr::vector<PathAttribute> attributes(arena.resource());
+                        parsePathAttributes(entry.Attributes, attributes);
+                        doNotOptimize(attributes.size());
+                        ++entryCount;
+                    });
+                }
+                arena.Reset();
+            }
+        });
+        std::cout << "RIB entries: " << entryCount << std::endl;
+
+        RibMemory ribMemory;
+        PathAttributeStore store(ribMemory.resource());
+        LocRib locRib(ribMemory.resource());
+        std::unordered_map<uint16_t, std::unique_ptr<AdjRibIn>> adjRibsIn;
+        runBenchmark("MRT load into Adj-RIB-In and Loc-RIB", entryCount, [&]() {
+            MrtReader reader(file.bytes());
+            std::vector<MrtPeer> peers;
+            while (const auto record = reader.Next()) {
+                if (record->Type == TableDumpV2 && record->Subtype == PeerIndexTable) {
+                    peers = parseMrtPeerIndexTable(*record);
+                } else if (record->Type == TableDumpV2 && record->Subtype == RibIpv4Unicast) {
+                    const auto rib = parseMrtRib(*record);
+                    rib.ForEachEntry([&](const MrtRibEntry &entry) {
+                        auto &adjRibIn = adjRibsIn[entry.PeerIndex];
+                        if (!adjRibIn) {
+                            const auto &peer = peers.at(entry.PeerIndex);
+                            adjRibIn = std::make_unique<AdjRibIn>(locRib.AddPeer(peer.Address, peer.BgpIdentifier, true),
+                                                                  ribMemory.resource());
+                        }
+                        std::pmr::vector<PathAttribute> attributes(arena.resource());
+                        parsePathAttributes(entry.Attributes, attributes);
+                        const auto set = store.Intern(attributes, true);
+                        if (adjRibIn->Update(rib.Prefix, set)) {
+                            locRib.Update(rib.Prefix, RibPath{adjRibIn->peer(), set, set->keys()});
+                        }
+                    });
+                }
+                arena.Reset();
+            }
+            locRib.TakeChanges();
+        });
+        std::cout << "Loc-RIB prefixes: " << locRib.size() << ", paths: " << locRib.path_count() << ", attribute sets: "
+                  << store.size() << std::endl;
+    }
+
+    if (argc <= 1) {
+        std::remove(path.c_str());
+    }
+
+    // Archiving: what the receive path pays per message, and whether the writer keeps up
+    const auto table = generateSyntheticTable(ARCHIVE_COUNT, ATTRIBUTE_SET_COUNT);
+    std::vector<std::vector<uint8_t>> messages;
+    for (size_t i = 0; i < ATTRIBUTE_SET_COUNT; ++i) {
+        BgpUpdateMessage update = {0, {}, 0, {table.Attributes[i].begin(), table.Attributes[i].end()}, {table.Routes[i]}};
+        messages.emplace_back(flattenBgpUpdateMessage(update));
+    }
+    const auto directory = std::filesystem::temp_directory_path() / "MrtBenchmark";
+    const auto roundTrip = checkArchiveRoundTrip(directory);
+    std::cout << "MRT archive round trip, 2 and 4-octet ASNs: " << (roundTrip ? "ok" : "FAILED") << std::endl;
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    {
+        MrtWriterOptions options{directory.string()};
+        options.MaxFileBytes = 64 * 1024 * 1024;
+        MrtWriter writer(options);
+        // The synthetic AS_PATHs are 4-octet
+        const MrtSession session{64500, 64496, 0xC0000201, 0xC0000202, 0, true};
+        runBenchmark("MRT archive UPDATE, receive path", ARCHIVE_COUNT, [&]() {
+            for (size_t i = 0; i < ARCHIVE_COUNT; ++i) {
+                writer.ArchiveMessage(session, messages[i % messages.size()]);
+            }
+        });
+        runBenchmark("MRT archive flush", 1, [&]() {
+            writer.Flush();
+        });
+
+        size_t archived = 0;
+        for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+            const MrtFile file(entry.path().string());
+            for (MrtReader reader(file.bytes()); reader.Next();) {
+                ++archived;
+            }
+        }
+        std::cout << "Archived " << writer.records() << " records, dropped " << writer.dropped() << ", read back "
+                  << archived << " from " << writer.files() << " files" << std::endl;
+    }
+    std::filesystem::remove_all(directory);
+    return roundTrip ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Rib.h"
+#include "../Fib.h"
+#include "../NextHopResolver.h"
+
+constexpr size_t TABLE_SIZE = 900000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 90000;
+constexpr NextHop TRANSIT_A = 0xC0000201;
+constexpr NextHop TRANSIT_B = 0xC0000202;
+constexpr size_t RESOLVED_ROUTE_COUNT = 1000000;
+constexpr uint32_t IBGP_PEER_COUNT = 50;
+// iBGP peers' loopbacks, 10.255.0.1 and up
+constexpr NextHop LOOPBACKS = 0x0AFF0001;
+
+// Counts the sampled prefixes forwarded to nextHop
+size_t countForwardedTo(const Fib &fib, const SyntheticTable &table, const NextHop nextHop) {
+    size_t count = 0;
+    for (size_t i = 0; i < table.Routes.size(); i += 97) {
+        count += fib.Lookup(table.Routes[i].Prefix) == nextHop;
+    }
+    return count;
+}
+
+size_t countForwarded(const Fib &fib, const SyntheticTable &table) {
+    size_t count = 0;
+    for (size_t i = 0; i < table.Routes.size(); i += 97) {
+        count += fib.Lookup(table.Routes[i].Prefix).has_value();
+    }
+    return count;
+}
+
+// An IGP table as a route reflector client would see it: a /32 loopback per iBGP peer, a few hundred infrastructure
+// prefixes, written out and loaded back the way a lab instance would load it
+IgpTable writeAndLoadIgpTable() {
+    const auto path = std::filesystem::temp_directory_path() / "bgp-benchmark-igp.txt";
+    {
+        std::ofstream file(path);
+        file << "# prefix metric interface" << std::endl;
+        for (uint32_t peer = 0; peer < IBGP_PEER_COUNT; ++peer) {
+            const auto loopback = LOOPBACKS + peer;
+            file << (loopback >> 24) << "." << (loopback >> 16 & 0xFF) << "." << (loopback >> 8 & 0xFF) << "."
+                 << (loopback & 0xFF) << "/32 " << 10 + peer * 10 << " " << peer % 4 << std::endl;
+        }
+        for (uint32_t link = 0; link < 400; ++link) {
+            file << "10." << link / 4 << "." << link % 4 * 64 << ".0/26 " << 10 + link % 7 << " " << link % 4
+                 << std::endl;
+        }
+    }
+    auto table = loadIgpTable(path.string());
+    std::filesystem::remove(path);
+    return table;
+}
+
+void benchmarkResolution() {
+    std::cout << std::endl << "Next hop resolution, " << RESOLVED_ROUTE_COUNT << " routes over " << IBGP_PEER_COUNT
+              << " iBGP next hops" << std::endl;
+    const auto table = generateSyntheticTable(RESOLVED_ROUTE_COUNT, ATTRIBUTE_SET_COUNT, 5);
+
+    NextHopResolver resolver;
+    runBenchmark("Load IGP table from file", 1, [&]() {
+        resolver = NextHopResolver(writeAndLoadIgpTable());
+    });
+    const auto nextHopFor = [](const size_t route) {
+        return LOOPBACKS + static_cast<uint32_t>(route % IBGP_PEER_COUNT);
+    };
+
+    runBenchmark("Resolve without cache, LPM per route", table.Routes.size(), [&]() {
+        uint64_t metrics = 0;
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            const auto route = resolver.table().Lookup(nextHopFor(i));
+            metrics += route ? route->Metric : 0;
+        }
+        doNotOptimize(metrics);
+    });
+    runBenchmark("Resolve with per-next-hop cache", table.Routes.size(), [&]() {
+        uint64_t metrics = 0;
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            metrics += resolver.Resolve(nextHopFor(i)).Metric;
+        }
+        doNotOptimize(metrics);
+    });
+    std::cout << "Resolver cache hits: " << resolver.hits() << ", misses: " << resolver.misses() << std::endl;
+
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> attributeSets;
+    for (const auto &attributes : table.Attributes) {
+        attributeSets.emplace_back(store.Intern(attributes, true));
+    }
+    LocRib locRib;
+    locRib.SetNextHopResolver(resolver.resolver());
+    for (uint32_t peer = 0; peer < IBGP_PEER_COUNT; ++peer) {
+        locRib.AddPeer(LOOPBACKS + peer, LOOPBACKS + peer, false);
+    }
+    Fib fib;
+    runBenchmark("LocRib + Fib load, resolved next hops", table.Routes.size(), [&]() {
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            const auto &attributes = attributeSets[table.AttributeIndex[i]];
+            auto keys = attributes->keys();
+            keys.NextHopAddress = nextHopFor(i);
+            locRib.Update(table.Routes[i], RibPath{static_cast<PeerId>(i % IBGP_PEER_COUNT), attributes, keys});
+        }
+        fib.Apply(locRib.TakeChanges());
+    });
+
+    // An IGP change only touches the cached next hops inside the changed prefix
+    const Route loopback{32, LOOPBACKS + 7};
+    size_t changes = 0;
+    size_t pathListChanges = 0;
+    runBenchmark("IGP metric change on one loopback", 1, [&]() {
+        for (const auto &change : resolver.AddRoute(IgpRoute{loopback, 1000, 1})) {
+            pathListChanges += locRib.SetNextHopResolution(change.Address, change.Resolution);
+            fib.Refresh(change.Address);
+            ++changes;
+        }
+    });
+    runBenchmark("IGP loopback withdrawn", 1, [&]() {
+        for (const auto &change : resolver.RemoveRoute(loopback)) {
+            pathListChanges += locRib.SetNextHopResolution(change.Address, change.Resolution);
+            fib.Refresh(change.Address);
+            ++changes;
+        }
+    });
+    std::cout << "Next hops re-resolved: " << changes << ", path lists with a new best path: "
+              << pathListChanges << ", sampled prefixes still forwarded: "
+              << countForwarded(fib, table) << " of " << (table.Routes.size() + 96) / 97 << std::endl;
+}
+
+// Two route reflectors sending the full table with identical attributes, so the IGP metric to their loopbacks picks the
+// best path: A at metric 30 is the backup, B at metric 20 the best. Losing A's loopback must not reorder anything, its
+// paths were already behind B's and stay there.
+void benchmarkBackupLoss(const SyntheticTable &table,
+                         const std::vector<std::shared_ptr<const PathAttributeSet>> &attributeSets) {
+    const NextHop reflectorA = LOOPBACKS;
+    const NextHop reflectorB = LOOPBACKS + 1;
+    LocRib locRib;
+    const auto peerA = locRib.AddPeer(reflectorA, reflectorA, false);
+    const auto peerB = locRib.AddPeer(reflectorB, reflectorB, false);
+    Fib fib;
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        const auto &attributes = attributeSets[table.AttributeIndex[i]];
+        auto keys = attributes->keys();
+        keys.NextHopAddress = reflectorA;
+        locRib.Update(table.Routes[i], RibPath{peerA, attributes, keys});
+        keys.NextHopAddress = reflectorB;
+        locRib.Update(table.Routes[i], RibPath{peerB, attributes, keys});
+    }
+    locRib.SetNextHopResolution(reflectorA, NextHopResolution{true, 30, 1});
+    locRib.SetNextHopResolution(reflectorB, NextHopResolution{true, 20, 1});
+    fib.Apply(locRib.TakeChanges());
+
+    size_t pathListChanges = 0;
+    runBenchmark("Fib converge, lose backup next hop at IGP metric 30", 1, [&]() {
+        pathListChanges = locRib.SetNextHopResolution(reflectorA, NextHopResolution{false, 0, 0});
+        fib.Refresh(reflectorA);
+    });
+    std::cout << "Path lists with a new best path: " << pathListChanges << ", prefix changes: "
+              << locRib.TakeChanges().size() << ", sampled prefixes via B: "
+              << countForwardedTo(fib, table, reflectorB) << " of " << (table.Routes.size() + 96) / 97 << std::endl;
+}
+
+int main() {
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> attributeSets;
+    for (const auto &attributes : table.Attributes) {
+        attributeSets.emplace_back(store.Intern(attributes, true));
+    }
+
+    // Two transits sending the full table, A preferred by LOCAL_PREF and B kept as the backup
+    LocRib locRib;
+    const auto transitA = locRib.AddPeer(TRANSIT_A, 0x0A000001, true);
+    const auto transitB = locRib.AddPeer(TRANSIT_B, 0x0A000002, true);
+    const auto pathFor = [&](const PeerId peer, const uint32_t attributeIndex) {
+        const auto &attributes = attributeSets[attributeIndex];
+        auto keys = attributes->keys();
+        keys.NextHopAddress = peer == transitA ? TRANSIT_A : TRANSIT_B;
+        keys.LocalPreference = peer == transitA ? 200 : 100;
+        return RibPath{peer, attributes, keys};
+    };
+
+    Fib fib;
+    runBenchmark("LocRib + Fib load, two full tables", table.Routes.size() * 2, [&]() {
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            locRib.Update(table.Routes[i], pathFor(transitA, table.AttributeIndex[i]));
+            locRib.Update(table.Routes[i], pathFor(transitB, table.AttributeIndex[i]));
+        }
+        fib.Apply(locRib.TakeChanges());
+    });
+    locRib.Purge();
+    std::cout << "Prefixes: " << locRib.size() << ", paths: " << locRib.path_count() << ", path lists: "
+              << locRib.path_list_count() << ", forwarding entries: " << fib.forwarding_entry_count() << std::endl;
+    std::cout << "Sampled prefixes via A: " << countForwardedTo(fib, table, TRANSIT_A) << ", via B: "
+              << countForwardedTo(fib, table, TRANSIT_B) << std::endl;
+
+    // Transit A's next hop becomes unreachable: the FIB converges by rewriting its forwarding entries, the Loc-RIB by
+    // re-running best path selection on the path lists that use it
+    size_t forwardingEntries = 0;
+    size_t pathListChanges = 0;
+    runBenchmark("Fib converge, lose transit A next hop", 1, [&]() {
+        pathListChanges = locRib.SetNextHopResolution(TRANSIT_A, NextHopResolution{false});
+        forwardingEntries = fib.Refresh(TRANSIT_A);
+    });
+    // What the Adj-RIBs-Out and the other consumers get to see afterwards
+    std::vector<RibChange> prefixChanges;
+    runBenchmark("Loc-RIB prefix changes after losing transit A", table.Routes.size(), [&]() {
+        prefixChanges = locRib.TakeChanges();
+    });
+    std::cout << "Forwarding entries rewritten: " << forwardingEntries << ", path lists with a new best path: "
+              << pathListChanges << ", prefix changes: " << prefixChanges.size() << std::endl;
+    std::cout << "Sampled prefixes via A: " << countForwardedTo(fib, table, TRANSIT_A) << ", via B: "
+              << countForwardedTo(fib, table, TRANSIT_B) << std::endl;
+
+    runBenchmark("Fib converge, transit A next hop restored", 1, [&]() {
+        locRib.SetNextHopResolution(TRANSIT_A, NextHopResolution{true});
+        fib.Refresh(TRANSIT_A);
+    });
+    fib.Apply(locRib.TakeChanges());
+
+    // For comparison, what the same failure costs when it has to be handled per prefix, i.e. withdrawing everything
+    // learned from transit A
+    runBenchmark("Per-prefix converge, withdraw transit A", table.Routes.size(), [&]() {
+        for (const auto &route : table.Routes) {
+            locRib.Withdraw(transitA, route);
+        }
+        fib.Apply(locRib.TakeChanges());
+    });
+    std::cout << "Sampled prefixes via A: " << countForwardedTo(fib, table, TRANSIT_A) << ", via B: "
+              << countForwardedTo(fib, table, TRANSIT_B) << std::endl;
+
+    benchmarkBackupLoss(table, attributeSets);
+    benchmarkResolution();
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Policy.h"
+
+// Prefix-list sizes seen on IXP route servers: a small peer, a regional network, a large transit customer cone, and a
+// full AS-SET expansion of a tier-1
+constexpr size_t PREFIX_LIST_SIZES[] = {100, 1000, 10000, 100000};
+constexpr size_t TABLE_SIZE = 900000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 90000;
+
+std::shared_ptr<const PrefixList> generatePrefixList(const SyntheticTable &table, const size_t size, std::mt19937 &random) {
+    std::uniform_int_distribution<size_t> route(0, table.Routes.size() - 1);
+    std::vector<PrefixListEntry> entries;
+    entries.reserve(size);
+
+    for (size_t i = 0; i < size; ++i) {
+        const auto &prefix = table.Routes[route(random)];
+        // Most IRR-generated filters allow deaggregation down to /24
+        entries.emplace_back(PrefixListEntry{static_cast<uint32_t>(i * 5 + 5), Permit, prefix.Prefix, prefix.Length,
+                                             prefix.Length, static_cast<uint8_t>(std::max<uint8_t>(prefix.Length, 24))});
+    }
+
+    return std::make_shared<const PrefixList>("IXP-PEER-" + std::to_string(size), std::move(entries));
+}
+
+int main() {
+    std::mt19937 random(7);
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+
+    PathAttributeStore store;
+    std::vector<std::shared_ptr<const PathAttributeSet>> attributeSets;
+    for (const auto &attributes : table.Attributes) {
+        attributeSets.emplace_back(store.Intern(attributes, true));
+    }
+
+    for (const auto size : PREFIX_LIST_SIZES) {
+        std::shared_ptr<const PrefixList> prefixList;
+        runBenchmark("PrefixList compile, " + std::to_string(size) + " entries", size, [&]() {
+            prefixList = generatePrefixList(table, size, random);
+        });
+
+        runBenchmark("PrefixList evaluate, " + std::to_string(size) + " entries", table.Routes.size(), [&]() {
+            uint64_t permitted = 0;
+            for (const auto &route : table.Routes) {
+                permitted += prefixList->Evaluate(route) == Permit;
+            }
+            doNotOptimize(permitted);
+        });
+    }
+
+    // A typical IXP import route-map: drop bogons and overly long paths, prefer a settlement-free peer, tag the rest
+    const auto bogons = std::make_shared<const PrefixList>("BOGONS", std::vector<PrefixListEntry>{
+            {10, Permit, 0x00000000, 8, 8, 32},
+            {20, Permit, 0x0A000000, 8, 8, 32},
+            {30, Permit, 0x7F000000, 8, 8, 32},
+            {40, Permit, 0xA9FE0000, 16, 16, 32},
+            {50, Permit, 0xAC100000, 12, 12, 32},
+            {60, Permit, 0xC0A80000, 16, 16, 32},
+            {70, Permit, 0xE0000000, 3, 3, 32}
+    });
+    const auto customers = generatePrefixList(table, 10000, random);
+
+    const RouteMap routeMap("IXP-IMPORT", {
+            {10, Deny, {{MatchPrefixList, 0, bogons}}, {}},
+            {20, Deny, {{MatchAsPathLengthAtLeast, 50}}, {}},
+            {30, Permit, {{MatchPrefixList, 0, customers}, {MatchFirstAs, 64501}}, {{SetLocalPref, 200}}},
+            {40, Permit, {{MatchFirstAs, 64502}}, {{SetLocalPref, 150}, {SetMultiExitDiscriminator, 0}}},
+            {50, Permit, {}, {{SetLocalPref, 100}}}
+    });
+
+    runBenchmark("RouteMap evaluate, 5 clauses", table.Routes.size(), [&]() {
+        uint64_t permitted = 0;
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            PolicyRoute route{table.Routes[i], *attributeSets[table.AttributeIndex[i]]};
+            permitted += routeMap.Evaluate(route) == Permit ? route.Keys.LocalPreference : 0;
+        }
+        doNotOptimize(permitted);
+    });
+
+    // 900k routes over ~90k distinct AS_PATHs, the DFA should only run once per distinct path
+    const auto regex = std::make_shared<const AsPathRegex>("^6450[1-3]_.*_[64512-65534,4200000000-4294967294]$");
+    runBenchmark("AsPathRegex match, cold cache", table.Routes.size(), [&]() {
+        uint64_t matched = 0;
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            matched += regex->Matches(*attributeSets[table.AttributeIndex[i]]->as_path());
+        }
+        doNotOptimize(matched);
+    });
+    runBenchmark("AsPathRegex match, warm cache", table.Routes.size(), [&]() {
+        uint64_t matched = 0;
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            matched += regex->Matches(*attributeSets[table.AttributeIndex[i]]->as_path());
+        }
+        doNotOptimize(matched);
+    });
+    // Import policy seen at most IXPs: honour BLACKHOLE, drop anything tagged by a specific peer, and rewrite the
+    // informational communities. The first pass also pays for decoding every attribute set's communities.
+    const RouteMap communityMap("COMMUNITY-IMPORT", {
+            {10, Permit, {{MatchCommunity, BLACKHOLE}}, {{SetLocalPref, 50}, {SetCommunityAdditive, NO_EXPORT}}},
+            {20, Deny, {{MatchCommunityAsn, 64503}}, {}},
+            {30, Permit, {{MatchCommunity, makeCommunity(64501, 100)}}, {{SetCommunityDelete, makeCommunity(64501, 100)}}},
+            {40, Permit, {}, {}}
+    });
+    for (const auto *pass : {"cold", "warm"}) {
+        runBenchmark(std::string("RouteMap evaluate, community matches, ") + pass, table.Routes.size(), [&]() {
+            uint64_t permitted = 0;
+            for (size_t i = 0; i < table.Routes.size(); ++i) {
+                PolicyRoute route{table.Routes[i], *attributeSets[table.AttributeIndex[i]]};
+                permitted += communityMap.Evaluate(route) == Permit;
+            }
+            doNotOptimize(permitted);
+        });
+    }
+    std::cout << "Distinct standard community sets: " << store.community_stores().Standard.size() << std::endl;
+
+    std::cout << "AsPathRegex DFA states: " << regex->state_count() << ", evaluations: " << regex->evaluations()
+              << " for " << store.as_paths().size() << " distinct AS_PATHs" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Rib.h"
+#include "../RouteRefresh.h"
+#include "../Export.h"
+#include "../Orf.h"
+
+constexpr size_t TABLE_SIZE = 900000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 90000;
+// A customer cone a peer filters us down to with ORF
+constexpr size_t ORF_SIZE = 10000;
+
+// Filling an eBGP peer's Adj-RIB-Out from a full Loc-RIB, answering a ROUTE-REFRESH for a full table from the
+// Adj-RIB-Out, pushing a prefix-list as ORF, and exporting through the peer's ORF entries and answering a ROUTE-REFRESH
+// after them
+int main() {
+    std::mt19937 random(7);
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+
+    PathAttributeStore store;
+    AdjRibOut adjRibOut(0);
+    std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+    for (const auto &attributes : table.Attributes) {
+        sets.emplace_back(store.Intern(attributes, true));
+    }
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        adjRibOut.Update(table.Routes[i], sets[table.AttributeIndex[i]]);
+    }
+
+    // What a session coming up is sent: every best path, learned from another eBGP peer, rewritten for this one
+    LocRib locRib;
+    const auto source = locRib.AddPeer(0xC0000201, 0xC0000201, true);
+    const auto peer = locRib.AddPeer(0xC0000202, 0xC0000202, true);
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        const auto &attributes = sets[table.AttributeIndex[i]];
+        locRib.Update(table.Routes[i], RibPath{source, attributes, attributes->keys()});
+    }
+    locRib.TakeChanges();
+    const ExportSession session{peer, 64496, 0xC0000263, true, false};
+
+    size_t bytes = 0;
+    size_t messages = 0;
+    {
+        AdjRibOut exported(peer);
+        RouteExporter exporter(session, exported, store);
+        runBenchmark("Export full Loc-RIB to an eBGP peer", locRib.size(), [&]() {
+            locRib.ForEach([&](const Route &route, const PathList &list) {
+                const auto best = list.best();
+                exporter.Export(route, best, best ? &locRib.peer(best->Peer) : nullptr);
+            });
+            messages = exporter.Flush([&](const std::vector<uint8_t> &update) {
+                bytes += update.size();
+            });
+        });
+        std::cout << "Exported: " << exported.size() << " prefixes, " << messages << " UPDATEs, " << bytes / 1024
+                  << " KiB" << std::endl;
+    }
+
+    bytes = 0;
+    runBenchmark("Refresh encode full Adj-RIB-Out", adjRibOut.size(), [&]() {
+        messages = forEachRefreshUpdate(adjRibOut, [&](const std::vector<uint8_t> &update) {
+            bytes += update.size();
+        });
+    });
+    std::cout << "Full table: " << messages << " UPDATEs, " << bytes / 1024 << " KiB" << std::endl;
+
+    std::uniform_int_distribution<size_t> route(0, table.Routes.size() - 1);
+    std::vector<PrefixListEntry> entries;
+    for (size_t i = 0; i < ORF_SIZE; ++i) {
+        const auto &prefix = table.Routes[route(random)];
+        entries.emplace_back(PrefixListEntry{static_cast<uint32_t>(i * 5 + 5), Permit, prefix.Prefix, prefix.Length,
+                                             prefix.Length, static_cast<uint8_t>(std::max<uint8_t>(prefix.Length, 24))});
+    }
+    const PrefixList prefixList("CUSTOMER-CONE", std::move(entries));
+
+    std::vector<std::vector<uint8_t>> orfMessages;
+    runBenchmark("ORF encode prefix-list", prefixList.size(), [&]() {
+        orfMessages = flattenOrfRouteRefreshMessages(prefixList);
+    });
+    OrfFilter filter;
+    runBenchmark("ORF decode and compile", prefixList.size(), [&]() {
+        for (const auto &message : orfMessages) {
+            const auto routeRefresh = parseBgpRouteRefreshMessage(std::span<const uint8_t>(message).subspan(19));
+            filter.Apply(parseOrfRequest(routeRefresh.Orf).Entries);
+        }
+        doNotOptimize(filter.filter()->size());
+    });
+    std::cout << "ORF: " << orfMessages.size() << " ROUTE-REFRESH messages, " << filter.size() << " entries"
+              << std::endl;
+
+    // The peer's ORF entries arriving on an established session: the Loc-RIB goes through export again, and all but
+    // the customer cone is withdrawn
+    bytes = 0;
+    AdjRibOut exported(peer);
+    RouteExporter exporter(session, exported, store);
+    locRib.ForEach([&](const Route &route, const PathList &list) {
+        const auto best = list.best();
+        exporter.Export(route, best, best ? &locRib.peer(best->Peer) : nullptr);
+    });
+    exporter.Flush([](const std::vector<uint8_t> &) {});
+    runBenchmark("Re-export full Loc-RIB through ORF", locRib.size(), [&]() {
+        const auto &orf = filter.filter();
+        locRib.ForEach([&](const Route &route, const PathList &list) {
+            const auto best = orf->Evaluate(route) == Permit ? list.best() : nullptr;
+            exporter.Export(route, best, best ? &locRib.peer(best->Peer) : nullptr);
+        });
+        messages = exporter.Flush([&](const std::vector<uint8_t> &update) {
+            bytes += update.size();
+        });
+    });
+    std::cout << "Re-exported: " << exported.size() << " prefixes left, " << messages << " UPDATEs, " << bytes / 1024
+              << " KiB" << std::endl;
+
+    bytes = 0;
+    runBenchmark("Refresh encode Adj-RIB-Out after ORF", exported.size(), [&]() {
+        messages = forEachRefreshUpdate(exported, [&](const std::vector<uint8_t> &update) {
+            bytes += update.size();
+        });
+    });
+    std::cout << "Filtered: " << messages << " UPDATEs, " << bytes / 1024 << " KiB" << std::endl;
+    return 0;
+}
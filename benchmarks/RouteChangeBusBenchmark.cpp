@@ -0,0 +1,141 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <random>
+#include <unordered_map>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+#include "../RouteChangeBus.h"
+
+constexpr size_t TABLE_SIZE = 500000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 50000;
+// After the table is loaded, CHURN_ROUNDS rounds of CHURN_SIZE random prefixes each moving to other attributes
+constexpr size_t CHURN_ROUNDS = 4;
+constexpr size_t CHURN_SIZE = TABLE_SIZE / 4;
+// Loc-RIB operations per published batch, about what one UPDATE carries
+constexpr size_t BATCH_SIZE = 64;
+// The fast subscriber takes its queue after every batch, the slow one only after this many
+constexpr size_t SLOW_EVERY = 2000;
+
+struct Consumer {
+    std::shared_ptr<RouteChangeSubscription> Subscription;
+    size_t Batches = 0;
+    size_t Changes = 0;
+    size_t PeakPending = 0;
+    // Latest best attributes seen per prefix, to check nothing was lost
+    std::unordered_map<uint64_t, std::shared_ptr<const std::vector<PathAttribute>>> State;
+};
+
+void consume(Consumer &consumer, const std::vector<RouteChange> &changes) {
+    if (changes.empty()) {
+        return;
+    }
+    ++consumer.Batches;
+    consumer.Changes += changes.size();
+    for (const auto &change : changes) {
+        consumer.State[routeKey(change.Prefix)] = change.Best ? change.Best->Attributes : nullptr;
+    }
+}
+
+size_t countMismatches(const Consumer &consumer, const LocRib &locRib, const SyntheticTable &table) {
+    size_t mismatches = 0;
+    for (const auto &route : table.Routes) {
+        const auto paths = locRib.Find(route);
+        const auto best = paths && paths->best() ? paths->best()->Attributes.get() : nullptr;
+        const auto it = consumer.State.find(routeKey(route));
+        mismatches += it == consumer.State.end() || !it->second != !best || (best && *it->second != best->attributes());
+    }
+    return mismatches;
+}
+
+// A full table is loaded and then churns, published batch by batch the way BgpServer does after every UPDATE. One
+// subscriber keeps up, the other falls behind and has to coalesce.
+int main() {
+    std::mt19937 random(7);
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    RibMemory ribMemory;
+    PathAttributeStore store(ribMemory.resource());
+    LocRib locRib(ribMemory.resource());
+    std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+    for (const auto &attributes : table.Attributes) {
+        sets.emplace_back(store.Intern(attributes, true));
+    }
+    const auto peer = locRib.AddPeer(0xC0000201, 0x0A000001, true);
+
+    // Decided up front, so only publishing is timed
+    std::vector<std::vector<RibChange>> batches;
+    size_t operations = 0;
+    const auto update = [&](const size_t i, const size_t attributeIndex) {
+        const auto &attributes = sets[attributeIndex % sets.size()];
+        locRib.Update(table.Routes[i], RibPath{peer, attributes, attributes->keys()});
+        if (++operations % BATCH_SIZE == 0) {
+            batches.emplace_back(locRib.TakeChanges());
+        }
+    };
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        update(i, table.AttributeIndex[i]);
+    }
+    std::uniform_int_distribution<size_t> prefix(0, table.Routes.size() - 1);
+    for (size_t round = 1; round <= CHURN_ROUNDS; ++round) {
+        for (size_t i = 0; i < CHURN_SIZE; ++i) {
+            const auto index = prefix(random);
+            update(index, table.AttributeIndex[index] + round);
+        }
+    }
+    batches.emplace_back(locRib.TakeChanges());
+    size_t changeCount = 0;
+    for (const auto &batch : batches) {
+        changeCount += batch.size();
+    }
+    std::cout << "Changes: " << changeCount << " in " << batches.size() << " batches" << std::endl;
+
+    {
+        RouteChangeBus bus;
+        runBenchmark("RouteChangeBus publish, no subscribers", changeCount, [&]() {
+            for (const auto &batch : batches) {
+                bus.Publish(batch);
+            }
+        });
+    }
+
+    // Consumers would normally have threads of their own. Draining them in between publishes keeps the numbers down to
+    // the bus itself, and deterministic.
+    RouteChangeBus bus;
+    Consumer fast{bus.Subscribe("fast"), 0, 0, 0, {}};
+    Consumer slow{bus.Subscribe("slow"), 0, 0, 0, {}};
+    std::vector<std::vector<RouteChange>> fastTaken;
+    std::vector<std::vector<RouteChange>> slowTaken;
+    fastTaken.reserve(batches.size());
+    runBenchmark("RouteChangeBus publish and take, fast and slow subscriber", changeCount, [&]() {
+        for (size_t i = 0; i < batches.size(); ++i) {
+            bus.Publish(batches[i]);
+            fastTaken.emplace_back(fast.Subscription->Take());
+            if ((i + 1) % SLOW_EVERY == 0) {
+                slow.PeakPending = std::max(slow.PeakPending, slow.Subscription->pending());
+                slowTaken.emplace_back(slow.Subscription->Take());
+            }
+        }
+        slowTaken.emplace_back(slow.Subscription->Take());
+    });
+    for (const auto &changes : fastTaken) {
+        consume(fast, changes);
+    }
+    for (const auto &changes : slowTaken) {
+        consume(slow, changes);
+    }
+
+    for (const auto *consumer : {&fast, &slow}) {
+        std::cout << consumer->Subscription->name() << " subscriber: " << consumer->Changes << " changes in "
+                  << consumer->Batches << " batches, " << consumer->Subscription->coalesced_count()
+                  << " coalesced, peak " << consumer->PeakPending << " pending, "
+                  << countMismatches(*consumer, locRib, table) << " prefixes out of date" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "MemoryUsage.h"
+#include "../Allocators.h"
+#include "../Rib.h"
+#include "../BgpUpdateMessage.h"
+
+// Roughly the public IPv4 table, with about ten prefixes per attribute set
+constexpr size_t FULL_TABLE_SIZE = 900000;
+constexpr size_t PREFIXES_PER_ATTRIBUTE_SET = 10;
+constexpr size_t PEER_COUNTS[] = {1, 4, 16, 64};
+constexpr size_t MAX_MESSAGE_SIZE = 4096;
+// Offsets each peer's choice of attribute set for a prefix, so peers disagree on AS_PATH length and best path has
+// something to decide
+constexpr size_t PEER_ATTRIBUTE_STRIDE = 7919;
+constexpr auto DEFAULT_RESULTS_PATH = "ScalingBenchmark.csv";
+constexpr auto RESULTS_HEADER = "peers,prefixes,paths,attribute_sets,ingest_seconds,ingest_paths_per_second,"
+                                "withdraw_convergence_seconds,withdraw_best_path_changes,"
+                                "reannounce_convergence_seconds,reannounce_best_path_changes,rib_bytes,bytes_per_path,"
+                                "resident_bytes,resident_bytes_per_path,peak_resident_bytes";
+
+// One full-table eBGP peer's view of table: every prefix, each through one of the table's attribute sets with the
+// peer's ASN prepended and the peer as next hop. Encoded the way forEachRefreshUpdate() sends a table, prefixes that
+// share an attribute set packed into as few UPDATEs as fit in 4096 octets.
+std::vector<std::vector<uint8_t>> encodePeerTable(const SyntheticTable &table, const uint32_t peer) {
+    const uint32_t asn = 65000 + peer;
+    const uint32_t address = 0x0A000001 + peer;
+    std::unordered_map<size_t, std::vector<Route>> groups;
+    for (size_t i = 0; i < table.Routes.size(); ++i) {
+        groups[(table.AttributeIndex[i] + peer * PEER_ATTRIBUTE_STRIDE) % table.Attributes.size()].emplace_back(
+                table.Routes[i]);
+    }
+
+    std::vector<std::vector<uint8_t>> messages;
+    for (const auto &[index, routes] : groups) {
+        BgpUpdateMessage message{0, {}, 0, {table.Attributes[index].begin(), table.Attributes[index].end()}, {}};
+        size_t attributesSize = 0;
+        for (auto &attribute : message.PathAttributes) {
+            if (attribute.Type == AsPathAttribute) {
+                // One AS_SEQUENCE segment, see generateSyntheticAttributes()
+                attribute.Value[1] = static_cast<uint8_t>(attribute.Value[1] + 1);
+                attribute.Value.insert(attribute.Value.begin() + 2, {_32to8(asn)});
+            } else if (attribute.Type == NextHopAttribute) {
+                attribute.Value = {_32to8(address)};
+            }
+            attributesSize += 3 + attribute.Value.size();
+        }
+        for (size_t i = 0; i < routes.size();) {
+            message.NLRI.clear();
+            for (size_t size = 23 + attributesSize; i < routes.size() && size + 5 <= MAX_MESSAGE_SIZE; size += 5) {
+                message.NLRI.emplace_back(routes[i++]);
+            }
+            messages.emplace_back(flattenBgpUpdateMessage(message));
+        }
+    }
+    return messages;
+}
+
+// Everything BgpServer holds for its peers, on RibMemory like BgpServer's. Memory is declared first, so everything
+// allocated from it is gone before it is.
+struct ScalingRib {
+    RibMemory Memory;
+    CountingResource Counting{Memory.resource()};
+    PathAttributeStore Store{&Counting};
+    LocRib Rib{&Counting};
+    std::vector<std::unique_ptr<AdjRibIn>> Peers;
+    MessageArena Arena;
+};
+
+// Drains the Loc-RIB's changes, counting the ones best path moved for
+size_t takeBestPathChanges(LocRib &locRib) {
+    const auto changes = locRib.TakeChanges();
+    return static_cast<size_t>(std::count_if(changes.begin(), changes.end(), [](const auto &change) {
+        return change.BestChanged;
+    }));
+}
+
+// Receives a peer's table the way BgpServer::HandleUpdate() does, without import policy. Returns the number of best
+// path changes.
+size_t ingest(ScalingRib &rib, AdjRibIn &adjRibIn, const std::vector<std::vector<uint8_t>> &messages) {
+    size_t changes = 0;
+    for (const auto &bytes : messages) {
+        rib.Arena.Reset();
+        const auto message = parseBgpUpdateMessage(std::span<const uint8_t>(bytes).subspan(19),
+                                                   rib.Arena.resource());
+        for (const auto &route : message.WithdrawnRoutes) {
+            if (adjRibIn.Withdraw(route)) {
+                rib.Rib.Withdraw(adjRibIn.peer(), route);
+            }
+        }
+        if (!message.NLRI.empty()) {
+            const auto attributes = rib.Store.Intern(message.PathAttributes, true);
+            for (const auto &route : message.NLRI) {
+                if (adjRibIn.Update(route, attributes)) {
+                    rib.Rib.Update(route, RibPath{adjRibIn.peer(), attributes, attributes->keys()});
+                }
+            }
+        }
+        changes += takeBestPathChanges(rib.Rib);
+    }
+    return changes;
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// peerCount full-table peers in one process, so peak RSS is this configuration's alone. Appends a row to resultsPath.
+int runPeerCount(const size_t peerCount, const size_t prefixCount, const std::string &resultsPath) {
+    const auto attributeSetCount = std::max<size_t>(prefixCount / PREFIXES_PER_ATTRIBUTE_SET, 1);
+    const auto table = generateSyntheticTable(prefixCount, attributeSetCount);
+    const auto baseline = residentBytes();
+    const auto paths = peerCount * table.Routes.size();
+    const auto name = std::to_string(peerCount) + (peerCount == 1 ? " peer" : " peers");
+
+    ScalingRib rib;
+    // The first peer's table is kept for re-announcing it, the others are encoded as their session comes up
+    const auto firstTable = encodePeerTable(table, 0);
+    double ingestSeconds = 0;
+    for (uint32_t peer = 0; peer < peerCount; ++peer) {
+        const auto id = rib.Rib.AddPeer(0x0A000001 + peer, 0x0A000001 + peer, true);
+        rib.Peers.emplace_back(std::make_unique<AdjRibIn>(id, &rib.Counting));
+        const auto encoded = peer == 0 ? std::vector<std::vector<uint8_t>>{} : encodePeerTable(table, peer);
+        const auto start = std::chrono::steady_clock::now();
+        ingest(rib, *rib.Peers.back(), peer == 0 ? firstTable : encoded);
+        ingestSeconds += secondsSince(start);
+    }
+    const auto ribBytes = rib.Counting.live();
+    const auto current = residentBytes();
+    const auto resident = current - std::min(current, baseline);
+    const auto attributeSets = rib.Store.size();
+
+    // The first peer's session goes down, and every prefix it was best for moves to the next best path
+    auto &first = *rib.Peers.front();
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &route : table.Routes) {
+        if (first.Withdraw(route)) {
+            rib.Rib.Withdraw(first.peer(), route);
+        }
+    }
+    const auto withdrawChanges = takeBestPathChanges(rib.Rib);
+    const auto withdrawSeconds = secondsSince(start);
+    rib.Rib.Purge();
+    rib.Store.Purge();
+
+    // And comes back with the same table
+    start = std::chrono::steady_clock::now();
+    const auto reannounceChanges = ingest(rib, first, firstTable);
+    const auto reannounceSeconds = secondsSince(start);
+
+    const auto peakResident = peakResidentBytes();
+    printBenchmarkResult({name + ", ingest", paths, ingestSeconds});
+    printBenchmarkResult({name + ", withdraw one peer", table.Routes.size(), withdrawSeconds});
+    printBenchmarkResult({name + ", re-announce one peer", table.Routes.size(), reannounceSeconds});
+    std::cout << name << ": " << withdrawChanges << " and " << reannounceChanges << " best path changes, "
+              << std::fixed << std::setprecision(1) << static_cast<double>(ribBytes) / static_cast<double>(paths)
+              << " bytes/path in the RIB, " << static_cast<double>(resident) / static_cast<double>(paths)
+              << " bytes/path resident, " << peakResident / 1048576 << " MiB peak RSS" << std::endl;
+
+    std::ofstream results(resultsPath, std::ios::app);
+    results << std::fixed << std::setprecision(6) << peerCount << ',' << table.Routes.size() << ',' << paths << ','
+            << attributeSets << ',' << ingestSeconds << ',' << static_cast<double>(paths) / ingestSeconds << ','
+            << withdrawSeconds << ',' << withdrawChanges << ',' << reannounceSeconds << ',' << reannounceChanges << ','
+            << ribBytes << ',' << static_cast<double>(ribBytes) / static_cast<double>(paths) << ',' << resident << ','
+            << static_cast<double>(resident) / static_cast<double>(paths) << ',' << peakResident << std::endl;
+    if (!results) {
+        std::cerr << "Could not write " << resultsPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// ScalingBenchmark [prefixes [results.csv]] runs every peer count against a table of prefixes (a full table by
+// default), each in a process of its own, and writes one CSV row per peer count to results.csv. The generator is
+// seeded, so runs on the same build are comparable. A full table at 64 peers takes several GiB.
+int main(int argc, char **argv) {
+    if (argc == 5 && std::string(argv[1]) == "--peers") {
+        return runPeerCount(std::stoul(argv[2]), std::stoul(argv[3]), argv[4]);
+    }
+    const size_t prefixCount = argc > 1 ? std::stoul(argv[1]) : FULL_TABLE_SIZE;
+    const std::string resultsPath = argc > 2 ? argv[2] : DEFAULT_RESULTS_PATH;
+    {
+        std::ofstream results(resultsPath, std::ios::trunc);
+        results << RESULTS_HEADER << std::endl;
+        if (!results) {
+            std::cerr << "Could not write " << resultsPath << std::endl;
+            return 1;
+        }
+    }
+    for (const auto peerCount : PEER_COUNTS) {
+        const auto command = std::string("\"") + argv[0] + "\" --peers " + std::to_string(peerCount) + " " +
+                             std::to_string(prefixCount) + " \"" + resultsPath + "\"";
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << peerCount << " peers failed" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Results written to " << resultsPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+#include "Benchmark.h"
+#include "SyntheticTable.h"
+#include "../Allocators.h"
+#include "../RibSnapshot.h"
+
+constexpr size_t TABLE_SIZE = 1000000;
+constexpr size_t ATTRIBUTE_SET_COUNT = 100000;
+constexpr uint32_t PEER_COUNT = 3;
+// Routes captured per message, as in BgpServer
+constexpr size_t CAPTURE_BATCH = 16384;
+
+// Warm restart: a full table from three peers, 3M paths, written to a snapshot, mapped, and loaded back into an empty
+// RIB
+int main() {
+    const std::string path = "SnapshotBenchmark.snapshot";
+    const auto table = generateSyntheticTable(TABLE_SIZE, ATTRIBUTE_SET_COUNT);
+    {
+        RibMemory ribMemory;
+        PathAttributeStore store(ribMemory.resource());
+        LocRib locRib(ribMemory.resource());
+        std::vector<std::unique_ptr<AdjRibIn>> adjRibsIn;
+        for (uint32_t peer = 0; peer < PEER_COUNT; ++peer) {
+            adjRibsIn.emplace_back(std::make_unique<AdjRibIn>(locRib.AddPeer(0xC0000201 + peer, 0x0A000001 + peer, true),
+                                                              ribMemory.resource()));
+        }
+        std::vector<std::shared_ptr<const PathAttributeSet>> sets;
+        for (const auto &attributes : table.Attributes) {
+            sets.emplace_back(store.Intern(attributes, true));
+        }
+        for (size_t i = 0; i < table.Routes.size(); ++i) {
+            for (auto &adjRibIn : adjRibsIn) {
+                const auto &attributes = sets[(table.AttributeIndex[i] + adjRibIn->peer()) % sets.size()];
+                adjRibIn->Update(table.Routes[i], attributes);
+                locRib.Update(table.Routes[i], RibPath{adjRibIn->peer(), attributes, attributes->keys()});
+            }
+        }
+        locRib.TakeChanges();
+
+        std::vector<const AdjRibIn *> views;
+        for (const auto &adjRibIn : adjRibsIn) {
+            views.emplace_back(adjRibIn.get());
+        }
+        // BgpServer captures a batch between messages and writes on a thread of its own, so the longest batch is what
+        // holds up the session
+        RibSnapshotCapture capture;
+        size_t batches = 0;
+        std::chrono::steady_clock::duration longest{};
+        runBenchmark("Snapshot capture, session thread", locRib.path_count(), [&]() {
+            RibSnapshotCapturer capturer(locRib, views);
+            for (bool done = false; !done; ++batches) {
+                const auto start = std::chrono::steady_clock::now();
+                done = capturer.Step(CAPTURE_BATCH);
+                longest = std::max(longest, std::chrono::steady_clock::now() - start);
+            }
+            capture = capturer.Take();
+        });
+        std::cout << "Snapshot capture: " << batches << " batches of " << CAPTURE_BATCH << ", longest "
+                  << std::chrono::duration<double, std::milli>(longest).count() << " ms" << std::endl;
+        runBenchmark("Snapshot sort and write, writer thread", locRib.path_count(), [&]() {
+            writeRibSnapshot(path, std::move(capture));
+        });
+    }
+
+    std::unique_ptr<RibSnapshot> snapshot;
+    runBenchmark("Snapshot map and validate", 1, [&]() {
+        snapshot = std::make_unique<RibSnapshot>(path);
+    });
+    std::cout << "Snapshot: " << snapshot->header().RouteCount << " prefixes, " << snapshot->header().PathCount
+              << " paths, " << snapshot->header().AttributeSetCount << " attribute sets" << std::endl;
+
+    RibMemory ribMemory;
+    PathAttributeStore store(ribMemory.resource());
+    LocRib locRib(ribMemory.resource());
+    std::vector<std::unique_ptr<AdjRibIn>> adjRibsIn;
+    runBenchmark("Snapshot restore into Loc-RIB and Adj-RIB-Ins", snapshot->header().PathCount, [&]() {
+        adjRibsIn = restoreRibSnapshot(*snapshot, store, locRib, ribMemory.resource());
+    });
+    std::cout << "Restored " << locRib.size() << " prefixes, " << locRib.path_count() << " paths, "
+              << locRib.TakeChanges().size() << " changes" << std::endl;
+
+    snapshot.reset();
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,110 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#ifndef BGP_SYNTHETICTABLE_H
+#define BGP_SYNTHETICTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <unordered_set>
+#include "../Util.h"
+#include "../Route.h"
+#include "../Path.h"
+#include "../Communities.h"
+
+// A generated IPv4 table shaped like a DFZ full table: mostly /24s, AS_PATHs of 1-10 hops, and many prefixes sharing
+// one attribute set the way prefixes from the same origin do. AS_PATHs are encoded with 4-octet ASNs. Every attribute
+// set carries a few informational communities of its neighbor, and a small fraction are tagged BLACKHOLE.
+struct SyntheticTable {
+    std::vector<Route> Routes;
+    // Index into Attributes for every entry of Routes
+    std::vector<uint32_t> AttributeIndex;
+    std::vector<std::vector<PathAttribute>> Attributes;
+    // Every ASN used, by position in the AS_PATH, for building filters that actually match something
+    std::vector<std::vector<uint32_t>> AsPaths;
+};
+
+std::vector<PathAttribute> generateSyntheticAttributes(const std::vector<uint32_t> &asns, const NextHop nextHop,
+                                                       const MultiExitDiscriminator med, const Origin origin,
+                                                       const std::vector<Community> &communities = {}) {
+    std::vector<uint8_t> asPath = {ASSequence, static_cast<uint8_t>(asns.size())};
+    for (const auto asn : asns) {
+        const uint8_t asnBytes[4] = {_32to8(asn)};
+        asPath.insert(asPath.end(), asnBytes, asnBytes + 4);
+    }
+
+    std::vector<PathAttribute> attributes = {
+            {Transitive, OriginAttribute, {origin}},
+            {Transitive, AsPathAttribute, {asPath.begin(), asPath.end()}},
+            {Transitive, NextHopAttribute, {_32to8(nextHop)}},
+            {Optional, MultiExitDiscriminatorAttribute, {_32to8(med)}}
+    };
+    if (!communities.empty()) {
+        std::vector<uint8_t> value;
+        for (const auto community : communities) {
+            const uint8_t communityBytes[4] = {_32to8(community)};
+            value.insert(value.end(), communityBytes, communityBytes + 4);
+        }
+        attributes.emplace_back(PathAttribute{static_cast<uint8_t>(Optional | Transitive), CommunityAttribute,
+                                                    {value.begin(), value.end()}});
+    }
+    return attributes;
+}
+
+SyntheticTable generateSyntheticTable(const size_t routeCount, const size_t attributeSetCount,
+                                      const uint32_t seed = 1) {
+    std::mt19937 random(seed);
+    SyntheticTable table;
+
+    // Rough shape of the public IPv4 table by prefix length
+    std::discrete_distribution<int> prefixLength({
+            /* /8-/15 */ 1, 1, 1, 1, 1, 2, 3, 6,
+            /* /16-/23 */ 80, 15, 30, 60, 120, 110, 180, 180,
+            /* /24 */ 1200
+    });
+    // AS_PATH lengths cluster around 3-5 hops
+    std::discrete_distribution<int> pathLength({0, 40, 170, 270, 240, 140, 70, 35, 15, 10, 5});
+    std::uniform_int_distribution<uint32_t> asn(1, 400000);
+    std::uniform_int_distribution<uint32_t> upstream(0, 15);
+    std::uniform_int_distribution<uint32_t> address;
+
+    // A handful of upstream next hops and neighbor ASes, like a router with a few transits and peers
+    for (size_t i = 0; i < attributeSetCount; ++i) {
+        const auto neighbor = upstream(random);
+        std::vector<uint32_t> path = {64500 + neighbor};
+        const auto length = pathLength(random);
+        for (int hop = 1; hop < length; ++hop) {
+            path.emplace_back(asn(random));
+        }
+        std::vector<Community> communities = {makeCommunity(static_cast<uint16_t>(64500 + neighbor), 100 + i % 4),
+                                              makeCommunity(static_cast<uint16_t>(64500 + neighbor), 3000 + i % 50)};
+        if (i % 500 == 0) {
+            communities.emplace_back(BLACKHOLE);
+        }
+        table.Attributes.emplace_back(generateSyntheticAttributes(path, 0xC0000201 + neighbor, neighbor * 10,
+                                                                  i % 16 == 0 ? Incomplete : IGP, communities));
+        table.AsPaths.emplace_back(std::move(path));
+    }
+
+    // Prefixes sharing an attribute set skew towards a few large origins
+    std::geometric_distribution<uint32_t> attributeSet(8.0 / static_cast<double>(attributeSetCount));
+    std::unordered_set<uint64_t> seen;
+    table.Routes.reserve(routeCount);
+    table.AttributeIndex.reserve(routeCount);
+
+    while (table.Routes.size() < routeCount) {
+        const auto length = static_cast<uint8_t>(8 + prefixLength(random));
+        const auto prefix = address(random) & ~(UINT32_MAX >> length);
+        if (!seen.insert(static_cast<uint64_t>(prefix) << 8 | length).second) {
+            continue;
+        }
+        table.Routes.emplace_back(Route{length, prefix});
+        table.AttributeIndex.emplace_back(attributeSet(random) % attributeSetCount);
+    }
+
+    return table;
+}
+
+#endif //BGP_SYNTHETICTABLE_H
@@ -0,0 +1,45 @@
+//
+// Created by zach on 2026-10-19.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+
+#include "../ConvergenceTrace.h"
+
+// Reports how long sampled prefix changes spent between each pair of stages, e.g.
+//   ConvergenceTraceDump trace/convergence.trace
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <convergence trace>" << std::endl;
+        return 2;
+    }
+    try {
+        const auto trace = readConvergenceTrace(argv[1]);
+        size_t withdrawn = 0;
+        for (const auto &sample : trace.Samples) {
+            withdrawn += sample.Withdrawn;
+        }
+        std::cout << trace.Samples.size() << " prefix changes sampled 1 in " << trace.SampleEvery << ", " << withdrawn
+                  << " of them withdrawals. Latencies in microseconds." << std::endl;
+        std::cout << std::left << std::setw(26) << "Step" << std::right << std::setw(10) << "Count" << std::setw(12)
+                  << "p50" << std::setw(12) << "p90" << std::setw(12) << "p99" << std::setw(12) << "p99.9"
+                  << std::setw(12) << "max" << std::endl;
+        const auto microseconds = [](const int64_t nanoseconds) {
+            return static_cast<double>(nanoseconds) / 1e3;
+        };
+        for (const auto &step : summarizeConvergenceTrace(trace.Samples)) {
+            std::cout << std::left << std::setw(26) << step.Name << std::right << std::setw(10) << step.Count
+                      << std::fixed << std::setprecision(1) << std::setw(12) << microseconds(step.P50)
+                      << std::setw(12) << microseconds(step.P90) << std::setw(12) << microseconds(step.P99)
+                      << std::setw(12) << microseconds(step.P999) << std::setw(12) << microseconds(step.Max)
+                      << std::endl;
+        }
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}